@@ -0,0 +1,184 @@
+// Copyright (C) 2018-2020 - DevSH Graphics Programming Sp. z O.O.
+// This file is part of the "Nabla Engine".
+// For conditions of distribution and use, see copyright notice in nabla.h
+
+#ifndef _C_ENVMAP_SAMPLING_TABLE_BUILDER_H_INCLUDED_
+#define _C_ENVMAP_SAMPLING_TABLE_BUILDER_H_INCLUDED_
+
+#include <nabla.h>
+
+#include <cmath>
+#include <numeric>
+#include <algorithm>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP>=2)
+#include <immintrin.h>
+#define _ENVMAP_SAMPLING_TABLE_BUILDER_SSE_
+#endif
+
+
+//! Builds the importance sampling LUTs for an equirectangular envmap: `phi` and `pdf` per texel, `theta` per row.
+/** Per row, the luminance times `sin(theta)` goes straight into the row's slot of a single double buffer, gets prefix summed in place into
+the conditional CDF and normalized, all in one pass over the texels with rows spread over threads. The marginal CDF is a prefix sum over
+the row integrals. The conditional pdf of a texel is recovered from its CDF step, so the luminance never needs its own buffer.
+Inverting the CDFs doesn't need a binary search per texel because the LUT's sample points `(i+0.5)/N` are increasing, so a single
+linear merge of the sample points against the CDF finds every interval in `O(N)` per row.
+
+Scratch is kept between builds and only grows, so rebuilding for a same-sized (or smaller) envmap doesn't allocate.
+Rows which are completely black get a uniform conditional CDF instead of dividing by zero, the marginal CDF never picks them anyway. */
+class CEnvmapSamplingTableBuilder
+{
+	public:
+		//! `texels` are `channelCount` floats each, tightly packed rows, only the first 3 channels contribute to the luminance.
+		//! `phiPdfLUT` receives `width*height` (phi,pdf) pairs and `thetaLUT` receives `height` floats.
+		//! Returns the factor that normalizes the envmap's luminance into a pdf over the sphere.
+		float build(const float* texels, const uint32_t width, const uint32_t height, const uint32_t channelCount, float* phiPdfLUT, float* thetaLUT)
+		{
+			assert(width>0u && height>0u && channelCount>0u && channelCount<=4u);
+			const size_t texelCount = size_t(width)*height;
+			if (conditionalCdf.size()<texelCount)
+				conditionalCdf.resize(texelCount);
+			if (rowIndices.size()<height)
+			{
+				rowIndices.resize(height);
+				std::iota(rowIndices.begin(),rowIndices.end(),0u);
+				rowIntegrals.resize(height);
+				marginalCdf.resize(height);
+				sampledRows.resize(height);
+				sampledThetas.resize(height);
+			}
+			const auto rowsBegin = rowIndices.begin();
+			const auto rowsEnd = rowsBegin+height;
+
+			std::for_each(nbl::core::execution::par_unseq,rowsBegin,rowsEnd,[&](const uint32_t y) -> void
+			{
+				const double sinTheta = std::sin(nbl::core::PI<double>()*((y+0.5)/double(height)));
+				double* const cdf = conditionalCdf.data()+size_t(y)*width;
+				computeRowLuminance(texels+size_t(y)*width*channelCount,width,channelCount,cdf);
+
+				double sum = 0.0;
+				for (uint32_t x=0u; x<width; x++)
+				{
+					sum += cdf[x]*sinTheta;
+					cdf[x] = sum;
+				}
+				rowIntegrals[y] = sum;
+
+				if (sum>0.0)
+				{
+					const double rcpSum = 1.0/sum;
+					for (uint32_t x=0u; x<width; x++)
+						cdf[x] *= rcpSum;
+				}
+				else
+				{
+					for (uint32_t x=0u; x<width; x++)
+						cdf[x] = double(x+1u)/double(width);
+				}
+			});
+
+			double marginalIntegral = 0.0;
+			for (uint32_t y=0u; y<height; y++)
+			{
+				marginalIntegral += rowIntegrals[y];
+				marginalCdf[y] = marginalIntegral;
+			}
+			if (marginalIntegral<=0.0)
+				return 0.f;
+			for (uint32_t y=0u; y<height; y++)
+				marginalCdf[y] /= marginalIntegral;
+
+			// the merge over the marginal CDF is serial, so find the row every LUT row samples up front
+			uint32_t rowToSample = 0u;
+			for (uint32_t y=0u; y<height; y++)
+			{
+				const double xi = (y+0.5)/double(height);
+				rowToSample = mergeStep(marginalCdf.data(),height,xi,rowToSample);
+				sampledRows[y] = rowToSample;
+				sampledThetas[y] = remap(marginalCdf.data(),height,xi,rowToSample)*nbl::core::PI<double>();
+				thetaLUT[y] = float(sampledThetas[y]);
+			}
+
+			std::for_each(nbl::core::execution::par_unseq,rowsBegin,rowsEnd,[&](const uint32_t y) -> void
+			{
+				const uint32_t rowToSample = sampledRows[y];
+				const double marginalPdf = rowIntegrals[rowToSample]/marginalIntegral;
+				const double theta = sampledThetas[y];
+				const double sinTheta = std::sin(theta);
+				const double pdfFactor = sinTheta==0.0 ? 0.0:(marginalPdf/(2.0*nbl::core::PI<double>()*nbl::core::PI<double>()*sinTheta));
+
+				const double* const cdf = conditionalCdf.data()+size_t(rowToSample)*width;
+				float* out = phiPdfLUT+size_t(y)*width*2u;
+				uint32_t colToSample = 0u;
+				for (uint32_t x=0u; x<width; x++)
+				{
+					const double xi = (x+0.5)/double(width);
+					colToSample = mergeStep(cdf,width,xi,colToSample);
+					const double conditionalPdf = cdf[colToSample]-(colToSample ? cdf[colToSample-1u]:0.0);
+					*out++ = float(remap(cdf,width,xi,colToSample)*2.0*nbl::core::PI<double>());
+					*out++ = float(conditionalPdf*pdfFactor);
+				}
+			});
+
+			return float(double(texelCount)/(marginalIntegral*2.0*nbl::core::PI<double>()*nbl::core::PI<double>()));
+		}
+
+	private:
+		//! First index whose CDF value is greater than `xi` (the interval `xi` falls in), given that the previous (smaller) `xi` landed at `start`
+		static inline uint32_t mergeStep(const double* cdf, const uint32_t count, const double xi, uint32_t start)
+		{
+			while (start+1u<count && cdf[start]<=xi)
+				start++;
+			return start;
+		}
+		//! Position of `xi` within the CDF in [0,1], linear within the interval
+		static inline double remap(const double* cdf, const uint32_t count, const double xi, const uint32_t interval)
+		{
+			const double begin = interval ? cdf[interval-1u]:0.0;
+			const double dx = (xi-begin)/(cdf[interval]-begin);
+			return (interval+dx)/double(count);
+		}
+
+		static inline void computeRowLuminance(const float* texels, const uint32_t width, const uint32_t channelCount, double* out)
+		{
+			constexpr float LuminanceScales[3] = {0.2126729f,0.7151522f,0.0721750f};
+			uint32_t x = 0u;
+			#ifdef _ENVMAP_SAMPLING_TABLE_BUILDER_SSE_
+			if (channelCount==4u)
+			{
+				const __m128 scaleR = _mm_set1_ps(LuminanceScales[0]);
+				const __m128 scaleG = _mm_set1_ps(LuminanceScales[1]);
+				const __m128 scaleB = _mm_set1_ps(LuminanceScales[2]);
+				for (; x+4u<=width; x+=4u)
+				{
+					// four RGBA texels transposed into RRRR GGGG BBBB AAAA
+					__m128 r = _mm_loadu_ps(texels+x*4u+0u);
+					__m128 g = _mm_loadu_ps(texels+x*4u+4u);
+					__m128 b = _mm_loadu_ps(texels+x*4u+8u);
+					__m128 a = _mm_loadu_ps(texels+x*4u+12u);
+					_MM_TRANSPOSE4_PS(r,g,b,a);
+					const __m128 luma = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r,scaleR),_mm_mul_ps(g,scaleG)),_mm_mul_ps(b,scaleB));
+					_mm_storeu_pd(out+x,_mm_cvtps_pd(luma));
+					_mm_storeu_pd(out+x+2u,_mm_cvtps_pd(_mm_movehl_ps(luma,luma)));
+				}
+			}
+			#endif
+			const uint32_t lumaChannels = std::min(channelCount,3u);
+			for (; x<width; x++)
+			{
+				double luma = 0.0;
+				for (uint32_t ch=0u; ch<lumaChannels; ch++)
+					luma += LuminanceScales[ch]*texels[x*channelCount+ch];
+				out[x] = luma;
+			}
+		}
+
+		nbl::core::vector<double> conditionalCdf;
+		nbl::core::vector<double> rowIntegrals;
+		nbl::core::vector<double> marginalCdf;
+		nbl::core::vector<uint32_t> sampledRows;
+		nbl::core::vector<double> sampledThetas;
+		//! 0,1,2... just so rows can be spread over threads with `std::for_each`
+		nbl::core::vector<uint32_t> rowIndices;
+};
+
+#endif
@@ -4,76 +4,20 @@
 
 #define _NBL_STATIC_LIB_
 #include <nabla.h>
+#include <chrono>
 #include "nbl/ext/FullScreenTriangle/FullScreenTriangle.h"
 #include "nbl/ext/ScreenShot/ScreenShot.h"
 #include "../common/Camera.hpp"
 #include "../common/CommonAPI.h"
 
+#include "CEnvmapSamplingTableBuilder.h"
+
 using namespace nbl;
 using namespace asset;
 using namespace core;
 using namespace video;
 using namespace ui;
 
-using SATFilter = CSummedAreaTableImageFilter<false>;
-
-static core::smart_refctd_ptr<ICPUBuffer> computeLuminancePdf(smart_refctd_ptr<ICPUImage> envmap, float* normalizationFactor)
-{
-	const core::vector2d<uint32_t> envmapExtent = { envmap->getCreationParameters().extent.width, envmap->getCreationParameters().extent.height };
-	const uint32_t channelCount = getFormatChannelCount(envmap->getCreationParameters().format);
-	
-	const core::vector2d<uint32_t> pdfDomainExtent = { envmapExtent.X, envmapExtent.Y };
-
-	const size_t outBufferSize = pdfDomainExtent.X * pdfDomainExtent.Y * sizeof(double);
-	core::smart_refctd_ptr<ICPUBuffer> outBuffer = core::make_smart_refctd_ptr<ICPUBuffer>(outBufferSize);
-
-	const double luminanceScales[4] = { 0.2126729 , 0.7151522, 0.0721750, 0.0 };
-
-	float* envmapPixel = (float*)envmap->getBuffer()->getPointer();
-	double* outPixel = (double*)outBuffer->getPointer();
-
-	double pdfSum = 0.0;
-
-	for (uint32_t y = 0; y < pdfDomainExtent.Y; ++y)
-	{
-		const double sinTheta = core::sin(core::PI<double>() * ((y + 0.5) / (double)pdfDomainExtent.Y));
-
-		for (uint32_t x = 0; x < pdfDomainExtent.X; ++x)
-		{
-			double result = 0.0;
-			for (uint32_t ch = 0; ch < channelCount; ++ch)
-				result += luminanceScales[ch] * envmapPixel[ch];
-
-			*outPixel++ = result * sinTheta;
-			pdfSum += result * sinTheta;
-			envmapPixel += channelCount;
-		}
-	}
-
-	if (normalizationFactor)
-		*normalizationFactor = (pdfDomainExtent.X * pdfDomainExtent.Y)/(pdfSum*2.0*core::PI<double>()*core::PI<double>());
-
-	return outBuffer;
-}
-
-// Returns the offset into the passed array the element at which is <= the passed element (`x`)
-// returns offset = -1 if passed element is < the element at index 0
-static int32_t bisectionSearch(const double* arr, const uint32_t arrCount, const double x, double* xFound)
-{
-	int32_t offset = std::upper_bound(arr, arr + arrCount, x) - arr - 1u;
-	double dx = 0.0;
-	if (offset == -1)
-		dx = x / arr[offset + 1];
-	else
-		dx = (x - arr[offset]) / (arr[offset + 1] - arr[offset]);
-
-	// This assumes array values to be in the range [0,1) which is fine for our purposes because we use them as texture coordinates
-	if (xFound)
-		*xFound = (offset + 1 + dx) / arrCount;
-
-	return offset;
-}
-
 class ImportanceSamplingEnvMaps : public ApplicationBase
 {
 	static constexpr uint32_t WIN_W = 2048;
@@ -131,6 +75,7 @@ public:
 	core::smart_refctd_ptr<IGPUDescriptorSet> uboDescriptorSet1;
 	core::smart_refctd_ptr<IGPUDescriptorSet> descriptorSet5;
 	float envmapNormalizationFactor;
+	CEnvmapSamplingTableBuilder envmapSamplingTableBuilder;
 
 	bool ss = true;
 	uint32_t acquiredNextFBO = {};
@@ -323,8 +268,6 @@ public:
 			auto envmapImage = core::smart_refctd_ptr_static_cast<asset::ICPUImage>(*envmapImageBundle.getContents().begin());
 			const uint32_t channelCount = getFormatChannelCount(envmapImage->getCreationParameters().format);
 
-			auto luminancePdfBuffer = computeLuminancePdf(envmapImage, &envmapNormalizationFactor);
-
 			ICPUImageView::SCreationParams viewParams;
 			viewParams.flags = static_cast<ICPUImageView::E_CREATE_FLAGS>(0u);
 			viewParams.image = envmapImage;
@@ -342,207 +285,21 @@ public:
 
 			const core::vector2d<uint32_t> pdfDomainExtent = { envmapImage->getCreationParameters().extent.width, envmapImage->getCreationParameters().extent.height };
 
-			core::smart_refctd_ptr<ICPUImage> conditionalCdfImage = nullptr;
-			core::smart_refctd_ptr<ICPUBuffer> conditionalIntegrals = nullptr;
-			{
-				// Create ICPUImage from the buffer for the input image to the SAT filter
-				auto luminanceImageParams = envmapImage->getCreationParameters();
-				luminanceImageParams.format = EF_R64_SFLOAT;
-				luminanceImageParams.extent = { pdfDomainExtent.X, pdfDomainExtent.Y, 1 };
-
-				auto luminanceImageRegions = core::make_refctd_dynamic_array<core::smart_refctd_dynamic_array<ICPUImage::SBufferCopy>>(1ull);
-				luminanceImageRegions->begin()->bufferOffset = 0ull;
-				luminanceImageRegions->begin()->bufferRowLength = luminanceImageParams.extent.width;
-				luminanceImageRegions->begin()->bufferImageHeight = 0u;
-				luminanceImageRegions->begin()->imageSubresource = {};
-				luminanceImageRegions->begin()->imageSubresource.layerCount = 1u;
-				luminanceImageRegions->begin()->imageOffset = { 0, 0, 0 };
-				luminanceImageRegions->begin()->imageExtent = { luminanceImageParams.extent.width, luminanceImageParams.extent.height, 1 };
-
-				core::smart_refctd_ptr<ICPUImage> luminanceImage = ICPUImage::create(std::move(luminanceImageParams));
-				luminanceImage->setBufferAndRegions(core::smart_refctd_ptr(luminancePdfBuffer), luminanceImageRegions);
-
-				// Create out image
-				const size_t conditionalCdfBufferSize = pdfDomainExtent.X * pdfDomainExtent.Y * sizeof(double);
-				core::smart_refctd_ptr<ICPUBuffer> conditionalCdfBuffer = core::make_smart_refctd_ptr<ICPUBuffer>(conditionalCdfBufferSize);
-				memset(conditionalCdfBuffer->getPointer(), 0, conditionalCdfBufferSize);
-
-				auto conditionalCdfImageParams = luminanceImage->getCreationParameters();
-				conditionalCdfImageParams.format = EF_R64_SFLOAT;
-
-				auto conditionalCdfImageRegions(luminanceImageRegions);
-				conditionalCdfImage = ICPUImage::create(std::move(conditionalCdfImageParams));
-				conditionalCdfImage->setBufferAndRegions(std::move(conditionalCdfBuffer), conditionalCdfImageRegions);
-
-				// Set up the filter state
-				SATFilter sum_filter;
-				SATFilter::state_type state;
-
-				state.inImage = luminanceImage.get();
-				state.outImage = conditionalCdfImage.get();
-				state.inOffset = { 0, 0, 0 };
-				state.inBaseLayer = 0;
-				state.outOffset = { 0, 0, 0 };
-				state.outBaseLayer = 0;
-				state.extent = luminanceImage->getCreationParameters().extent;
-				state.layerCount = luminanceImage->getCreationParameters().arrayLayers;
-				state.scratchMemoryByteSize = state.getRequiredScratchByteSize(state.inImage, state.extent);
-				state.scratchMemory = reinterpret_cast<uint8_t*>(_NBL_ALIGNED_MALLOC(state.scratchMemoryByteSize, 32));
-				state.axesToSum = ((0) << 2) | ((0) << 1) | ((1) << 0); // ZYX
-				state.inMipLevel = 0;
-				state.outMipLevel = 0;
-
-				if (!sum_filter.execute(core::execution::par_unseq, &state))
-					std::cout << "SAT filter failed for some reason" << std::endl;
-
-				_NBL_ALIGNED_FREE(state.scratchMemory);
-
-				// From the outImage you gotta extract integrals and normalize
-				double* conditionalCdfPixel = (double*)conditionalCdfImage->getBuffer()->getPointer();
-
-				conditionalIntegrals = core::make_smart_refctd_ptr<ICPUBuffer>(pdfDomainExtent.Y * sizeof(double));
-				double* conditionalIntegralsPixel = (double*)conditionalIntegrals->getPointer();
-				for (uint32_t y = 0; y < pdfDomainExtent.Y; ++y)
-				{
-					// printf("\n Conditional Integral[%d] = %f", y, conditionalCdfPixel[y * pdfDomainExtent.X + (pdfDomainExtent.X - 1)]);
-					*conditionalIntegralsPixel++ = conditionalCdfPixel[y * pdfDomainExtent.X + (pdfDomainExtent.X - 1)];
-				}
-
-				conditionalCdfPixel = (double*)conditionalCdfImage->getBuffer()->getPointer();
-				conditionalIntegralsPixel = (double*)conditionalIntegrals->getPointer();
-
-				// now normalize
-				for (uint32_t y = 0; y < pdfDomainExtent.Y; ++y)
-				{
-					for (uint32_t x = 0; x < pdfDomainExtent.X; ++x)
-					{
-						conditionalCdfPixel[y * pdfDomainExtent.X + x] /= conditionalIntegralsPixel[y];
-					}
-				}
-			}
-
-			core::smart_refctd_ptr<ICPUImage> marginalCdfImage = nullptr;
-			double marginalIntegral = 0.0;
-			{
-				// Input: conditionalIntegrals
-				// Create ICPUImage from the buffer for the input image to the SAT filter
-				IImage::SCreationParams inParams;
-				inParams.flags = static_cast<asset::IImage::E_CREATE_FLAGS>(0u);
-				inParams.type = IImage::ET_1D;
-				inParams.format = asset::EF_R64_SFLOAT;
-				inParams.extent = { pdfDomainExtent.Y, 1, 1 };
-				inParams.mipLevels = 1u;
-				inParams.arrayLayers = 1u;
-				inParams.samples = asset::ICPUImage::ESCF_1_BIT;
-
-				auto inImageRegions = core::make_refctd_dynamic_array<core::smart_refctd_dynamic_array<ICPUImage::SBufferCopy>>(1ull);
-				inImageRegions->begin()->bufferOffset = 0ull;
-				inImageRegions->begin()->bufferRowLength = inParams.extent.width;
-				inImageRegions->begin()->bufferImageHeight = 0u;
-				inImageRegions->begin()->imageSubresource = {};
-				inImageRegions->begin()->imageSubresource.layerCount = 1u;
-				inImageRegions->begin()->imageOffset = { 0, 0, 0 };
-				inImageRegions->begin()->imageExtent = { inParams.extent.width, inParams.extent.height, inParams.extent.depth };
-
-				core::smart_refctd_ptr<ICPUImage> inImage = ICPUImage::create(std::move(inParams));
-				inImage->setBufferAndRegions(core::smart_refctd_ptr(conditionalIntegrals), inImageRegions);
-
-				// Ouput: 1d cdf of conditionalIntegrals
-				// Create out image
-				core::smart_refctd_ptr<ICPUBuffer> marginalCdfBuffer = core::make_smart_refctd_ptr<ICPUBuffer>(conditionalIntegrals->getSize());
-				memset(marginalCdfBuffer->getPointer(), 0, marginalCdfBuffer->getSize());
-
-				auto marginalCdfImageParams = inImage->getCreationParameters();
-				marginalCdfImageParams.format = EF_R64_SFLOAT;
-
-				auto marginalCdfImageRegions(inImageRegions);
-				marginalCdfImage = ICPUImage::create(std::move(marginalCdfImageParams));
-				marginalCdfImage->setBufferAndRegions(std::move(marginalCdfBuffer), marginalCdfImageRegions);
-
-				// Set up the filter state
-				SATFilter sum_filter;
-				SATFilter::state_type state;
-
-				state.inImage = inImage.get();
-				state.outImage = marginalCdfImage.get();
-				state.inOffset = { 0, 0, 0 };
-				state.inBaseLayer = 0;
-				state.outOffset = { 0, 0, 0 };
-				state.outBaseLayer = 0;
-				state.extent = inImage->getCreationParameters().extent;
-				state.layerCount = inImage->getCreationParameters().arrayLayers;
-				state.scratchMemoryByteSize = state.getRequiredScratchByteSize(state.inImage, state.extent);
-				state.scratchMemory = reinterpret_cast<uint8_t*>(_NBL_ALIGNED_MALLOC(state.scratchMemoryByteSize, 32));
-				state.axesToSum = ((0) << 2) | ((0) << 1) | ((1) << 0); // ZYX
-				state.inMipLevel = 0;
-				state.outMipLevel = 0;
-
-				if (!sum_filter.execute(core::execution::par_unseq, &state))
-					std::cout << "SAT filter failed for some reason" << std::endl;
-
-				_NBL_ALIGNED_FREE(state.scratchMemory);
-
-				// From the outImage you gotta extract integral and normalize
-				double* marginalCdfPixel = (double*)marginalCdfImage->getBuffer()->getPointer();
-
-				marginalIntegral = marginalCdfPixel[pdfDomainExtent.Y - 1];
-
-				// now normalize
-				for (uint32_t y = 0; y < pdfDomainExtent.Y; ++y)
-				{
-					// printf("\n MarginalCDFPixel[%d] = %f", y, marginalCdfPixel[y]);
-					marginalCdfPixel[y] /= marginalIntegral;
-				}
-			}
-
-			for (uint32_t i = 1; i < (marginalCdfImage->getBuffer()->getSize() / sizeof(double)); ++i)
-				assert(((double*)marginalCdfImage->getBuffer()->getPointer())[i] > ((double*)marginalCdfImage->getBuffer()->getPointer())[i - 1]);
-
-			// Computing LUTs
-
 			const uint32_t phiPdfLUTChannelCount = 2u; // phi and pdf
 			const size_t phiPdfLUTBufferSize = pdfDomainExtent.X * pdfDomainExtent.Y * phiPdfLUTChannelCount * sizeof(float);
 			core::smart_refctd_ptr<ICPUBuffer> phiPdfLUTBuffer = core::make_smart_refctd_ptr<ICPUBuffer>(phiPdfLUTBufferSize);
-			memset(phiPdfLUTBuffer->getPointer(), 0, phiPdfLUTBufferSize);
 
 			const uint32_t thetaLUTChannelCount = 1u; // theta
 			const size_t thetaLUTBufferSize = pdfDomainExtent.Y * thetaLUTChannelCount * sizeof(float);
 			core::smart_refctd_ptr<ICPUBuffer> thetaLUTBuffer = core::make_smart_refctd_ptr<ICPUBuffer>(thetaLUTBufferSize);
-			memset(thetaLUTBuffer->getPointer(), 0, thetaLUTBufferSize);
-
-			float* phiPdfLUTPixel = (float*)phiPdfLUTBuffer->getPointer();
-			float* thetaLUTPixel = (float*)thetaLUTBuffer->getPointer();
-
-			core::vector2d<double> xi(0.0, 0.0);
-			core::vector2d<double> xiRemapped = { 0.0, 0.0 };
-			for (uint32_t y = 0; y < pdfDomainExtent.Y; ++y)
-			{
-				xi.Y = (y + 0.5) / (double)pdfDomainExtent.Y;
-
-				int32_t yoffset = bisectionSearch((double*)marginalCdfImage->getBuffer()->getPointer(), pdfDomainExtent.Y, xi.Y, &xiRemapped.Y);
-				const uint32_t rowToSample = (uint32_t)(yoffset + 1);
-				assert(rowToSample < pdfDomainExtent.Y);
-				double marginalPdf = ((double*)conditionalIntegrals->getPointer())[rowToSample] / marginalIntegral;
-
-				const double theta = xiRemapped.Y * core::PI<double>();
-				*thetaLUTPixel++ = (float)theta;
 
-				for (uint32_t x = 0; x < pdfDomainExtent.X; ++x)
-				{
-					xi.X = (x + 0.5) / (double)pdfDomainExtent.X;
-
-					const int32_t xoffset = bisectionSearch((double*)conditionalCdfImage->getBuffer()->getPointer() + rowToSample * pdfDomainExtent.X, pdfDomainExtent.X, xi.X, &xiRemapped.X);
-					const uint32_t colToSample = (uint32_t)(xoffset + 1);
-					assert(colToSample < pdfDomainExtent.X);
-					const double conditionalPdf = ((double*)luminancePdfBuffer->getPointer())[rowToSample * pdfDomainExtent.X + colToSample] / ((double*)conditionalIntegrals->getPointer())[rowToSample];
-
-					const double phi = xiRemapped.X * 2.0 * core::PI<double>();
-					const double pdf = (core::sin(theta) == 0.0) ? 0.0 : (marginalPdf * conditionalPdf) / (2.0 * core::PI<double>() * core::PI<double>() * core::sin(theta));
-
-					*phiPdfLUTPixel++ = (float)phi;
-					*phiPdfLUTPixel++ = (float)pdf;
-				}
-			}
+			const auto buildStart = std::chrono::high_resolution_clock::now();
+			envmapNormalizationFactor = envmapSamplingTableBuilder.build(
+				reinterpret_cast<const float*>(envmapImage->getBuffer()->getPointer()), pdfDomainExtent.X, pdfDomainExtent.Y, channelCount,
+				reinterpret_cast<float*>(phiPdfLUTBuffer->getPointer()), reinterpret_cast<float*>(thetaLUTBuffer->getPointer())
+			);
+			const auto buildTime = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - buildStart).count();
+			logger->log("Built the %ux%u envmap sampling tables in %lld us", system::ILogger::ELL_INFO, pdfDomainExtent.X, pdfDomainExtent.Y, static_cast<long long>(buildTime));
 
 			phiPdfLUTImageView = getLUTGPUImageViewFromBuffer(phiPdfLUTBuffer, IGPUImage::ET_2D, asset::EF_R32G32_SFLOAT, { pdfDomainExtent.X, pdfDomainExtent.Y, 1 }, IGPUImageView::ET_2D);
 			thetaLUTImageView = getLUTGPUImageViewFromBuffer(thetaLUTBuffer, IGPUImage::ET_1D, asset::EF_R32_SFLOAT, { pdfDomainExtent.Y, 1, 1 }, IGPUImageView::ET_1D);
@@ -0,0 +1,431 @@
+// Copyright (C) 2018-2020 - DevSH Graphics Programming Sp. z O.O.
+// This file is part of the "Nabla Engine".
+// For conditions of distribution and use, see copyright notice in nabla.h
+
+#ifndef _ALLOCATOR_BENCHMARK_H_INCLUDED_
+#define _ALLOCATOR_BENCHMARK_H_INCLUDED_
+
+#include <nabla.h>
+
+#include "ConcurrentPoolAddressAllocator.h"
+
+#include <random>
+#include <chrono>
+#include <fstream>
+#include <filesystem>
+#include <algorithm>
+
+
+// A recorded (or synthesized) sequence of allocations and frees, replayable against any address allocator.
+// Frees reference the allocation they release by its index in the trace, so the same trace means the same thing for every allocator.
+class CAllocationTrace
+{
+	public:
+		struct SOp
+		{
+			enum E_TYPE : uint32_t
+			{
+				ET_ALLOC,
+				ET_FREE,
+				ET_RESET
+			};
+
+			E_TYPE type;
+			uint32_t size; // only for ET_ALLOC
+			uint32_t alignment; // only for ET_ALLOC
+			uint32_t allocationIx; // ET_ALLOC: index assigned to this allocation, ET_FREE: allocation being freed
+		};
+
+		struct SGenerationParams
+		{
+			uint32_t seed = 0x45u;
+			uint32_t opCount = 1u<<20u;
+			uint32_t minSize = 16u;
+			uint32_t maxSize = 64u<<10u;
+			uint32_t maxAlignmentExp = 12u; // 4096
+			// probability an op is an allocation while there are live allocations, above 0.5 the live set grows until the allocator fills up
+			double allocProbability = 0.55;
+			// the live set is never allowed to grow past this, so the trace reaches a steady state instead of just running out of memory
+			uint32_t maxLiveAllocations = 1u<<14u;
+		};
+
+		//! Deterministic for a given `params.seed`, sizes are log-uniform to mimic the mix of tiny and large uploads seen by streaming buffers
+		static CAllocationTrace generate(const SGenerationParams& params)
+		{
+			CAllocationTrace trace;
+			trace.ops.reserve(params.opCount);
+
+			std::mt19937 mt(params.seed);
+			std::uniform_real_distribution<double> logSizeDist(std::log2(double(params.minSize)),std::log2(double(params.maxSize)));
+			std::uniform_int_distribution<uint32_t> alignExpDist(0u,params.maxAlignmentExp);
+			std::uniform_real_distribution<double> opDist(0.0,1.0);
+
+			nbl::core::vector<uint32_t> live;
+			live.reserve(params.maxLiveAllocations);
+			for (uint32_t i=0u; i<params.opCount; i++)
+			{
+				const bool alloc = live.empty() || (live.size()<params.maxLiveAllocations && opDist(mt)<params.allocProbability);
+				if (alloc)
+				{
+					const uint32_t size = std::clamp<uint32_t>(uint32_t(std::exp2(logSizeDist(mt))),params.minSize,params.maxSize);
+					trace.pushAlloc(size,1u<<alignExpDist(mt));
+					live.push_back(trace.allocationCount-1u);
+				}
+				else
+				{
+					std::uniform_int_distribution<size_t> liveDist(0u,live.size()-1u);
+					const size_t victim = liveDist(mt);
+					trace.ops.push_back({SOp::ET_FREE,0u,0u,live[victim]});
+					live[victim] = live.back();
+					live.pop_back();
+				}
+			}
+			return trace;
+		}
+
+		//! Text format, one op per line: `a <size> <alignment>`, `f <allocation index>` or `r`
+		bool load(const std::filesystem::path& path)
+		{
+			std::ifstream file(path);
+			if (!file.is_open())
+				return false;
+
+			ops.clear();
+			allocationCount = 0u;
+			maxSize = 0u;
+			maxAlignment = 1u;
+
+			char type;
+			while (file >> type)
+			switch (type)
+			{
+				case 'a':
+				{
+					uint32_t size,alignment;
+					if (!(file >> size >> alignment) || size==0u || !nbl::core::isPoT(alignment))
+						return false;
+					pushAlloc(size,alignment);
+					break;
+				}
+				case 'f':
+				{
+					uint32_t allocationIx;
+					if (!(file >> allocationIx) || allocationIx>=allocationCount)
+						return false;
+					ops.push_back({SOp::ET_FREE,0u,0u,allocationIx});
+					break;
+				}
+				case 'r':
+					ops.push_back({SOp::ET_RESET,0u,0u,0u});
+					break;
+				default:
+					return false;
+			}
+			return true;
+		}
+
+		bool save(const std::filesystem::path& path) const
+		{
+			std::ofstream file(path);
+			if (!file.is_open())
+				return false;
+
+			for (const auto& op : ops)
+			switch (op.type)
+			{
+				case SOp::ET_ALLOC:
+					file << "a " << op.size << " " << op.alignment << "\n";
+					break;
+				case SOp::ET_FREE:
+					file << "f " << op.allocationIx << "\n";
+					break;
+				default:
+					file << "r\n";
+					break;
+			}
+			return file.good();
+		}
+
+		nbl::core::vector<SOp> ops;
+		uint32_t allocationCount = 0u;
+		uint32_t maxSize = 0u;
+		uint32_t maxAlignment = 1u;
+
+	private:
+		inline void pushAlloc(uint32_t size, uint32_t alignment)
+		{
+			ops.push_back({SOp::ET_ALLOC,size,alignment,allocationCount++});
+			maxSize = std::max(maxSize,size);
+			maxAlignment = std::max(maxAlignment,alignment);
+		}
+};
+
+struct SAllocatorBenchmarkResult
+{
+	const char* name = nullptr;
+	uint64_t opCount = 0ull;
+	uint64_t failedAllocs = 0ull;
+	uint64_t forcedResets = 0ull;
+	double totalNs = 0.0;
+	// latency of a single op `multi_alloc_addr`/`multi_free_addr` call, a batched call only tells the mean of its ops
+	double p50Ns = 0.0;
+	double p99Ns = 0.0;
+	// 1-(largest allocatable block/free space), sampled after every allocation batch
+	double peakFragmentation = 0.0;
+	// bytes the allocator reports as allocated on top of what the trace asked for (alignment, block rounding)
+	uint64_t peakPaddingBytes = 0ull;
+	uint64_t peakRequestedBytes = 0ull;
+
+	void print() const
+	{
+		printf(
+			"%-24s %10llu ops %8.2f ns/op | single op p50 %8.2f ns p99 %8.2f ns | failed allocs %8llu forced resets %6llu | peak fragmentation %6.2f%% peak padding %10llu B (%6.2f%% of live)\n",
+			name,static_cast<unsigned long long>(opCount),opCount ? totalNs/double(opCount):0.0,p50Ns,p99Ns,
+			static_cast<unsigned long long>(failedAllocs),static_cast<unsigned long long>(forcedResets),
+			peakFragmentation*100.0,static_cast<unsigned long long>(peakPaddingBytes),peakRequestedBytes ? double(peakPaddingBytes)*100.0/double(peakRequestedBytes):0.0
+		);
+	}
+};
+
+struct SAllocatorBenchmarkParams
+{
+	uint32_t addressSpaceSize = 256u<<20u;
+	// minimum block size for the Stack and General Purpose allocators, Pools use the largest trace allocation as the block size
+	uint32_t minBlockSize = 32u;
+};
+
+// Replays a `CAllocationTrace` against one allocator type, batching consecutive ops of the same kind into `multi_alloc_addr`/`multi_free_addr` calls.
+// The latency percentiles come from a second replay of the same batches which issues every op as its own call.
+template<typename AlctrType>
+class CAllocatorBenchmark
+{
+		using Traits = nbl::core::address_allocator_traits<AlctrType>;
+		using clock_t = std::chrono::high_resolution_clock;
+
+		static inline constexpr bool isLinear = std::is_same_v<AlctrType,nbl::core::LinearAddressAllocator<uint32_t>>;
+		static inline constexpr bool isPool = std::is_same_v<AlctrType,nbl::core::PoolAddressAllocator<uint32_t>>||std::is_same_v<AlctrType,nbl::core::IteratablePoolAddressAllocator<uint32_t>>||std::is_same_v<AlctrType,ConcurrentPoolAddressAllocator<uint32_t>>;
+
+	public:
+		static SAllocatorBenchmarkResult run(const char* name, const CAllocationTrace& trace, const SAllocatorBenchmarkParams& params)
+		{
+			auto result = replay(name,trace,params,false);
+			const auto singleOps = replay(name,trace,params,true);
+			result.p50Ns = singleOps.p50Ns;
+			result.p99Ns = singleOps.p99Ns;
+			return result;
+		}
+
+	private:
+		static SAllocatorBenchmarkResult replay(const char* name, const CAllocationTrace& trace, const SAllocatorBenchmarkParams& params, const bool singleOpCalls)
+		{
+			SAllocatorBenchmarkResult result;
+			result.name = name;
+
+			const uint32_t maxAlign = std::max(trace.maxAlignment,1u);
+			const uint32_t blockSz = isPool ? trace.maxSize:params.minBlockSize;
+
+			AlctrType alctr;
+			void* reservedSpace = nullptr;
+			if constexpr (isLinear)
+				alctr = AlctrType(nullptr,0u,0u,maxAlign,params.addressSpaceSize);
+			else
+			{
+				reservedSpace = _NBL_ALIGNED_MALLOC(AlctrType::reserved_size(maxAlign,params.addressSpaceSize,blockSz),_NBL_SIMD_ALIGNMENT);
+				alctr = AlctrType(reservedSpace,0u,0u,maxAlign,params.addressSpaceSize,blockSz);
+			}
+
+			nbl::core::vector<uint32_t> requestedSizes(trace.allocationCount,0u);
+			for (const auto& op : trace.ops)
+			if (op.type==CAllocationTrace::SOp::ET_ALLOC)
+				requestedSizes[op.allocationIx] = op.size;
+
+			nbl::core::vector<uint32_t> addresses(trace.allocationCount,AlctrType::invalid_address);
+			nbl::core::vector<uint32_t> allocatedSizes(trace.allocationCount,0u);
+			// only used when the allocator needs LIFO frees
+			nbl::core::vector<uint32_t> liveStack;
+			nbl::core::vector<bool> pendingFree(trace.allocationCount,false);
+			uint64_t liveRequestedBytes = 0ull;
+
+			nbl::core::vector<uint32_t> batchIx(Traits::maxMultiOps);
+			nbl::core::vector<uint32_t> batchAddresses(Traits::maxMultiOps);
+			nbl::core::vector<uint32_t> batchSizes(Traits::maxMultiOps);
+			nbl::core::vector<uint32_t> batchAlignments(Traits::maxMultiOps);
+			nbl::core::vector<double> batchNs;
+			batchNs.reserve(Traits::maxMultiOps);
+			nbl::core::vector<double> latencies;
+			if (singleOpCalls)
+				latencies.reserve(trace.ops.size());
+
+			auto resetAll = [&]() -> void
+			{
+				alctr.reset();
+				std::fill(addresses.begin(),addresses.end(),AlctrType::invalid_address);
+				liveStack.clear();
+				std::fill(pendingFree.begin(),pendingFree.end(),false);
+				liveRequestedBytes = 0ull;
+			};
+			// `call(first,count)` issues ops `[first,first+count)` of the batch
+			auto timeBatch = [&](auto call, const uint32_t count) -> void
+			{
+				batchNs.clear();
+				auto time = [&](const uint32_t first, const uint32_t callCount) -> void
+				{
+					const auto start = clock_t::now();
+					call(first,callCount);
+					const auto end = clock_t::now();
+					batchNs.push_back(double(std::chrono::duration_cast<std::chrono::nanoseconds>(end-start).count()));
+				};
+				if (singleOpCalls)
+				for (uint32_t j=0u; j<count; j++)
+					time(j,1u);
+				else
+					time(0u,count);
+			};
+			auto recordBatch = [&](const uint32_t count) -> void
+			{
+				for (const auto ns : batchNs)
+					result.totalNs += ns;
+				result.opCount += count;
+				if (singleOpCalls)
+					latencies.insert(latencies.end(),batchNs.begin(),batchNs.end());
+			};
+			auto allocBatch = [&](const uint32_t first, const uint32_t count) -> void
+			{
+				Traits::multi_alloc_addr(alctr,count,batchAddresses.data()+first,batchSizes.data()+first,batchAlignments.data()+first);
+			};
+			auto freeBatch = [&](const uint32_t first, const uint32_t count) -> void
+			{
+				Traits::multi_free_addr(alctr,count,batchAddresses.data()+first,batchSizes.data()+first);
+			};
+
+			for (size_t i=0u; i<trace.ops.size();)
+			{
+				const auto type = trace.ops[i].type;
+				if (type==CAllocationTrace::SOp::ET_RESET)
+				{
+					resetAll();
+					i++;
+					continue;
+				}
+
+				uint32_t count = 0u;
+				for (; i<trace.ops.size() && trace.ops[i].type==type && count<Traits::maxMultiOps; i++)
+				{
+					const auto& op = trace.ops[i];
+					if (type==CAllocationTrace::SOp::ET_ALLOC)
+					{
+						batchIx[count] = op.allocationIx;
+						batchAddresses[count] = AlctrType::invalid_address;
+						batchSizes[count] = isPool ? blockSz:op.size;
+						batchAlignments[count] = isPool ? blockSz:op.alignment;
+						count++;
+					}
+					else if constexpr (!isLinear)
+					{
+						const uint32_t victim = op.allocationIx;
+						// the allocation may have failed
+						if (addresses[victim]==AlctrType::invalid_address)
+							continue;
+						if constexpr (Traits::supportsArbitraryOrderFrees)
+						{
+							batchIx[count] = victim;
+							batchAddresses[count] = addresses[victim];
+							batchSizes[count] = allocatedSizes[victim];
+							count++;
+						}
+						else
+						{
+							// a LIFO allocator gets the free deferred until everything allocated after it is freed too, like a frame-scoped user would do
+							pendingFree[victim] = true;
+							while (!liveStack.empty() && pendingFree[liveStack.back()] && count<Traits::maxMultiOps)
+							{
+								const uint32_t top = liveStack.back();
+								liveStack.pop_back();
+								pendingFree[top] = false;
+								batchIx[count] = top;
+								batchAddresses[count] = addresses[top];
+								batchSizes[count] = allocatedSizes[top];
+								count++;
+							}
+						}
+					}
+				}
+				if (count==0u)
+					continue;
+
+				if (type==CAllocationTrace::SOp::ET_ALLOC)
+				{
+					timeBatch(allocBatch,count);
+					if constexpr (isLinear)
+					{
+						// a linear allocator can only be reset, so treat running out of space as the end of a frame
+						if (std::find(batchAddresses.begin(),batchAddresses.begin()+count,AlctrType::invalid_address)!=batchAddresses.begin()+count)
+						{
+							result.forcedResets++;
+							resetAll();
+							std::fill(batchAddresses.begin(),batchAddresses.begin()+count,AlctrType::invalid_address);
+							timeBatch(allocBatch,count);
+						}
+					}
+					recordBatch(count);
+
+					for (uint32_t j=0u; j<count; j++)
+					{
+						if (batchAddresses[j]==AlctrType::invalid_address)
+						{
+							result.failedAllocs++;
+							continue;
+						}
+						const uint32_t ix = batchIx[j];
+						addresses[ix] = batchAddresses[j];
+						allocatedSizes[ix] = batchSizes[j];
+						liveRequestedBytes += requestedSizes[ix];
+						if constexpr (!Traits::supportsArbitraryOrderFrees)
+							liveStack.push_back(ix);
+					}
+
+					const uint64_t allocated = alctr.get_allocated_size();
+					if (allocated>liveRequestedBytes)
+						result.peakPaddingBytes = std::max<uint64_t>(result.peakPaddingBytes,allocated-liveRequestedBytes);
+					result.peakRequestedBytes = std::max(result.peakRequestedBytes,liveRequestedBytes);
+					if constexpr (!isPool)
+					{
+						// fixed size blocks can't fragment externally, for everything else compare the largest possible allocation against all the free space
+						const uint64_t freeSize = alctr.get_free_size();
+						if (freeSize)
+							result.peakFragmentation = std::max(result.peakFragmentation,1.0-double(Traits::max_size(alctr))/double(freeSize));
+					}
+				}
+				else
+				{
+					timeBatch(freeBatch,count);
+					recordBatch(count);
+
+					for (uint32_t j=0u; j<count; j++)
+					{
+						const uint32_t ix = batchIx[j];
+						addresses[ix] = AlctrType::invalid_address;
+						liveRequestedBytes -= requestedSizes[ix];
+					}
+				}
+			}
+
+			if (!latencies.empty())
+			{
+				auto percentile = [&](double p) -> double
+				{
+					auto nth = latencies.begin()+size_t(p*double(latencies.size()-1u));
+					std::nth_element(latencies.begin(),nth,latencies.end());
+					return *nth;
+				};
+				result.p50Ns = percentile(0.5);
+				result.p99Ns = percentile(0.99);
+			}
+
+			if constexpr (!isLinear)
+				_NBL_ALIGNED_FREE(reservedSpace);
+			return result;
+		}
+};
+
+#endif
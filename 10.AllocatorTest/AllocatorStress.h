@@ -0,0 +1,282 @@
+// Copyright (C) 2018-2020 - DevSH Graphics Programming Sp. z O.O.
+// This file is part of the "Nabla Engine".
+// For conditions of distribution and use, see copyright notice in nabla.h
+
+#ifndef _ALLOCATOR_STRESS_H_INCLUDED_
+#define _ALLOCATOR_STRESS_H_INCLUDED_
+
+#include <nabla.h>
+
+#include "ConcurrentPoolAddressAllocator.h"
+
+#include <random>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <barrier>
+#include <memory>
+#include <algorithm>
+
+
+struct SAllocatorStressParams
+{
+	uint32_t seed = 0x45u;
+	uint32_t opsPerThread = 1u<<18u;
+	uint32_t addressSpaceSize = 64u<<20u;
+	// every size, alignment and block size is a multiple of this, ownership of the address space is tracked per granule
+	uint32_t granuleSize = 256u;
+	uint32_t maxSizeInGranules = 16u;
+	uint32_t maxAlignment = 4096u;
+	// Pools hand out blocks of this many granules
+	uint32_t poolBlockGranules = 1u;
+	// each thread stops allocating and only frees once it holds this many addresses, keeps the allocator from running dry
+	uint32_t maxLivePerThread = 2048u;
+};
+
+struct SAllocatorStressResult
+{
+	uint32_t threadCount = 0u;
+	uint64_t opCount = 0ull;
+	uint64_t failedAllocs = 0ull;
+	double wallNs = 0.0;
+	// summed over all threads
+	double lockWaitNs = 0.0;
+	double lockHoldNs = 0.0;
+	bool doubleHandout = false;
+
+	// failed allocations return immediately, so they don't count towards the throughput
+	inline double opsPerSecond() const {return wallNs>0.0 ? double(opCount-failedAllocs)*1e9/wallNs:0.0;}
+
+	void print(const double singleThreadOpsPerSecond) const
+	{
+		const double efficiency = singleThreadOpsPerSecond>0.0 ? opsPerSecond()/(singleThreadOpsPerSecond*double(threadCount)):0.0;
+		printf(
+			"%3u threads %12.0f ops/s scaling efficiency %6.2f%% | lock hold %8.2f ns/op lock wait %8.2f ns/op | failed allocs %8llu%s\n",
+			threadCount,opsPerSecond(),efficiency*100.0,
+			opCount ? lockHoldNs/double(opCount):0.0,opCount ? lockWaitNs/double(opCount):0.0,
+			static_cast<unsigned long long>(failedAllocs),doubleHandout ? " ADDRESS HANDED OUT TWICE!":""
+		);
+	}
+};
+
+// Hammers one `*MT` allocator from many threads issuing mixed `multi_alloc_addr`/`multi_free_addr` batches (each thread only frees what it allocated, like upload threads do).
+// Every granule of the address space has an owner flag, so an address range handed out while it's still live somewhere else gets caught.
+template<typename AlctrType>
+class CAllocatorStress
+{
+		using Traits = nbl::core::address_allocator_traits<AlctrType>;
+		using clock_t = std::chrono::high_resolution_clock;
+
+		static inline constexpr bool isLinear = std::is_same_v<AlctrType,nbl::core::LinearAddressAllocatorMT<uint32_t,std::recursive_mutex>>;
+		static inline constexpr bool isPool = std::is_same_v<AlctrType,nbl::core::PoolAddressAllocatorMT<uint32_t,std::recursive_mutex>>||std::is_same_v<AlctrType,nbl::core::IteratablePoolAddressAllocatorMT<uint32_t,std::recursive_mutex>>||std::is_same_v<AlctrType,ConcurrentPoolAddressAllocator<uint32_t>>;
+		static_assert(isLinear||Traits::supportsArbitraryOrderFrees,"Threads can't agree on a free order!");
+
+	public:
+		static SAllocatorStressResult run(const uint32_t threadCount, const SAllocatorStressParams& params)
+		{
+			SAllocatorStressResult result;
+			result.threadCount = threadCount;
+
+			const uint32_t blockSz = isPool ? params.poolBlockGranules*params.granuleSize:params.granuleSize;
+			void* reservedSpace = nullptr;
+			std::unique_ptr<AlctrType> alctr;
+			if constexpr (isLinear)
+				alctr = std::make_unique<AlctrType>(nullptr,0u,0u,params.maxAlignment,params.addressSpaceSize);
+			else
+			{
+				reservedSpace = _NBL_ALIGNED_MALLOC(AlctrType::reserved_size(params.maxAlignment,params.addressSpaceSize,blockSz),_NBL_SIMD_ALIGNMENT);
+				alctr = std::make_unique<AlctrType>(reservedSpace,0u,0u,params.maxAlignment,params.addressSpaceSize,blockSz);
+			}
+
+			const uint32_t granuleCount = params.addressSpaceSize/params.granuleSize;
+			auto owners = std::make_unique<std::atomic_uint8_t[]>(granuleCount);
+			for (uint32_t i=0u; i<granuleCount; i++)
+				owners[i].store(0u,std::memory_order_relaxed);
+
+			// a linear allocator can't free, so it gets reset every frame, sized so that all threads' allocations of a frame fit even if every
+			// one wastes almost a whole alignment, the others run everything as one frame
+			const uint32_t worstAllocSize = params.maxSizeInGranules*params.granuleSize+params.maxAlignment;
+			const uint32_t frameOps = isLinear ? std::max(params.addressSpaceSize/(threadCount*worstAllocSize),1u):params.opsPerThread;
+			// the last thread to finish a frame resets the allocator and the ownership while all the others wait
+			auto endFrame = [&]() noexcept -> void
+			{
+				if constexpr (isLinear)
+				{
+					alctr->reset();
+					for (uint32_t i=0u; i<granuleCount; i++)
+						owners[i].store(0u,std::memory_order_relaxed);
+				}
+			};
+			std::barrier frameBarrier(threadCount,endFrame);
+
+			struct SThreadResult
+			{
+				uint64_t opCount = 0ull;
+				uint64_t failedAllocs = 0ull;
+				double lockWaitNs = 0.0;
+				double lockHoldNs = 0.0;
+				bool doubleHandout = false;
+			};
+			nbl::core::vector<SThreadResult> threadResults(threadCount);
+
+			std::atomic_uint32_t ready = 0u;
+			std::atomic_bool go = false;
+			auto worker = [&](const uint32_t threadIx) -> void
+			{
+				auto& out = threadResults[threadIx];
+				std::mt19937 mt(params.seed+threadIx);
+				std::uniform_int_distribution<uint32_t> batchDist(1u,Traits::maxMultiOps);
+				std::uniform_int_distribution<uint32_t> sizeDist(1u,params.maxSizeInGranules);
+				std::uniform_int_distribution<uint32_t> alignExpDist(nbl::core::findMSB(params.granuleSize),nbl::core::findMSB(params.maxAlignment));
+
+				nbl::core::vector<uint32_t> addresses(Traits::maxMultiOps),sizes(Traits::maxMultiOps),alignments(Traits::maxMultiOps);
+				struct SLive {uint32_t address,size;};
+				nbl::core::vector<SLive> live;
+				live.reserve(params.maxLivePerThread+Traits::maxMultiOps);
+
+				// flips the ownership of every granule in the range, returns false if any of them already was in the target state
+				auto claim = [&](const uint32_t address, const uint32_t size, const uint8_t owned) -> bool
+				{
+					bool ok = true;
+					for (uint32_t g=address/params.granuleSize; g<(address+size)/params.granuleSize; g++)
+						ok = owners[g].exchange(owned,std::memory_order_acq_rel)!=owned && ok;
+					return ok;
+				};
+				// the adaptor locks internally too, but taking the recursive lock ourselves lets us time the wait and the hold separately
+				// lock-free allocators have no wait, all the time spent inside counts as hold
+				auto locked = [&](auto&& op) -> void
+				{
+					const auto start = clock_t::now();
+					std::unique_lock<std::recursive_mutex> lock;
+					if constexpr (requires {alctr->get_lock();})
+						lock = std::unique_lock(alctr->get_lock());
+					const auto acquired = clock_t::now();
+					op();
+					const auto released = clock_t::now();
+					if (lock.owns_lock())
+						lock.unlock();
+					out.lockWaitNs += double(std::chrono::duration_cast<std::chrono::nanoseconds>(acquired-start).count());
+					out.lockHoldNs += double(std::chrono::duration_cast<std::chrono::nanoseconds>(released-acquired).count());
+				};
+
+				ready++;
+				while (!go.load(std::memory_order_acquire))
+					std::this_thread::yield();
+
+				while (out.opCount<params.opsPerThread)
+				{
+					const uint64_t frameEnd = std::min<uint64_t>((out.opCount/frameOps+1ull)*frameOps,params.opsPerThread);
+					const uint32_t count = static_cast<uint32_t>(std::min<uint64_t>(batchDist(mt),frameEnd-out.opCount));
+					// a linear allocator can't free, so it just keeps allocating until the frame ends
+					const bool alloc = isLinear || (live.size()<params.maxLivePerThread && (live.empty() || (mt()&0x1u)));
+					if (alloc)
+					{
+						for (uint32_t j=0u; j<count; j++)
+						{
+							addresses[j] = AlctrType::invalid_address;
+							sizes[j] = isPool ? blockSz:(sizeDist(mt)*params.granuleSize);
+							alignments[j] = isPool ? blockSz:(1u<<alignExpDist(mt));
+						}
+						locked([&](){Traits::multi_alloc_addr(*alctr,count,addresses.data(),sizes.data(),alignments.data());});
+						for (uint32_t j=0u; j<count; j++)
+						{
+							if (addresses[j]==AlctrType::invalid_address)
+							{
+								out.failedAllocs++;
+								continue;
+							}
+							if (!claim(addresses[j],sizes[j],1u))
+								out.doubleHandout = true;
+							if constexpr (!isLinear)
+								live.push_back({addresses[j],sizes[j]});
+						}
+					}
+					else if constexpr (!isLinear)
+					{
+						const uint32_t freeCount = std::min<uint32_t>(count,live.size());
+						for (uint32_t j=0u; j<freeCount; j++)
+						{
+							std::uniform_int_distribution<size_t> liveDist(0u,live.size()-1u);
+							const size_t victim = liveDist(mt);
+							addresses[j] = live[victim].address;
+							sizes[j] = live[victim].size;
+							live[victim] = live.back();
+							live.pop_back();
+							// release ownership before the allocator can hand the range to someone else
+							if (!claim(addresses[j],sizes[j],0u))
+								out.doubleHandout = true;
+						}
+						locked([&](){Traits::multi_free_addr(*alctr,freeCount,addresses.data(),sizes.data());});
+					}
+					out.opCount += count;
+					// every thread does the same number of ops, so they all end the same number of frames
+					if constexpr (isLinear)
+					if (out.opCount==frameEnd)
+						frameBarrier.arrive_and_wait();
+				}
+
+				// leave the allocator empty for the next run
+				if constexpr (!isLinear)
+				for (size_t j=0u; j<live.size(); j+=Traits::maxMultiOps)
+				{
+					const uint32_t freeCount = std::min<size_t>(Traits::maxMultiOps,live.size()-j);
+					for (uint32_t k=0u; k<freeCount; k++)
+					{
+						addresses[k] = live[j+k].address;
+						sizes[k] = live[j+k].size;
+						claim(addresses[k],sizes[k],0u);
+					}
+					Traits::multi_free_addr(*alctr,freeCount,addresses.data(),sizes.data());
+				}
+			};
+
+			nbl::core::vector<std::thread> threads;
+			threads.reserve(threadCount);
+			for (uint32_t i=0u; i<threadCount; i++)
+				threads.emplace_back(worker,i);
+			while (ready.load()!=threadCount)
+				std::this_thread::yield();
+
+			const auto start = clock_t::now();
+			go.store(true,std::memory_order_release);
+			for (auto& thread : threads)
+				thread.join();
+			result.wallNs = double(std::chrono::duration_cast<std::chrono::nanoseconds>(clock_t::now()-start).count());
+
+			for (const auto& threadResult : threadResults)
+			{
+				result.opCount += threadResult.opCount;
+				result.failedAllocs += threadResult.failedAllocs;
+				result.lockWaitNs += threadResult.lockWaitNs;
+				result.lockHoldNs += threadResult.lockHoldNs;
+				result.doubleHandout = result.doubleHandout||threadResult.doubleHandout;
+			}
+
+			alctr = nullptr;
+			if constexpr (!isLinear)
+				_NBL_ALIGNED_FREE(reservedSpace);
+			return result;
+		}
+
+		//! Runs 1,2,4,.. threads up to and including `std::thread::hardware_concurrency`, returns false if any run handed out an address twice
+		static bool runScaling(const char* name, const SAllocatorStressParams& params)
+		{
+			printf("%s\n",name);
+			const uint32_t maxThreads = std::max(std::thread::hardware_concurrency(),1u);
+			double singleThreadOpsPerSecond = 0.0;
+			bool passed = true;
+			for (uint32_t threadCount=1u; ; threadCount=std::min(threadCount*2u,maxThreads))
+			{
+				const auto result = run(threadCount,params);
+				if (threadCount==1u)
+					singleThreadOpsPerSecond = result.opsPerSecond();
+				result.print(singleThreadOpsPerSecond);
+				passed = passed&&!result.doubleHandout;
+				if (threadCount==maxThreads)
+					break;
+			}
+			return passed;
+		}
+};
+
+#endif
@@ -0,0 +1,302 @@
+// Copyright (C) 2018-2020 - DevSH Graphics Programming Sp. z O.O.
+// This file is part of the "Nabla Engine".
+// For conditions of distribution and use, see copyright notice in nabla.h
+
+#ifndef _CONCURRENT_POOL_ADDRESS_ALLOCATOR_H_INCLUDED_
+#define _CONCURRENT_POOL_ADDRESS_ALLOCATOR_H_INCLUDED_
+
+#include <nabla.h>
+
+#include <atomic>
+#include <algorithm>
+
+
+//! Fixed block size address allocator which is safe to use from many threads without a mutex.
+/** Free blocks live on a lock-free (tagged, so no ABA) stack stored in the reserved space, threads grab a cache slot and move blocks
+between it and the shared stack in bulk. The common path only does an uncontended test-and-set on the flag of the thread's own slot,
+other threads only touch that slot when they steal from it or when every other slot is busy.
+Same constructor and reserved space layout contract as `PoolAddressAllocator`, so it plugs into `address_allocator_traits` as-is.
+Construction, `reset()` and moves are NOT thread-safe, only `alloc_addr`/`free_addr` and their `multi_` versions are. */
+template<typename _size_type>
+class ConcurrentPoolAddressAllocator
+{
+	public:
+		typedef _size_type							size_type;
+		typedef typename std::make_signed<_size_type>::type	difference_type;
+		typedef uint8_t*							ubyte_pointer;
+		static inline constexpr size_type invalid_address = ~size_type(0);
+
+		static inline constexpr bool supportsArbitraryOrderFrees = true;
+		static inline constexpr uint32_t maxMultiOps = 256u;
+
+		//! Way more than the number of threads we'd ever run, a thread only falls back to the shared stack if every slot is taken
+		static inline constexpr uint32_t CacheSlotCount = 64u;
+		static inline constexpr uint32_t CacheCapacity = 64u;
+		//! How many blocks move between a cache and the shared stack at once
+		static inline constexpr uint32_t CacheTransferCount = CacheCapacity/2u;
+
+		static inline size_type reserved_size(size_type maxAlignment, size_type bufSz, size_type blockSz) noexcept
+		{
+			return (bufSz/blockSz)*sizeof(std::atomic_uint32_t);
+		}
+
+		ConcurrentPoolAddressAllocator() : reservedSpace(nullptr), nextFree(nullptr), addressOffset(invalid_address), alignOffset(invalid_address), maxRequestableAlignment(0u), blockSize(1u), blockCount(0u)
+		{
+			head.store(packHead(0u,InvalidBlock),std::memory_order_relaxed);
+			freeOnStack.store(0u,std::memory_order_relaxed);
+			for (auto& cache : caches)
+			{
+				cache.busy.clear();
+				cache.count = 0u;
+			}
+		}
+
+		ConcurrentPoolAddressAllocator(void* reservedSpc, size_type addressOffsetToApply, size_type alignOffsetNeeded, size_type maxAllocatableAlignment, size_type bufSz, size_type blockSz) noexcept
+			: ConcurrentPoolAddressAllocator()
+		{
+			reservedSpace = reservedSpc;
+			addressOffset = addressOffsetToApply;
+			alignOffset = alignOffsetNeeded;
+			maxRequestableAlignment = maxAllocatableAlignment;
+			blockSize = blockSz;
+			blockCount = (bufSz-alignOffsetNeeded)/blockSz;
+			assert(blockCount<InvalidBlock);
+
+			nextFree = reinterpret_cast<std::atomic_uint32_t*>(reservedSpace);
+			for (uint32_t i=0u; i<blockCount; i++)
+				new (nextFree+i) std::atomic_uint32_t();
+			reset();
+		}
+
+		ConcurrentPoolAddressAllocator(ConcurrentPoolAddressAllocator&& other) noexcept : ConcurrentPoolAddressAllocator()
+		{
+			operator=(std::move(other));
+		}
+
+		inline ConcurrentPoolAddressAllocator& operator=(ConcurrentPoolAddressAllocator&& other) noexcept
+		{
+			std::swap(reservedSpace,other.reservedSpace);
+			std::swap(nextFree,other.nextFree);
+			std::swap(addressOffset,other.addressOffset);
+			std::swap(alignOffset,other.alignOffset);
+			std::swap(maxRequestableAlignment,other.maxRequestableAlignment);
+			std::swap(blockSize,other.blockSize);
+			std::swap(blockCount,other.blockCount);
+			{
+				const auto tmp = head.load(std::memory_order_relaxed);
+				head.store(other.head.load(std::memory_order_relaxed),std::memory_order_relaxed);
+				other.head.store(tmp,std::memory_order_relaxed);
+			}
+			{
+				const auto tmp = freeOnStack.load(std::memory_order_relaxed);
+				freeOnStack.store(other.freeOnStack.load(std::memory_order_relaxed),std::memory_order_relaxed);
+				other.freeOnStack.store(tmp,std::memory_order_relaxed);
+			}
+			for (uint32_t i=0u; i<CacheSlotCount; i++)
+			{
+				std::swap(caches[i].count,other.caches[i].count);
+				std::swap(caches[i].blocks,other.caches[i].blocks);
+			}
+			return *this;
+		}
+
+		inline size_type alloc_addr(size_type bytes, size_type alignment, size_type hint=0ull) noexcept
+		{
+			size_type address = invalid_address;
+			multi_alloc_addr(1u,&address,&bytes,&alignment);
+			return address;
+		}
+
+		inline void free_addr(size_type addr, size_type bytes) noexcept
+		{
+			multi_free_addr(1u,&addr,&bytes);
+		}
+
+		//! Only fills the `outAddresses` which are `invalid_address`, same as all the other allocators
+		inline void multi_alloc_addr(uint32_t count, size_type* outAddresses, const size_type* bytes, const size_type* alignment, const size_type* hint=nullptr) noexcept
+		{
+			SCache* cache = acquireCache();
+			for (uint32_t i=0u; i<count; i++)
+			{
+				if (outAddresses[i]!=invalid_address)
+					continue;
+				if (bytes[i]==0u || bytes[i]>blockSize)
+					continue;
+
+				uint32_t block = InvalidBlock;
+				if (cache)
+				{
+					if (cache->count==0u)
+						refill(cache);
+					if (cache->count)
+						block = cache->blocks[--cache->count];
+				}
+				else
+					popChain(&block,1u);
+				if (block==InvalidBlock)
+					break;
+				outAddresses[i] = blockToAddress(block);
+			}
+			releaseCache(cache);
+		}
+
+		inline void multi_free_addr(uint32_t count, const size_type* addr, const size_type* bytes) noexcept
+		{
+			SCache* cache = acquireCache();
+			for (uint32_t i=0u; i<count; i++)
+			{
+				if (addr[i]==invalid_address)
+					continue;
+
+				uint32_t block = addressToBlock(addr[i]);
+				if (cache)
+				{
+					if (cache->count==CacheCapacity)
+					{
+						pushChain(cache->blocks+CacheCapacity-CacheTransferCount,CacheTransferCount);
+						cache->count -= CacheTransferCount;
+					}
+					cache->blocks[cache->count++] = block;
+				}
+				else
+					pushChain(&block,1u);
+			}
+			releaseCache(cache);
+		}
+
+		//! NOT thread-safe
+		inline void reset()
+		{
+			for (uint32_t i=0u; i<blockCount; i++)
+				nextFree[i].store(i+1u<blockCount ? (i+1u):InvalidBlock,std::memory_order_relaxed);
+			head.store(packHead(0u,blockCount ? 0u:InvalidBlock),std::memory_order_relaxed);
+			freeOnStack.store(blockCount,std::memory_order_relaxed);
+			for (auto& cache : caches)
+				cache.count = 0u;
+			std::atomic_thread_fence(std::memory_order_release);
+		}
+
+		inline size_type max_size() const noexcept {return blockSize;}
+		inline size_type min_size() const noexcept {return blockSize;}
+		inline size_type max_alignment() const noexcept {return maxRequestableAlignment;}
+		inline size_type get_align_offset() const noexcept {return alignOffset;}
+		inline size_type get_combined_offset() const noexcept {return addressOffset+alignOffset;}
+
+		//! Only exact when no other thread is allocating or freeing
+		inline size_type get_free_size() const noexcept
+		{
+			size_type freeBlocks = freeOnStack.load(std::memory_order_relaxed);
+			for (const auto& cache : caches)
+				freeBlocks += cache.count;
+			return freeBlocks*blockSize;
+		}
+		inline size_type get_allocated_size() const noexcept {return get_total_size()-get_free_size();}
+		inline size_type get_total_size() const noexcept {return blockCount*blockSize;}
+
+	private:
+		static inline constexpr uint32_t InvalidBlock = ~0u;
+
+		struct alignas(64) SCache
+		{
+			std::atomic_flag busy;
+			uint32_t count;
+			uint32_t blocks[CacheCapacity];
+		};
+
+		// the tag gets bumped on every successful CAS, so a head popped and pushed back in between our load and CAS can't fool us
+		static inline uint64_t packHead(uint32_t tag, uint32_t block) {return (uint64_t(tag)<<32ull)|block;}
+		static inline uint32_t headTag(uint64_t packed) {return uint32_t(packed>>32ull);}
+		static inline uint32_t headBlock(uint64_t packed) {return uint32_t(packed);}
+
+		inline size_type blockToAddress(uint32_t block) const {return size_type(block)*blockSize+get_combined_offset();}
+		inline uint32_t addressToBlock(size_type addr) const {return uint32_t((addr-get_combined_offset())/blockSize);}
+
+		//! Pops up to `maxCount` blocks with a single CAS, returns how many it got
+		inline uint32_t popChain(uint32_t* out, const uint32_t maxCount) noexcept
+		{
+			uint64_t oldHead = head.load(std::memory_order_acquire);
+			while (true)
+			{
+				uint32_t count = 0u;
+				uint32_t block = headBlock(oldHead);
+				// links can be stale if someone else wins the race, but they're always valid indices or `InvalidBlock` and the CAS will fail anyway
+				while (count<maxCount && block!=InvalidBlock)
+				{
+					out[count++] = block;
+					block = nextFree[block].load(std::memory_order_relaxed);
+				}
+				if (count==0u)
+					return 0u;
+				if (head.compare_exchange_weak(oldHead,packHead(headTag(oldHead)+1u,block),std::memory_order_acq_rel,std::memory_order_acquire))
+				{
+					freeOnStack.fetch_sub(count,std::memory_order_relaxed);
+					return count;
+				}
+			}
+		}
+
+		//! Links the blocks up and pushes them with a single CAS
+		inline void pushChain(const uint32_t* blocks, const uint32_t count) noexcept
+		{
+			for (uint32_t i=1u; i<count; i++)
+				nextFree[blocks[i-1u]].store(blocks[i],std::memory_order_relaxed);
+			uint64_t oldHead = head.load(std::memory_order_relaxed);
+			do
+			{
+				nextFree[blocks[count-1u]].store(headBlock(oldHead),std::memory_order_relaxed);
+			} while (!head.compare_exchange_weak(oldHead,packHead(headTag(oldHead)+1u,blocks[0]),std::memory_order_release,std::memory_order_relaxed));
+			freeOnStack.fetch_add(count,std::memory_order_relaxed);
+		}
+
+		//! When the shared stack runs dry, blocks may still be sitting in other threads' caches
+		inline void refill(SCache* cache) noexcept
+		{
+			cache->count = popChain(cache->blocks,CacheTransferCount);
+			if (cache->count)
+				return;
+			for (auto& other : caches)
+			{
+				if (&other==cache || other.busy.test_and_set(std::memory_order_acquire))
+					continue;
+				const uint32_t stolen = std::min(other.count,CacheTransferCount);
+				other.count -= stolen;
+				std::copy_n(other.blocks+other.count,stolen,cache->blocks);
+				other.busy.clear(std::memory_order_release);
+				if ((cache->count=stolen))
+					return;
+			}
+		}
+
+		//! Every thread starts probing at its own slot, `nullptr` means every slot is busy and the shared stack has to be used directly
+		inline SCache* acquireCache() noexcept
+		{
+			static std::atomic_uint32_t threadCounter = 0u;
+			thread_local const uint32_t threadSlot = threadCounter++;
+			for (uint32_t i=0u; i<CacheSlotCount; i++)
+			{
+				SCache* cache = caches+(threadSlot+i)%CacheSlotCount;
+				if (!cache->busy.test_and_set(std::memory_order_acquire))
+					return cache;
+			}
+			return nullptr;
+		}
+		inline void releaseCache(SCache* cache) noexcept
+		{
+			if (cache)
+				cache->busy.clear(std::memory_order_release);
+		}
+
+		void* reservedSpace;
+		std::atomic_uint32_t* nextFree;
+		size_type addressOffset;
+		size_type alignOffset;
+		size_type maxRequestableAlignment;
+		size_type blockSize;
+		size_type blockCount;
+
+		alignas(64) std::atomic_uint64_t head;
+		alignas(64) std::atomic<size_type> freeOnStack;
+		SCache caches[CacheSlotCount];
+};
+
+#endif
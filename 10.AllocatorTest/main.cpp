@@ -3,6 +3,9 @@
 #include <random>
 #include <cmath>
 #include "../common/CommonAPI.h"
+#include "AllocatorBenchmark.h"
+#include "AllocatorStress.h"
+#include "ConcurrentPoolAddressAllocator.h"
 using namespace nbl;
 using namespace core;
 
@@ -31,6 +34,12 @@ public:
 		return dist(mt);
 	}
 
+	// makes the randomized tests reproducible
+	inline void seed(uint32_t value)
+	{
+		mt.seed(value);
+	}
+
 	inline std::mt19937& getMt()
 	{
 		return mt;
@@ -237,7 +246,7 @@ private:
 			{
 				// randomly decide sizes (but always less than `address_allocator_traits::max_size`)
 
-				if constexpr (std::is_same_v<AlctrType,core::PoolAddressAllocator<uint32_t>>||std::is_same_v<AlctrType,core::IteratablePoolAddressAllocator<uint32_t>>)
+				if constexpr (std::is_same_v<AlctrType,core::PoolAddressAllocator<uint32_t>>||std::is_same_v<AlctrType,core::IteratablePoolAddressAllocator<uint32_t>>||std::is_same_v<AlctrType,ConcurrentPoolAddressAllocator<uint32_t>>)
 				{
 					sizes[j] = randAllocParams.blockSz;
 					alignments[j] = randAllocParams.blockSz;
@@ -305,6 +314,42 @@ public:
 
 	void onAppInitialized_impl() override
 	{
+		// `-BENCHMARK [-SEED=n] [-TRACE=path] [-RECORD_TRACE=path]` replays the same allocation trace against every allocator instead of the randomized test
+		// `-STRESS [-SEED=n]` hammers the `*MT` allocators from 1 up to `hardware_concurrency` threads
+		{
+			bool benchmark = false;
+			bool stress = false;
+			CAllocationTrace::SGenerationParams traceParams;
+			std::string tracePath, recordPath;
+			for (const auto& arg : argv)
+			{
+				if (arg=="-BENCHMARK")
+					benchmark = true;
+				else if (arg=="-STRESS")
+					stress = true;
+				else if (arg.rfind("-SEED=",0)==0)
+				{
+					traceParams.seed = std::stoul(arg.substr(6));
+					rng.seed(traceParams.seed);
+				}
+				else if (arg.rfind("-TRACE=",0)==0)
+					tracePath = arg.substr(7);
+				else if (arg.rfind("-RECORD_TRACE=",0)==0)
+					recordPath = arg.substr(14);
+			}
+
+			if (benchmark)
+				runAllocatorBenchmark(traceParams,tracePath,recordPath);
+			if (stress)
+			{
+				SAllocatorStressParams stressParams;
+				stressParams.seed = traceParams.seed;
+				runAllocatorStress(stressParams);
+			}
+			if (benchmark||stress)
+				return;
+		}
+
 		// Allocator test
 		{
 			{
@@ -317,6 +362,11 @@ public:
 				iterPoolAlctrHandler.executeAllocatorTest();
 			}
 
+			{
+				AllocatorHandler<ConcurrentPoolAddressAllocator<uint32_t>> concurrentPoolAlctrHandler;
+				concurrentPoolAlctrHandler.executeAllocatorTest();
+			}
+
 			{
 				AllocatorHandler<core::LinearAddressAllocator<uint32_t>> linearAlctrHandler;
 				linearAlctrHandler.executeAllocatorTest();
@@ -357,7 +407,46 @@ public:
 			nbl::core::address_allocator_traits<core::IteratablePoolAddressAllocatorMT<uint32_t, std::recursive_mutex> >::printDebugInfo();
 			printf("General \n");
 			nbl::core::address_allocator_traits<core::GeneralpurposeAddressAllocatorMT<uint32_t, std::recursive_mutex> >::printDebugInfo();
+			printf("Concurrent Pool \n");
+			nbl::core::address_allocator_traits<ConcurrentPoolAddressAllocator<uint32_t> >::printDebugInfo();
+		}
+	}
+
+	void runAllocatorBenchmark(const CAllocationTrace::SGenerationParams& traceParams, const std::string& tracePath, const std::string& recordPath)
+	{
+		CAllocationTrace trace;
+		if (tracePath.empty())
+			trace = CAllocationTrace::generate(traceParams);
+		else if (!trace.load(tracePath))
+		{
+			printf("Could not load allocation trace %s\n",tracePath.c_str());
+			exit(35);
 		}
+
+		if (!recordPath.empty() && !trace.save(recordPath))
+			printf("Could not record allocation trace to %s\n",recordPath.c_str());
+
+		printf("Replaying %zu ops (%u allocations, max size %u, max alignment %u), seed %u\n",trace.ops.size(),trace.allocationCount,trace.maxSize,trace.maxAlignment,traceParams.seed);
+		// same params for all, so the numbers are comparable
+		const SAllocatorBenchmarkParams params;
+		CAllocatorBenchmark<core::PoolAddressAllocator<uint32_t>>::run("Pool",trace,params).print();
+		CAllocatorBenchmark<core::IteratablePoolAddressAllocator<uint32_t>>::run("IteratablePool",trace,params).print();
+		CAllocatorBenchmark<ConcurrentPoolAddressAllocator<uint32_t>>::run("ConcurrentPool",trace,params).print();
+		CAllocatorBenchmark<core::LinearAddressAllocator<uint32_t>>::run("Linear",trace,params).print();
+		CAllocatorBenchmark<core::StackAddressAllocator<uint32_t>>::run("Stack",trace,params).print();
+		CAllocatorBenchmark<core::GeneralpurposeAddressAllocator<uint32_t>>::run("General",trace,params).print();
+	}
+
+	void runAllocatorStress(const SAllocatorStressParams& params)
+	{
+		bool passed = true;
+		passed = CAllocatorStress<core::LinearAddressAllocatorMT<uint32_t,std::recursive_mutex>>::runScaling("Linear MT",params) && passed;
+		passed = CAllocatorStress<core::PoolAddressAllocatorMT<uint32_t,std::recursive_mutex>>::runScaling("Pool MT",params) && passed;
+		passed = CAllocatorStress<core::IteratablePoolAddressAllocatorMT<uint32_t,std::recursive_mutex>>::runScaling("Iteratable Pool MT",params) && passed;
+		passed = CAllocatorStress<ConcurrentPoolAddressAllocator<uint32_t>>::runScaling("Concurrent Pool",params) && passed;
+		passed = CAllocatorStress<core::GeneralpurposeAddressAllocatorMT<uint32_t,std::recursive_mutex>>::runScaling("General MT",params) && passed;
+		if (!passed)
+			exit(36);
 	}
 
 	void onAppTerminated_impl() override
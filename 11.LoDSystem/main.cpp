@@ -9,6 +9,8 @@
 #include "../common/CommonAPI.h"
 #include "nbl/ext/ScreenShot/ScreenShot.h"
 
+#include "../63.OBB/CBoundingVolumeBatch.h"
+
 using namespace nbl;
 using namespace core;
 using namespace system;
@@ -199,6 +201,14 @@ void addLoDTable(
             assert(false);
             break;
         }
+        // bounds of all the batches at once, instead of pointing the meshbuffer's index binding at every batch in turn
+        core::vector<CBoundingVolumeBatch::SJob> batchJobs;
+        batchJobs.reserve(batchCount);
+        for (auto i = 0u; i < indexCount; i += indicesPerBatch)
+            batchJobs.push_back(CBoundingVolumeBatch::makeJob(cpumeshes[lod].get(), i, core::min(indexCount - i, indicesPerBatch)));
+        core::vector<core::aabbox3df> batchAABBs(batchCount);
+        CBoundingVolumeBatch().compute(batchJobs.data(), batchJobs.data() + batchJobs.size(), batchAABBs.data());
+
         auto batchID = 0u;
         for (auto i = 0u; i < indexCount; i += indicesPerBatch, batchID++)
         {
@@ -212,18 +222,7 @@ void addLoDTable(
            
             lodLibraryData.drawCallOffsetsIn20ByteStrides.emplace_back(di.drawCallOffset / di.drawCommandStride + batchID);
 
-            core::aabbox3df batchAABB;
-            {
-                // temporarily change the base vertex and index count to make AABB computation easier
-                auto mb = cpumeshes[lod].get();
-                auto oldBinding = mb->getIndexBufferBinding();
-                const auto oldIndexCount = mb->getIndexCount();
-                mb->setIndexBufferBinding({ oldBinding.offset + i * indexSize,oldBinding.buffer });
-                mb->setIndexCount(drawCallData.count);
-                batchAABB = IMeshManipulator::calculateBoundingBox(mb);
-                mb->setIndexCount(oldIndexCount);
-                mb->setIndexBufferBinding(std::move(oldBinding));
-            }
+            const auto& batchAABB = batchAABBs[batchID];
             aabb.addInternalBox(batchAABB);
 
             const uint32_t drawCallDWORDOffset = (di.drawCallOffset + batchID * di.drawCommandStride) / sizeof(uint32_t);
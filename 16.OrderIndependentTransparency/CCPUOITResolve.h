@@ -0,0 +1,174 @@
+#ifndef _C_CPU_OIT_RESOLVE_INCLUDED_
+#define _C_CPU_OIT_RESOLVE_INCLUDED_
+
+#include "nabla.h"
+
+#include <cmath>
+#include <numeric>
+#include <algorithm>
+
+
+// CPU version of what 16.OrderIndependentTransparency does with `ext::OIT::COIT`, for finding out offline how much a node budget costs in
+// quality and bandwidth before changing the one of the extension.
+//
+// The fill pass keeps every pixel's nodes sorted front to back and inserts each fragment as it arrives, when that leaves one node too many
+// the two furthest ones get blended into one (multi layer alpha blending). The resolve then composites the nodes front to back over the
+// background. With at least as many nodes as a pixel has fragments nothing ever gets merged and the result is exactly the sorted composite,
+// which `resolveExact` computes with the same arithmetic so the two can be compared bit for bit.
+// Fragments and nodes get treated like `oit_fill_nodes.frag` does: fragments with less than 1/255 alpha get discarded, the premultiplied
+// color is stored with `packUnorm4x8`, the visibility is one minus alpha in 8 bits, and the depth is the 32bit reverse Z the shader encodes
+// (positive floats order the same as their bits, so it stays a float here). Nodes get rounded to that whenever they get written, on
+// insertion and after a merge. The sorted composite is made of the same rounded nodes, so the error against it is only the one of merging.
+//
+// Depth follows the example's reverse Z (`ECO_GREATER`), the greater the depth the closer the fragment, fragments at equal depth
+// composite in the order they were drawn.
+class CCPUOITResolve : public nbl::core::IReferenceCounted
+{
+	public:
+		static inline constexpr uint32_t MaxNodeCount = 16u;
+		// a `packUnorm4x8` color, a 32bit depth and an 8bit visibility per node
+		static inline constexpr uint32_t NodeSize = 9u;
+
+		// color isn't premultiplied by alpha
+		struct SFragment
+		{
+			float color[3];
+			float alpha;
+			float depth;
+		};
+		// fragments of pixel `i` are the ones from `offsets[i]` to `offsets[i+1]`, in the order they were drawn
+		struct SFragmentLists
+		{
+			const SFragment* fragments = nullptr;
+			const uint32_t* offsets = nullptr;
+			uint32_t pixelCount = 0u;
+		};
+
+		static inline nbl::core::smart_refctd_ptr<CCPUOITResolve> create(const uint32_t nodeCount)
+		{
+			if (nodeCount==0u || nodeCount>MaxNodeCount)
+				return nullptr;
+			return nbl::core::smart_refctd_ptr<CCPUOITResolve>(new CCPUOITResolve(nodeCount),nbl::core::dont_grab);
+		}
+
+		inline uint32_t getNodeCount() const { return nodeCount; }
+		inline uint32_t getBytesPerPixel() const { return nodeCount*NodeSize; }
+
+		// fills and resolves every pixel, writes 3 floats per pixel to `rgb`
+		inline void resolve(const SFragmentLists& lists, const float* background, float* rgb) const
+		{
+			parallelFor(lists.pixelCount,[&](const uint32_t pixel) -> void
+			{
+				SNode nodes[MaxNodeCount+1u];
+				uint32_t count = 0u;
+				for (auto i=lists.offsets[pixel]; i<lists.offsets[pixel+1u]; i++)
+				{
+					if (isDiscarded(lists.fragments[i]))
+						continue;
+					insert(nodes,count,lists.fragments[i]);
+					if (count>nodeCount)
+						mergeLast(nodes,count);
+				}
+				composite(nodes,count,background,rgb+pixel*3u);
+			});
+		}
+
+		// sorts all of every pixel's fragments, what `resolve` would give with unlimited nodes
+		static inline void resolveExact(const SFragmentLists& lists, const float* background, float* rgb)
+		{
+			parallelFor(lists.pixelCount,[&](const uint32_t pixel) -> void
+			{
+				nbl::core::vector<SNode> nodes;
+				nodes.reserve(lists.offsets[pixel+1u]-lists.offsets[pixel]);
+				for (auto i=lists.offsets[pixel]; i<lists.offsets[pixel+1u]; i++)
+				if (!isDiscarded(lists.fragments[i]))
+					nodes.push_back(makeNode(lists.fragments[i]));
+				std::stable_sort(nodes.begin(),nodes.end(),[](const SNode& lhs, const SNode& rhs) -> bool {return lhs.depth>rhs.depth;});
+				composite(nodes.data(),static_cast<uint32_t>(nodes.size()),background,rgb+pixel*3u);
+			});
+		}
+
+	private:
+		CCPUOITResolve(const uint32_t _nodeCount) : nodeCount(_nodeCount) {}
+
+		// premultiplied color and how much of what's behind shows through
+		struct SNode
+		{
+			float color[3];
+			float transmittance;
+			float depth;
+		};
+
+		template<typename F>
+		static inline void parallelFor(const uint32_t count, F&& f)
+		{
+			nbl::core::vector<uint32_t> indices(count);
+			std::iota(indices.begin(),indices.end(),0u);
+			std::for_each(nbl::core::execution::par_unseq,indices.begin(),indices.end(),std::forward<F>(f));
+		}
+
+		static inline SNode makeNode(const SFragment& fragment)
+		{
+			SNode node = {{fragment.color[0]*fragment.alpha,fragment.color[1]*fragment.alpha,fragment.color[2]*fragment.alpha},1.f-fragment.alpha,fragment.depth};
+			quantize(node);
+			return node;
+		}
+
+		static inline bool isDiscarded(const SFragment& fragment)
+		{
+			return fragment.alpha<1.f/255.f;
+		}
+
+		// what `packUnorm4x8` keeps of a channel
+		static inline float quantizeUnorm8(const float value)
+		{
+			return std::floor(std::clamp(value,0.f,1.f)*255.f+0.5f)/255.f;
+		}
+
+		// the color and visibility get stored in 8 bits each, the depth as 32 bits anyway
+		static inline void quantize(SNode& node)
+		{
+			for (auto c=0u; c<3u; c++)
+				node.color[c] = quantizeUnorm8(node.color[c]);
+			node.transmittance = quantizeUnorm8(node.transmittance);
+		}
+
+		// behind every node at the same depth, so those keep the order they were drawn in
+		static inline void insert(SNode* nodes, uint32_t& count, const SFragment& fragment)
+		{
+			uint32_t i = count++;
+			for (; i && nodes[i-1u].depth<fragment.depth; i--)
+				nodes[i] = nodes[i-1u];
+			nodes[i] = makeNode(fragment);
+		}
+
+		// the furthest node gets blended under the one in front of it, which keeps its depth
+		static inline void mergeLast(SNode* nodes, uint32_t& count)
+		{
+			SNode& front = nodes[count-2u];
+			const SNode& back = nodes[count-1u];
+			for (auto c=0u; c<3u; c++)
+				front.color[c] += front.transmittance*back.color[c];
+			front.transmittance *= back.transmittance;
+			quantize(front);
+			count--;
+		}
+
+		static inline void composite(const SNode* nodes, const uint32_t count, const float* background, float* rgb)
+		{
+			float color[3] = {0.f,0.f,0.f};
+			float transmittance = 1.f;
+			for (auto i=0u; i<count; i++)
+			{
+				for (auto c=0u; c<3u; c++)
+					color[c] += transmittance*nodes[i].color[c];
+				transmittance *= nodes[i].transmittance;
+			}
+			for (auto c=0u; c<3u; c++)
+				rgb[c] = color[c]+transmittance*background[c];
+		}
+
+		const uint32_t nodeCount;
+};
+
+#endif
@@ -0,0 +1,261 @@
+#ifndef _C_VERTEX_ATTRIBUTE_REPACKER_INCLUDED_
+#define _C_VERTEX_ATTRIBUTE_REPACKER_INCLUDED_
+
+#include "nabla.h"
+
+#include <cmath>
+#include <algorithm>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP>=2)
+#include <immintrin.h>
+#define _VERTEX_ATTRIBUTE_REPACKER_SSE_
+#endif
+
+
+// Builds the combined normal and half float UV stream the virtual geometry shaders fetch with `nbl_glsl_VG_attribFetch2u`,
+// for many meshbuffers at once with the vertices of all of them split into chunks spread over threads.
+//
+// Normals which are already 32bit (the loaders' RGB10A2 SNORM) get copied raw, 3 float normals get quantized to RGB10A2 SNORM the same
+// way `nbl_glsl_encodeRGB10A2_SNORM` does, UVs in 2 floats get converted to halves 4 vertices at a time with the same bit-exact rounding
+// as `core::Float16Compressor`. Any other format goes through `ICPUMeshBuffer::getAttribute`, which is slow but always right.
+// An attribute which is elided (or disabled on the meshbuffer, so no material can read it) gets written as zero without being read.
+class CVertexAttributeRepacker
+{
+	public:
+		struct SCombinedNormalUV
+		{
+			uint32_t nml;
+			uint16_t u,v;
+		};
+		static_assert(sizeof(SCombinedNormalUV)==sizeof(uint64_t));
+
+		struct SAttribute
+		{
+			const uint8_t* data = nullptr;
+			uint32_t stride = 0u;
+			nbl::asset::E_FORMAT format = nbl::asset::EF_UNKNOWN;
+			// only needed for formats without a fast path
+			const nbl::asset::ICPUMeshBuffer* meshBuffer = nullptr;
+			uint32_t attributeIx = ~0u;
+		};
+		struct SJob
+		{
+			SAttribute normal;
+			SAttribute uv;
+			// vertex `i` of the source attributes lands in `out[i]`
+			SCombinedNormalUV* out = nullptr;
+			uint32_t vertexCount = 0u;
+		};
+
+		// Has to be called before the meshbuffer's vertex input params get changed, as the source formats get captured here.
+		static inline SJob makeJob(const nbl::asset::ICPUMeshBuffer* meshBuffer, const uint32_t uvAttributeIx, SCombinedNormalUV* out, const uint32_t vertexCount, const bool elideNormal=false, const bool elideUV=false)
+		{
+			auto makeAttribute = [meshBuffer](const uint32_t attributeIx, const bool elide) -> SAttribute
+			{
+				SAttribute retval;
+				if (elide || attributeIx>=nbl::asset::SVertexInputParams::MAX_VERTEX_ATTRIB_COUNT || !meshBuffer->isAttributeEnabled(attributeIx))
+					return retval;
+				retval.data = meshBuffer->getAttribPointer(attributeIx);
+				if (!retval.data)
+					return retval;
+				retval.stride = meshBuffer->getAttribStride(attributeIx);
+				retval.format = meshBuffer->getAttribFormat(attributeIx);
+				retval.meshBuffer = meshBuffer;
+				retval.attributeIx = attributeIx;
+				return retval;
+			};
+
+			SJob job;
+			job.normal = makeAttribute(meshBuffer->getNormalAttributeIx(),elideNormal);
+			job.uv = makeAttribute(uvAttributeIx,elideUV);
+			job.out = out;
+			job.vertexCount = vertexCount;
+			return job;
+		}
+
+		// Results don't depend on the chunk size or thread count.
+		void repack(const SJob* jobsBegin, const SJob* jobsEnd, const uint32_t verticesPerChunk=VerticesPerChunk)
+		{
+			assert(verticesPerChunk%4u==0u);
+			chunks.clear();
+			for (auto job=jobsBegin; job!=jobsEnd; job++)
+			for (uint32_t first=0u; first<job->vertexCount; first+=verticesPerChunk)
+				chunks.push_back({job,first,std::min(first+verticesPerChunk,job->vertexCount)});
+
+			std::for_each(nbl::core::execution::par_unseq,chunks.begin(),chunks.end(),[](const SChunk& chunk) -> void
+			{
+				repackNormals(chunk.job->normal,chunk.job->out,chunk.begin,chunk.end);
+				repackUVs(chunk.job->uv,chunk.job->out,chunk.begin,chunk.end);
+			});
+		}
+
+		static inline uint32_t quantizeNormal(const float x, const float y, const float z)
+		{
+			auto quantize = [](const float c) -> uint32_t
+			{
+				return uint32_t(std::lrint(std::clamp(c,-1.f,1.f)*511.f))&0x3ffu;
+			};
+			return quantize(x)|(quantize(y)<<10u)|(quantize(z)<<20u)|NormalAlphaBits;
+		}
+
+	private:
+		static inline constexpr uint32_t VerticesPerChunk = 0x1u<<14u;
+		// alpha of 1.0 in 2bit SNORM
+		static inline constexpr uint32_t NormalAlphaBits = 0x1u<<30u;
+
+		struct SChunk
+		{
+			const SJob* job;
+			uint32_t begin,end;
+		};
+
+		template<typename T>
+		static inline const T& fetch(const SAttribute& attr, const uint32_t i)
+		{
+			return *reinterpret_cast<const T*>(attr.data+size_t(i)*attr.stride);
+		}
+
+		static inline void repackNormals(const SAttribute& attr, SCombinedNormalUV* out, const uint32_t begin, const uint32_t end)
+		{
+			if (!attr.data)
+			{
+				for (auto i=begin; i<end; i++)
+					out[i].nml = 0u;
+			}
+			else if (nbl::asset::getTexelOrBlockBytesize(attr.format)==sizeof(uint32_t))
+			{
+				// already packed, the shader decodes it as RGB10A2 SNORM
+				for (auto i=begin; i<end; i++)
+					memcpy(&out[i].nml,attr.data+size_t(i)*attr.stride,sizeof(uint32_t));
+			}
+			else if (attr.format==nbl::asset::EF_R32G32B32_SFLOAT)
+			{
+				auto i = begin;
+				#ifdef _VERTEX_ATTRIBUTE_REPACKER_SSE_
+				const __m128 one = _mm_set1_ps(1.f);
+				const __m128 minusOne = _mm_set1_ps(-1.f);
+				const __m128 scale = _mm_set1_ps(511.f);
+				const __m128i mask = _mm_set1_epi32(0x3ff);
+				auto quantize = [&](const __m128 c) -> __m128i
+				{
+					return _mm_and_si128(_mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(c,minusOne),one),scale)),mask);
+				};
+				for (; i+4u<=end; i+=4u)
+				{
+					const float* n[4] = {&fetch<float>(attr,i),&fetch<float>(attr,i+1u),&fetch<float>(attr,i+2u),&fetch<float>(attr,i+3u)};
+					const __m128i x = quantize(_mm_setr_ps(n[0][0],n[1][0],n[2][0],n[3][0]));
+					const __m128i y = quantize(_mm_setr_ps(n[0][1],n[1][1],n[2][1],n[3][1]));
+					const __m128i z = quantize(_mm_setr_ps(n[0][2],n[1][2],n[2][2],n[3][2]));
+					alignas(16) uint32_t packed[4];
+					_mm_store_si128(reinterpret_cast<__m128i*>(packed),_mm_or_si128(_mm_or_si128(x,_mm_slli_epi32(y,10)),_mm_or_si128(_mm_slli_epi32(z,20),_mm_set1_epi32(NormalAlphaBits))));
+					for (auto j=0u; j<4u; j++)
+						out[i+j].nml = packed[j];
+				}
+				#endif
+				for (; i<end; i++)
+				{
+					const float* n = &fetch<float>(attr,i);
+					out[i].nml = quantizeNormal(n[0],n[1],n[2]);
+				}
+			}
+			else
+			{
+				for (auto i=begin; i<end; i++)
+				{
+					nbl::core::vectorSIMDf n;
+					attr.meshBuffer->getAttribute(n,attr.attributeIx,i);
+					out[i].nml = quantizeNormal(n.x,n.y,n.z);
+				}
+			}
+		}
+
+		static inline void repackUVs(const SAttribute& attr, SCombinedNormalUV* out, const uint32_t begin, const uint32_t end)
+		{
+			if (!attr.data)
+			{
+				for (auto i=begin; i<end; i++)
+					out[i].u = out[i].v = 0u;
+			}
+			else if (attr.format==nbl::asset::EF_R32G32_SFLOAT)
+			{
+				auto i = begin;
+				#ifdef _VERTEX_ATTRIBUTE_REPACKER_SSE_
+				for (; i+4u<=end; i+=4u)
+				{
+					const float* uv[4] = {&fetch<float>(attr,i),&fetch<float>(attr,i+1u),&fetch<float>(attr,i+2u),&fetch<float>(attr,i+3u)};
+					const __m128i lo = compressHalf(_mm_setr_ps(uv[0][0],uv[0][1],uv[1][0],uv[1][1]));
+					const __m128i hi = compressHalf(_mm_setr_ps(uv[2][0],uv[2][1],uv[3][0],uv[3][1]));
+					// halves are in the low 16 bits of every lane, pack two lanes into one `u,v` pair
+					alignas(16) uint32_t packed[4];
+					_mm_store_si128(reinterpret_cast<__m128i*>(packed),packHalfPairs(lo,hi));
+					for (auto j=0u; j<4u; j++)
+					{
+						out[i+j].u = uint16_t(packed[j]);
+						out[i+j].v = uint16_t(packed[j]>>16u);
+					}
+				}
+				#endif
+				for (; i<end; i++)
+				{
+					const float* uv = &fetch<float>(attr,i);
+					out[i].u = nbl::core::Float16Compressor::compress(uv[0]);
+					out[i].v = nbl::core::Float16Compressor::compress(uv[1]);
+				}
+			}
+			else
+			{
+				for (auto i=begin; i<end; i++)
+				{
+					nbl::core::vectorSIMDf uv;
+					attr.meshBuffer->getAttribute(uv,attr.attributeIx,i);
+					out[i].u = nbl::core::Float16Compressor::compress(uv.x);
+					out[i].v = nbl::core::Float16Compressor::compress(uv.y);
+				}
+			}
+		}
+
+		#ifdef _VERTEX_ATTRIBUTE_REPACKER_SSE_
+		// branchless `core::Float16Compressor::compress` on 4 floats, the result is in the low 16 bits of every lane
+		static inline __m128i compressHalf(const __m128 value)
+		{
+			auto select = [](const __m128i a, const __m128i b, const __m128i mask) -> __m128i
+			{
+				return _mm_xor_si128(a,_mm_and_si128(_mm_xor_si128(a,b),mask));
+			};
+			const __m128i infN = _mm_set1_epi32(0x7F800000);
+			const __m128i maxN = _mm_set1_epi32(0x477FE000);
+			const __m128i minN = _mm_set1_epi32(0x38800000);
+			const __m128i nanN = _mm_set1_epi32(0x7F802000);
+			const __m128i maxC = _mm_set1_epi32(0x23BFF);
+			const __m128i subC = _mm_set1_epi32(0x003FF);
+			const __m128i maxD = _mm_set1_epi32(0x1C000);
+			const __m128i minD = _mm_set1_epi32(0x1C000);
+			const __m128 mulN = _mm_castsi128_ps(_mm_set1_epi32(0x52000000));
+
+			__m128i v = _mm_castps_si128(value);
+			const __m128i sign = _mm_and_si128(v,_mm_set1_epi32(0x80000000));
+			v = _mm_xor_si128(v,sign);
+			// correct subnormals
+			const __m128i s = _mm_cvttps_epi32(_mm_mul_ps(mulN,_mm_castsi128_ps(v)));
+			v = select(v,s,_mm_cmpgt_epi32(minN,v));
+			v = select(v,infN,_mm_and_si128(_mm_cmpgt_epi32(infN,v),_mm_cmpgt_epi32(v,maxN)));
+			v = select(v,nanN,_mm_and_si128(_mm_cmpgt_epi32(nanN,v),_mm_cmpgt_epi32(v,infN)));
+			v = _mm_srli_epi32(v,13);
+			v = select(v,_mm_sub_epi32(v,maxD),_mm_cmpgt_epi32(v,maxC));
+			v = select(v,_mm_sub_epi32(v,minD),_mm_cmpgt_epi32(v,subC));
+			return _mm_or_si128(v,_mm_srli_epi32(sign,16));
+		}
+		// lanes `{u0,v0,u1,v1}` and `{u2,v2,u3,v3}` into `{u0|v0<<16,...,u3|v3<<16}`
+		static inline __m128i packHalfPairs(const __m128i lo, const __m128i hi)
+		{
+			const __m128i evenLo = _mm_shuffle_epi32(lo,_MM_SHUFFLE(3,1,2,0)); // u0 u1 v0 v1
+			const __m128i evenHi = _mm_shuffle_epi32(hi,_MM_SHUFFLE(3,1,2,0)); // u2 u3 v2 v3
+			const __m128i us = _mm_unpacklo_epi64(evenLo,evenHi); // u0 u1 u2 u3
+			const __m128i vs = _mm_unpackhi_epi64(evenLo,evenHi); // v0 v1 v2 v3
+			return _mm_or_si128(us,_mm_slli_epi32(vs,16));
+		}
+		#endif
+
+		nbl::core::vector<SChunk> chunks;
+};
+
+#endif
@@ -2,8 +2,8 @@
 #include <filesystem>
 
 #include "Renderer.h"
+#include "SampleSequenceCache.h"
 
-#include "nbl/ext/ScreenShot/ScreenShot.h"
 #include "nbl/ext/FullScreenTriangle/FullScreenTriangle.h"
 #include "nbl/asset/filters/CFillImageFilter.h"
 #include "../source/Nabla/COpenCLHandler.h"
@@ -316,8 +316,9 @@ Renderer::InitializationData Renderer::initSceneObjects(const SAssetBundle& mesh
 				{
 					core::vector<const ICPUMeshBuffer*> meshBuffersToProcess;
 					meshBuffersToProcess.reserve(contents.size());
+					core::vector<CVertexAttributeRepacker::SJob> repackJobs;
+					repackJobs.reserve(contents.size());
 					// TODO: Optimize! Check which triangles need normals, bin into two separate meshbuffers, dont have normals for meshbuffers where all(abs(transpose(normals)*cross(pos1-pos0,pos2-pos0))~=1.f) 
-					// TODO: Optimize! Check which materials use any textures, if meshbuffer doens't use any textures, its pipeline doesn't need UV coordinates
 					// TODO: separate pipeline for stuff without UVs and separate out the barycentric derivative FBO attachment 
 					for (const auto& asset : contents)
 					{
@@ -330,6 +331,24 @@ Renderer::InitializationData Renderer::initSceneObjects(const SAssetBundle& mesh
 						{
 							auto meshBuffer = *mbIt;
 							assert(meshBuffer->getInstanceCount()==instanceCount);
+							// vertex `i` of the original attributes ends up in element `i` of the new buffer, same as any other attribute
+							const auto approxVxCount = IMeshManipulator::upperBoundVertexID(meshBuffer)+meshBuffer->getBaseVertex();
+							auto newBuff = core::make_smart_refctd_ptr<ICPUBuffer>(sizeof(CVertexAttributeRepacker::SCombinedNormalUV)*approxVxCount);
+							// needs to capture the original attribute formats, before we mess with them
+							constexpr auto uvAttributeIx = 2u;
+							// UVs only feed the texture prefetch stream and smooth normals are only fetched when there's a BxDF to continue the path with,
+							// so if no instance's material reads them on either side, don't bother reading or converting them
+							bool usesUV = false, usesNormal = false;
+							{
+								const auto* mbInstanceData = origInstanceData+meshBuffer->getBaseInstance();
+								for (auto i=0u; i<instanceCount; i++)
+								for (const auto& oriented : {mbInstanceData[i].material.front,mbInstanceData[i].material.back})
+								{
+									usesUV = usesUV || oriented.prefetch_count!=0u;
+									usesNormal = usesNormal || oriented.genchoice_count!=0u;
+								}
+							}
+							repackJobs.push_back(CVertexAttributeRepacker::makeJob(meshBuffer,uvAttributeIx,reinterpret_cast<CVertexAttributeRepacker::SCombinedNormalUV*>(newBuff->getPointer()),approxVxCount,!usesNormal,!usesUV));
 							// We'll disable certain attributes to ensure we only copy position, normal and uv attribute
 							SVertexInputParams& vertexInput = meshBuffer->getPipeline()->getVertexInputParams();
 							// but we'll pack normals and UVs together to save one SSBO binding (and quantize UVs to half floats)
@@ -340,26 +359,7 @@ Renderer::InitializationData Renderer::initSceneObjects(const SAssetBundle& mesh
 							vertexInput.enabledBindingFlags |= 0x1u<<freeBinding;
 							vertexInput.bindings[freeBinding].inputRate = EVIR_PER_VERTEX;
 							vertexInput.bindings[freeBinding].stride = 0u;
-							const auto approxVxCount = IMeshManipulator::upperBoundVertexID(meshBuffer)+meshBuffer->getBaseVertex();
-							struct CombinedNormalUV
-							{
-								uint32_t nml;
-								uint16_t u,v;
-							};
-							auto newBuff = core::make_smart_refctd_ptr<ICPUBuffer>(sizeof(CombinedNormalUV)*approxVxCount);
-							auto* dst = reinterpret_cast<CombinedNormalUV*>(newBuff->getPointer())+meshBuffer->getBaseVertex();
-							meshBuffer->setVertexBufferBinding({0u,newBuff},freeBinding);
-							// copy and pack data
-							const auto normalAttr = meshBuffer->getNormalAttributeIx();
-							vertexInput.attributes[normalAttr].format = EF_R32_UINT;
-							for (auto i=0u; i<approxVxCount; i++)
-							{
-								meshBuffer->getAttribute(&dst[i].nml,normalAttr,i);
-								core::vectorSIMDf uv;
-								meshBuffer->getAttribute(uv,2u,i);
-								dst[i].u = core::Float16Compressor::compress(uv.x);
-								dst[i].v = core::Float16Compressor::compress(uv.y);
-							}
+							meshBuffer->setVertexBufferBinding({0u,std::move(newBuff)},freeBinding);
 						}
 
 						const uint32_t mdiBound = cpump->calcMDIStructMaxCount(meshBuffers.begin(),meshBuffers.end());
@@ -368,8 +368,14 @@ Renderer::InitializationData Renderer::initSceneObjects(const SAssetBundle& mesh
 
 						meshBuffersToProcess.insert(meshBuffersToProcess.end(),meshBuffers.begin(),meshBuffers.end());
 					}
+					// copy and pack data, all meshbuffers at once
+					vertexAttributeRepacker.repack(repackJobs.data(),repackJobs.data()+repackJobs.size());
 					for (auto meshBuffer : meshBuffersToProcess)
-						const_cast<ICPUMeshBuffer*>(meshBuffer)->getPipeline()->getVertexInputParams().enabledAttribFlags = newEnabledAttributeMask;
+					{
+						auto& vertexInput = const_cast<ICPUMeshBuffer*>(meshBuffer)->getPipeline()->getVertexInputParams();
+						vertexInput.attributes[meshBuffer->getNormalAttributeIx()].format = EF_R32_UINT;
+						vertexInput.enabledAttribFlags = newEnabledAttributeMask;
+					}
 
 					allocData.resize(meshBuffersToProcess.size());
 
@@ -853,52 +859,13 @@ core::smart_refctd_ptr<IGPUImageView> Renderer::createScreenSizedTexture(E_FORMA
 }
 
 
-core::smart_refctd_ptr<asset::ICPUBuffer> Renderer::SampleSequence::createCPUBuffer(uint32_t quantizedDimensions, uint32_t sampleCount)
-{
-	const size_t bytesize = SampleSequence::QuantizedDimensionsBytesize*quantizedDimensions*sampleCount;
-	if (bytesize)
-		return core::make_smart_refctd_ptr<asset::ICPUBuffer>(bytesize);
-	else
-		return nullptr;
-}
-void Renderer::SampleSequence::createBufferView(IVideoDriver* driver, core::smart_refctd_ptr<asset::ICPUBuffer>&& buff)
+void Renderer::SampleSequence::createBufferView(IVideoDriver* driver, const std::filesystem::path& cachePath, uint32_t quantizedDimensions, uint32_t sampleCount)
 {
+	auto buff = SampleSequenceCache::get(cachePath,quantizedDimensions,sampleCount,ScrambleSeed);
+	// upload sequence to GPU
 	auto gpubuf = driver->createFilledDeviceLocalBufferOnDedMem(buff->getSize(),buff->getPointer());
 	bufferView = driver->createBufferView(gpubuf.get(),asset::EF_R32G32_UINT);
 }
-core::smart_refctd_ptr<ICPUBuffer> Renderer::SampleSequence::createBufferView(IVideoDriver* driver, uint32_t quantizedDimensions, uint32_t sampleCount)
-{
-	constexpr auto DimensionsPerQuanta = 3u;
-	const auto dimensions = quantizedDimensions*DimensionsPerQuanta;
-	core::OwenSampler sampler(dimensions,0xdeadbeefu);
-
-	// Memory Order: 3 Dimensions, then multiple of sampling stragies per vertex, then depth, then sample ID
-	auto buff = createCPUBuffer(quantizedDimensions,sampleCount);
-	uint32_t(&pout)[][2] = *reinterpret_cast<uint32_t(*)[][2]>(buff->getPointer());
-	// the horrible order of iteration over output memory is caused by the fact that certain samplers like the 
-	// Owen Scramble sampler, have a large cache which needs to be generated separately for each dimension.
-	for (auto metadim=0u; metadim<quantizedDimensions; metadim++)
-	{
-		const auto trudim = metadim*DimensionsPerQuanta;
-		for (uint32_t i=0; i<sampleCount; i++)
-			pout[i*quantizedDimensions+metadim][0] = sampler.sample(trudim+0u,i);
-		for (uint32_t i=0; i<sampleCount; i++)
-			pout[i*quantizedDimensions+metadim][1] = sampler.sample(trudim+1u,i);
-		for (uint32_t i=0; i<sampleCount; i++)
-		{
-			const auto sample = sampler.sample(trudim+2u,i);
-			const auto out = pout[i*quantizedDimensions+metadim];
-			out[0] &= 0xFFFFF800u;
-			out[0] |= sample>>21;
-			out[1] &= 0xFFFFF800u;
-			out[1] |= (sample>>10)&0x07FFu;
-		}
-	}
-	// upload sequence to GPU
-	createBufferView(driver,core::smart_refctd_ptr(buff));
-	// return for caching
-	return buff;
-}
 
 //
 
@@ -1023,24 +990,7 @@ void Renderer::initSceneResources(SAssetBundle& meshes, nbl::io::path&& _sampleS
 		
 		// load sample cache
 		{
-			core::smart_refctd_ptr<ICPUBuffer> cachebuff;
-			uint32_t cachedQuantizedDimensions=0u,cachedSampleCount=0u;
-			{
-				sampleSequenceCachePath = std::move(_sampleSequenceCachePath);
-				io::IReadFile* cacheFile = m_assetManager->getFileSystem()->createAndOpenFile(sampleSequenceCachePath);
-				if (cacheFile)
-				{
-					cacheFile->read(&cachedQuantizedDimensions,sizeof(cachedQuantizedDimensions));
-					if (cachedQuantizedDimensions)
-					{
-						cachedSampleCount = (cacheFile->getSize()-cacheFile->getPos())/(cachedQuantizedDimensions*SampleSequence::QuantizedDimensionsBytesize);
-						cachebuff = sampleSequence.createCPUBuffer(cachedQuantizedDimensions,cachedSampleCount);
-						if (cachebuff)
-							cacheFile->read(cachebuff->getPointer(),cachebuff->getSize());
-					}
-					cacheFile->drop();
-				}
-			}
+			sampleSequenceCachePath = std::move(_sampleSequenceCachePath);
 			// lets keep path length within bounds of sanity
 			constexpr auto MaxPathDepth = 255u;
 			if (pathDepth==0)
@@ -1059,21 +1009,8 @@ void Renderer::initSceneResources(SAssetBundle& meshes, nbl::io::path&& _sampleS
 			// near 1.0 with exponent -1 after the sample count passes 2^24 elements.
 			// Another limiting factor is our encoding of sample sequences, we only use 21bits per channel, so no duplicates till 2^21 samples.
 			maxSensorSamples = core::min(0x1<<21,maxSensorSamples);
-			if (cachedQuantizedDimensions>=quantizedDimensions && cachedSampleCount>=maxSensorSamples)
-				sampleSequence.createBufferView(m_driver,std::move(cachebuff));
-			else
-			{
-				printf("[INFO] Generating Low Discrepancy Sample Sequence Cache, please wait...\n");
-				cachebuff = sampleSequence.createBufferView(m_driver,quantizedDimensions,maxSensorSamples);
-				// save sequence
-				io::IWriteFile* cacheFile = m_assetManager->getFileSystem()->createAndWriteFile(sampleSequenceCachePath);
-				if (cacheFile)
-				{
-					cacheFile->write(&quantizedDimensions,sizeof(quantizedDimensions));
-					cacheFile->write(cachebuff->getPointer(),cachebuff->getSize());
-					cacheFile->drop();
-				}
-			}
+			// a cache with more dimensions or samples than needed only gets the needed ones read, laid out with the stride the shaders expect
+			sampleSequence.createBufferView(m_driver,std::filesystem::path(sampleSequenceCachePath.c_str()),quantizedDimensions,maxSensorSamples);
 			std::cout << "\tpathDepth = " << pathDepth << std::endl;
 			std::cout << "\tnoRussianRouletteDepth = " << noRussianRouletteDepth << std::endl;
 			std::cout << "\tmaxSamples = " << maxSensorSamples << std::endl;
@@ -1484,6 +1421,113 @@ void Renderer::resetSampleAndFrameCounters()
 	m_prevCamTform = nbl::core::matrix4x3();
 }
 
+core::smart_refctd_ptr<ICPUImage> Renderer::downloadImage(const IGPUImageView* imageView)
+{
+	auto* gpuImage = imageView->getCreationParameters().image.get();
+	const auto& gpuParams = gpuImage->getCreationParameters();
+	const uint32_t bytesize = gpuParams.extent.width*gpuParams.extent.height*getTexelOrBlockBytesize(gpuParams.format);
+
+	auto downloadStagingArea = m_driver->getDefaultDownStreamingBuffer();
+	uint32_t address = std::remove_pointer<decltype(downloadStagingArea)>::type::invalid_address;
+	constexpr uint64_t timeoutInNanoSeconds = 300000000000u;
+	{
+		const auto waitPoint = std::chrono::high_resolution_clock::now()+std::chrono::nanoseconds(timeoutInNanoSeconds);
+		const uint32_t alignment = 4096u; // common page size
+		if (downloadStagingArea->multi_alloc(waitPoint,1u,&address,&bytesize,&alignment))
+		{
+			std::cout << "[ERROR] Could not allocate the staging memory to download the screenshot!" << std::endl;
+			return nullptr;
+		}
+	}
+
+	IGPUImage::SBufferCopy region = {};
+	region.bufferOffset = address;
+	region.bufferRowLength = gpuParams.extent.width;
+	region.bufferImageHeight = gpuParams.extent.height;
+	//region.imageSubresource.aspectMask = wait for Vulkan;
+	region.imageSubresource.mipLevel = 0u;
+	region.imageSubresource.baseArrayLayer = 0u;
+	region.imageSubresource.layerCount = 1u;
+	region.imageOffset = {0u,0u,0u};
+	region.imageExtent = {gpuParams.extent.width,gpuParams.extent.height,1u};
+	m_driver->copyImageToBuffer(gpuImage,downloadStagingArea->getBuffer(),1u,&region);
+	auto downloadFence = m_driver->placeFence(true);
+
+	auto result = downloadFence->waitCPU(timeoutInNanoSeconds,true);
+	if (result==E_DRIVER_FENCE_RETVAL::EDFR_TIMEOUT_EXPIRED||result==E_DRIVER_FENCE_RETVAL::EDFR_FAIL)
+	{
+		std::cout << "[ERROR] Could not download the screenshot from the GPU, fence not signalled!" << std::endl;
+		downloadStagingArea->multi_free(1u,&address,&bytesize,nullptr);
+		return nullptr;
+	}
+	if (downloadStagingArea->needsManualFlushOrInvalidate())
+		m_driver->invalidateMappedMemoryRanges({{downloadStagingArea->getBuffer()->getBoundMemory(),address,bytesize}});
+
+	ICPUImage::SCreationParams imgParams;
+	imgParams.flags = static_cast<ICPUImage::E_CREATE_FLAGS>(0u);
+	imgParams.type = ICPUImage::ET_2D;
+	imgParams.format = gpuParams.format;
+	imgParams.extent = region.imageExtent;
+	imgParams.mipLevels = 1u;
+	imgParams.arrayLayers = 1u;
+	imgParams.samples = ICPUImage::ESCF_1_BIT;
+	auto image = ICPUImage::create(std::move(imgParams));
+
+	// copy out, the staging area is shared with everything else
+	auto buffer = core::make_smart_refctd_ptr<ICPUBuffer>(bytesize);
+	memcpy(buffer->getPointer(),reinterpret_cast<uint8_t*>(downloadStagingArea->getBufferPointer())+address,bytesize);
+	downloadStagingArea->multi_free(1u,&address,&bytesize,nullptr);
+
+	auto regions = core::make_refctd_dynamic_array<core::smart_refctd_dynamic_array<IImage::SBufferCopy>>(1u);
+	regions->front() = region;
+	regions->front().bufferOffset = 0u;
+	image->setBufferAndRegions(std::move(buffer),regions);
+	return image;
+}
+
+void Renderer::initPostProcessParams(const DenoiserArgs& denoiserArgs, CCPUDenoiserTonemapper::SParams& params)
+{
+	const std::filesystem::path defaultBloomFile = "../../media/kernels/physical_flare_512.exr";
+	const std::string defaultTonemapperArgs = "ACES=0.4,0.8";
+	constexpr auto defaultBloomScale = 0.1f;
+	constexpr auto defaultBloomIntensity = 0.1f;
+	const auto bloomFilePath = denoiserArgs.bloomFilePath.empty() ? defaultBloomFile:denoiserArgs.bloomFilePath;
+	params.bloomRelativeScale = (denoiserArgs.bloomScale == 0.0f) ? defaultBloomScale : denoiserArgs.bloomScale;
+	params.bloomIntensity = (denoiserArgs.bloomIntensity == 0.0f) ? defaultBloomIntensity : denoiserArgs.bloomIntensity;
+	const auto& tonemapperArgs = (denoiserArgs.tonemapperArgs.empty()) ? defaultTonemapperArgs : denoiserArgs.tonemapperArgs;
+	if (!CCPUDenoiserTonemapper::STonemapper::parse(tonemapperArgs,params.tonemapper))
+	{
+		std::cout << "[ERROR] Invalid tonemapper arguments \"" << tonemapperArgs << "\", using " << defaultTonemapperArgs << std::endl;
+		CCPUDenoiserTonemapper::STonemapper::parse(defaultTonemapperArgs,params.tonemapper);
+	}
+
+	if (bloomFilePath!=m_bloomPSFPath)
+	{
+		m_bloomPSFPath = bloomFilePath;
+		m_bloomPSF = nullptr;
+		asset::IAssetLoader::SAssetLoadParams lp(0ull,nullptr);
+		auto bundle = m_assetManager->getAsset(bloomFilePath.string(),lp);
+		if (bundle.getContents().empty())
+			std::cout << "[ERROR] Could not load the bloom PSF " << bloomFilePath << ", bloom is disabled." << std::endl;
+		else
+			m_bloomPSF = core::smart_refctd_ptr_static_cast<ICPUImage>(bundle.getContents().begin()[0]);
+	}
+	params.bloomPSF = m_bloomPSF.get();
+
+#ifdef _NBL_BUILD_OPTIX_
+	if (!m_denoiserCreationAttempted)
+	{
+		m_denoiserCreationAttempted = true;
+		m_denoiser = COptiXDenoiser::create(m_driver,m_assetManager->getFileSystem());
+		if (!m_denoiser)
+			std::cout << "[WARNING] Could not initialize CUDA or OptiX, the screenshots will only be bloomed and tonemapped." << std::endl;
+	}
+	params.denoiser = m_denoiser.get();
+#else
+	params.denoiser = nullptr;
+#endif
+}
+
 void Renderer::takeAndSaveScreenShot(const std::filesystem::path& screenshotFilePath, bool denoise, const DenoiserArgs& denoiserArgs)
 {
 	auto commandQueue = m_rrManager->getCLCommandQueue();
@@ -1491,45 +1535,32 @@ void Renderer::takeAndSaveScreenShot(const std::filesystem::path& screenshotFile
 
 	glFinish();
 
-	// we always decode to 16bit HDR because thats what the denoiser takes
-	// if we save to PNG instead of EXR, it will be converted and clamped once more automagically
-	const asset::E_FORMAT format = asset::EF_R16G16B16A16_SFLOAT;
+	// every AOV gets downloaded once, the EXRs and the post processing share the images
+	auto color = m_tonemapOutput ? downloadImage(m_tonemapOutput.get()):nullptr;
+	auto albedo = m_albedoRslv ? downloadImage(m_albedoRslv.get()):nullptr;
+	auto normal = m_normalRslv ? downloadImage(m_normalRslv.get()):nullptr;
 
+	// we always write 16bit HDR because thats what the denoiser takes
 	auto filename_wo_ext = screenshotFilePath;
 	filename_wo_ext.replace_extension();
-	if (m_tonemapOutput)
-		ext::ScreenShot::createScreenShot(m_driver,m_assetManager,m_tonemapOutput.get(),filename_wo_ext.string()+".exr",format);
-	if (m_albedoRslv)
-		ext::ScreenShot::createScreenShot(m_driver,m_assetManager,m_albedoRslv.get(),filename_wo_ext.string()+"_albedo.exr",format);
-	if (m_normalRslv)
-		ext::ScreenShot::createScreenShot(m_driver,m_assetManager,m_normalRslv.get(),filename_wo_ext.string()+"_normal.exr",format);
-
-	if(denoise)
+	if (color)
+		CCPUDenoiserTonemapper::writeEXR(m_assetManager,color.get(),filename_wo_ext.string()+".exr");
+	if (albedo)
+		CCPUDenoiserTonemapper::writeEXR(m_assetManager,albedo.get(),filename_wo_ext.string()+"_albedo.exr");
+	if (normal)
+		CCPUDenoiserTonemapper::writeEXR(m_assetManager,normal.get(),filename_wo_ext.string()+"_normal.exr");
+
+	if(denoise && color)
 	{
-		const std::string defaultBloomFile = "../../media/kernels/physical_flare_512.exr";
-		const std::string defaultTonemapperArgs = "ACES=0.4,0.8";
-		constexpr auto defaultBloomScale = 0.1f;
-		constexpr auto defaultBloomIntensity = 0.1f;
-		auto bloomFilePathStr = (denoiserArgs.bloomFilePath.string().empty()) ? defaultBloomFile : denoiserArgs.bloomFilePath.string();
-		auto bloomScale = (denoiserArgs.bloomScale == 0.0f) ? defaultBloomScale : denoiserArgs.bloomScale;
-		auto bloomIntensity = (denoiserArgs.bloomIntensity == 0.0f) ? defaultBloomIntensity : denoiserArgs.bloomIntensity;
-		auto tonemapperArgs = (denoiserArgs.tonemapperArgs.empty()) ? defaultTonemapperArgs : denoiserArgs.tonemapperArgs;
-
-		std::ostringstream denoiserCmd;
-		// 1.ColorFile 2.AlbedoFile 3.NormalFile 4.BloomPsfFilePath(STRING) 5.BloomScale(FLOAT) 6.BloomIntensity(FLOAT) 7.TonemapperArgs(STRING)
-		denoiserCmd << "call ../denoiser_hook.bat";
-		denoiserCmd << " \"" << filename_wo_ext.string() << ".exr" << "\"";
-		denoiserCmd << " \"" << filename_wo_ext.string() << "_albedo.exr" << "\"";
-		denoiserCmd << " \"" << filename_wo_ext.string() << "_normal.exr" << "\"";
-		denoiserCmd << " \"" << bloomFilePathStr << "\"";
-		denoiserCmd << " " << bloomScale;
-		denoiserCmd << " " << bloomIntensity;
-		denoiserCmd << " " << "\"" << tonemapperArgs << "\"";
-		// NOTE/TODO/FIXME : Do as I say, not as I do
-		// https://wiki.sei.cmu.edu/confluence/pages/viewpage.action?pageId=87152177
-		std::cout << "\n---[DENOISER_BEGIN]---" << std::endl;
-		std::system(denoiserCmd.str().c_str());
-		std::cout << "\n---[DENOISER_END]---" << std::endl;
+		CCPUDenoiserTonemapper::SParams params;
+		initPostProcessParams(denoiserArgs,params);
+		params.color = color.get();
+		params.albedo = albedo.get();
+		params.normal = normal.get();
+
+		auto output = m_postProcessor.process(params);
+		if (!output || !m_postProcessor.writeOutputs(m_assetManager,output.get(),filename_wo_ext.string()+"_denoised"))
+			std::cout << "[ERROR] Post processing " << filename_wo_ext << " failed." << std::endl;
 	}
 }
 
@@ -1544,85 +1575,50 @@ void Renderer::denoiseCubemapFaces(
 
 	glFinish();
 
-	std::string renderFilePaths[6] = {};
-	std::string albedoFilePaths[6] = {};
-	std::string normalFilePaths[6] = {};
-	for(uint32_t i = 0; i < 6; ++i)
-		renderFilePaths[i] = filePaths[i].replace_extension().string() + ".exr";
-	for(uint32_t i = 0; i < 6; ++i)
-		albedoFilePaths[i] = filePaths[i].replace_extension().string() + "_albedo.exr";
-	for(uint32_t i = 0; i < 6; ++i)
-		normalFilePaths[i] = filePaths[i].replace_extension().string() + "_normal.exr";
-	
-	std::string mergedRenderFilePath = mergedFileName + ".exr";
-	std::string mergedAlbedoFilePath = mergedFileName + "_albedo.exr";
-	std::string mergedNormalFilePath = mergedFileName + "_normal.exr";
-	std::string mergedDenoisedFilePath = mergedFileName + "_denoised.exr";
-	
-	std::ostringstream mergeRendersCmd;
-	mergeRendersCmd << "call ../mergeCubemap.bat";
-	for(uint32_t i = 0; i < 6; ++i)
-		mergeRendersCmd << " " << renderFilePaths[i];
-	mergeRendersCmd << " " << mergedRenderFilePath;
-	std::system(mergeRendersCmd.str().c_str());
-
-	std::ostringstream mergeAlbedosCmd;
-	mergeAlbedosCmd << "call ../mergeCubemap.bat ";
-	for(uint32_t i = 0; i < 6; ++i)
-		mergeAlbedosCmd << " " << albedoFilePaths[i];
-	mergeAlbedosCmd << " " << mergedAlbedoFilePath;
-	std::system(mergeAlbedosCmd.str().c_str());
-	
-	std::ostringstream mergeNormalsCmd;
-	mergeNormalsCmd << "call ../mergeCubemap.bat ";
-	for(uint32_t i = 0; i < 6; ++i)
-		mergeNormalsCmd << " " << normalFilePaths[i];
-	mergeNormalsCmd << " " << mergedNormalFilePath;
-	std::system(mergeNormalsCmd.str().c_str());
-
-	const std::string defaultBloomFile = "../../media/kernels/physical_flare_512.exr";
-	const std::string defaultTonemapperArgs = "ACES=0.4,0.8";
-	constexpr auto defaultBloomScale = 0.1f;
-	constexpr auto defaultBloomIntensity = 0.1f;
-	auto bloomFilePathStr = (denoiserArgs.bloomFilePath.string().empty()) ? defaultBloomFile : denoiserArgs.bloomFilePath.string();
-	auto bloomScale = (denoiserArgs.bloomScale == 0.0f) ? defaultBloomScale : denoiserArgs.bloomScale;
-	auto bloomIntensity = (denoiserArgs.bloomIntensity == 0.0f) ? defaultBloomIntensity : denoiserArgs.bloomIntensity;
-	auto tonemapperArgs = (denoiserArgs.tonemapperArgs.empty()) ? defaultTonemapperArgs : denoiserArgs.tonemapperArgs;
-	
-	std::ostringstream denoiserCmd;
-	// 1.ColorFile 2.AlbedoFile 3.NormalFile 4.BloomPsfFilePath(STRING) 5.BloomScale(FLOAT) 6.BloomIntensity(FLOAT) 7.TonemapperArgs(STRING)
-	denoiserCmd << "call ../denoiser_hook.bat";
-	denoiserCmd << " \"" << mergedRenderFilePath << "\"";
-	denoiserCmd << " \"" << mergedAlbedoFilePath << "\"";
-	denoiserCmd << " \"" << mergedNormalFilePath << "\"";
-	denoiserCmd << " \"" << bloomFilePathStr << "\"";
-	denoiserCmd << " " << bloomScale;
-	denoiserCmd << " " << bloomIntensity;
-	denoiserCmd << " " << "\"" << tonemapperArgs << "\"";
-	// NOTE/TODO/FIXME : Do as I say, not as I do
-	// https://wiki.sei.cmu.edu/confluence/pages/viewpage.action?pageId=87152177
-	std::cout << "\n---[DENOISER_BEGIN]---" << std::endl;
-	std::system(denoiserCmd.str().c_str());
-	std::cout << "\n---[DENOISER_END]---" << std::endl;
-	
-	auto extractCubemapFaces = [&](const std::string& extension) -> void
+	// the faces were rendered and saved one by one, the in-process load is still way cheaper than what ImageMagick used to do
+	asset::IAssetLoader::SAssetLoadParams lp(0ull,nullptr,asset::IAssetLoader::ECF_DONT_CACHE_TOP_LEVEL);
+	auto mergeFaces = [&](const char* suffix) -> core::smart_refctd_ptr<ICPUImage>
 	{
-		std::ostringstream extractImagesCmd;
-		auto mergedDenoisedWithoutExtension = std::filesystem::path(mergedDenoisedFilePath).replace_extension().string();
-		extractImagesCmd << "call ../extractCubemap.bat ";
-		extractImagesCmd << " " << std::to_string(borderPixels);
-		extractImagesCmd << " " << mergedDenoisedWithoutExtension + extension;
-		for(uint32_t i = 0; i < 6; ++i)
+		core::smart_refctd_ptr<ICPUImage> faces[6];
+		const ICPUImage* facePtrs[6];
+		for (uint32_t i = 0; i < 6; ++i)
 		{
-			auto renderFilePathWithoutExtension = std::filesystem::path(renderFilePaths[i]).replace_extension().string();
-			extractImagesCmd << " " << renderFilePathWithoutExtension + "_denoised" + extension;
+			const auto path = filePaths[i].replace_extension().string() + suffix;
+			auto bundle = m_assetManager->getAsset(path,lp);
+			if (bundle.getContents().empty())
+			{
+				std::cout << "[ERROR] Could not load cubemap face " << path << std::endl;
+				return nullptr;
+			}
+			faces[i] = core::smart_refctd_ptr_static_cast<ICPUImage>(bundle.getContents().begin()[0]);
+			facePtrs[i] = faces[i].get();
 		}
-		std::system(extractImagesCmd.str().c_str());
+		return CCPUDenoiserTonemapper::mergeCubemapFaces(facePtrs);
 	};
+	auto mergedColor = mergeFaces(".exr");
+	if (!mergedColor)
+		return;
+	auto mergedAlbedo = mergeFaces("_albedo.exr");
+	auto mergedNormal = mergeFaces("_normal.exr");
+
+	CCPUDenoiserTonemapper::SParams params;
+	initPostProcessParams(denoiserArgs,params);
+	params.color = mergedColor.get();
+	params.albedo = mergedAlbedo.get();
+	params.normal = mergedNormal.get();
+	auto output = m_postProcessor.process(params);
+	if (!output || !m_postProcessor.writeOutputs(m_assetManager,output.get(),mergedFileName+"_denoised"))
+	{
+		std::cout << "[ERROR] Post processing the cubemap " << mergedFileName << " failed." << std::endl;
+		return;
+	}
 
-	extractCubemapFaces(".exr");
-	extractCubemapFaces(".png");
-	extractCubemapFaces(".jpg");
+	for(uint32_t i = 0; i < 6; ++i)
+	{
+		auto face = CCPUDenoiserTonemapper::extractCubemapFace(output.get(),i,borderPixels);
+		if (!face || !m_postProcessor.writeOutputs(m_assetManager,face.get(),filePaths[i].replace_extension().string()+"_denoised"))
+			std::cout << "[ERROR] Could not extract cubemap face " << i << " of " << mergedFileName << std::endl;
+	}
 }
 
 // one day it will just work like that
@@ -8,10 +8,14 @@
 
 #include "nbl/ext/MitsubaLoader/CMitsubaLoader.h"
 
+#include "CVertexAttributeRepacker.h"
+#include "../39.DenoiserTonemapper/CCPUDenoiserTonemapper.h"
+
 #include <ISceneManager.h>
 
 #ifdef _NBL_BUILD_OPTIX_
 #include "nbl/ext/OptiX/Manager.h"
+#include "../39.DenoiserTonemapper/COptiXDenoiser.h"
 #endif
 
 #include <thread>
@@ -125,6 +129,10 @@ class Renderer : public nbl::core::IReferenceCounted, public nbl::core::Interfac
 
 		//
 		nbl::core::smart_refctd_ptr<nbl::video::IGPUImageView> createScreenSizedTexture(nbl::asset::E_FORMAT format, uint32_t layers=0u);
+		nbl::core::smart_refctd_ptr<nbl::asset::ICPUImage> downloadImage(const nbl::video::IGPUImageView* imageView);
+
+		// fills in the bloom, tonemapper and defaults for anything `denoiserArgs` leaves unset
+		void initPostProcessParams(const DenoiserArgs& denoiserArgs, CCPUDenoiserTonemapper::SParams& params);
 
 		//
 		void preDispatch(const nbl::video::IGPUPipelineLayout* layout, nbl::video::IGPUDescriptorSet*const *const lastDS);
@@ -168,17 +176,14 @@ class Renderer : public nbl::core::IReferenceCounted, public nbl::core::Interfac
 		struct SampleSequence
 		{
 			public:
-				static inline constexpr auto QuantizedDimensionsBytesize = sizeof(uint64_t);
+				static inline constexpr uint32_t ScrambleSeed = 0xdeadbeefu;
 				SampleSequence() : bufferView() {}
 
 				// one less because first path vertex uses a different sequence 
 				static inline uint32_t computeQuantizedDimensions(uint32_t maxPathDepth) {return (maxPathDepth-1)*SAMPLING_STRATEGY_COUNT;}
-				nbl::core::smart_refctd_ptr<nbl::asset::ICPUBuffer> createCPUBuffer(uint32_t quantizedDimensions, uint32_t sampleCount);
 
-				// from cache
-				void createBufferView(nbl::video::IVideoDriver* driver, nbl::core::smart_refctd_ptr<nbl::asset::ICPUBuffer>&& buff);
-				// regenerate
-				nbl::core::smart_refctd_ptr<nbl::asset::ICPUBuffer> createBufferView(nbl::video::IVideoDriver* driver, uint32_t quantizedDimensions, uint32_t sampleCount);
+				// from `SampleSequenceCache`, generating and caching if needed
+				void createBufferView(nbl::video::IVideoDriver* driver, const std::filesystem::path& cachePath, uint32_t quantizedDimensions, uint32_t sampleCount);
 
 				auto getBufferView() const {return bufferView;}
 
@@ -188,6 +193,17 @@ class Renderer : public nbl::core::IReferenceCounted, public nbl::core::Interfac
 		uint16_t pathDepth;
 		uint16_t noRussianRouletteDepth;
 		uint32_t maxSensorSamples;
+		// keeps its scratch between scenes
+		CVertexAttributeRepacker vertexAttributeRepacker;
+		// same for the screenshots, also the bloom PSF so its not reloaded on every one
+		CCPUDenoiserTonemapper m_postProcessor;
+		std::filesystem::path m_bloomPSFPath;
+		nbl::core::smart_refctd_ptr<nbl::asset::ICPUImage> m_bloomPSF;
+	#ifdef _NBL_BUILD_OPTIX_
+		// created for the first denoised screenshot, stays null if OptiX can't be initialized
+		nbl::core::smart_refctd_ptr<COptiXDenoiser> m_denoiser;
+		bool m_denoiserCreationAttempted = false;
+	#endif
 
 		// scene specific data
 		nbl::core::vector<::RadeonRays::Shape*> rrShapes;
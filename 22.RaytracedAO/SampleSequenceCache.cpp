@@ -0,0 +1,281 @@
+#include "SampleSequenceCache.h"
+
+#include <thread>
+#include <atomic>
+#include <numeric>
+#include <algorithm>
+#include <fstream>
+
+#ifdef _NBL_PLATFORM_WINDOWS_
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+using namespace nbl;
+
+
+namespace
+{
+// read-only mapping of a whole file, pages only get read from disk when touched
+class CMappedFile
+{
+	public:
+		CMappedFile(const std::filesystem::path& path)
+		{
+			#ifdef _NBL_PLATFORM_WINDOWS_
+			file = CreateFileW(path.c_str(),GENERIC_READ,FILE_SHARE_READ,nullptr,OPEN_EXISTING,FILE_ATTRIBUTE_NORMAL,nullptr);
+			if (file==INVALID_HANDLE_VALUE)
+				return;
+			LARGE_INTEGER fileSize;
+			if (!GetFileSizeEx(file,&fileSize) || fileSize.QuadPart==0)
+				return;
+			mapping = CreateFileMappingW(file,nullptr,PAGE_READONLY,0,0,nullptr);
+			if (!mapping)
+				return;
+			ptr = MapViewOfFile(mapping,FILE_MAP_READ,0,0,0);
+			if (ptr)
+				size = fileSize.QuadPart;
+			#else
+			fd = ::open(path.c_str(),O_RDONLY);
+			if (fd<0)
+				return;
+			struct stat fileStat;
+			if (fstat(fd,&fileStat)!=0 || fileStat.st_size==0)
+				return;
+			void* mapped = mmap(nullptr,fileStat.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+			if (mapped==MAP_FAILED)
+				return;
+			ptr = mapped;
+			size = fileStat.st_size;
+			#endif
+		}
+		~CMappedFile()
+		{
+			#ifdef _NBL_PLATFORM_WINDOWS_
+			if (ptr)
+				UnmapViewOfFile(ptr);
+			if (mapping)
+				CloseHandle(mapping);
+			if (file!=INVALID_HANDLE_VALUE)
+				CloseHandle(file);
+			#else
+			if (ptr)
+				munmap(ptr,size);
+			if (fd>=0)
+				::close(fd);
+			#endif
+		}
+
+		inline const uint8_t* data() const {return reinterpret_cast<const uint8_t*>(ptr);}
+		inline size_t getSize() const {return size;}
+
+	private:
+		#ifdef _NBL_PLATFORM_WINDOWS_
+		HANDLE file = INVALID_HANDLE_VALUE;
+		HANDLE mapping = nullptr;
+		#else
+		int fd = -1;
+		#endif
+		void* ptr = nullptr;
+		size_t size = 0ull;
+};
+}
+
+
+core::smart_refctd_ptr<asset::ICPUBuffer> SampleSequenceCache::get(const std::filesystem::path& path, const uint32_t quantizedDimensions, const uint32_t sampleCount, const uint32_t scrambleSeed)
+{
+	if (quantizedDimensions==0u || sampleCount==0u)
+		return nullptr;
+
+	if (!path.empty())
+	{
+		if (auto cached=load(path,quantizedDimensions,sampleCount,scrambleSeed))
+			return cached;
+	}
+
+	printf("[INFO] Generating Low Discrepancy Sample Sequence Cache, please wait...\n");
+	const auto dimensionMajor = generate(quantizedDimensions,sampleCount,scrambleSeed);
+	if (!path.empty() && !save(path,dimensionMajor,quantizedDimensions,sampleCount,scrambleSeed))
+		printf("[WARNING] Failed to write the Sample Sequence Cache to %s\n",path.string().c_str());
+	return interleave(dimensionMajor.data(),sampleCount,quantizedDimensions,sampleCount);
+}
+
+core::vector<uint64_t> SampleSequenceCache::generate(const uint32_t quantizedDimensions, const uint32_t sampleCount, const uint32_t scrambleSeed, uint32_t threadCount)
+{
+	core::vector<uint64_t> retval(size_t(quantizedDimensions)*sampleCount);
+
+	if (threadCount==0u)
+		threadCount = std::max(std::thread::hardware_concurrency(),1u);
+	threadCount = std::min(threadCount,quantizedDimensions);
+
+	// the Owen Scramble sampler has a large cache which is generated separately for each dimension, so threads work on whole dimensions,
+	// each with its own sampler as sampling isn't thread-safe, dimensions don't depend on each other so any split gives the same sequence
+	std::atomic_uint32_t nextDimension = 0u;
+	auto work = [&]() -> void
+	{
+		core::OwenSampler sampler(quantizedDimensions*DimensionsPerQuanta,scrambleSeed);
+		for (uint32_t metadim; (metadim=nextDimension++)<quantizedDimensions; )
+		{
+			const auto trudim = metadim*DimensionsPerQuanta;
+			uint32_t(&pout)[][2] = *reinterpret_cast<uint32_t(*)[][2]>(retval.data()+size_t(metadim)*sampleCount);
+			for (uint32_t i=0; i<sampleCount; i++)
+				pout[i][0] = sampler.sample(trudim+0u,i);
+			for (uint32_t i=0; i<sampleCount; i++)
+				pout[i][1] = sampler.sample(trudim+1u,i);
+			for (uint32_t i=0; i<sampleCount; i++)
+			{
+				const auto sample = sampler.sample(trudim+2u,i);
+				const auto out = pout[i];
+				out[0] &= 0xFFFFF800u;
+				out[0] |= sample>>21;
+				out[1] &= 0xFFFFF800u;
+				out[1] |= (sample>>10)&0x07FFu;
+			}
+		}
+	};
+	core::vector<std::thread> threads;
+	threads.reserve(threadCount-1u);
+	for (uint32_t t=1u; t<threadCount; t++)
+		threads.emplace_back(work);
+	work();
+	for (auto& thread : threads)
+		thread.join();
+	return retval;
+}
+
+core::smart_refctd_ptr<asset::ICPUBuffer> SampleSequenceCache::load(const std::filesystem::path& path, const uint32_t quantizedDimensions, const uint32_t sampleCount, const uint32_t scrambleSeed)
+{
+	CMappedFile file(path);
+	if (!file.data())
+		return nullptr;
+
+	if (file.getSize()<sizeof(SHeader))
+	{
+		printf("[WARNING] Sample Sequence Cache %s is truncated, regenerating.\n",path.string().c_str());
+		return nullptr;
+	}
+	SHeader header;
+	memcpy(&header,file.data(),sizeof(SHeader));
+	if (header.magic!=Magic || header.version!=Version)
+	{
+		printf("[INFO] Sample Sequence Cache %s is from an older version, regenerating.\n",path.string().c_str());
+		return nullptr;
+	}
+	if (header.scrambleSeed!=scrambleSeed)
+	{
+		printf("[INFO] Sample Sequence Cache %s has a different scramble seed, regenerating.\n",path.string().c_str());
+		return nullptr;
+	}
+	if (header.quantizedDimensions<quantizedDimensions || header.sampleCount<sampleCount)
+	{
+		printf("[INFO] Sample Sequence Cache %s has %u dimensions and %u samples, need %u and %u, regenerating.\n",path.string().c_str(),header.quantizedDimensions,header.sampleCount,quantizedDimensions,sampleCount);
+		return nullptr;
+	}
+
+	const uint32_t blockCount = getChecksumBlockCount(header.sampleCount);
+	const size_t checksumsOffset = sizeof(SHeader);
+	const size_t samplesOffset = checksumsOffset+sizeof(uint64_t)*header.quantizedDimensions*blockCount;
+	if (file.getSize()<samplesOffset+QuantizedDimensionsBytesize*header.quantizedDimensions*header.sampleCount)
+	{
+		printf("[WARNING] Sample Sequence Cache %s is truncated, regenerating.\n",path.string().c_str());
+		return nullptr;
+	}
+
+	// only the blocks holding the samples we need get paged in and validated
+	const auto* checksums = reinterpret_cast<const uint64_t*>(file.data()+checksumsOffset);
+	const auto* samples = reinterpret_cast<const uint64_t*>(file.data()+samplesOffset);
+	const uint32_t neededBlockCount = getChecksumBlockCount(sampleCount);
+	std::atomic_bool valid = true;
+	core::vector<uint32_t> blocks(quantizedDimensions*neededBlockCount);
+	std::iota(blocks.begin(),blocks.end(),0u);
+	std::for_each(core::execution::par_unseq,blocks.begin(),blocks.end(),[&](const uint32_t ix) -> void
+	{
+		const uint32_t metadim = ix/neededBlockCount;
+		const uint32_t block = ix%neededBlockCount;
+		const uint32_t firstSample = block*ChecksumBlockSamples;
+		const uint32_t blockSamples = std::min(header.sampleCount-firstSample,ChecksumBlockSamples);
+		if (checksum(samples+size_t(metadim)*header.sampleCount+firstSample,blockSamples)!=checksums[size_t(metadim)*blockCount+block])
+			valid = false;
+	});
+	if (!valid)
+	{
+		printf("[WARNING] Sample Sequence Cache %s failed validation, regenerating.\n",path.string().c_str());
+		return nullptr;
+	}
+	return interleave(samples,header.sampleCount,quantizedDimensions,sampleCount);
+}
+
+bool SampleSequenceCache::save(const std::filesystem::path& path, const core::vector<uint64_t>& dimensionMajor, const uint32_t quantizedDimensions, const uint32_t sampleCount, const uint32_t scrambleSeed)
+{
+	const uint32_t blockCount = getChecksumBlockCount(sampleCount);
+	core::vector<uint64_t> checksums(size_t(quantizedDimensions)*blockCount);
+	for (uint32_t metadim=0u; metadim<quantizedDimensions; metadim++)
+	for (uint32_t block=0u; block<blockCount; block++)
+	{
+		const uint32_t firstSample = block*ChecksumBlockSamples;
+		checksums[size_t(metadim)*blockCount+block] = checksum(dimensionMajor.data()+size_t(metadim)*sampleCount+firstSample,std::min(sampleCount-firstSample,ChecksumBlockSamples));
+	}
+
+	// other processes may be reading the old cache or writing their own at the same time, the rename replaces it in one go
+	#ifdef _NBL_PLATFORM_WINDOWS_
+	const auto pid = GetCurrentProcessId();
+	#else
+	const auto pid = getpid();
+	#endif
+	auto tmpPath = path;
+	tmpPath += ".tmp"+std::to_string(pid);
+	{
+		const SHeader header = {Magic,Version,quantizedDimensions,sampleCount,scrambleSeed,0u};
+		std::ofstream file(tmpPath,std::ios::binary|std::ios::trunc);
+		file.write(reinterpret_cast<const char*>(&header),sizeof(header));
+		file.write(reinterpret_cast<const char*>(checksums.data()),sizeof(uint64_t)*checksums.size());
+		file.write(reinterpret_cast<const char*>(dimensionMajor.data()),sizeof(uint64_t)*dimensionMajor.size());
+		file.close();
+		if (!file)
+		{
+			std::error_code ec;
+			std::filesystem::remove(tmpPath,ec);
+			return false;
+		}
+	}
+	std::error_code ec;
+	std::filesystem::rename(tmpPath,path,ec);
+	if (ec)
+	{
+		std::filesystem::remove(tmpPath,ec);
+		return false;
+	}
+	return true;
+}
+
+core::smart_refctd_ptr<asset::ICPUBuffer> SampleSequenceCache::interleave(const uint64_t* dimensionMajor, const uint32_t srcSampleCount, const uint32_t quantizedDimensions, const uint32_t sampleCount)
+{
+	// Memory Order: 3 Dimensions, then multiple of sampling stragies per vertex, then depth, then sample ID
+	auto buff = core::make_smart_refctd_ptr<asset::ICPUBuffer>(QuantizedDimensionsBytesize*quantizedDimensions*sampleCount);
+	auto* const out = reinterpret_cast<uint64_t*>(buff->getPointer());
+	core::vector<uint32_t> dimensions(quantizedDimensions);
+	std::iota(dimensions.begin(),dimensions.end(),0u);
+	std::for_each(core::execution::par_unseq,dimensions.begin(),dimensions.end(),[&](const uint32_t metadim) -> void
+	{
+		const uint64_t* in = dimensionMajor+size_t(metadim)*srcSampleCount;
+		for (uint32_t i=0; i<sampleCount; i++)
+			out[size_t(i)*quantizedDimensions+metadim] = in[i];
+	});
+	return buff;
+}
+
+uint64_t SampleSequenceCache::checksum(const uint64_t* data, const size_t count)
+{
+	uint64_t hash = 0xcbf29ce484222325ull;
+	for (size_t i=0ull; i<count; i++)
+	{
+		hash ^= data[i];
+		hash *= 0x100000001b3ull;
+	}
+	return hash;
+}
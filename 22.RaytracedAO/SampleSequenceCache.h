@@ -0,0 +1,54 @@
+#ifndef _SAMPLE_SEQUENCE_CACHE_INCLUDED_
+#define _SAMPLE_SEQUENCE_CACHE_INCLUDED_
+
+#include "nabla.h"
+
+#include <filesystem>
+
+
+// Owen scrambled low discrepancy sequence, generated in parallel and cached on disk
+//
+// File layout: `SHeader`, then one 64bit checksum (FNV-1a over 64bit words) per block of `ChecksumBlockSamples` samples of every quantized
+// dimension, then the samples dimension-major (all samples of quantized dimension 0, then all of dimension 1, ...) so that a cache with more
+// dimensions or samples than needed can serve a request by only touching (memory mapping in) the prefix of every dimension it needs, and only
+// the blocks of that prefix get validated.
+// The cache gets written to a temporary file next to it and renamed over it, so readers never see a half written one.
+// The GPU wants the samples interleaved (sample-major, stride of the requested dimension count), which gets built from the mapping.
+class SampleSequenceCache
+{
+	public:
+		static inline constexpr uint32_t Magic = 0x5153444cu; // "LDSQ"
+		static inline constexpr uint32_t Version = 2u;
+		static inline constexpr uint32_t DimensionsPerQuanta = 3u;
+		static inline constexpr auto QuantizedDimensionsBytesize = sizeof(uint64_t);
+		// 32kB of samples, a whole number of pages
+		static inline constexpr uint32_t ChecksumBlockSamples = 4096u;
+
+		struct SHeader
+		{
+			uint32_t magic;
+			uint32_t version;
+			uint32_t quantizedDimensions;
+			uint32_t sampleCount;
+			uint32_t scrambleSeed;
+			uint32_t reserved;
+		};
+
+		// Returns the sequence in GPU layout, from the cache at `path` if it's valid and big enough, otherwise regenerates and rewrites the cache.
+		static nbl::core::smart_refctd_ptr<nbl::asset::ICPUBuffer> get(const std::filesystem::path& path, const uint32_t quantizedDimensions, const uint32_t sampleCount, const uint32_t scrambleSeed);
+
+		// Dimension-major, `threadCount==0` uses all hardware threads
+		static nbl::core::vector<uint64_t> generate(const uint32_t quantizedDimensions, const uint32_t sampleCount, const uint32_t scrambleSeed, uint32_t threadCount=0u);
+
+	private:
+		static nbl::core::smart_refctd_ptr<nbl::asset::ICPUBuffer> load(const std::filesystem::path& path, const uint32_t quantizedDimensions, const uint32_t sampleCount, const uint32_t scrambleSeed);
+		static bool save(const std::filesystem::path& path, const nbl::core::vector<uint64_t>& dimensionMajor, const uint32_t quantizedDimensions, const uint32_t sampleCount, const uint32_t scrambleSeed);
+
+		// the first `sampleCount` samples of each of the first `quantizedDimensions` out of `srcSampleCount` per dimension
+		static nbl::core::smart_refctd_ptr<nbl::asset::ICPUBuffer> interleave(const uint64_t* dimensionMajor, const uint32_t srcSampleCount, const uint32_t quantizedDimensions, const uint32_t sampleCount);
+
+		static inline uint32_t getChecksumBlockCount(const uint32_t sampleCount) {return (sampleCount+ChecksumBlockSamples-1u)/ChecksumBlockSamples;}
+		static uint64_t checksum(const uint64_t* data, const size_t count);
+};
+
+#endif
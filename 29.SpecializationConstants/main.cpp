@@ -6,6 +6,7 @@
 #include <nabla.h>
 
 #include "../common/CommonAPI.h"
+#include "../common/CSPIRVCompileCache.h"
 using namespace nbl;
 using namespace core;
 using namespace ui;
@@ -186,6 +187,8 @@ public:
 
 		const char* pathToCompShader = "../particles.comp";
 		auto compilerSet = assetManager->getCompilerSet();
+		// every start after the first loads the SPIR-V from disk instead of compiling it again
+		auto spirvCache = core::make_smart_refctd_ptr<CSPIRVCompileCache>(core::smart_refctd_ptr<asset::CCompilerSet>(compilerSet), localOutputCWD / "spirv_cache");
 		core::smart_refctd_ptr<asset::ICPUShader> computeUnspec = nullptr;
 		core::smart_refctd_ptr<asset::ICPUShader> computeUnspecSPIRV = nullptr;
 		{
@@ -213,7 +216,7 @@ public:
 			compilerOptions.stage = computeUnspec->getStage();
 			compilerOptions.debugInfoFlags = asset::IShaderCompiler::E_DEBUG_INFO_FLAGS::EDIF_SOURCE_BIT; // should be DIF_SOURCE_BIT for introspection
 			compilerOptions.preprocessorOptions.sourceIdentifier = computeUnspec->getFilepathHint(); // already preprocessed but for logging it's best to fill sourceIdentifier
-			computeUnspecSPIRV = compilerSet->compileToSPIRV(computeUnspec.get(), compilerOptions);
+			computeUnspecSPIRV = spirvCache->compileToSPIRV(computeUnspec.get(), compilerOptions);
 
 			asset::CSPIRVIntrospector::SIntrospectionParams params = { "main", computeUnspecSPIRV };
 			introspection = introspector.introspect(params);
@@ -322,7 +325,7 @@ public:
 			compilerOptions.debugInfoFlags = asset::IShaderCompiler::E_DEBUG_INFO_FLAGS::EDIF_SOURCE_BIT;
 			compilerOptions.preprocessorOptions.sourceIdentifier = unspecShader->getFilepathHint(); // already preprocessed but for logging it's best to fill sourceIdentifier
 			compilerOptions.preprocessorOptions.includeFinder = compiler->getDefaultIncludeFinder();
-			auto unspecSPIRV = compilerSet->compileToSPIRV(unspecShader, compilerOptions);
+			auto unspecSPIRV = spirvCache->compileToSPIRV(unspecShader, compilerOptions);
 
 			return core::make_smart_refctd_ptr<asset::ICPUSpecializedShader>(std::move(unspecSPIRV), asset::ISpecializedShader::SInfo(specializedShader->getSpecializationInfo()));
 		};
@@ -0,0 +1,226 @@
+// Copyright (C) 2018-2020 - DevSH Graphics Programming Sp. z O.O.
+// This file is part of the "Nabla Engine".
+// For conditions of distribution and use, see copyright notice in nabla.h
+
+#ifndef _COMPACT_LRU_CACHE_H_INCLUDED_
+#define _COMPACT_LRU_CACHE_H_INCLUDED_
+
+#include <nabla.h>
+
+#include <memory>
+#include <new>
+#include <iostream>
+#include <algorithm>
+
+
+//! Same interface as `core::LRUCache` but with everything preallocated at construction and no pointers anywhere.
+/** List nodes live in one contiguous pool and link to each other with 32-bit indices, the key to node map is an open addressing table
+(linear probing, backward shift deletion so no tombstones) of 32-bit node indices kept at most half full.
+For small keys and values that's around 16 bytes per node plus 8-16 bytes of index, and a `get()` is a couple of cache misses at most. */
+template<typename Key, typename Value, typename MapHash=std::hash<Key>, typename MapEquals=std::equal_to<Key>>
+class CompactLRUCache
+{
+		static inline constexpr uint32_t InvalidIx = ~0u;
+
+		struct SNode
+		{
+			Key key;
+			Value value;
+			uint32_t prev;
+			uint32_t next;
+		};
+		using node_storage_t = std::aligned_storage_t<sizeof(SNode),alignof(SNode)>;
+
+	public:
+		CompactLRUCache(const uint32_t _capacity) : capacity(_capacity), nodes(std::make_unique<node_storage_t[]>(_capacity))
+		{
+			assert(capacity>0u && capacity<=(1u<<30u));
+			const uint32_t slotCount = nbl::core::roundUpToPoT(capacity*2u);
+			slots = std::make_unique<uint32_t[]>(slotCount);
+			std::fill_n(slots.get(),slotCount,InvalidIx);
+			slotMask = slotCount-1u;
+		}
+		CompactLRUCache(const CompactLRUCache&) = delete;
+		CompactLRUCache& operator=(const CompactLRUCache&) = delete;
+
+		~CompactLRUCache()
+		{
+			for (uint32_t ix=head; ix!=InvalidIx; )
+			{
+				const uint32_t next = node(ix).next;
+				node(ix).~SNode();
+				ix = next;
+			}
+		}
+
+		template<typename K, typename V>
+		inline void insert(K&& key, V&& value)
+		{
+			uint32_t slot = findSlot(key);
+			if (slots[slot]!=InvalidIx)
+			{
+				auto& existing = node(slots[slot]);
+				existing.value = std::forward<V>(value);
+				moveToFront(slots[slot]);
+				return;
+			}
+
+			uint32_t ix;
+			if (size==capacity)
+			{
+				// reuse the least recently used node, removing it from the table can shift the slot we just found
+				ix = tail;
+				eraseSlot(findSlot(node(ix).key));
+				unlink(ix);
+				node(ix).~SNode();
+				slot = findSlot(key);
+			}
+			else
+				ix = size++;
+
+			new (nodes.get()+ix) SNode{Key(std::forward<K>(key)),Value(std::forward<V>(value)),InvalidIx,InvalidIx};
+			slots[slot] = ix;
+			linkFront(ix);
+		}
+
+		//! Bumps the entry to most recently used
+		inline Value* get(const Key& key)
+		{
+			const uint32_t ix = slots[findSlot(key)];
+			if (ix==InvalidIx)
+				return nullptr;
+			moveToFront(ix);
+			return &node(ix).value;
+		}
+
+		//! Doesn't change the recency of the entry
+		inline Value* peek(const Key& key)
+		{
+			const uint32_t ix = slots[findSlot(key)];
+			return ix!=InvalidIx ? &node(ix).value:nullptr;
+		}
+		inline const Value* peek(const Key& key) const
+		{
+			return const_cast<CompactLRUCache*>(this)->peek(key);
+		}
+
+		inline void erase(const Key& key)
+		{
+			const uint32_t slot = findSlot(key);
+			const uint32_t ix = slots[slot];
+			if (ix==InvalidIx)
+				return;
+			eraseSlot(slot);
+			unlink(ix);
+			node(ix).~SNode();
+
+			// keep the pool dense by moving the last node into the hole, so there's no free list to chase
+			const uint32_t last = --size;
+			if (ix!=last)
+			{
+				auto& moved = node(last);
+				slots[findSlot(moved.key)] = ix;
+				if (moved.prev!=InvalidIx)
+					node(moved.prev).next = ix;
+				else
+					head = ix;
+				if (moved.next!=InvalidIx)
+					node(moved.next).prev = ix;
+				else
+					tail = ix;
+				new (nodes.get()+ix) SNode(std::move(moved));
+				moved.~SNode();
+			}
+		}
+
+		inline uint32_t getSize() const {return size;}
+		inline uint32_t getCapacity() const {return capacity;}
+		//! Everything is preallocated, so this is exact and doesn't depend on how full the cache is
+		inline size_t getMemoryFootprint() const {return sizeof(*this)+sizeof(node_storage_t)*capacity+sizeof(uint32_t)*(slotMask+1u);}
+
+		//! Most recently used first
+		inline void print(std::ostream& stream) const
+		{
+			for (uint32_t ix=head; ix!=InvalidIx; ix=node(ix).next)
+				stream << "Key: " << node(ix).key << ", Value: " << node(ix).value << "\n";
+		}
+
+	private:
+		inline SNode& node(uint32_t ix) {return *std::launder(reinterpret_cast<SNode*>(nodes.get()+ix));}
+		inline const SNode& node(uint32_t ix) const {return *std::launder(reinterpret_cast<const SNode*>(nodes.get()+ix));}
+		// `std::hash` of integers is the identity on most standard libraries, so spread the bits before masking
+		inline uint32_t homeSlot(const Key& key) const
+		{
+			uint64_t hash = MapHash()(key);
+			hash ^= hash>>33ull;
+			hash *= 0xff51afd7ed558ccdull;
+			hash ^= hash>>33ull;
+			return uint32_t(hash)&slotMask;
+		}
+
+		//! Slot holding `key` or the empty slot where it would go
+		inline uint32_t findSlot(const Key& key) const
+		{
+			uint32_t slot = homeSlot(key);
+			while (slots[slot]!=InvalidIx && !MapEquals()(node(slots[slot]).key,key))
+				slot = (slot+1u)&slotMask;
+			return slot;
+		}
+
+		//! Backward shift deletion, moves every later entry of the probe run that would still be reachable from its home slot into the hole
+		inline void eraseSlot(uint32_t hole)
+		{
+			for (uint32_t slot=(hole+1u)&slotMask; slots[slot]!=InvalidIx; slot=(slot+1u)&slotMask)
+			{
+				const uint32_t home = homeSlot(node(slots[slot]).key);
+				// cyclic distance from home, the entry may move into the hole only if the hole lies between its home and where it is now
+				if (((slot-home)&slotMask)>=((slot-hole)&slotMask))
+				{
+					slots[hole] = slots[slot];
+					hole = slot;
+				}
+			}
+			slots[hole] = InvalidIx;
+		}
+
+		inline void unlink(const uint32_t ix)
+		{
+			auto& n = node(ix);
+			if (n.prev!=InvalidIx)
+				node(n.prev).next = n.next;
+			else
+				head = n.next;
+			if (n.next!=InvalidIx)
+				node(n.next).prev = n.prev;
+			else
+				tail = n.prev;
+		}
+		inline void linkFront(const uint32_t ix)
+		{
+			auto& n = node(ix);
+			n.prev = InvalidIx;
+			n.next = head;
+			if (head!=InvalidIx)
+				node(head).prev = ix;
+			head = ix;
+			if (tail==InvalidIx)
+				tail = ix;
+		}
+		inline void moveToFront(const uint32_t ix)
+		{
+			if (ix==head)
+				return;
+			unlink(ix);
+			linkFront(ix);
+		}
+
+		const uint32_t capacity;
+		uint32_t size = 0u;
+		uint32_t head = InvalidIx;
+		uint32_t tail = InvalidIx;
+		uint32_t slotMask;
+		std::unique_ptr<node_storage_t[]> nodes;
+		std::unique_ptr<uint32_t[]> slots;
+};
+
+#endif
@@ -0,0 +1,299 @@
+// Copyright (C) 2018-2020 - DevSH Graphics Programming Sp. z O.O.
+// This file is part of the "Nabla Engine".
+// For conditions of distribution and use, see copyright notice in nabla.h
+
+#ifndef _LRU_CACHE_BENCHMARK_H_INCLUDED_
+#define _LRU_CACHE_BENCHMARK_H_INCLUDED_
+
+#include <nabla.h>
+#include "nbl/core/containers/LRUcache.h"
+
+#include <random>
+#include <chrono>
+#include <thread>
+#include <cmath>
+#include <algorithm>
+#include <fstream>
+#include <memory>
+#include <cstdio>
+
+#if defined(_NBL_PLATFORM_WINDOWS_)
+#include <windows.h>
+#include <psapi.h>
+#elif defined(_NBL_PLATFORM_LINUX_) || defined(_NBL_PLATFORM_ANDROID_)
+#include <unistd.h>
+#endif
+
+#include "ShardedLRUCache.h"
+
+
+//! Zipf distribution over [1,N] by rejection-inversion (Hörmann & Derflinger), O(1) memory so it works for the 50M key spaces too
+class CZipfDistribution
+{
+	public:
+		CZipfDistribution(uint64_t _n, double _exponent) : n(_n), exponent(_exponent)
+		{
+			hIntegralX1 = hIntegral(1.5)-1.0;
+			hIntegralN = hIntegral(double(n)+0.5);
+			s = 2.0-hIntegralInverse(hIntegral(2.5)-h(2.0));
+		}
+
+		template<class URBG>
+		inline uint64_t operator()(URBG& g)
+		{
+			std::uniform_real_distribution<double> uniform(0.0,1.0);
+			while (true)
+			{
+				const double u = hIntegralN+uniform(g)*(hIntegralX1-hIntegralN);
+				const double x = hIntegralInverse(u);
+				const uint64_t k = uint64_t(std::clamp(x+0.5,1.0,double(n)));
+				if (double(k)-x<=s || u>=hIntegral(double(k)+0.5)-h(double(k)))
+					return k;
+			}
+		}
+
+	private:
+		inline double h(double x) const {return std::exp(-exponent*std::log(x));}
+		inline double hIntegral(double x) const
+		{
+			const double logX = std::log(x);
+			return helper2((1.0-exponent)*logX)*logX;
+		}
+		inline double hIntegralInverse(double x) const
+		{
+			const double t = std::max(x*(1.0-exponent),-1.0);
+			return std::exp(helper1(t)*x);
+		}
+		// log1p(x)/x and expm1(x)/x, both go to 1 as x goes to 0
+		static inline double helper1(double x) {return std::abs(x)>1e-8 ? std::log1p(x)/x:1.0-x*(0.5-x/3.0);}
+		static inline double helper2(double x) {return std::abs(x)>1e-8 ? std::expm1(x)/x:1.0+x*0.5*(1.0+x/3.0);}
+
+		uint64_t n;
+		double exponent;
+		double hIntegralX1,hIntegralN,s;
+};
+
+//! Resident set size of the whole process, only meaningful as a difference between two calls
+inline size_t getResidentMemoryBytes()
+{
+#if defined(_NBL_PLATFORM_WINDOWS_)
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(),&counters,sizeof(counters)))
+		return counters.WorkingSetSize;
+	return 0ull;
+#elif defined(_NBL_PLATFORM_LINUX_) || defined(_NBL_PLATFORM_ANDROID_)
+	std::ifstream statm("/proc/self/statm");
+	size_t totalPages = 0ull, residentPages = 0ull;
+	statm >> totalPages >> residentPages;
+	return residentPages*size_t(sysconf(_SC_PAGESIZE));
+#else
+	return 0ull;
+#endif
+}
+
+class CLRUCacheBenchmark
+{
+		using clock_t = std::chrono::high_resolution_clock;
+
+	public:
+		enum E_KEY_DISTRIBUTION
+		{
+			EKD_UNIFORM,
+			EKD_ZIPF
+		};
+
+		struct SParams
+		{
+			uint32_t seed = 0x45u;
+			double zipfExponent = 0.99;
+			// keys are drawn from a space twice the capacity, so uniform lookups hit about half the time
+			uint32_t keySpaceMultiplier = 2u;
+			uint32_t maxLookupOps = 1u<<22u;
+			// small caches get measured as many copies adding up to at least this many entries, to get above page and heap arena granularity
+			uint32_t minMeasuredEntries = 1u<<20u;
+		};
+
+		struct SResult
+		{
+			uint32_t capacity;
+			E_KEY_DISTRIBUTION distribution;
+			double insertMops,getMops,peekMops,eraseMops;
+			double getHitRate;
+			// filled in separately by `measureBytesPerEntry`, negative if the RSS didn't grow
+			double bytesPerEntry = -1.0;
+
+			void print() const
+			{
+				printf(
+					"%10u entries %-7s | insert %8.2f Mops/s get %8.2f Mops/s (hit rate %5.1f%%) peek %8.2f Mops/s erase %8.2f Mops/s | ",
+					capacity,distribution==EKD_ZIPF ? "zipf":"uniform",insertMops,getMops,getHitRate*100.0,peekMops,eraseMops
+				);
+				if (bytesPerEntry<0.0)
+					printf("n/a B/entry\n");
+				else
+					printf("%7.1f B/entry\n",bytesPerEntry);
+			}
+		};
+
+		//! Key streams get generated up front so the RNG doesn't pollute the timings
+		static nbl::core::vector<int> generateKeys(const uint32_t count, const uint32_t keySpace, const E_KEY_DISTRIBUTION distribution, const SParams& params, const uint32_t stream)
+		{
+			nbl::core::vector<int> keys(count);
+			std::mt19937_64 mt(uint64_t(params.seed)^(uint64_t(stream)<<32ull));
+			if (distribution==EKD_ZIPF)
+			{
+				CZipfDistribution zipf(keySpace,params.zipfExponent);
+				// scramble the ranks, otherwise the hot keys are all small integers which hash very nicely
+				for (auto& key : keys)
+					key = int(((zipf(mt)-1ull)*0x9E3779B1ull)%keySpace);
+			}
+			else
+			{
+				std::uniform_int_distribution<uint32_t> uniform(0u,keySpace-1u);
+				for (auto& key : keys)
+					key = int(uniform(mt));
+			}
+			return keys;
+		}
+
+		template<class Cache>
+		static SResult run(const uint32_t capacity, const E_KEY_DISTRIBUTION distribution, const SParams& params)
+		{
+			SResult result;
+			result.capacity = capacity;
+			result.distribution = distribution;
+			const uint32_t keySpace = capacity*params.keySpaceMultiplier;
+			const uint32_t lookupOps = std::min(capacity*params.keySpaceMultiplier,params.maxLookupOps);
+
+			const auto insertKeys = generateKeys(capacity,keySpace,distribution,params,0u);
+			const auto lookupKeys = generateKeys(lookupOps,keySpace,distribution,params,1u);
+
+			// fill the cache with a sweep first so every phase below runs against a full cache
+			Cache cache(capacity);
+			for (uint32_t i=0u; i<capacity; i++)
+				cache.insert(int(i),char(i));
+
+			auto mops = [](const uint32_t ops, clock_t::time_point start) -> double
+			{
+				const double us = double(std::chrono::duration_cast<std::chrono::microseconds>(clock_t::now()-start).count());
+				return us>0.0 ? double(ops)/us:0.0;
+			};
+
+			{
+				const auto start = clock_t::now();
+				for (const auto key : insertKeys)
+					cache.insert(key,char(key));
+				result.insertMops = mops(capacity,start);
+			}
+			{
+				uint32_t hits = 0u;
+				const auto start = clock_t::now();
+				for (const auto key : lookupKeys)
+					hits += cache.get(key) ? 1u:0u;
+				result.getMops = mops(lookupOps,start);
+				result.getHitRate = double(hits)/double(lookupOps);
+			}
+			{
+				// accumulate so the compiler can't drop the lookups
+				volatile uint32_t hits = 0u;
+				const auto start = clock_t::now();
+				for (const auto key : lookupKeys)
+					hits = hits+(cache.peek(key) ? 1u:0u);
+				result.peekMops = mops(lookupOps,start);
+			}
+			{
+				const auto start = clock_t::now();
+				for (const auto key : lookupKeys)
+					cache.erase(key);
+				result.eraseMops = mops(lookupOps,start);
+			}
+			return result;
+		}
+
+		//! RSS growth per entry from filling full caches of `capacity`, same for every cache type so they can be compared.
+		//! Memory freed earlier in the process gets reused without the RSS growing, so call this from a fresh process (see `measureBytesPerEntryInChildProcess`).
+		template<class Cache>
+		static double measureBytesPerEntry(const uint32_t capacity, const SParams& params)
+		{
+			const uint32_t cacheCount = (params.minMeasuredEntries+capacity-1u)/capacity;
+			nbl::core::vector<std::unique_ptr<Cache>> caches(cacheCount);
+			const size_t memoryBefore = getResidentMemoryBytes();
+			for (auto& cache : caches)
+			{
+				cache = std::make_unique<Cache>(capacity);
+				for (uint32_t i=0u; i<capacity; i++)
+					cache->insert(int(i),char(i));
+			}
+			const size_t memoryAfter = getResidentMemoryBytes();
+			return memoryAfter>memoryBefore ? double(memoryAfter-memoryBefore)/(double(capacity)*double(cacheCount)):-1.0;
+		}
+
+		//! Runs `executable` with `arguments`, which must make it print the result of `measureBytesPerEntry` and nothing else
+		static double measureBytesPerEntryInChildProcess(const std::string& executable, const std::string& arguments)
+		{
+			const std::string command = "\""+executable+"\" "+arguments;
+#if defined(_NBL_PLATFORM_WINDOWS_)
+			FILE* child = _popen(command.c_str(),"r");
+#else
+			FILE* child = popen(command.c_str(),"r");
+#endif
+			if (!child)
+				return -1.0;
+			double bytesPerEntry = -1.0;
+			if (fscanf(child,"%lf",&bytesPerEntry)!=1)
+				bytesPerEntry = -1.0;
+#if defined(_NBL_PLATFORM_WINDOWS_)
+			_pclose(child);
+#else
+			pclose(child);
+#endif
+			return bytesPerEntry;
+		}
+
+		//! Threads each do a mix of 90% gets and 10% inserts on one shared cache, returns aggregate Mops/s
+		template<class ConcurrentCache>
+		static double runConcurrent(const uint32_t capacity, const uint32_t threadCount, const E_KEY_DISTRIBUTION distribution, const SParams& params)
+		{
+			const uint32_t keySpace = capacity*params.keySpaceMultiplier;
+			const uint32_t opsPerThread = std::min(capacity,params.maxLookupOps)/threadCount;
+
+			ConcurrentCache cache(capacity);
+			for (uint32_t i=0u; i<capacity; i++)
+				cache.insert(int(i),char(i));
+
+			nbl::core::vector<nbl::core::vector<int>> keys(threadCount);
+			for (uint32_t t=0u; t<threadCount; t++)
+				keys[t] = generateKeys(opsPerThread,keySpace,distribution,params,t+2u);
+
+			std::atomic_uint32_t ready = 0u;
+			std::atomic_bool go = false;
+			nbl::core::vector<std::thread> threads;
+			for (uint32_t t=0u; t<threadCount; t++)
+			threads.emplace_back([&,t]() -> void
+			{
+				ready++;
+				while (!go.load(std::memory_order_acquire))
+					std::this_thread::yield();
+				char value;
+				for (uint32_t i=0u; i<opsPerThread; i++)
+				{
+					const int key = keys[t][i];
+					if (i%10u==0u)
+						cache.insert(key,char(key));
+					else
+						cache.get(key,value);
+				}
+			});
+			while (ready.load()!=threadCount)
+				std::this_thread::yield();
+
+			const auto start = clock_t::now();
+			go.store(true,std::memory_order_release);
+			for (auto& thread : threads)
+				thread.join();
+			const double us = double(std::chrono::duration_cast<std::chrono::microseconds>(clock_t::now()-start).count());
+			return us>0.0 ? double(opsPerThread*threadCount)/us:0.0;
+		}
+};
+
+#endif
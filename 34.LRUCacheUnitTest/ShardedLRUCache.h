@@ -0,0 +1,102 @@
+// Copyright (C) 2018-2020 - DevSH Graphics Programming Sp. z O.O.
+// This file is part of the "Nabla Engine".
+// For conditions of distribution and use, see copyright notice in nabla.h
+
+#ifndef _SHARDED_LRU_CACHE_H_INCLUDED_
+#define _SHARDED_LRU_CACHE_H_INCLUDED_
+
+#include <nabla.h>
+#include "nbl/core/containers/LRUcache.h"
+
+#include <mutex>
+#include <memory>
+#include <algorithm>
+
+
+//! Thread-safe LRU cache, keys get spread over `ShardCount` independent `LRUCache`s each behind its own lock.
+/** Recency and eviction are tracked per shard, so it's an approximation of a global LRU which gets better the more uniform the key hashes are.
+Values are copied out under the lock (or visited with a callback) because a pointer into a shard is invalidated the moment another thread inserts into it.
+`ShardCount==1` gives you the plain single global lock, handy as a baseline. */
+template<typename Key, typename Value, uint32_t ShardCount=64u, typename MapHash=std::hash<Key>, typename MapEquals=std::equal_to<Key>>
+class ShardedLRUCache
+{
+		static_assert(ShardCount>0u);
+		using shard_cache_t = nbl::core::LRUCache<Key,Value,MapHash,MapEquals>;
+
+		struct alignas(64) SShard
+		{
+			SShard(uint32_t capacity) : cache(capacity) {}
+
+			std::mutex lock;
+			shard_cache_t cache;
+		};
+
+	public:
+		//! `capacity` gets split evenly between the shards (rounded up, so you may get up to `ShardCount-1` more)
+		ShardedLRUCache(const uint32_t capacity)
+		{
+			const uint32_t shardCapacity = std::max((capacity+ShardCount-1u)/ShardCount,1u);
+			for (auto& shard : shards)
+				shard = std::make_unique<SShard>(shardCapacity);
+		}
+
+		template<typename K, typename V>
+		inline void insert(K&& key, V&& value)
+		{
+			auto& shard = getShard(key);
+			std::unique_lock lock(shard.lock);
+			shard.cache.insert(std::forward<K>(key),std::forward<V>(value));
+		}
+
+		//! Bumps the entry to most recently used, copies it to `out` on a hit
+		inline bool get(const Key& key, Value& out)
+		{
+			return get(key,[&out](const Value& value) -> void {out = value;});
+		}
+		//! Same as above but `f(const Value&)` runs under the shard lock instead of copying
+		template<typename F>
+		inline bool get(const Key& key, F&& f)
+		{
+			auto& shard = getShard(key);
+			std::unique_lock lock(shard.lock);
+			const Value* value = shard.cache.get(key);
+			if (value)
+				f(*value);
+			return value;
+		}
+
+		//! Doesn't change the recency of the entry
+		inline bool peek(const Key& key, Value& out)
+		{
+			auto& shard = getShard(key);
+			std::unique_lock lock(shard.lock);
+			const Value* value = shard.cache.peek(key);
+			if (value)
+				out = *value;
+			return value;
+		}
+
+		inline void erase(const Key& key)
+		{
+			auto& shard = getShard(key);
+			std::unique_lock lock(shard.lock);
+			shard.cache.erase(key);
+		}
+
+	private:
+		// the shard's own map hashes the same keys, so mix the bits or every shard ends up with the same bucket pattern
+		inline SShard& getShard(const Key& key)
+		{
+			if constexpr (ShardCount==1u)
+				return *shards[0];
+			uint64_t hash = MapHash()(key);
+			hash ^= hash>>33ull;
+			hash *= 0xff51afd7ed558ccdull;
+			hash ^= hash>>33ull;
+			return *shards[hash%ShardCount];
+		}
+
+		std::unique_ptr<SShard> shards[ShardCount];
+};
+
+#endif
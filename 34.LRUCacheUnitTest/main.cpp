@@ -2,11 +2,93 @@
 #include <nabla.h>
 #include "nbl/core/containers/LRUcache.h"
 
+#include "ShardedLRUCache.h"
+#include "CompactLRUCache.h"
+#include "LRUCacheBenchmark.h"
+
 using namespace nbl;
 using namespace nbl::core;
 
-int main()
+// times one cache type from 1K up to `maxEntries`, the bytes per entry come from `-MEASURE_MEMORY` in a child process for every cache type alike
+// so that no memory freed by a previous run gets reused
+template<class Cache>
+static void runCacheBenchmark(const char* name, const std::string& executable, const uint32_t maxEntries, const CLRUCacheBenchmark::SParams& params)
 {
+	printf("%s<int,char>\n",name);
+	for (const uint32_t capacity : {1000u,10000u,100000u,1000000u,10000000u,50000000u})
+	if (capacity<=maxEntries)
+	{
+		const double bytesPerEntry = CLRUCacheBenchmark::measureBytesPerEntryInChildProcess(executable,std::string("-MEASURE_MEMORY=")+name+" -CAPACITY="+std::to_string(capacity));
+		for (const auto distribution : {CLRUCacheBenchmark::EKD_UNIFORM,CLRUCacheBenchmark::EKD_ZIPF})
+		{
+			auto result = CLRUCacheBenchmark::run<Cache>(capacity,distribution,params);
+			result.bytesPerEntry = bytesPerEntry;
+			result.print();
+		}
+	}
+}
+
+// `-BENCHMARK [-MAX_ENTRIES=n]` times the single threaded cache from 1K up to `n` (default 50M) entries and the sharded one under contention
+// `-MEASURE_MEMORY=<LRUCache|CompactLRUCache> -CAPACITY=n` prints the bytes per entry of one cache type and exits
+static void runBenchmark(const std::string& executable, const uint32_t maxEntries)
+{
+	const CLRUCacheBenchmark::SParams params;
+	const CLRUCacheBenchmark::E_KEY_DISTRIBUTION distributions[] = {CLRUCacheBenchmark::EKD_UNIFORM,CLRUCacheBenchmark::EKD_ZIPF};
+
+	runCacheBenchmark<LRUCache<int,char>>("LRUCache",executable,maxEntries,params);
+	runCacheBenchmark<CompactLRUCache<int,char>>("CompactLRUCache",executable,maxEntries,params);
+
+	const uint32_t concurrentCapacity = std::min(1000000u,maxEntries);
+	const uint32_t maxThreads = std::max(std::thread::hardware_concurrency(),1u);
+	printf("Concurrent 90%% get 10%% insert, %u entries\n",concurrentCapacity);
+	for (const auto distribution : distributions)
+	for (uint32_t threadCount=1u; ; threadCount=std::min(threadCount*2u,maxThreads))
+	{
+		const double globalLock = CLRUCacheBenchmark::runConcurrent<ShardedLRUCache<int,char,1u>>(concurrentCapacity,threadCount,distribution,params);
+		const double sharded = CLRUCacheBenchmark::runConcurrent<ShardedLRUCache<int,char>>(concurrentCapacity,threadCount,distribution,params);
+		printf("%3u threads %-7s | global lock %8.2f Mops/s sharded %8.2f Mops/s\n",threadCount,distribution==CLRUCacheBenchmark::EKD_ZIPF ? "zipf":"uniform",globalLock,sharded);
+		if (threadCount==maxThreads)
+			break;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	{
+		bool benchmark = false;
+		uint32_t maxEntries = 50000000u;
+		std::string measureMemory;
+		uint32_t capacity = 0u;
+		for (int i=1; i<argc; i++)
+		{
+			const std::string arg = argv[i];
+			if (arg=="-BENCHMARK")
+				benchmark = true;
+			else if (arg.rfind("-MAX_ENTRIES=",0)==0)
+				maxEntries = std::stoul(arg.substr(13));
+			else if (arg.rfind("-MEASURE_MEMORY=",0)==0)
+				measureMemory = arg.substr(16);
+			else if (arg.rfind("-CAPACITY=",0)==0)
+				capacity = std::stoul(arg.substr(10));
+		}
+		if (!measureMemory.empty() && capacity!=0u)
+		{
+			const CLRUCacheBenchmark::SParams params;
+			double bytesPerEntry = -1.0;
+			if (measureMemory=="LRUCache")
+				bytesPerEntry = CLRUCacheBenchmark::measureBytesPerEntry<LRUCache<int,char>>(capacity,params);
+			else if (measureMemory=="CompactLRUCache")
+				bytesPerEntry = CLRUCacheBenchmark::measureBytesPerEntry<CompactLRUCache<int,char>>(capacity,params);
+			printf("%f\n",bytesPerEntry);
+			return 0;
+		}
+		if (benchmark)
+		{
+			runBenchmark(argv[0],maxEntries);
+			return 0;
+		}
+	}
+
 	LRUCache<int, char> hugeCache(50000000u);
 
 	LRUCache<int, char> cache(5u);
@@ -73,6 +155,99 @@ int main()
 	i = 111;
 	cache2.print(std::cout);
 
+	// compact layout has to behave exactly like the regular one
+	{
+		CompactLRUCache<int,std::string> compactCache(3u);
+		compactCache.insert(500,"five hundred");
+		compactCache.insert(510,"five hundred and ten");
+		compactCache.insert(52,"fifty two");
+		// bump 500 so 510 is the one to go
+		assert(*compactCache.get(500)=="five hundred");
+		compactCache.insert(21,"key is 21");
+		assert(compactCache.peek(510)==nullptr);
+		assert(*compactCache.peek(52)=="fifty two");
+		// erasing moves the last pooled node into the hole
+		compactCache.erase(500);
+		assert(compactCache.get(500)==nullptr);
+		assert(*compactCache.get(21)=="key is 21");
+		assert(*compactCache.get(52)=="fifty two");
+		assert(compactCache.getSize()==2u);
+		compactCache.print(std::cout);
+
+		// random ops against the pointer based cache, fresh keys only so there's no ambiguity about re-inserts
+		LRUCache<int,int> reference(64u);
+		CompactLRUCache<int,int> compact(64u);
+		std::mt19937 mt(0x45u);
+		for (int i=0; i<100000; i++)
+		{
+			const int key = int(mt()%256u);
+			switch (mt()%4u)
+			{
+				case 0u:
+					if (!reference.peek(key))
+					{
+						reference.insert(key,i);
+						compact.insert(key,i);
+					}
+					break;
+				case 1u:
+				{
+					const int* expected = reference.get(key);
+					const int* returned = compact.get(key);
+					assert((expected==nullptr)==(returned==nullptr) && (!expected || *expected==*returned));
+					break;
+				}
+				case 2u:
+				{
+					const int* expected = reference.peek(key);
+					const int* returned = compact.peek(key);
+					assert((expected==nullptr)==(returned==nullptr) && (!expected || *expected==*returned));
+					break;
+				}
+				default:
+					reference.erase(key);
+					compact.erase(key);
+					break;
+			}
+		}
+	}
+
+	// sharded, plenty of room in every shard so nothing gets evicted early by an unlucky hash
+	ShardedLRUCache<int,std::string,4u> shardedCache(4u*64u);
+	shardedCache.insert(500,"five hundred");
+	shardedCache.insert(510,"five hundred and ten");
+	std::string shardedReturned;
+	bool found = shardedCache.get(500,shardedReturned);
+	assert(found && shardedReturned=="five hundred");
+	found = shardedCache.peek(510,shardedReturned);
+	assert(found && shardedReturned=="five hundred and ten");
+	shardedCache.erase(510);
+	found = shardedCache.get(510,shardedReturned);
+	assert(!found);
+
+	// every thread inserts its own keys, they all must still be there since every shard has 4x headroom
+	{
+		constexpr uint32_t threadCount = 8u;
+		constexpr int keysPerThread = 1000;
+		ShardedLRUCache<int,int> concurrentCache(threadCount*keysPerThread*4u);
+		core::vector<std::thread> threads;
+		for (uint32_t t=0u; t<threadCount; t++)
+		threads.emplace_back([&concurrentCache,t]() -> void
+		{
+			for (int k=0; k<keysPerThread; k++)
+				concurrentCache.insert(int(t)*keysPerThread+k,k);
+		});
+		for (auto& thread : threads)
+			thread.join();
+
+		int value;
+		for (int key=0; key<int(threadCount)*keysPerThread; key++)
+		{
+			found = concurrentCache.get(key,value);
+			assert(found && value==key%keysPerThread);
+		}
+	}
+
 
 	return 0;
 }
@@ -9,6 +9,7 @@
 
 #include "../common/Camera.hpp"
 #include "../common/CommonAPI.h"
+#include "../common/CSPIRVCompileCache.h"
 #include "nbl/ext/ScreenShot/ScreenShot.h"
 
 using namespace nbl;
@@ -275,6 +276,7 @@ public:
 		auto arrowGeometry = geometryCreator->createArrowMesh();
 		auto icosphereGeometry = geometryCreator->createIcoSphere(1, 3, true);
 
+		auto spirvCache = core::make_smart_refctd_ptr<CSPIRVCompileCache>(core::smart_refctd_ptr<asset::CCompilerSet>(assetManager->getCompilerSet()), localOutputCWD / "spirv_cache");
 		auto createSpecializedShaderFromSource = [=](const char* source, asset::IShader::E_SHADER_STAGE stage) -> core::smart_refctd_ptr<video::IGPUSpecializedShader>
 		{
 			auto computeUnspec = core::make_smart_refctd_ptr<asset::ICPUShader>(source, stage, asset::IShader::E_CONTENT_TYPE::ECT_GLSL, "runtimeID");
@@ -283,7 +285,7 @@ public:
 			options.preprocessorOptions.sourceIdentifier = "runtimeID";
 			options.stage = stage;
 
-			auto spirv = assetManager->getCompilerSet()->compileToSPIRV(computeUnspec.get(), std::move(options));
+			auto spirv = spirvCache->compileToSPIRV(computeUnspec.get(), options);
 			if (!spirv)
 				return nullptr;
 
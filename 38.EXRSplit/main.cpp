@@ -6,6 +6,10 @@
 
 #include <iostream>
 #include <cstdio>
+#include <chrono>
+#include <atomic>
+#include <thread>
+#include <algorithm>
 
 
 using namespace nbl;
@@ -14,21 +18,148 @@ using namespace asset;
 using namespace system;
 
 
+/*
+	Usage: exrsplit [file.exr] [-LAYERS=pattern,...] [-COMPRESSION=pattern:mode,...] [-SERIAL] [-BENCHMARK]
+
+	-LAYERS       only split out the layers whose channel set name matches one of the patterns (`*` and `?` wildcards),
+	              unnamed layers are matched by their index
+	-COMPRESSION  per layer output compression, the first rule whose pattern matches wins, `mode` is `NONE` or `ZIP` with an
+	              optional level `ZIP:0.5`, layers no rule matches are written uncompressed like before
+	-SERIAL       write the layers one after another instead of spreading them over a worker per hardware thread
+	-BENCHMARK    write everything in parallel once uncompressed and once compressed, then serially and in parallel with the
+	              -COMPRESSION= rules, reporting the throughput and the size of the written files of each
+*/
+struct SLayerJob
+{
+	smart_refctd_ptr<ICPUImageView> imageView;
+	std::string outputPath;
+	// what the writer gets in `SAssetWriteParams`
+	E_WRITER_FLAGS flags = EWF_BINARY;
+	float compressionLevel = 0.f;
+	size_t bytesize = 0ull;
+};
+
+struct SCompressionRule
+{
+	std::string pattern;
+	E_WRITER_FLAGS flags;
+	float compressionLevel;
+};
+
+// Nothing guarantees that an `IAssetManager`, its writers or the `ISystem` behind them can be used from many threads at once, so every
+// worker gets its own and the only thing the workers share are the images, which the writes only read.
+struct SWriterContext
+{
+	smart_refctd_ptr<ISystem> system;
+	smart_refctd_ptr<IAssetManager> assetManager;
+};
+
+static smart_refctd_ptr<ISystem> createSystem()
+{
+#ifdef _NBL_PLATFORM_WINDOWS_
+	return make_smart_refctd_ptr<nbl::system::CSystemWin32>();
+#elif defined(_NBL_PLATFORM_LINUX_)
+	return make_smart_refctd_ptr<nbl::system::CSystemLinux>();
+#else
+#error "Unsupported Platform"
+#endif
+}
+
+static bool matchesPattern(const char* name, const char* pattern)
+{
+	for (; *pattern; pattern++,name++)
+	{
+		if (*pattern=='*')
+		{
+			// collapse runs of stars, then try every suffix
+			while (pattern[1]=='*')
+				pattern++;
+			for (; ; name++)
+			{
+				if (matchesPattern(name,pattern+1))
+					return true;
+				if (!*name)
+					return false;
+			}
+		}
+		if (!*name || (*pattern!='?' && *pattern!=*name))
+			return false;
+	}
+	return !*name;
+}
+
+static std::vector<std::string> splitList(const std::string& list)
+{
+	std::vector<std::string> retval;
+	for (size_t begin=0ull; begin<=list.size(); )
+	{
+		auto end = list.find(',',begin);
+		if (end==std::string::npos)
+			end = list.size();
+		if (end!=begin)
+			retval.push_back(list.substr(begin,end-begin));
+		begin = end+1ull;
+	}
+	return retval;
+}
+
+static bool writeLayer(IAssetManager* assetManager, const SLayerJob& job)
+{
+	const auto writeParams = IAssetWriter::SAssetWriteParams(job.imageView.get(),job.flags,job.compressionLevel);
+	return assetManager->writeAsset(job.outputPath,writeParams);
+}
+
+// the workers take the next unwritten layer until there's none left, returns the seconds it took, negative if any write failed
+static double writeLayers(const uint32_t workerCount, const std::vector<SLayerJob>& jobs)
+{
+	// not timed, only the writes are
+	std::vector<SWriterContext> contexts(workerCount);
+	for (auto& context : contexts)
+	{
+		context.system = createSystem();
+		context.assetManager = make_smart_refctd_ptr<IAssetManager>(smart_refctd_ptr(context.system));
+	}
+
+	std::atomic_uint32_t nextJob = 0u;
+	std::atomic_bool success = true;
+	auto work = [&](const SWriterContext& context) -> void
+	{
+		for (auto j=nextJob++; j<jobs.size(); j=nextJob++)
+		if (!writeLayer(context.assetManager.get(),jobs[j]))
+			success = false;
+	};
+
+	const auto start = std::chrono::high_resolution_clock::now();
+	std::vector<std::thread> workers;
+	for (auto w=1u; w<workerCount; w++)
+		workers.emplace_back(work,std::cref(contexts[w]));
+	work(contexts[0]);
+	for (auto& worker : workers)
+		worker.join();
+	const double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now()-start).count();
+	return success ? seconds:-1.0;
+}
+
+// of the files the jobs wrote
+static size_t writtenBytesize(const std::vector<SLayerJob>& jobs)
+{
+	size_t retval = 0ull;
+	for (const auto& job : jobs)
+	{
+		std::error_code error;
+		const auto size = std::filesystem::file_size(job.outputPath,error);
+		if (!error)
+			retval += size;
+	}
+	return retval;
+}
+
 int main(int argc, char * argv[])
 {
 	// need to call this to Delay-Load DLLs properly
 	IApplicationFramework::GlobalsInit();
 
-	smart_refctd_ptr<ISystem> system = nullptr;
-	{
-	#ifdef _NBL_PLATFORM_WINDOWS_
-		system = make_smart_refctd_ptr<nbl::system::CSystemWin32>();
-	#elif defined(_NBL_PLATFORM_LINUX_)
-		system = make_smart_refctd_ptr<nbl::system::CSystemLinux>();
-	#else
-	#error "Unsupported Platform"
-	#endif
-	}
+	smart_refctd_ptr<ISystem> system = createSystem();
 
 	#if defined(_NBL_PLATFORM_WINDOWS_)
 	auto logger = core::make_smart_refctd_ptr<system::CColoredStdoutLoggerWin32>();
@@ -37,21 +168,60 @@ int main(int argc, char * argv[])
 	#endif
 	auto assetManager = core::make_smart_refctd_ptr<nbl::asset::IAssetManager>(nbl::core::smart_refctd_ptr(system));
 
-	const bool isItDefaultImage = argc == 1;
+	std::string imagePath;
+	std::vector<std::string> layerPatterns;
+	std::vector<SCompressionRule> compressionRules;
+	bool serial = false, benchmark = false;
+	for (auto i=1; i<argc; i++)
+	{
+		const std::string arg = argv[i];
+		if (arg.rfind("-LAYERS=",0)==0)
+			layerPatterns = splitList(arg.substr(8));
+		else if (arg.rfind("-COMPRESSION=",0)==0)
+		{
+			for (const auto& rule : splitList(arg.substr(13)))
+			{
+				const auto modeBegin = rule.find(':');
+				const auto levelBegin = rule.find(':',modeBegin+1ull);
+				const auto mode = modeBegin!=std::string::npos ? rule.substr(modeBegin+1ull,levelBegin-modeBegin-1ull):"";
+				if (mode=="NONE")
+					compressionRules.push_back({rule.substr(0ull,modeBegin),EWF_BINARY,0.f});
+				else if (mode=="ZIP")
+				{
+					const float level = levelBegin!=std::string::npos ? std::stof(rule.substr(levelBegin+1ull)):1.f;
+					compressionRules.push_back({rule.substr(0ull,modeBegin),static_cast<E_WRITER_FLAGS>(EWF_BINARY|EWF_COMPRESSED),level});
+				}
+				else
+				{
+					logger->log("Invalid compression rule %s, expected pattern:NONE or pattern:ZIP[:level]!", ILogger::ELL_ERROR, rule.c_str());
+					return 0;
+				}
+			}
+		}
+		else if (arg=="-SERIAL")
+			serial = true;
+		else if (arg=="-BENCHMARK")
+			benchmark = true;
+		else if (imagePath.empty() && arg.front()!='-')
+			imagePath = arg;
+		else
+		{
+			logger->log("Unknown argument %s - pass a single filename of an OpenEXR image and the optional -LAYERS=, -COMPRESSION=, -SERIAL and -BENCHMARK switches!", ILogger::ELL_ERROR, arg.c_str());
+			return 0;
+		}
+	}
+
+	const bool isItDefaultImage = imagePath.empty();
 	if (isItDefaultImage)
 		logger->log("No image specified - loading a default OpenEXR image placed in media/OpenEXR!", ILogger::ELL_INFO);
-	else if (argc == 2)
-		logger->log((argv[1] + std::string(" specified!")).c_str(), ILogger::ELL_INFO);
 	else
-	{
-		logger->log("To many arguments - pass a single filename without .exr extension of OpenEXR image placed in media/OpenEXR!", ILogger::ELL_ERROR);
-		return 0;
-	}
+		logger->log((imagePath + std::string(" specified!")).c_str(), ILogger::ELL_INFO);
 
 	IAssetLoader::SAssetLoadParams loadParams;
 	constexpr std::string_view defaultImagePath = "../../media/noises/spp_benchmark_4k_512.exr";
-	const auto filePath = std::string(isItDefaultImage ? defaultImagePath.data() : argv[1]);
+	const auto filePath = isItDefaultImage ? std::string(defaultImagePath.data()):imagePath;
 
+	const auto loadStart = std::chrono::high_resolution_clock::now();
 	const asset::COpenEXRMetadata* meta;
 	auto image_bundle = assetManager->getAsset(filePath, loadParams);
 	auto contents = image_bundle.getContents();
@@ -61,34 +231,97 @@ int main(int argc, char * argv[])
 		status = meta = image_bundle.getMetadata()->selfCast<const COpenEXRMetadata>();
 		assert(status);
 	}
+	const double loadSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now()-loadStart).count();
 
+	std::filesystem::path filename, extension;
+	core::splitFilename(filePath.c_str(), nullptr, &filename, &extension);
+
+	// gather everything up front, the writes themselves only read the images
+	std::vector<SLayerJob> jobs;
+	size_t loadedBytesize = 0ull;
 	uint32_t i = 0u;
 	for (auto asset : contents)
 	{
 		auto image = IAsset::castDown<ICPUImage>(asset);
+		loadedBytesize += image->getBuffer()->getSize();
 		const auto* metadata = static_cast<const COpenEXRMetadata::CImage*>(meta->getAssetSpecificMetadata(image.get()));
 
+		const auto channelsName = metadata->m_name;
+		const auto layerName = channelsName.empty() ? std::to_string(i++):channelsName;
+		if (!layerPatterns.empty() && std::none_of(layerPatterns.begin(),layerPatterns.end(),[&](const std::string& pattern){return matchesPattern(layerName.c_str(),pattern.c_str());}))
+			continue;
+
+		SLayerJob job;
+		job.bytesize = image->getBuffer()->getSize();
+
 		ICPUImageView::SCreationParams imgViewParams;
 		imgViewParams.flags = static_cast<ICPUImageView::E_CREATE_FLAGS>(0u);
 		imgViewParams.image = std::move(image);
 		imgViewParams.format = imgViewParams.image->getCreationParameters().format;
 		imgViewParams.viewType = ICPUImageView::ET_2D;
 		imgViewParams.subresourceRange = { static_cast<IImage::E_ASPECT_FLAGS>(0u),0u,1u,0u,1u };
-		auto imageView = ICPUImageView::create(std::move(imgViewParams));
+		job.imageView = ICPUImageView::create(std::move(imgViewParams));
 
-		auto channelsName = metadata->m_name;
+		job.outputPath = filename.string() + "_" + layerName + extension.string();
+		for (const auto& rule : compressionRules)
+		if (matchesPattern(layerName.c_str(),rule.pattern.c_str()))
+		{
+			job.flags = rule.flags;
+			job.compressionLevel = rule.compressionLevel;
+			break;
+		}
+		jobs.push_back(std::move(job));
+	}
+	if (jobs.empty())
+	{
+		logger->log("No layers matched the -LAYERS= patterns, nothing to write!", ILogger::ELL_WARNING);
+		return 0;
+	}
 
-		std::filesystem::path filename, extension;
-		core::splitFilename(filePath.c_str(), nullptr, &filename, &extension);
-		const std::string finalFileNameWithExtension = filename.string() + extension.string();
-		const std::string finalOutputPath = channelsName.empty() ? (filename.string() + "_" + std::to_string(i++) + extension.string()) : (filename.string() + "_" + channelsName + extension.string());
+	size_t totalBytesize = 0ull;
+	for (const auto& job : jobs)
+		totalBytesize += job.bytesize;
+	const double totalMegabytes = double(totalBytesize)/double(0x1u<<20u);
+	const uint32_t parallelWorkerCount = std::clamp<uint32_t>(std::thread::hardware_concurrency(),1u,static_cast<uint32_t>(jobs.size()));
+	auto reportWrite = [&](const char* mode, const double seconds) -> void
+	{
+		if (seconds<0.0)
+			logger->log("%s write of some layers failed!", ILogger::ELL_ERROR, mode);
+		else
+			logger->log("%s write of %u layers, %.1f MB in %.3f s = %.1f MB/s, %.1f MB of files", ILogger::ELL_PERFORMANCE, mode, static_cast<uint32_t>(jobs.size()), totalMegabytes, seconds, totalMegabytes/seconds, double(writtenBytesize(jobs))/double(0x1u<<20u));
+	};
 
-		const auto writeParams = IAssetWriter::SAssetWriteParams(imageView.get(), EWF_BINARY);
+	if (benchmark)
+	{
+		const double loadedMegabytes = double(loadedBytesize)/double(0x1u<<20u);
+		logger->log("Loaded %s, %u layers, %.1f MB in %.3f s = %.1f MB/s", ILogger::ELL_PERFORMANCE, filePath.c_str(), static_cast<uint32_t>(contents.size()), loadedMegabytes, loadSeconds, loadedMegabytes/loadSeconds);
+		// every layer the same way first, so the files left behind are the ones the -COMPRESSION= rules ask for
+		auto withCompression = [&](const E_WRITER_FLAGS flags, const float compressionLevel) -> std::vector<SLayerJob>
 		{
-			bool status = assetManager->writeAsset(finalOutputPath, writeParams);
-			assert(status);
-		}
+			auto retval = jobs;
+			for (auto& job : retval)
+			{
+				job.flags = flags;
+				job.compressionLevel = compressionLevel;
+			}
+			return retval;
+		};
+		const auto uncompressedJobs = withCompression(EWF_BINARY,0.f);
+		const double uncompressedSeconds = writeLayers(parallelWorkerCount,uncompressedJobs);
+		const size_t uncompressedBytesize = writtenBytesize(uncompressedJobs);
+		reportWrite("Parallel uncompressed",uncompressedSeconds);
+		const auto compressedJobs = withCompression(static_cast<E_WRITER_FLAGS>(EWF_BINARY|EWF_COMPRESSED),1.f);
+		const double compressedSeconds = writeLayers(parallelWorkerCount,compressedJobs);
+		reportWrite("Parallel compressed",compressedSeconds);
+		if (uncompressedSeconds>=0.0 && compressedSeconds>=0.0 && writtenBytesize(compressedJobs)==uncompressedBytesize)
+			logger->log("Compressed and uncompressed layers came out the same size, the EXR writer ignores EWF_COMPRESSED!", ILogger::ELL_WARNING);
+		reportWrite("Serial",writeLayers(1u,jobs));
+		reportWrite("Parallel",writeLayers(parallelWorkerCount,jobs));
 	}
-		
+	else if (serial)
+		reportWrite("Serial",writeLayers(1u,jobs));
+	else
+		reportWrite("Parallel",writeLayers(parallelWorkerCount,jobs));
+
 	return 0;
 }
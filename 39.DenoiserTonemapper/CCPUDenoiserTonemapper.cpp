@@ -0,0 +1,554 @@
+// Copyright (C) 2018-2020 - DevSH Graphics Programming Sp. z O.O.
+// This file is part of the "Nabla Engine".
+// For conditions of distribution and use, see copyright notice in nabla.h
+
+#include "CCPUDenoiserTonemapper.h"
+
+#include "nbl/asset/filters/dithering/CPrecomputedDither.h"
+
+#include <cfloat>
+#include <cctype>
+#include <numeric>
+#include <algorithm>
+
+using namespace nbl;
+using namespace asset;
+
+
+namespace
+{
+	template<typename F>
+	void parallelFor(const uint32_t count, F&& f)
+	{
+		core::vector<uint32_t> indices(count);
+		std::iota(indices.begin(),indices.end(),0u);
+		std::for_each(core::execution::par_unseq,indices.begin(),indices.end(),std::forward<F>(f));
+	}
+
+	constexpr float sRGBtoXYZ[3][3] = {
+		{0.4124564f,0.3575761f,0.1804375f},
+		{0.2126729f,0.7151522f,0.0721750f},
+		{0.0193339f,0.1191920f,0.9503041f}
+	};
+	constexpr float XYZtosRGB[3][3] = {
+		{ 3.2404542f,-1.5371385f,-0.4985314f},
+		{-0.9692660f, 1.8760108f, 0.0415560f},
+		{ 0.0556434f,-0.2040259f, 1.0572252f}
+	};
+	// Stephen Hill's fit of the ACES RRT+ODT, same as the ToneMapper extension's
+	constexpr float ACESInput[3][3] = {
+		{0.59719f,0.35458f,0.04823f},
+		{0.07600f,0.90834f,0.01566f},
+		{0.02840f,0.13383f,0.83777f}
+	};
+	constexpr float ACESOutput[3][3] = {
+		{ 1.60475f,-0.53108f,-0.07367f},
+		{-0.10208f, 1.10813f,-0.00605f},
+		{-0.00327f,-0.07276f, 1.07602f}
+	};
+	inline void mul(const float m[3][3], const float* in, float* out)
+	{
+		for (auto r=0u; r<3u; r++)
+			out[r] = m[r][0]*in[0]+m[r][1]*in[1]+m[r][2]*in[2];
+	}
+	inline float luma(const float* rgb)
+	{
+		return sRGBtoXYZ[1][0]*rgb[0]+sRGBtoXYZ[1][1]*rgb[1]+sRGBtoXYZ[1][2]*rgb[2];
+	}
+
+	core::smart_refctd_ptr<ICPUImageView> createView(core::smart_refctd_ptr<ICPUImage>&& image)
+	{
+		const auto& creationParams = image->getCreationParameters();
+		ICPUImageView::SCreationParams viewParams;
+		viewParams.flags = static_cast<ICPUImageView::E_CREATE_FLAGS>(0u);
+		viewParams.format = creationParams.format;
+		viewParams.viewType = ICPUImageView::ET_2D;
+		viewParams.subresourceRange = {static_cast<IImage::E_ASPECT_FLAGS>(0u),0u,creationParams.mipLevels,0u,creationParams.arrayLayers};
+		viewParams.image = std::move(image);
+		return ICPUImageView::create(std::move(viewParams));
+	}
+
+	// the log2 luma the metering sees would give a middle gray of 0.18 after multiplying by this
+	inline float getOptiXIntensity(const float measuredLumaLog2)
+	{
+		return exp2(log2(0.18f)-measuredLumaLog2);
+	}
+
+	template<typename T>
+	inline T* getTexels(const ICPUImage* image, uint32_t& outRowPitch)
+	{
+		const auto& region = image->getRegions().begin()[0];
+		const auto& creationParams = image->getCreationParameters();
+		outRowPitch = (region.bufferRowLength ? region.bufferRowLength:creationParams.extent.width)*getTexelOrBlockBytesize(creationParams.format);
+		return reinterpret_cast<T*>(reinterpret_cast<uint8_t*>(const_cast<ICPUBuffer*>(image->getBuffer())->getPointer())+region.bufferOffset);
+	}
+
+	inline bool isUsable(const ICPUImage* image)
+	{
+		return image && image->getBuffer() && image->getRegions().size()==1u && !isBlockCompressionFormat(image->getCreationParameters().format);
+	}
+}
+
+
+bool CCPUDenoiserTonemapper::STonemapper::parse(const std::string& str, STonemapper& out)
+{
+	const auto eq = str.find('=');
+	if (eq==std::string::npos)
+		return false;
+
+	auto name = str.substr(0u,eq);
+	std::transform(name.begin(),name.end(),name.begin(),[](const char c) -> char {return std::toupper(c);});
+	if (name=="REINHARD")
+		out.op = ET_REINHARD;
+	else if (name=="ACES")
+		out.op = ET_ACES;
+	else if (name=="NONE")
+		out.op = ET_NONE;
+	else
+		return false;
+
+	const auto values = str.substr(eq+1u);
+	const auto comma = values.find(',');
+	const auto keyStr = values.substr(0u,comma);
+	try
+	{
+		if (out.op==ET_NONE && keyStr=="AutoexposureOff")
+			out.key = core::nan<float>();
+		else
+			out.key = std::stof(keyStr);
+		if (out.op!=ET_NONE)
+		{
+			if (comma==std::string::npos)
+				return false;
+			out.extra = std::stof(values.substr(comma+1u));
+		}
+	}
+	catch (const std::logic_error&)
+	{
+		return false;
+	}
+	return true;
+}
+
+core::smart_refctd_ptr<ICPUImage> CCPUDenoiserTonemapper::process(const SParams& params)
+{
+	if (!decodeRGB(params.color,m_color))
+	{
+		os::Printer::log("CCPUDenoiserTonemapper: color image is missing or has an unsupported layout!",ELL_ERROR);
+		return nullptr;
+	}
+	const auto& extent = params.color->getCreationParameters().extent;
+	const uint32_t width = extent.width;
+	const uint32_t height = extent.height;
+	const uint32_t pixelCount = width*height;
+
+	auto decodeAOV = [extent](const ICPUImage* image, core::vector<float>& out, const char* name) -> bool
+	{
+		if (!image)
+			return false;
+		const auto& aovExtent = image->getCreationParameters().extent;
+		if (aovExtent.width!=extent.width || aovExtent.height!=extent.height || !decodeRGB(image,out))
+		{
+			os::Printer::log(std::string("CCPUDenoiserTonemapper: ignoring the ")+name+" image, it doesn't match the color image!",ELL_WARNING);
+			return false;
+		}
+		return true;
+	};
+
+	if (params.denoiser)
+	{
+		const bool hasAlbedo = decodeAOV(params.albedo,m_albedo,"albedo");
+		const bool hasNormal = decodeAOV(params.normal,m_normal,"normal");
+		// same sanitization as the deinterleave shader
+		parallelFor(height,[&](const uint32_t y) -> void
+		{
+			for (uint32_t i=y*width; i<(y+1u)*width; i++)
+			{
+				if (hasAlbedo)
+				{
+					float* albedo = m_albedo.data()+i*3u;
+					if (!std::isfinite(albedo[0]) || !std::isfinite(albedo[1]) || !std::isfinite(albedo[2]))
+						albedo[0] = albedo[1] = albedo[2] = 1.f;
+				}
+				if (hasNormal)
+				{
+					float* normal = m_normal.data()+i*3u;
+					core::vectorSIMDf n(normal[0],normal[1],normal[2]);
+					const bool valid = std::isfinite(n.x) && std::isfinite(n.y) && std::isfinite(n.z) && core::length(n)[0]>=0.000000001f;
+					if (valid)
+					{
+						params.normalMatrix.mulSub3x3WithNx1(n);
+						n = core::normalize(n);
+					}
+					else
+						n = core::vectorSIMDf(0.f,0.f,1.f);
+					std::copy_n(n.pointer,3u,normal);
+				}
+			}
+		});
+
+		const float hdrIntensity = getOptiXIntensity(meterLumaLog2(m_color.data(),pixelCount)+params.denoiserExposureBias);
+		m_denoised.resize(m_color.size());
+		const bool denoised = params.denoiser->denoise(
+			m_denoised.data(),m_color.data(),hasAlbedo ? m_albedo.data():nullptr,hasNormal ? m_normal.data():nullptr,
+			width,height,hdrIntensity,params.denoiserBlendFactor
+		);
+		if (denoised)
+			std::swap(m_color,m_denoised);
+		else
+			os::Printer::log("CCPUDenoiserTonemapper: denoiser failed, continuing with the noisy image!",ELL_WARNING);
+	}
+
+	// second metering on the denoised image, before bloom
+	const bool autoexposure = params.tonemapper.op!=ET_NONE || !core::isnan(params.tonemapper.key);
+	const float intensity = autoexposure ? getOptiXIntensity(meterLumaLog2(m_color.data(),pixelCount)):1.f;
+
+	if (params.bloomPSF && params.bloomIntensity>0.f)
+		bloom(m_color.data(),width,height,params);
+
+	tonemap(m_color.data(),pixelCount,params.tonemapper,intensity);
+
+	return encodeRGBA16F(m_color.data(),width,height);
+}
+
+bool CCPUDenoiserTonemapper::writeEXR(IAssetManager* assetManager, const ICPUImage* image, const std::string& path)
+{
+	core::smart_refctd_ptr<ICPUImage> hdrImage;
+	if (image->getCreationParameters().format==EF_R16G16B16A16_SFLOAT)
+		hdrImage = core::smart_refctd_ptr<ICPUImage>(const_cast<ICPUImage*>(image));
+	else
+	{
+		core::vector<float> rgb;
+		if (!decodeRGB(image,rgb))
+		{
+			os::Printer::log("CCPUDenoiserTonemapper: image to write has an unsupported layout!",ELL_ERROR);
+			return false;
+		}
+		const auto& extent = image->getCreationParameters().extent;
+		hdrImage = encodeRGBA16F(rgb.data(),extent.width,extent.height);
+	}
+	auto imageView = createView(std::move(hdrImage));
+	IAssetWriter::SAssetWriteParams wp(imageView.get());
+	return assetManager->writeAsset(path,wp);
+}
+
+bool CCPUDenoiserTonemapper::writeOutputs(IAssetManager* assetManager, ICPUImage* image, const std::string& pathWithoutExtension)
+{
+	bool success = writeEXR(assetManager,image,pathWithoutExtension+".exr");
+
+	if (!m_ditherImageView)
+	{
+		auto ditheringBundle = assetManager->getAsset("../../media/blueNoiseDithering/LDR_RGBA.png",{});
+		if (ditheringBundle.getContents().empty())
+		{
+			os::Printer::log("CCPUDenoiserTonemapper: Could not load the dithering image!",ELL_ERROR);
+			return false;
+		}
+		m_ditherImageView = createView(core::smart_refctd_ptr_static_cast<ICPUImage>(ditheringBundle.getContents().begin()[0]));
+	}
+
+	// convert to EF_R8G8B8_SRGB and save it as .png and .jpg
+	using CONVERSION_FILTER = CConvertFormatImageFilter<EF_UNKNOWN,EF_UNKNOWN,CPrecomputedDither,void,true>;
+	const auto& extent = image->getCreationParameters().extent;
+	auto converted = createImage(EF_R8G8B8_SRGB,extent.width,extent.height);
+	{
+		CONVERSION_FILTER convertFilter;
+		CONVERSION_FILTER::state_type state;
+		state.ditherState = _NBL_NEW(std::remove_pointer<decltype(state.ditherState)>::type,m_ditherImageView.get());
+		state.inImage = image;
+		state.outImage = converted.get();
+		state.inOffset = {0,0,0};
+		state.inBaseLayer = 0;
+		state.outOffset = {0,0,0};
+		state.outBaseLayer = 0;
+		state.extent = {extent.width,extent.height,1u};
+		state.layerCount = 1u;
+		state.inMipLevel = 0u;
+		state.outMipLevel = 0u;
+
+		if (!convertFilter.execute(core::execution::par_unseq,&state))
+		{
+			os::Printer::log("CCPUDenoiserTonemapper: Something went wrong while converting the image!",ELL_WARNING);
+			success = false;
+		}
+
+		_NBL_DELETE(state.ditherState);
+	}
+	auto convertedView = createView(std::move(converted));
+	IAssetWriter::SAssetWriteParams wp(convertedView.get());
+	success = assetManager->writeAsset(pathWithoutExtension+".png",wp) && success;
+	success = assetManager->writeAsset(pathWithoutExtension+".jpg",wp) && success;
+	return success;
+}
+
+core::smart_refctd_ptr<ICPUImage> CCPUDenoiserTonemapper::mergeCubemapFaces(const ICPUImage* const faces[6])
+{
+	if (!isUsable(faces[0]))
+		return nullptr;
+	const auto& referenceParams = faces[0]->getCreationParameters();
+	const uint32_t size = referenceParams.extent.width;
+	for (auto i=0u; i<6u; i++)
+	{
+		if (!isUsable(faces[i]))
+			return nullptr;
+		const auto& creationParams = faces[i]->getCreationParameters();
+		if (creationParams.format!=referenceParams.format || creationParams.extent.width!=size || creationParams.extent.height!=size)
+		{
+			os::Printer::log("CCPUDenoiserTonemapper: cubemap faces need the same square extent and format!",ELL_ERROR);
+			return nullptr;
+		}
+	}
+
+	auto merged = createImage(referenceParams.format,size*3u,size*2u);
+	uint32_t dstRowPitch;
+	auto* dst = getTexels<uint8_t>(merged.get(),dstRowPitch);
+	const uint32_t faceRowBytes = size*getTexelOrBlockBytesize(referenceParams.format);
+	parallelFor(size*2u,[&](const uint32_t y) -> void
+	{
+		for (auto column=0u; column<3u; column++)
+		{
+			uint32_t srcRowPitch;
+			const auto* src = getTexels<const uint8_t>(faces[(y/size)*3u+column],srcRowPitch);
+			memcpy(dst+y*dstRowPitch+column*faceRowBytes,src+(y%size)*srcRowPitch,faceRowBytes);
+		}
+	});
+	return merged;
+}
+
+core::smart_refctd_ptr<ICPUImage> CCPUDenoiserTonemapper::extractCubemapFace(const ICPUImage* merged, const uint32_t face, const uint32_t borderPixels)
+{
+	if (!isUsable(merged) || face>=6u)
+		return nullptr;
+	const auto& creationParams = merged->getCreationParameters();
+	const uint32_t size = creationParams.extent.width/3u;
+	if (size<=borderPixels*2u || creationParams.extent.height<size*2u)
+	{
+		os::Printer::log("CCPUDenoiserTonemapper: merged cubemap is too small for the border!",ELL_ERROR);
+		return nullptr;
+	}
+	const uint32_t extractedSize = size-borderPixels*2u;
+
+	auto extracted = createImage(creationParams.format,extractedSize,extractedSize);
+	uint32_t srcRowPitch,dstRowPitch;
+	const auto* src = getTexels<const uint8_t>(merged,srcRowPitch);
+	auto* dst = getTexels<uint8_t>(extracted.get(),dstRowPitch);
+	const uint32_t texelBytesize = getTexelOrBlockBytesize(creationParams.format);
+	const uint32_t offsetX = (face%3u)*size+borderPixels;
+	const uint32_t offsetY = (face/3u)*size+borderPixels;
+	for (uint32_t y=0u; y<extractedSize; y++)
+		memcpy(dst+y*dstRowPitch,src+(offsetY+y)*srcRowPitch+offsetX*texelBytesize,dstRowPitch);
+	return extracted;
+}
+
+bool CCPUDenoiserTonemapper::decodeRGB(const ICPUImage* image, core::vector<float>& out)
+{
+	if (!isUsable(image))
+		return false;
+	const auto& creationParams = image->getCreationParameters();
+	const auto format = creationParams.format;
+	const uint32_t width = creationParams.extent.width;
+	const uint32_t texelBytesize = getTexelOrBlockBytesize(format);
+	uint32_t rowPitch;
+	const auto* texels = getTexels<const uint8_t>(image,rowPitch);
+
+	out.resize(size_t(width)*creationParams.extent.height*3u);
+	parallelFor(creationParams.extent.height,[&](const uint32_t y) -> void
+	{
+		for (uint32_t x=0u; x<width; x++)
+		{
+			const void* srcPix[4] = {texels+y*rowPitch+x*texelBytesize,nullptr,nullptr,nullptr};
+			double decoded[4] = {0.0,0.0,0.0,1.0};
+			decodePixelsRuntime<double>(format,srcPix,decoded,0u,0u);
+			for (auto c=0u; c<3u; c++)
+				out[(size_t(y)*width+x)*3u+c] = float(decoded[c]);
+		}
+	});
+	return true;
+}
+
+core::smart_refctd_ptr<ICPUImage> CCPUDenoiserTonemapper::encodeRGBA16F(const float* rgb, const uint32_t width, const uint32_t height)
+{
+	auto output = createImage(EF_R16G16B16A16_SFLOAT,width,height);
+	auto* outTexels = reinterpret_cast<uint16_t*>(output->getBuffer()->getPointer());
+	parallelFor(height,[&](const uint32_t y) -> void
+	{
+		for (uint32_t i=y*width; i<(y+1u)*width; i++)
+		{
+			for (auto c=0u; c<3u; c++)
+				outTexels[i*4u+c] = core::Float16Compressor::compress(rgb[i*3u+c]);
+			outTexels[i*4u+3u] = core::Float16Compressor::compress(1.f);
+		}
+	});
+	return output;
+}
+
+core::smart_refctd_ptr<ICPUImage> CCPUDenoiserTonemapper::createImage(const E_FORMAT format, const uint32_t width, const uint32_t height)
+{
+	ICPUImage::SCreationParams imgParams;
+	imgParams.flags = static_cast<ICPUImage::E_CREATE_FLAGS>(0u);
+	imgParams.type = ICPUImage::ET_2D;
+	imgParams.format = format;
+	imgParams.extent = {width,height,1u};
+	imgParams.mipLevels = 1u;
+	imgParams.arrayLayers = 1u;
+	imgParams.samples = ICPUImage::ESCF_1_BIT;
+	auto image = ICPUImage::create(std::move(imgParams));
+
+	auto regions = core::make_refctd_dynamic_array<core::smart_refctd_dynamic_array<IImage::SBufferCopy>>(1u);
+	{
+		auto& region = regions->front();
+		region.bufferOffset = 0u;
+		region.bufferRowLength = width;
+		region.bufferImageHeight = height;
+		region.imageSubresource.mipLevel = 0u;
+		region.imageSubresource.baseArrayLayer = 0u;
+		region.imageSubresource.layerCount = 1u;
+		region.imageOffset = {0u,0u,0u};
+		region.imageExtent = {width,height,1u};
+	}
+	auto buffer = core::make_smart_refctd_ptr<ICPUBuffer>(size_t(width)*height*getTexelOrBlockBytesize(format));
+	image->setBufferAndRegions(std::move(buffer),regions);
+	return image;
+}
+
+float CCPUDenoiserTonemapper::meterLumaLog2(const float* rgb, const uint32_t pixelCount)
+{
+	if (pixelCount==0u)
+		return log2(0.18f);
+
+	m_lumaScratch.resize(pixelCount);
+	const float minLumaLog2 = log2(MinLuma);
+	const float maxLumaLog2 = log2(MaxLuma);
+	parallelFor((pixelCount+4095u)/4096u,[&](const uint32_t chunk) -> void
+	{
+		const uint32_t end = core::min((chunk+1u)*4096u,pixelCount);
+		for (uint32_t i=chunk*4096u; i<end; i++)
+		{
+			const float l = luma(rgb+i*3u);
+			// NaNs count as the darkest bin, like in the histogram
+			m_lumaScratch[i] = l>MinLuma ? core::min(log2(l),maxLumaLog2):minLumaLog2;
+		}
+	});
+
+	// exact version of the median mode histogram, average of everything between the percentiles
+	const auto lower = core::min(static_cast<uint32_t>(LowerPercentile*float(pixelCount)),pixelCount-1u);
+	const auto upper = core::max(core::min(static_cast<uint32_t>(UpperPercentile*float(pixelCount)),pixelCount-1u),lower);
+	std::nth_element(m_lumaScratch.begin(),m_lumaScratch.begin()+lower,m_lumaScratch.end());
+	std::nth_element(m_lumaScratch.begin()+lower,m_lumaScratch.begin()+upper,m_lumaScratch.end());
+	const double sum = std::accumulate(m_lumaScratch.begin()+lower,m_lumaScratch.begin()+upper+1u,0.0);
+	return float(sum/double(upper-lower+1u));
+}
+
+void CCPUDenoiserTonemapper::bloom(float* rgb, const uint32_t width, const uint32_t height, const SParams& params)
+{
+	const auto& kerDim = params.bloomPSF->getCreationParameters().extent;
+
+	// same kernel scaling as the GPU path
+	uint32_t kernelWidth,kernelHeight;
+	const float kernelScale = CCPUFFTConvolution::computeKernelExtent(kernelWidth,kernelHeight,width,height,kerDim.width,kerDim.height,params.bloomRelativeScale);
+	const float minKernelScale = 2.f/float(width<height ? kerDim.width:kerDim.height);
+	if (kernelScale>1.f)
+		os::Printer::log("CCPUDenoiserTonemapper: Bloom Kernel loose sharpness, increase resolution of bloom kernel or reduce its relative scale!",ELL_WARNING);
+	else if (kernelScale<minKernelScale)
+		os::Printer::log("CCPUDenoiserTonemapper: Bloom Kernel relative scale pathologically small, clamping to prevent division by 0!",ELL_WARNING);
+
+	// the kernel spectra only need rebuilding when the PSF, its scaled extent or the intensity change
+	const bool kernelChanged = m_bloomPSF.get()!=params.bloomPSF || m_bloomKernelWidth!=kernelWidth || m_bloomKernelHeight!=kernelHeight || m_bloomIntensity!=params.bloomIntensity;
+	if (kernelChanged)
+	{
+		m_bloomPSF = nullptr;
+		if (!decodeRGB(params.bloomPSF,m_psf))
+		{
+			os::Printer::log("CCPUDenoiserTonemapper: bloom PSF has an unsupported layout, skipping bloom!",ELL_WARNING);
+			return;
+		}
+		core::vector<float> kernel(size_t(kernelWidth)*kernelHeight*3u);
+		CCPUFFTConvolution::scaleKernel(kernel.data(),kernelWidth,kernelHeight,m_psf.data(),kerDim.width,kerDim.height);
+		if (!m_bloomConvolution.setKernel(kernel.data(),kernelWidth,kernelHeight,params.bloomIntensity))
+		{
+			os::Printer::log("CCPUDenoiserTonemapper: bloom PSF is black, skipping bloom!",ELL_WARNING);
+			return;
+		}
+		m_bloomPSF = core::smart_refctd_ptr<const ICPUImage>(params.bloomPSF);
+		m_bloomKernelWidth = kernelWidth;
+		m_bloomKernelHeight = kernelHeight;
+		m_bloomIntensity = params.bloomIntensity;
+	}
+
+	m_bloomConvolution.convolve(rgb,width,height);
+}
+
+void CCPUDenoiserTonemapper::tonemap(float* rgb, const uint32_t pixelCount, const STonemapper& tonemapper, const float intensity)
+{
+	// the denoiser intensity already brings middle gray to 0.18, the tonemapper parameters are relative to a key of 1
+	const float optiXIntensityKeyCompensation = -log2(0.18f);
+	float reinhardKeyAndLinearExposure=0.f,reinhardRcpWhite2=0.f;
+	float acesGamma=1.f,acesExposure=0.f;
+	float linearScale = 1.f;
+	switch (tonemapper.op)
+	{
+		case ET_REINHARD:
+			reinhardKeyAndLinearExposure = tonemapper.key*exp2(optiXIntensityKeyCompensation);
+			reinhardRcpWhite2 = 1.f/(tonemapper.extra*tonemapper.extra);
+			break;
+		case ET_ACES:
+			// middle grays get exposed to different values between tonemappers given the same key
+			acesGamma = tonemapper.extra;
+			acesExposure = optiXIntensityKeyCompensation+log2(tonemapper.key*0.77321666f);
+			break;
+		default:
+			linearScale = (core::isnan(tonemapper.key) ? 0.18f:tonemapper.key)*exp2(optiXIntensityKeyCompensation);
+			break;
+	}
+
+	parallelFor((pixelCount+4095u)/4096u,[&](const uint32_t chunk) -> void
+	{
+		const uint32_t end = core::min((chunk+1u)*4096u,pixelCount);
+		for (uint32_t i=chunk*4096u; i<end; i++)
+		{
+			float* color = rgb+i*3u;
+			float xyz[3];
+			mul(sRGBtoXYZ,color,xyz);
+			for (auto c=0u; c<3u; c++)
+				xyz[c] *= intensity;
+			switch (tonemapper.op)
+			{
+				case ET_REINHARD:
+				{
+					const float exposedLuma = xyz[1]*reinhardKeyAndLinearExposure;
+					const float scale = reinhardKeyAndLinearExposure*(1.f+exposedLuma*reinhardRcpWhite2)/(1.f+exposedLuma);
+					for (auto c=0u; c<3u; c++)
+						xyz[c] *= scale;
+					mul(XYZtosRGB,xyz,color);
+					break;
+				}
+				case ET_ACES:
+				{
+					if (xyz[1]>FLT_MIN)
+					{
+						const float scale = exp2(log2(xyz[1])*(acesGamma-1.f)+acesExposure*acesGamma);
+						for (auto c=0u; c<3u; c++)
+							xyz[c] *= scale;
+					}
+					float linear[3],rrt[3];
+					mul(XYZtosRGB,xyz,linear);
+					mul(ACESInput,linear,rrt);
+					for (auto c=0u; c<3u; c++)
+					{
+						const float v = rrt[c];
+						rrt[c] = (v*(v+0.0245786f)-0.000090537f)/(v*(0.983729f*v+0.4329510f)+0.238081f);
+					}
+					mul(ACESOutput,rrt,color);
+					for (auto c=0u; c<3u; c++)
+						color[c] = core::clamp(color[c],0.f,1.f);
+					break;
+				}
+				default:
+					for (auto c=0u; c<3u; c++)
+						xyz[c] *= linearScale;
+					mul(XYZtosRGB,xyz,color);
+					break;
+			}
+		}
+	});
+}
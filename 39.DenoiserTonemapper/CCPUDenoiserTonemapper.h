@@ -0,0 +1,113 @@
+// Copyright (C) 2018-2020 - DevSH Graphics Programming Sp. z O.O.
+// This file is part of the "Nabla Engine".
+// For conditions of distribution and use, see copyright notice in nabla.h
+
+#ifndef _C_CPU_DENOISER_TONEMAPPER_H_INCLUDED_
+#define _C_CPU_DENOISER_TONEMAPPER_H_INCLUDED_
+
+#include "nabla.h"
+
+#include "CCPUFFTConvolution.h"
+
+
+// The post processing chain of the DenoiserTonemapper example as an in-process API working on CPU images, so renderers don't need
+// to write their AOVs to disk and launch the example per image.
+//
+// Same order of operations as the GPU path:
+//	1. luma metering of the noisy color (median mode, 45th to 55th percentile of log2 luma) plus the denoiser exposure bias
+//	2. denoising through `IDenoiser`, only OptiX can do it (`COptiXDenoiser`) so there's no CPU fallback, without one the color passes through untouched
+//	3. luma metering again on the denoised color, this is the autoexposure used for tonemapping
+//	4. bloom, convolving with the PSF scaled relative to the smaller image dimension, see `CCPUFFTConvolution`
+//	5. exposure and tonemapping in CIE XYZ (Reinhard, ACES or none), then conversion to linear sRGB
+// The output is EF_R16G16B16A16_SFLOAT like the example's, `writeOutputs` saves it as EXR, PNG and JPG.
+class CCPUDenoiserTonemapper
+{
+	public:
+		enum E_TONEMAPPER : uint8_t
+		{
+			ET_REINHARD,
+			ET_ACES,
+			ET_NONE
+		};
+		struct STonemapper
+		{
+			E_TONEMAPPER op = ET_ACES;
+			// for ET_NONE a NaN key turns autoexposure off (`NONE=AutoexposureOff`)
+			float key = 0.4f;
+			// white level for ET_REINHARD, gamma/contrast for ET_ACES, ignored for ET_NONE
+			float extra = 0.8f;
+
+			// same syntax as `-TONEMAPPER=` of the example, "REINHARD=key,whiteLevel", "ACES=key,gamma" or "NONE=key"
+			static bool parse(const std::string& str, STonemapper& out);
+		};
+
+		// Denoising is the only step which needs a GPU, implement this to plug it in (the OptiX manager for example).
+		// All buffers are tightly packed RGB triplets, `albedo` and `normal` can be null, normals are already transformed.
+		class IDenoiser
+		{
+			public:
+				virtual ~IDenoiser() = default;
+
+				virtual bool denoise(float* outColor, const float* color, const float* albedo, const float* normal, const uint32_t width, const uint32_t height, const float hdrIntensity, const float blendFactor) = 0;
+		};
+
+		struct SParams
+		{
+			// any non-compressed format, single region, albedo and normal need to match the color extent
+			const nbl::asset::ICPUImage* color = nullptr;
+			const nbl::asset::ICPUImage* albedo = nullptr;
+			const nbl::asset::ICPUImage* normal = nullptr;
+			nbl::core::matrix3x4SIMD normalMatrix = {};
+
+			IDenoiser* denoiser = nullptr;
+			float denoiserExposureBias = 0.f;
+			float denoiserBlendFactor = 0.f;
+
+			// null disables bloom, the kernel spectra are kept while the same PSF image is passed in so don't modify it in between calls
+			const nbl::asset::ICPUImage* bloomPSF = nullptr;
+			float bloomRelativeScale = 0.1f;
+			float bloomIntensity = 0.1f;
+
+			STonemapper tonemapper = {};
+		};
+
+		static inline constexpr float MinLuma = 1.f/4096.f;
+		static inline constexpr float MaxLuma = 32768.f;
+		static inline constexpr float LowerPercentile = 0.45f;
+		static inline constexpr float UpperPercentile = 0.55f;
+
+		// Returns nullptr on invalid input, keeps its scratch memory between calls so reuse the object for sequences of images.
+		nbl::core::smart_refctd_ptr<nbl::asset::ICPUImage> process(const SParams& params);
+
+		// `pathWithoutExtension` + ".exr" as is, + ".png" and ".jpg" converted to EF_R8G8B8_SRGB with the blue noise dither
+		bool writeOutputs(nbl::asset::IAssetManager* assetManager, nbl::asset::ICPUImage* image, const std::string& pathWithoutExtension);
+
+		// The cubemap layout the old ImageMagick scripts used, 3x2 faces: right, left, top in the first row and bottom, front, back in the second.
+		// All faces need the same square extent and format, the result has the same format.
+		static nbl::core::smart_refctd_ptr<nbl::asset::ICPUImage> mergeCubemapFaces(const nbl::asset::ICPUImage* const faces[6]);
+		static nbl::core::smart_refctd_ptr<nbl::asset::ICPUImage> extractCubemapFace(const nbl::asset::ICPUImage* merged, const uint32_t face, const uint32_t borderPixels);
+
+		// tightly packed RGB, ignores alpha
+		static bool decodeRGB(const nbl::asset::ICPUImage* image, nbl::core::vector<float>& out);
+		// EF_R16G16B16A16_SFLOAT images get written as they are, anything else `decodeRGB` takes as EF_R16G16B16A16_SFLOAT with an alpha of 1
+		static bool writeEXR(nbl::asset::IAssetManager* assetManager, const nbl::asset::ICPUImage* image, const std::string& path);
+
+	private:
+		static nbl::core::smart_refctd_ptr<nbl::asset::ICPUImage> createImage(const nbl::asset::E_FORMAT format, const uint32_t width, const uint32_t height);
+		static nbl::core::smart_refctd_ptr<nbl::asset::ICPUImage> encodeRGBA16F(const float* rgb, const uint32_t width, const uint32_t height);
+
+		// mean log2 luma of the pixels between the percentiles, takes sRGB
+		float meterLumaLog2(const float* rgb, const uint32_t pixelCount);
+		void bloom(float* rgb, const uint32_t width, const uint32_t height, const SParams& params);
+		static void tonemap(float* rgb, const uint32_t pixelCount, const STonemapper& tonemapper, const float intensity);
+
+		nbl::core::vector<float> m_color,m_albedo,m_normal,m_denoised,m_psf;
+		nbl::core::vector<float> m_lumaScratch;
+		CCPUFFTConvolution m_bloomConvolution;
+		nbl::core::smart_refctd_ptr<const nbl::asset::ICPUImage> m_bloomPSF;
+		uint32_t m_bloomKernelWidth = 0u, m_bloomKernelHeight = 0u;
+		float m_bloomIntensity = 0.f;
+		nbl::core::smart_refctd_ptr<nbl::asset::ICPUImageView> m_ditherImageView;
+};
+
+#endif
@@ -0,0 +1,296 @@
+// Copyright (C) 2018-2020 - DevSH Graphics Programming Sp. z O.O.
+// This file is part of the "Nabla Engine".
+// For conditions of distribution and use, see copyright notice in nabla.h
+
+#include "CCPUFFTConvolution.h"
+
+#include <numeric>
+#include <algorithm>
+
+using namespace nbl;
+
+
+namespace
+{
+	template<typename F>
+	void parallelFor(const uint32_t count, F&& f)
+	{
+		core::vector<uint32_t> indices(count);
+		std::iota(indices.begin(),indices.end(),0u);
+		std::for_each(core::execution::par_unseq,indices.begin(),indices.end(),std::forward<F>(f));
+	}
+
+	// Y of sRGB to XYZ, what the kernel normalization shader uses for the power
+	inline float luma(const float* rgb)
+	{
+		return 0.2126729f*rgb[0]+0.7151522f*rgb[1]+0.0721750f*rgb[2];
+	}
+
+	// ISampler::ETC_MIRROR
+	inline uint32_t mirror(int32_t x, const int32_t size)
+	{
+		const int32_t period = size*2;
+		x %= period;
+		if (x<0)
+			x += period;
+		return x<size ? x:(period-1-x);
+	}
+
+	// std::complex multiplication checks for NaNs and infinities, which costs more than the whole butterfly
+	inline std::complex<float> cmul(const std::complex<float>& a, const std::complex<float>& b)
+	{
+		return {a.real()*b.real()-a.imag()*b.imag(),a.real()*b.imag()+a.imag()*b.real()};
+	}
+
+	// in-place iterative radix-2, `twiddles` holds the first half of the forward roots of unity
+	void fft1D(std::complex<float>* data, const uint32_t log2Size, const std::complex<float>* twiddles, const bool inverse)
+	{
+		const uint32_t size = 0x1u<<log2Size;
+		for (uint32_t i=1u,j=0u; i<size; i++)
+		{
+			uint32_t bit = size>>1u;
+			for (; j&bit; bit>>=1u)
+				j ^= bit;
+			j ^= bit;
+			if (i<j)
+				std::swap(data[i],data[j]);
+		}
+		for (uint32_t log2Len=1u; log2Len<=log2Size; log2Len++)
+		{
+			const uint32_t half = 0x1u<<(log2Len-1u);
+			const uint32_t twiddleStride = size>>log2Len;
+			for (uint32_t i=0u; i<size; i+=half*2u)
+			for (uint32_t k=0u; k<half; k++)
+			{
+				auto w = twiddles[k*twiddleStride];
+				if (inverse)
+					w = std::conj(w);
+				const auto u = data[i+k];
+				const auto v = cmul(data[i+k+half],w);
+				data[i+k] = u+v;
+				data[i+k+half] = u-v;
+			}
+		}
+	}
+
+	core::vector<std::complex<float>> makeTwiddles(const uint32_t log2Size)
+	{
+		const uint32_t size = 0x1u<<log2Size;
+		core::vector<std::complex<float>> retval(core::max(size>>1u,1u));
+		for (uint32_t k=0u; k<retval.size(); k++)
+		{
+			const double angle = -2.0*core::PI<double>()*double(k)/double(size);
+			retval[k] = {float(cos(angle)),float(sin(angle))};
+		}
+		return retval;
+	}
+}
+
+
+float CCPUFFTConvolution::computeKernelExtent(uint32_t& outWidth, uint32_t& outHeight, const uint32_t imageWidth, const uint32_t imageHeight, const uint32_t psfWidth, const uint32_t psfHeight, const float bloomRelativeScale)
+{
+	const float kernelScale = imageWidth<imageHeight ? (float(imageWidth)*bloomRelativeScale/float(psfWidth)):(float(imageHeight)*bloomRelativeScale/float(psfHeight));
+	outWidth = core::max<uint32_t>(ceil(float(psfWidth)*kernelScale),2u);
+	outHeight = core::max<uint32_t>(ceil(float(psfHeight)*kernelScale),2u);
+	return kernelScale;
+}
+
+void CCPUFFTConvolution::scaleKernel(float* outRGB, const uint32_t width, const uint32_t height, const float* psfRGB, const uint32_t psfWidth, const uint32_t psfHeight)
+{
+	auto fetch = [&](const int32_t x, const int32_t y, const uint32_t c) -> float
+	{
+		if (x<0 || y<0 || x>=int32_t(psfWidth) || y>=int32_t(psfHeight))
+			return 0.f;
+		return psfRGB[(size_t(y)*psfWidth+x)*3u+c];
+	};
+	parallelFor(height,[&](const uint32_t j) -> void
+	{
+		const float v = (float(j)+0.5f)/float(height)*float(psfHeight)-0.5f;
+		const int32_t y = floor(v);
+		const float fy = v-float(y);
+		for (uint32_t i=0u; i<width; i++)
+		{
+			const float u = (float(i)+0.5f)/float(width)*float(psfWidth)-0.5f;
+			const int32_t x = floor(u);
+			const float fx = u-float(x);
+			for (auto c=0u; c<3u; c++)
+			{
+				const float top = core::mix(fetch(x,y,c),fetch(x+1,y,c),fx);
+				const float bottom = core::mix(fetch(x,y+1,c),fetch(x+1,y+1,c),fx);
+				outRGB[(size_t(j)*width+i)*3u+c] = core::mix(top,bottom,fy);
+			}
+		}
+	});
+}
+
+bool CCPUFFTConvolution::setKernel(const float* rgb, const uint32_t width, const uint32_t height, const float intensity)
+{
+	if (width==0u || height==0u)
+		return false;
+
+	double sum[3] = {0.0,0.0,0.0};
+	for (size_t i=0ull; i<size_t(width)*height; i++)
+	for (auto c=0u; c<3u; c++)
+		sum[c] += rgb[i*3u+c];
+	const float sumF[3] = {float(sum[0]),float(sum[1]),float(sum[2])};
+	const float power = luma(sumF);
+	if (!(power>0.f))
+		return false;
+
+	const float factor = intensity/power;
+	m_kernel.resize(size_t(width)*height*3u);
+	std::transform(rgb,rgb+m_kernel.size(),m_kernel.begin(),[factor](const float v){return v*factor;});
+	m_kernelWidth = width;
+	m_kernelHeight = height;
+	m_intensity = intensity;
+	m_spectraWidth = m_spectraHeight = 0u;
+	return true;
+}
+
+bool CCPUFFTConvolution::convolve(float* rgb, const uint32_t width, const uint32_t height)
+{
+	if (m_kernel.empty() || width==0u || height==0u)
+		return false;
+
+	const uint32_t paddedWidth = padDimension(width+m_kernelWidth-1u);
+	const uint32_t paddedHeight = padDimension(height+m_kernelHeight-1u);
+	const uint32_t log2Width = core::findMSB(paddedWidth);
+	const uint32_t log2Height = core::findMSB(paddedHeight);
+	if (paddedWidth!=m_spectraWidth || paddedHeight!=m_spectraHeight)
+		buildKernelSpectra(paddedWidth,paddedHeight);
+
+	const size_t paddedCount = size_t(paddedWidth)*paddedHeight;
+	for (auto& spectrum : m_imageSpectra)
+		spectrum.resize(paddedCount);
+
+	// the image goes in the middle, like the GPU FFT does it
+	const int32_t paddingX = (paddedWidth-width)>>1u;
+	const int32_t paddingY = (paddedHeight-height)>>1u;
+	parallelFor(paddedHeight,[&](const uint32_t y) -> void
+	{
+		const float* srcRow = rgb+size_t(mirror(int32_t(y)-paddingY,height))*width*3u;
+		complex_t* redGreen = m_imageSpectra[0].data()+size_t(y)*paddedWidth;
+		complex_t* blue = m_imageSpectra[1].data()+size_t(y)*paddedWidth;
+		for (uint32_t x=0u; x<paddedWidth; x++)
+		{
+			const float* texel = srcRow+mirror(int32_t(x)-paddingX,width)*3u;
+			redGreen[x] = {texel[0],texel[1]};
+			blue[x] = {texel[2],0.f};
+		}
+	});
+	for (auto& spectrum : m_imageSpectra)
+		fft2D(spectrum.data(),log2Width,log2Height,false);
+
+	// Red and green spectra are the Hermitian and anti-Hermitian parts of the shared one, Z[k] and Z[-k] give both channels at k and -k,
+	// multiplying them by their own kernels and packing back as `R+iG` keeps the inverse transform shared too.
+	parallelFor((paddedHeight>>1u)+1u,[&](const uint32_t y) -> void
+	{
+		const uint32_t negY = (paddedHeight-y)&(paddedHeight-1u);
+		complex_t* row = m_imageSpectra[0].data()+size_t(y)*paddedWidth;
+		complex_t* negRow = m_imageSpectra[0].data()+size_t(negY)*paddedWidth;
+		const complex_t* redKernel = m_kernelSpectra[0].data();
+		const complex_t* greenKernel = m_kernelSpectra[1].data();
+		// only the first half of the self-paired rows, the loop writes both `k` and `-k`
+		const uint32_t endX = y==negY ? ((paddedWidth>>1u)+1u):paddedWidth;
+		for (uint32_t x=0u; x<endX; x++)
+		{
+			const uint32_t negX = (paddedWidth-x)&(paddedWidth-1u);
+			const size_t k = size_t(y)*paddedWidth+x;
+			const size_t negK = size_t(negY)*paddedWidth+negX;
+			const complex_t z = row[x];
+			const complex_t negZ = negRow[negX];
+			auto combine = [](const complex_t& z, const complex_t& negZ, const complex_t& redK, const complex_t& greenK) -> complex_t
+			{
+				const complex_t red = (z+std::conj(negZ))*0.5f;
+				// (z-conj(negZ))/2i
+				const complex_t diff = (z-std::conj(negZ))*0.5f;
+				const complex_t green(diff.imag(),-diff.real());
+				const complex_t redOut = cmul(red,redK);
+				const complex_t greenOut = cmul(green,greenK);
+				return {redOut.real()-greenOut.imag(),redOut.imag()+greenOut.real()};
+			};
+			row[x] = combine(z,negZ,redKernel[k],greenKernel[k]);
+			if (negK!=k)
+				negRow[negX] = combine(negZ,z,redKernel[negK],greenKernel[negK]);
+		}
+	});
+	parallelFor(paddedHeight,[&](const uint32_t y) -> void
+	{
+		complex_t* row = m_imageSpectra[1].data()+size_t(y)*paddedWidth;
+		const complex_t* kernel = m_kernelSpectra[2].data()+size_t(y)*paddedWidth;
+		for (uint32_t x=0u; x<paddedWidth; x++)
+			row[x] = cmul(row[x],kernel[x]);
+	});
+
+	for (auto& spectrum : m_imageSpectra)
+		fft2D(spectrum.data(),log2Width,log2Height,true);
+
+	const float normalization = 1.f/float(paddedCount);
+	parallelFor(height,[&](const uint32_t y) -> void
+	{
+		const size_t offset = size_t(y+paddingY)*paddedWidth+paddingX;
+		const complex_t* redGreen = m_imageSpectra[0].data()+offset;
+		const complex_t* blue = m_imageSpectra[1].data()+offset;
+		float* dstRow = rgb+size_t(y)*width*3u;
+		for (uint32_t x=0u; x<width; x++)
+		{
+			dstRow[x*3u+0u] = redGreen[x].real()*normalization;
+			dstRow[x*3u+1u] = redGreen[x].imag()*normalization;
+			dstRow[x*3u+2u] = blue[x].real()*normalization;
+		}
+	});
+	return true;
+}
+
+void CCPUFFTConvolution::fft2D(complex_t* data, const uint32_t log2Width, const uint32_t log2Height, const bool inverse)
+{
+	const uint32_t width = 0x1u<<log2Width;
+	const uint32_t height = 0x1u<<log2Height;
+
+	const auto rowTwiddles = makeTwiddles(log2Width);
+	parallelFor(height,[&](const uint32_t y) -> void
+	{
+		fft1D(data+size_t(y)*width,log2Width,rowTwiddles.data(),inverse);
+	});
+
+	// columns get gathered in small batches so every row of the image is read in cachelines, not single elements
+	constexpr uint32_t MaxColumnsPerBatch = 16u;
+	const uint32_t columnsPerBatch = core::min(MaxColumnsPerBatch,width);
+	const auto columnTwiddles = makeTwiddles(log2Height);
+	parallelFor(width/columnsPerBatch,[&](const uint32_t batch) -> void
+	{
+		core::vector<complex_t> columns(size_t(columnsPerBatch)*height);
+		const uint32_t firstColumn = batch*columnsPerBatch;
+		for (uint32_t y=0u; y<height; y++)
+		for (uint32_t c=0u; c<columnsPerBatch; c++)
+			columns[size_t(c)*height+y] = data[size_t(y)*width+firstColumn+c];
+		for (uint32_t c=0u; c<columnsPerBatch; c++)
+			fft1D(columns.data()+size_t(c)*height,log2Height,columnTwiddles.data(),inverse);
+		for (uint32_t y=0u; y<height; y++)
+		for (uint32_t c=0u; c<columnsPerBatch; c++)
+			data[size_t(y)*width+firstColumn+c] = columns[size_t(c)*height+y];
+	});
+}
+
+void CCPUFFTConvolution::buildKernelSpectra(const uint32_t paddedWidth, const uint32_t paddedHeight)
+{
+	const uint32_t log2Width = core::findMSB(paddedWidth);
+	const uint32_t log2Height = core::findMSB(paddedHeight);
+	for (auto c=0u; c<3u; c++)
+	{
+		auto& spectrum = m_kernelSpectra[c];
+		spectrum.assign(size_t(paddedWidth)*paddedHeight,complex_t(0.f,0.f));
+		// centered on the origin, padded size is always at least as big as the kernel so nothing overlaps
+		for (uint32_t j=0u; j<m_kernelHeight; j++)
+		for (uint32_t i=0u; i<m_kernelWidth; i++)
+		{
+			const uint32_t x = (i-(m_kernelWidth>>1u))&(paddedWidth-1u);
+			const uint32_t y = (j-(m_kernelHeight>>1u))&(paddedHeight-1u);
+			spectrum[size_t(y)*paddedWidth+x] = m_kernel[(size_t(j)*m_kernelWidth+i)*3u+c];
+		}
+		spectrum[0] += 1.f-m_intensity;
+		fft2D(spectrum.data(),log2Width,log2Height,false);
+	}
+	m_spectraWidth = paddedWidth;
+	m_spectraHeight = paddedHeight;
+}
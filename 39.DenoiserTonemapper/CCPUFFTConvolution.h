@@ -0,0 +1,61 @@
+// Copyright (C) 2018-2020 - DevSH Graphics Programming Sp. z O.O.
+// This file is part of the "Nabla Engine".
+// For conditions of distribution and use, see copyright notice in nabla.h
+
+#ifndef _C_CPU_FFT_CONVOLUTION_H_INCLUDED_
+#define _C_CPU_FFT_CONVOLUTION_H_INCLUDED_
+
+#include "nabla.h"
+
+#include <complex>
+
+
+// Multithreaded CPU version of the bloom convolution which 39.DenoiserTonemapper and 49.ComputeFFT do with `ext::FFT`, for machines
+// without a GPU and as a reference for the GPU results.
+//
+// Same semantics as the GPU path:
+//	- the kernel is a PSF resampled relative to the image size, centered on texel (width/2,height/2)
+//	- it gets normalized by the luminance of its DC term (the sum of all texels) and blended with a dirac delta by the bloom intensity
+//	- the image is mirror padded (ETC_MIRROR) to the next power of two of `imageExtent+kernelExtent-1` so nothing wraps around
+// The only intended difference is that the kernel spectrum is computed at the padded image size instead of being interpolated from
+// a spectrum at the kernel's own padded size, so the result matches a direct spatial convolution to float precision.
+//
+// All images are tightly packed RGB float triplets.
+class CCPUFFTConvolution
+{
+	public:
+		using complex_t = std::complex<float>;
+
+		// same as `ext::FFT::FFT::padDimensions`
+		static inline uint32_t padDimension(const uint32_t dim) {return nbl::core::roundUpToPoT(dim);}
+
+		// How 39.DenoiserTonemapper scales the PSF so it spans `bloomRelativeScale` of the smaller image dimension.
+		// Returns the unclamped scale so callers can warn about loss of sharpness (>1) or clamping (<2/psfDim).
+		static float computeKernelExtent(uint32_t& outWidth, uint32_t& outHeight, const uint32_t imageWidth, const uint32_t imageHeight, const uint32_t psfWidth, const uint32_t psfHeight, const float bloomRelativeScale);
+
+		// Bilinear samples of the PSF at the texel centers of the new extent with a black border, like the GPU kernel sampler.
+		static void scaleKernel(float* outRGB, const uint32_t width, const uint32_t height, const float* psfRGB, const uint32_t psfWidth, const uint32_t psfHeight);
+
+		// `intensity*K/luma(sum(K))+(1-intensity)*delta`, returns false and keeps the old kernel if `K` has no luminance.
+		bool setKernel(const float* rgb, const uint32_t width, const uint32_t height, const float intensity=1.f);
+
+		// In-place, needs a kernel. The kernel spectra are cached between calls with the same padded extent.
+		bool convolve(float* rgb, const uint32_t width, const uint32_t height);
+
+		// Unnormalized in both directions, `data` is row-major `(1<<log2Width)*(1<<log2Height)`.
+		static void fft2D(complex_t* data, const uint32_t log2Width, const uint32_t log2Height, const bool inverse);
+
+	private:
+		void buildKernelSpectra(const uint32_t paddedWidth, const uint32_t paddedHeight);
+
+		nbl::core::vector<float> m_kernel;
+		uint32_t m_kernelWidth = 0u, m_kernelHeight = 0u;
+		float m_intensity = 1.f;
+
+		uint32_t m_spectraWidth = 0u, m_spectraHeight = 0u;
+		nbl::core::vector<complex_t> m_kernelSpectra[3];
+		// red and green share one complex FFT, blue gets the other
+		nbl::core::vector<complex_t> m_imageSpectra[2];
+};
+
+#endif
@@ -0,0 +1,196 @@
+// Copyright (C) 2018-2020 - DevSH Graphics Programming Sp. z O.O.
+// This file is part of the "Nabla Engine".
+// For conditions of distribution and use, see copyright notice in nabla.h
+
+#include "COptiXDenoiser.h"
+
+#include <chrono>
+
+using namespace nbl;
+using namespace asset;
+using namespace video;
+
+
+namespace
+{
+	constexpr uint32_t PixelStride = sizeof(float)*3u;
+	constexpr uint32_t DenoiseTileDims[] = {COptiXDenoiser::TileWidth,COptiXDenoiser::TileHeight};
+	constexpr uint32_t DenoiseTileDimsWithOverlap[] = {COptiXDenoiser::TileWidth+COptiXDenoiser::Overlap*2u,COptiXDenoiser::TileHeight+COptiXDenoiser::Overlap*2u};
+	constexpr size_t IntensityValuesSize = sizeof(float);
+}
+
+core::smart_refctd_ptr<COptiXDenoiser> COptiXDenoiser::create(IVideoDriver* driver, io::IFileSystem* filesystem)
+{
+	auto manager = ext::OptiX::Manager::create(driver,filesystem);
+	if (!manager)
+		return nullptr;
+	auto context = manager->createContext(0u);
+	if (!context)
+		return nullptr;
+
+	auto retval = core::smart_refctd_ptr<COptiXDenoiser>(new COptiXDenoiser(driver,std::move(manager),std::move(context)),core::dont_grab);
+	retval->m_stream = retval->m_manager->getDeviceStream(0u);
+	if (!retval->m_stream || !retval->createBuffers())
+		return nullptr;
+	return retval;
+}
+
+bool COptiXDenoiser::createBuffers()
+{
+	constexpr OptixDenoiserInputKind inputKinds[EI_COUNT] = {OPTIX_DENOISER_INPUT_RGB,OPTIX_DENOISER_INPUT_RGB_ALBEDO,OPTIX_DENOISER_INPUT_RGB_ALBEDO_NORMAL};
+	size_t stateBufferSize = 0u;
+	size_t scratchBufferSize = 0u;
+	for (uint32_t i=0u; i<EI_COUNT; i++)
+	{
+		OptixDenoiserOptions opts = {inputKinds[i]};
+		auto& denoiser = m_denoisers[i];
+		denoiser.denoiser = m_context->createDenoiser(&opts);
+		if (!denoiser.denoiser)
+		{
+			os::Printer::log("COptiXDenoiser: Could not create the OptiX denoiser!",ELL_ERROR);
+			return false;
+		}
+
+		OptixDenoiserSizes memReqs;
+		if (denoiser.denoiser->computeMemoryResources(&memReqs,DenoiseTileDims)!=OPTIX_SUCCESS)
+		{
+			os::Printer::log("COptiXDenoiser: Failed to compute the denoiser memory requirements!",ELL_ERROR);
+			return false;
+		}
+		denoiser.stateOffset = stateBufferSize;
+		stateBufferSize += denoiser.stateSize = memReqs.stateSizeInBytes;
+		scratchBufferSize = core::max(scratchBufferSize,denoiser.scratchSize = memReqs.withOverlapScratchSizeInBytes);
+	}
+	m_intensityOffset = stateBufferSize;
+
+	m_buffers[EB_STATE] = m_driver->createDeviceLocalGPUBufferOnDedMem(stateBufferSize+IntensityValuesSize);
+	m_buffers[EB_SCRATCH] = m_driver->createDeviceLocalGPUBufferOnDedMem(scratchBufferSize);
+	for (auto i : {EB_STATE,EB_SCRATCH})
+	{
+		if (!cuda::CCUDAHandler::defaultHandleResult(cuda::CCUDAHandler::registerBuffer(m_buffers+i)))
+		{
+			os::Printer::log("COptiXDenoiser: Could not register the denoiser buffers with CUDA!",ELL_ERROR);
+			return false;
+		}
+	}
+	return true;
+}
+
+bool COptiXDenoiser::reservePixelBuffer(const size_t size)
+{
+	if (m_buffers[EB_PIXELS].getObject() && m_buffers[EB_PIXELS].getObject()->getSize()>=size)
+		return true;
+
+	m_buffers[EB_PIXELS] = m_driver->createDeviceLocalGPUBufferOnDedMem(size);
+	if (!cuda::CCUDAHandler::defaultHandleResult(cuda::CCUDAHandler::registerBuffer(m_buffers+EB_PIXELS)))
+	{
+		os::Printer::log("COptiXDenoiser: Could not register the pixel buffer with CUDA!",ELL_ERROR);
+		m_buffers[EB_PIXELS] = buffer_link_t();
+		return false;
+	}
+	return true;
+}
+
+bool COptiXDenoiser::denoise(float* outColor, const float* color, const float* albedo, const float* normal, const uint32_t width, const uint32_t height, const float hdrIntensity, const float blendFactor)
+{
+	// OptiX only takes normals together with the albedo
+	const E_INPUT inputKind = albedo ? (normal ? EI_NORMAL:EI_ALBEDO):EI_COLOR;
+	const float* inputs[EI_COUNT] = {color,albedo,normal};
+	const uint32_t inputCount = inputKind+1u;
+
+	const size_t imageSize = size_t(width)*height*PixelStride;
+	// the output goes after the inputs
+	const size_t outputOffset = imageSize*inputCount;
+	if (!reservePixelBuffer(outputOffset+imageSize))
+		return false;
+	auto* pixelBuffer = m_buffers[EB_PIXELS].getObject();
+	for (uint32_t i=0u; i<inputCount; i++)
+		m_driver->updateBufferRangeViaStagingBuffer(pixelBuffer,imageSize*i,imageSize,inputs[i]);
+	m_driver->updateBufferRangeViaStagingBuffer(m_buffers[EB_STATE].getObject(),m_intensityOffset,IntensityValuesSize,&hdrIntensity);
+
+	if (!cuda::CCUDAHandler::defaultHandleResult(cuda::CCUDAHandler::acquireAndGetPointers(m_buffers,m_buffers+EB_COUNT,m_stream)))
+	{
+		os::Printer::log("COptiXDenoiser: Error when mapping OpenGL Buffers to CUdeviceptr!",ELL_ERROR);
+		return false;
+	}
+	bool success = [&]() -> bool
+	{
+		auto& denoiser = m_denoisers[inputKind];
+		auto& state = m_buffers[EB_STATE];
+		auto& scratch = m_buffers[EB_SCRATCH];
+		if (denoiser.denoiser->setup(m_stream,DenoiseTileDimsWithOverlap,state,denoiser.stateSize,scratch,denoiser.scratchSize,denoiser.stateOffset)!=OPTIX_SUCCESS)
+		{
+			os::Printer::log("COptiXDenoiser: Could not setup the denoiser for the image resolution and denoiser buffers!",ELL_ERROR);
+			return false;
+		}
+
+		OptixDenoiserParams denoiserParams = {};
+		denoiserParams.blendFactor = blendFactor;
+		denoiserParams.denoiseAlpha = 0u;
+		denoiserParams.hdrIntensity = state.asBuffer.pointer+m_intensityOffset;
+
+		auto fillImage = [&](OptixImage2D& image, const size_t offset) -> void
+		{
+			image.data = m_buffers[EB_PIXELS].asBuffer.pointer+offset;
+			image.width = width;
+			image.height = height;
+			image.rowStrideInBytes = width*PixelStride;
+			image.format = OPTIX_PIXEL_FORMAT_FLOAT3;
+			image.pixelStrideInBytes = PixelStride;
+		};
+		OptixImage2D denoiserInputs[EI_COUNT];
+		for (uint32_t i=0u; i<inputCount; i++)
+			fillImage(denoiserInputs[i],imageSize*i);
+		OptixImage2D denoiserOutput;
+		fillImage(denoiserOutput,outputOffset);
+
+		if (denoiser.denoiser->tileAndInvoke(m_stream,&denoiserParams,denoiserInputs,inputCount,&denoiserOutput,scratch,denoiser.scratchSize,Overlap,TileWidth,TileHeight)!=OPTIX_SUCCESS)
+		{
+			os::Printer::log("COptiXDenoiser: Could not invoke the denoiser successfully!",ELL_ERROR);
+			return false;
+		}
+		return true;
+	}();
+
+	void* scratch[EB_COUNT*sizeof(CUgraphicsResource)];
+	if (!cuda::CCUDAHandler::defaultHandleResult(cuda::CCUDAHandler::releaseResourcesToGraphics(scratch,m_buffers,m_buffers+EB_COUNT,m_stream)))
+	{
+		os::Printer::log("COptiXDenoiser: Error when unmapping CUdeviceptr back to OpenGL!",ELL_ERROR);
+		return false;
+	}
+	return success && downloadPixels(outColor,outputOffset,imageSize);
+}
+
+// same as the screenshot downloads, through the default streaming buffer and a fence
+bool COptiXDenoiser::downloadPixels(float* dst, const size_t offset, const size_t size)
+{
+	auto downloadStagingArea = m_driver->getDefaultDownStreamingBuffer();
+	uint32_t address = std::remove_pointer<decltype(downloadStagingArea)>::type::invalid_address;
+	const uint32_t bytesize = static_cast<uint32_t>(size);
+	constexpr uint64_t timeoutInNanoSeconds = 300000000000u;
+	{
+		const auto waitPoint = std::chrono::high_resolution_clock::now()+std::chrono::nanoseconds(timeoutInNanoSeconds);
+		const uint32_t alignment = 4096u; // common page size
+		if (downloadStagingArea->multi_alloc(waitPoint,1u,&address,&bytesize,&alignment))
+		{
+			os::Printer::log("COptiXDenoiser: Could not allocate the staging memory to download the denoised image!",ELL_ERROR);
+			return false;
+		}
+	}
+
+	m_driver->copyBuffer(m_buffers[EB_PIXELS].getObject(),downloadStagingArea->getBuffer(),offset,address,size);
+	auto downloadFence = m_driver->placeFence(true);
+	auto result = downloadFence->waitCPU(timeoutInNanoSeconds,true);
+	if (result==E_DRIVER_FENCE_RETVAL::EDFR_TIMEOUT_EXPIRED||result==E_DRIVER_FENCE_RETVAL::EDFR_FAIL)
+	{
+		os::Printer::log("COptiXDenoiser: Could not download the denoised image, fence not signalled!",ELL_ERROR);
+		downloadStagingArea->multi_free(1u,&address,&bytesize,nullptr);
+		return false;
+	}
+	if (downloadStagingArea->needsManualFlushOrInvalidate())
+		m_driver->invalidateMappedMemoryRanges({{downloadStagingArea->getBuffer()->getBoundMemory(),address,bytesize}});
+
+	memcpy(dst,reinterpret_cast<const uint8_t*>(downloadStagingArea->getBufferPointer())+address,size);
+	downloadStagingArea->multi_free(1u,&address,&bytesize,nullptr);
+	return true;
+}
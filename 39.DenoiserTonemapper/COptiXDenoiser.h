@@ -0,0 +1,72 @@
+// Copyright (C) 2018-2020 - DevSH Graphics Programming Sp. z O.O.
+// This file is part of the "Nabla Engine".
+// For conditions of distribution and use, see copyright notice in nabla.h
+
+#ifndef _C_OPTIX_DENOISER_H_INCLUDED_
+#define _C_OPTIX_DENOISER_H_INCLUDED_
+
+#include "nabla.h"
+
+#include "nbl/ext/OptiX/Manager.h"
+
+#include "CCPUDenoiserTonemapper.h"
+
+
+// The OptiX denoisers of the DenoiserTonemapper example behind `CCPUDenoiserTonemapper::IDenoiser`, for renderers which post process
+// their screenshots on the CPU but still want them denoised like the example does.
+// The triplets get uploaded as OPTIX_PIXEL_FORMAT_FLOAT3, denoised with the example's tiling and overlap, and downloaded again. The pixel
+// buffer only ever grows, so keep the object around for sequences of images.
+class COptiXDenoiser : public nbl::core::IReferenceCounted, public CCPUDenoiserTonemapper::IDenoiser
+{
+	public:
+		static inline constexpr uint32_t Overlap = 64u;
+		static inline constexpr uint32_t TileWidth = 1024u;
+		static inline constexpr uint32_t TileHeight = 1024u;
+
+		// nullptr if there's no CUDA capable device or OptiX fails to initialize
+		static nbl::core::smart_refctd_ptr<COptiXDenoiser> create(nbl::video::IVideoDriver* driver, nbl::io::IFileSystem* filesystem);
+
+		bool denoise(float* outColor, const float* color, const float* albedo, const float* normal, const uint32_t width, const uint32_t height, const float hdrIntensity, const float blendFactor) override;
+
+	private:
+		enum E_INPUT : uint32_t
+		{
+			EI_COLOR,
+			EI_ALBEDO,
+			EI_NORMAL,
+			EI_COUNT
+		};
+		// the inputs and the output share the pixel buffer, the intensity goes right after the denoiser states
+		enum E_BUFFER : uint32_t
+		{
+			EB_STATE,
+			EB_SCRATCH,
+			EB_PIXELS,
+			EB_COUNT
+		};
+		struct SDenoiser
+		{
+			nbl::core::smart_refctd_ptr<nbl::ext::OptiX::IDenoiser> denoiser;
+			size_t stateOffset = 0u;
+			size_t stateSize = 0u;
+			size_t scratchSize = 0u;
+		};
+		using buffer_link_t = nbl::cuda::CCUDAHandler::GraphicsAPIObjLink<nbl::video::IGPUBuffer>;
+
+		COptiXDenoiser(nbl::video::IVideoDriver* _driver, nbl::core::smart_refctd_ptr<nbl::ext::OptiX::Manager>&& _manager, nbl::core::smart_refctd_ptr<nbl::ext::OptiX::IContext>&& _context)
+			: m_driver(_driver), m_manager(std::move(_manager)), m_context(std::move(_context)) {}
+
+		bool createBuffers();
+		bool reservePixelBuffer(const size_t size);
+		bool downloadPixels(float* dst, const size_t offset, const size_t size);
+
+		nbl::video::IVideoDriver* m_driver;
+		nbl::core::smart_refctd_ptr<nbl::ext::OptiX::Manager> m_manager;
+		nbl::core::smart_refctd_ptr<nbl::ext::OptiX::IContext> m_context;
+		CUstream m_stream = nullptr;
+		SDenoiser m_denoisers[EI_COUNT];
+		size_t m_intensityOffset = 0u;
+		buffer_link_t m_buffers[EB_COUNT];
+};
+
+#endif
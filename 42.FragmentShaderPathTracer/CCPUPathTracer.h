@@ -0,0 +1,901 @@
+#ifndef _C_CPU_PATH_TRACER_INCLUDED_
+#define _C_CPU_PATH_TRACER_INCLUDED_
+
+#include "nabla.h"
+
+#include <cfloat>
+#include <bit>
+#include <cmath>
+#include <numeric>
+#include <algorithm>
+
+
+// Multithreaded CPU version of 42.FragmentShaderPathTracer's compute shaders, for golden images to check shader changes against on machines
+// without a GPU, and for comparing the light sampling techniques.
+//
+// Renders the same scene (`common.glsl` plus one of the `litBy*.comp`, keep them in sync) with the same BSDFs, light sampling, thresholds and
+// Gaussian reconstruction filter, from the same Owen scrambled sample sequence and per pixel xoroshiro scrambles, so with the default seeds
+// and the shader's resolution every sample sees the same random numbers as on the GPU.
+// Paths are as long as `maxPathLength` surface hits. At 1, which is what the shaders do right now, the first hit only does next event
+// estimation. Longer paths weigh next event estimation and BSDF sampling with the power heuristic, and do next event estimation at every hit.
+// Only the area and solid angle light sampling exists, not the approximate projected solid angle one.
+//
+// Samples accumulate over calls to `render`, so the image can be looked at after every power of two samples without starting over.
+class CCPUPathTracer : public nbl::core::IReferenceCounted
+{
+	public:
+		enum E_LIGHT_GEOMETRY : uint8_t
+		{
+			ELG_SPHERE,
+			ELG_TRIANGLE,
+			ELG_RECTANGLE,
+			ELG_COUNT
+		};
+		// the shaders' `POLYGON_METHOD`, the sphere always gets its cone of directions sampled
+		enum E_POLYGON_METHOD : uint8_t
+		{
+			EPM_AREA,
+			EPM_SOLID_ANGLE,
+			EPM_COUNT
+		};
+
+		// the shaders' `MAX_DEPTH_LOG2`, every hit takes two proto dimensions of 3 samples and the camera ray the first one
+		static inline constexpr uint32_t MaxDepthLog2 = 4u;
+		static inline constexpr uint32_t Dimensions = 3u<<MaxDepthLog2;
+		static inline constexpr uint32_t MaxPathLength = ((1u<<MaxDepthLog2)-2u)/2u;
+
+		struct SParams
+		{
+			uint32_t width = 1280u;
+			uint32_t height = 720u;
+			// inverse of the camera's view projection, camera rays start on the near plane like in the shaders
+			nbl::core::matrix4SIMD invMVP = {};
+			E_LIGHT_GEOMETRY lightGeometry = ELG_SPHERE;
+			E_POLYGON_METHOD polygonMethod = EPM_SOLID_ANGLE;
+			// surface hits per path, at most `MaxPathLength`
+			uint32_t maxPathLength = 1u;
+			// the shaders' `MAX_SAMPLES_LOG2`, how many samples per pixel there can be at most
+			uint32_t maxSamplesLog2 = 10u;
+			// these two are the ones 42.FragmentShaderPathTracer uses, change them to get an independent reference
+			uint32_t sequenceSeed = 0xdeadbeefu;
+			uint32_t scrambleSeed = 0xbadc0ffeu;
+		};
+
+		// returns nullptr on invalid params, generates the sample sequence so it's not cheap for many samples
+		static inline nbl::core::smart_refctd_ptr<CCPUPathTracer> create(const SParams& params)
+		{
+			if (params.width==0u || params.height==0u || params.lightGeometry>=ELG_COUNT || params.polygonMethod>=EPM_COUNT)
+				return nullptr;
+			if (params.maxPathLength==0u || params.maxPathLength>MaxPathLength || params.maxSamplesLog2>(32u-MaxDepthLog2))
+				return nullptr;
+			return nbl::core::smart_refctd_ptr<CCPUPathTracer>(new CCPUPathTracer(params),nbl::core::dont_grab);
+		}
+
+		// Renders the next `sampleCount` samples of every pixel, returns how many there were before running out of the sequence.
+		uint32_t render(uint32_t sampleCount)
+		{
+			sampleCount = std::min(sampleCount,getMaxSampleCount()-samples);
+			if (sampleCount==0u)
+				return 0u;
+			parallelFor(params.height,[&](const uint32_t y) -> void
+			{
+				for (uint32_t x=0u; x<params.width; x++)
+					renderPixel(x,y,samples,samples+sampleCount);
+			});
+			samples += sampleCount;
+			return sampleCount;
+		}
+		inline void reset()
+		{
+			std::fill(color.begin(),color.end(),0.f);
+			std::fill(meanLumaSquared.begin(),meanLumaSquared.end(),0.f);
+			samples = 0u;
+		}
+
+		inline const SParams& getParams() const {return params;}
+		inline uint32_t getSampleCount() const {return samples;}
+		inline uint32_t getMaxSampleCount() const {return 0x1u<<params.maxSamplesLog2;}
+		// mean of the samples so far, tightly packed RGB
+		inline const float* getColor() const {return color.data();}
+
+		// Variance of a single sample's luma, averaged over the pixels, the variance of the whole image is this divided by the sample count.
+		// With the sequence being low discrepancy that's only an upper bound, the error against a reference says how much there actually is.
+		double getLumaVariance() const
+		{
+			if (samples<2u)
+				return 0.0;
+			double retval = 0.0;
+			for (size_t i=0u; i<meanLumaSquared.size(); i++)
+			{
+				const float luma = getLuma(float3(color.data()+i*3u));
+				retval += std::max(meanLumaSquared[i]-luma*luma,0.f);
+			}
+			return retval*double(samples)/(double(samples-1u)*meanLumaSquared.size());
+		}
+
+		// EF_R32G32B32A32_SFLOAT with alpha 1, ready to write as EXR
+		nbl::core::smart_refctd_ptr<nbl::asset::ICPUImage> createImage() const
+		{
+			using namespace nbl::asset;
+			ICPUImage::SCreationParams imgParams;
+			imgParams.flags = static_cast<ICPUImage::E_CREATE_FLAGS>(0u);
+			imgParams.type = ICPUImage::ET_2D;
+			imgParams.format = EF_R32G32B32A32_SFLOAT;
+			imgParams.extent = {params.width,params.height,1u};
+			imgParams.mipLevels = 1u;
+			imgParams.arrayLayers = 1u;
+			imgParams.samples = ICPUImage::ESCF_1_BIT;
+			auto image = ICPUImage::create(std::move(imgParams));
+
+			auto regions = nbl::core::make_refctd_dynamic_array<nbl::core::smart_refctd_dynamic_array<IImage::SBufferCopy>>(1u);
+			{
+				auto& region = regions->front();
+				region.bufferOffset = 0u;
+				region.bufferRowLength = params.width;
+				region.bufferImageHeight = params.height;
+				region.imageSubresource.mipLevel = 0u;
+				region.imageSubresource.baseArrayLayer = 0u;
+				region.imageSubresource.layerCount = 1u;
+				region.imageOffset = {0u,0u,0u};
+				region.imageExtent = {params.width,params.height,1u};
+			}
+			const size_t pixelCount = size_t(params.width)*params.height;
+			auto buffer = nbl::core::make_smart_refctd_ptr<ICPUBuffer>(pixelCount*4u*sizeof(float));
+			auto* texels = reinterpret_cast<float*>(buffer->getPointer());
+			for (size_t i=0u; i<pixelCount; i++)
+			{
+				std::copy_n(color.data()+i*3u,3u,texels+i*4u);
+				texels[i*4u+3u] = 1.f;
+			}
+			image->setBufferAndRegions(std::move(buffer),regions);
+			return image;
+		}
+
+	private:
+		struct float3
+		{
+			float x, y, z;
+
+			float3() = default;
+			constexpr float3(const float _x, const float _y, const float _z) : x(_x), y(_y), z(_z) {}
+			explicit constexpr float3(const float s) : x(s), y(s), z(s) {}
+			explicit float3(const float* v) : x(v[0]), y(v[1]), z(v[2]) {}
+
+			inline float3 operator-() const {return {-x,-y,-z};}
+			inline float3 operator+(const float3& o) const {return {x+o.x,y+o.y,z+o.z};}
+			inline float3 operator-(const float3& o) const {return {x-o.x,y-o.y,z-o.z};}
+			inline float3 operator*(const float3& o) const {return {x*o.x,y*o.y,z*o.z};}
+			inline float3 operator*(const float s) const {return {x*s,y*s,z*s};}
+			inline float3 operator/(const float s) const {return {x/s,y/s,z/s};}
+			inline float3& operator+=(const float3& o) {return *this = *this+o;}
+			inline float3& operator*=(const float3& o) {return *this = *this*o;}
+			inline float3& operator*=(const float s) {return *this = *this*s;}
+		};
+		static inline float dot(const float3& a, const float3& b) {return a.x*b.x+a.y*b.y+a.z*b.z;}
+		static inline float3 cross(const float3& a, const float3& b) {return {a.y*b.z-a.z*b.y,a.z*b.x-a.x*b.z,a.x*b.y-a.y*b.x};}
+		static inline float3 normalize(const float3& v) {return v/std::sqrt(dot(v,v));}
+
+		static inline constexpr float Pi = 3.14159265358979323846f;
+		static inline constexpr uint16_t InvalidID = 0xffffu;
+		// `INTERSECTION_ERROR_BOUND_LOG2`, rays start this far along their direction (scaled by the distance for shadow rays)
+		static inline const float StartTolerance = std::exp2(-8.f);
+		static inline const float EndTolerance = 1.f-std::exp2(-7.f);
+		// smallest perceptible contribution, the luma of the sRGB EOTF of 1/255
+		static inline constexpr float LumaContributionThreshold = 1.f/(255.f*12.92f);
+		static inline constexpr float BSDFPdfThreshold = 0.0001f;
+
+		struct SSphere
+		{
+			float3 position;
+			float radius2;
+			uint16_t bsdfID;
+			uint16_t lightID;
+		};
+		struct SPolygon
+		{
+			// the triangle's first vertex or the rectangle's corner
+			float3 offset;
+			float3 edge0;
+			float3 edge1;
+		};
+		enum E_BSDF_TYPE : uint8_t
+		{
+			EBT_DIFFUSE,
+			EBT_CONDUCTOR,
+			EBT_DIELECTRIC
+		};
+		struct SBSDF
+		{
+			E_BSDF_TYPE type;
+			// albedo for diffuse
+			float3 realEta;
+			float3 imaginaryEta;
+			float roughness;
+		};
+		// view dependent shading frame, the normal is the geometric one and doesn't get flipped towards the viewer
+		struct SInteraction
+		{
+			float3 N, T, B;
+			float3 V;
+			float NdotV;
+		};
+
+		static inline const SSphere Spheres[] = {
+			{{0.f,-100.5f,-1.f},100.f*100.f,0u,InvalidID},
+			{{2.f,0.f,-1.f},0.25f,1u,InvalidID},
+			{{0.f,0.f,-1.f},0.25f,2u,InvalidID},
+			{{-2.f,0.f,-1.f},0.25f,3u,InvalidID},
+			{{2.f,0.f,1.f},0.25f,4u,InvalidID},
+			{{0.f,0.f,1.f},0.25f,4u,InvalidID},
+			{{-2.f,0.f,1.f},0.25f,5u,InvalidID},
+			{{0.5f,1.f,0.5f},0.25f,6u,InvalidID},
+			// only there when the sphere is the light
+			{{-1.5f,1.5f,0.f},0.09f,InvalidID,0u}
+		};
+		static inline const SBSDF BSDFs[] = {
+			{EBT_DIFFUSE,{0.8f,0.8f,0.8f},{0.f,0.f,0.f},0.f},
+			{EBT_DIFFUSE,{0.8f,0.4f,0.4f},{0.f,0.f,0.f},0.f},
+			{EBT_DIFFUSE,{0.4f,0.8f,0.4f},{0.f,0.f,0.f},0.f},
+			{EBT_CONDUCTOR,{1.02f,1.02f,1.3f},{1.f,1.f,2.f},0.f},
+			{EBT_CONDUCTOR,{1.02f,1.3f,1.02f},{1.f,2.f,1.f},0.f},
+			{EBT_CONDUCTOR,{1.02f,1.3f,1.02f},{1.f,2.f,1.f},0.15f},
+			{EBT_DIELECTRIC,{1.4f,1.45f,1.5f},{0.f,0.f,0.f},0.0625f}
+		};
+		static inline const float3 LightRadiance = {30.f,25.f,15.f};
+		static inline const float3 EnvironmentRadiance = {0.15f,0.21f,0.3f};
+
+		CCPUPathTracer(const SParams& _params) : params(_params)
+		{
+			const size_t pixelCount = size_t(params.width)*params.height;
+			color.resize(pixelCount*3u,0.f);
+			meanLumaSquared.resize(pixelCount,0.f);
+
+			// laid out like the shaders' texel buffer, all dimensions of a sample next to each other
+			const uint32_t sampleCount = getMaxSampleCount();
+			sequence.resize(size_t(sampleCount)*Dimensions);
+			nbl::core::OwenSampler sampler(Dimensions,params.sequenceSeed);
+			for (auto dim=0u; dim<Dimensions; dim++)
+			for (uint32_t i=0u; i<sampleCount; i++)
+				sequence[size_t(i)*Dimensions+dim] = sampler.sample(dim,i);
+
+			scrambles.resize(pixelCount*2u);
+			nbl::core::RandomSampler rng(params.scrambleSeed);
+			for (auto& scramble : scrambles)
+				scramble = rng.nextSample();
+
+			const float* invMVP = params.invMVP.pointer();
+			std::copy_n(invMVP,16u,unproject);
+
+			const bool sphereLight = params.lightGeometry==ELG_SPHERE;
+			sphereCount = std::size(Spheres)-(sphereLight ? 0u:1u);
+			if (params.lightGeometry==ELG_TRIANGLE)
+				light = {float3(-18.f,3.5f,3.f),float3(6.f,0.f,-3.f),float3(3.f,4.5f,-6.f)};
+			else if (params.lightGeometry==ELG_RECTANGLE)
+			{
+				const float3 offset(-3.8f,0.35f,1.3f);
+				light = {offset,normalize(float3(2.f,0.f,-1.f))*7.f,normalize(float3(2.f,-5.f,4.f))*0.1f};
+			}
+		}
+
+		template<typename F>
+		static inline void parallelFor(const uint32_t count, F&& f)
+		{
+			nbl::core::vector<uint32_t> indices(count);
+			std::iota(indices.begin(),indices.end(),0u);
+			std::for_each(nbl::core::execution::par_unseq,indices.begin(),indices.end(),std::forward<F>(f));
+		}
+
+		static inline float getLuma(const float3& col)
+		{
+			return dot(float3(0.2126729f,0.7151522f,0.0721750f),col);
+		}
+
+		// `nbl_glsl_xoroshiro64star`
+		static inline uint32_t xoroshiro64star(uint32_t state[2])
+		{
+			const uint32_t retval = state[0]*0x9E3779BBu;
+			state[1] ^= state[0];
+			state[0] = std::rotl(state[0],26)^state[1]^(state[1]<<9u);
+			state[1] = std::rotl(state[1],13);
+			return retval;
+		}
+		// `rand3d` of the shaders
+		inline void rand3d(float out[2][3], const uint32_t protoDimension, const uint32_t sampleIx, uint32_t state[2]) const
+		{
+			const uint32_t* sample = sequence.data()+size_t(sampleIx)*Dimensions+protoDimension*3u;
+			for (auto i=0u; i<2u; i++)
+			for (auto c=0u; c<3u; c++)
+				out[i][c] = float(sample[i*3u+c]^xoroshiro64star(state))*std::bit_cast<float>(0x2f800004u);
+		}
+
+		inline float3 unprojectNDC(const float x, const float y, const float z) const
+		{
+			float tmp[4];
+			for (auto r=0u; r<4u; r++)
+				tmp[r] = unproject[r*4u+0u]*x+unproject[r*4u+1u]*y+unproject[r*4u+2u]*z+unproject[r*4u+3u];
+			return float3(tmp)/tmp[3];
+		}
+
+		// NaN on a miss
+		static inline float intersectSphere(const SSphere& sphere, const float3& origin, const float3& direction)
+		{
+			const float3 relOrigin = origin-sphere.position;
+			const float relOriginLen2 = dot(relOrigin,relOrigin);
+			const float dirDotRelOrigin = dot(direction,relOrigin);
+			const float det = sphere.radius2-relOriginLen2+dirDotRelOrigin*dirDotRelOrigin;
+			const float detsqrt = std::sqrt(det);
+			return -dirDotRelOrigin+(relOriginLen2>sphere.radius2 ? (-detsqrt):detsqrt);
+		}
+		inline float intersectLight(const float3& origin, const float3& direction) const
+		{
+			const float3 h = cross(direction,light.edge1);
+			const float a = dot(light.edge0,h);
+			const float3 relOrigin = origin-light.offset;
+			const float u = dot(relOrigin,h)/a;
+			const float3 q = cross(relOrigin,light.edge0);
+			const float v = dot(direction,q)/a;
+			const float t = dot(light.edge1,q)/a;
+			const bool inside = params.lightGeometry==ELG_TRIANGLE ? ((u+v)<=1.f):(u<=1.f && v<=1.f);
+			return t>0.f && u>=0.f && v>=0.f && inside ? t:std::numeric_limits<float>::quiet_NaN();
+		}
+		// returns the object hit or -1, the polygon light comes after the spheres
+		inline int32_t traceRay(float& intersectionT, const float3& origin, const float3& direction) const
+		{
+			int32_t objectID = -1;
+			for (auto i=0u; i<sphereCount; i++)
+			{
+				const float t = intersectSphere(Spheres[i],origin,direction);
+				if (t>0.f && t<intersectionT)
+				{
+					intersectionT = t;
+					objectID = i;
+				}
+			}
+			if (params.lightGeometry!=ELG_SPHERE)
+			{
+				const float t = intersectLight(origin,direction);
+				if (t>0.f && t<intersectionT)
+				{
+					intersectionT = t;
+					objectID = sphereCount;
+				}
+			}
+			return objectID;
+		}
+
+		// `nbl_glsl_frisvad`
+		static inline void frisvad(const float3& n, float3& T, float3& B)
+		{
+			if (n.z<-0.9999999f)
+			{
+				T = {0.f,-1.f,0.f};
+				B = {-1.f,0.f,0.f};
+				return;
+			}
+			const float a = 1.f/(1.f+n.z);
+			const float b = -n.x*n.y*a;
+			T = {1.f-n.x*n.x*a,b,-n.x};
+			B = {b,1.f-n.y*n.y*a,-n.y};
+		}
+
+		static inline float3 fresnelConductor(const float3& eta, const float3& etak, const float cosTheta)
+		{
+			const float cosTheta2 = cosTheta*cosTheta;
+			const float sinTheta2 = 1.f-cosTheta2;
+			auto channel = [&](const float eta, const float etak) -> float
+			{
+				const float eta2 = eta*eta;
+				const float etak2 = etak*etak;
+				const float t0 = eta2-etak2-sinTheta2;
+				const float a2plusb2 = std::sqrt(t0*t0+4.f*eta2*etak2);
+				const float t1 = a2plusb2+cosTheta2;
+				const float a = std::sqrt(0.5f*(a2plusb2+t0));
+				const float t2 = 2.f*a*cosTheta;
+				const float rs = (t1-t2)/(t1+t2);
+				const float t3 = cosTheta2*a2plusb2+sinTheta2*sinTheta2;
+				const float t4 = t2*sinTheta2;
+				const float rp = rs*(t3-t4)/(t3+t4);
+				return 0.5f*(rp+rs);
+			};
+			return {channel(eta.x,etak.x),channel(eta.y,etak.y),channel(eta.z,etak.z)};
+		}
+		// `orientedEta` is the one of the side the light goes into over the one it comes from
+		static inline float fresnelDielectric(const float orientedEta, const float cosTheta)
+		{
+			const float sinTheta2 = 1.f-cosTheta*cosTheta;
+			const float orientedEta2 = orientedEta*orientedEta;
+			const float t0 = std::sqrt(std::max(orientedEta2-sinTheta2,0.f));
+			const float rs = (cosTheta-t0)/(cosTheta+t0);
+			const float t2 = orientedEta2*cosTheta;
+			const float rp = (t0-t2)/(t0+t2);
+			return (rs*rs+rp*rp)*0.5f;
+		}
+
+		static inline float ggxD(const float a2, const float NdotH)
+		{
+			const float denom = NdotH*NdotH*(a2-1.f)+1.f;
+			return a2/(Pi*denom*denom);
+		}
+		// `2*NdotX/(NdotX+sqrt(a2+(1-a2)*NdotX^2))`
+		static inline float ggxG1(const float a2, const float NdotX)
+		{
+			return 2.f*NdotX/(NdotX+std::sqrt(a2+(1.f-a2)*NdotX*NdotX));
+		}
+		// height correlated Smith
+		static inline float ggxG2(const float a2, const float NdotV, const float NdotL)
+		{
+			const float lambdaV = NdotL*std::sqrt(a2+(1.f-a2)*NdotV*NdotV);
+			const float lambdaL = NdotV*std::sqrt(a2+(1.f-a2)*NdotL*NdotL);
+			return 2.f*NdotV*NdotL/(lambdaV+lambdaL);
+		}
+		// visible normal sampling in the frame of `N`, `V` has to be above it
+		static inline float3 ggxGenerateH(const float3& T, const float3& B, const float3& N, const float3& V, const float a, const float u[2])
+		{
+			const float3 localV = normalize(float3(a*dot(V,T),a*dot(V,B),dot(V,N)));
+			const float lensq = localV.x*localV.x+localV.y*localV.y;
+			const float3 T1 = lensq>0.f ? float3(-localV.y,localV.x,0.f)/std::sqrt(lensq):float3(1.f,0.f,0.f);
+			const float3 T2 = cross(localV,T1);
+			const float r = std::sqrt(u[0]);
+			const float phi = 2.f*Pi*u[1];
+			const float t1 = r*std::cos(phi);
+			const float s = 0.5f*(1.f+localV.z);
+			const float t2 = (1.f-s)*std::sqrt(1.f-t1*t1)+s*r*std::sin(phi);
+			float3 H = T1*t1+T2*t2+localV*std::sqrt(std::max(0.f,1.f-t1*t1-t2*t2));
+			H = normalize(float3(a*H.x,a*H.y,std::max(0.f,H.z)));
+			return T*H.x+B*H.y+N*H.z;
+		}
+		// `nbl_glsl_concentricMapping` then lifted onto the hemisphere
+		static inline float3 cosineGenerate(const SInteraction& interaction, const float u[2])
+		{
+			const float ux = 2.f*u[0]-1.f;
+			const float uy = 2.f*u[1]-1.f;
+			float px = 0.f, py = 0.f;
+			if (ux!=0.f || uy!=0.f)
+			{
+				float r, theta;
+				if (std::abs(ux)>std::abs(uy))
+				{
+					r = ux;
+					theta = 0.25f*Pi*(uy/ux);
+				}
+				else
+				{
+					r = uy;
+					theta = 0.5f*Pi-0.25f*Pi*(ux/uy);
+				}
+				px = r*std::cos(theta);
+				py = r*std::sin(theta);
+			}
+			const float z = std::sqrt(std::max(1.f-px*px-py*py,0.f));
+			return interaction.T*px+interaction.B*py+interaction.N*z;
+		}
+
+		// BSDF times the cosine and the probability of `sampleBSDF` generating `L`, the dielectric one is monochrome with `monochromeEta`
+		static inline float3 evalBSDF(float& pdf, const SBSDF& bsdf, const SInteraction& interaction, const float3& L, const float monochromeEta)
+		{
+			pdf = 0.f;
+			const float NdotL = dot(interaction.N,L);
+			const bool transmitted = (interaction.NdotV<0.f)!=(NdotL<0.f);
+			const bool transmissive = bsdf.type==EBT_DIELECTRIC;
+			const float clampedNdotV = transmissive ? std::abs(interaction.NdotV):std::max(interaction.NdotV,0.f);
+			const float clampedNdotL = transmissive ? std::abs(NdotL):std::max(NdotL,0.f);
+			constexpr float MinimumProjVectorLen = 0.00000001f;
+			if (clampedNdotV<=MinimumProjVectorLen || clampedNdotL<=MinimumProjVectorLen || (transmitted && !transmissive))
+				return float3(0.f);
+
+			const float a = std::max(bsdf.roughness,0.0001f);
+			const float a2 = a*a;
+			switch (bsdf.type)
+			{
+				case EBT_DIFFUSE:
+				{
+					// Oren-Nayar with the BSDF's `a*a` as the roughness
+					const float halfA2 = a2*0.5f;
+					const float A = 1.f-0.5f*halfA2/(halfA2+0.33f);
+					const float B = 0.45f*halfA2/(halfA2+0.09f);
+					const float cosPhiSinTheta = std::max(dot(interaction.V,L)-clampedNdotL*clampedNdotV,0.f);
+					pdf = clampedNdotL/Pi;
+					return bsdf.realEta*((A+B*cosPhiSinTheta/std::max(clampedNdotL,clampedNdotV))*pdf);
+				}
+				case EBT_CONDUCTOR:
+				{
+					const float3 H = normalize(interaction.V+L);
+					const float VdotH = dot(interaction.V,H);
+					const float D = ggxD(a2,dot(interaction.N,H));
+					pdf = D*ggxG1(a2,clampedNdotV)/(4.f*clampedNdotV);
+					return fresnelConductor(bsdf.realEta,bsdf.imaginaryEta,VdotH)*(D*ggxG2(a2,clampedNdotV,clampedNdotL)/(4.f*clampedNdotV));
+				}
+				default:
+				{
+					// everything on the side the view comes from
+					const bool backside = interaction.NdotV<0.f;
+					const float orientedEta = backside ? (1.f/monochromeEta):monochromeEta;
+					const float3 N = backside ? (-interaction.N):interaction.N;
+					float3 H = transmitted ? (interaction.V+L*orientedEta):(interaction.V+L);
+					H = normalize(H);
+					if (dot(N,H)<0.f)
+						H = -H;
+					const float NdotH = dot(N,H);
+					const float VdotH = dot(interaction.V,H);
+					const float LdotH = dot(L,H);
+					if (NdotH<=FLT_MIN || VdotH<=0.f || (transmitted ? (LdotH>=0.f):(LdotH<=0.f)))
+						return float3(0.f);
+
+					const float F = fresnelDielectric(orientedEta,VdotH);
+					const float D = ggxD(a2,NdotH);
+					const float visibleD = D*ggxG1(a2,clampedNdotV)/clampedNdotV;
+					if (transmitted)
+					{
+						const float denom = VdotH+orientedEta*LdotH;
+						pdf = (1.f-F)*visibleD*VdotH*orientedEta*orientedEta*std::abs(LdotH)/(denom*denom);
+					}
+					else
+						pdf = F*visibleD*0.25f;
+					return float3(pdf*ggxG2(a2,clampedNdotV,clampedNdotL)/ggxG1(a2,clampedNdotV));
+				}
+			}
+		}
+		// generates `L` and returns the BSDF times the cosine over the probability of generating it
+		static inline float3 sampleBSDF(float3& L, float& pdf, const SBSDF& bsdf, const SInteraction& interaction, const float u[3], const float monochromeEta)
+		{
+			switch (bsdf.type)
+			{
+				case EBT_DIFFUSE:
+					L = cosineGenerate(interaction,u);
+					break;
+				case EBT_CONDUCTOR:
+				{
+					const float3 H = ggxGenerateH(interaction.T,interaction.B,interaction.N,interaction.V,bsdf.roughness,u);
+					L = H*(2.f*dot(interaction.V,H))-interaction.V;
+					break;
+				}
+				default:
+				{
+					const bool backside = interaction.NdotV<0.f;
+					const float orientedEta = backside ? (1.f/monochromeEta):monochromeEta;
+					const float3 N = backside ? (-interaction.N):interaction.N;
+					const float3 H = ggxGenerateH(interaction.T,interaction.B,N,interaction.V,bsdf.roughness,u);
+					const float VdotH = dot(interaction.V,H);
+					if (u[2]<fresnelDielectric(orientedEta,VdotH))
+						L = H*(2.f*VdotH)-interaction.V;
+					else
+					{
+						// total internal reflection would have a fresnel of 1
+						const float rcpEta = 1.f/orientedEta;
+						const float cosT = std::sqrt(std::max(1.f-rcpEta*rcpEta*(1.f-VdotH*VdotH),0.f));
+						L = H*(VdotH*rcpEta-cosT)-interaction.V*rcpEta;
+					}
+					break;
+				}
+			}
+			const float3 value = evalBSDF(pdf,bsdf,interaction,L,monochromeEta);
+			return pdf>0.f ? (value/pdf):float3(0.f);
+		}
+
+		static inline float sphereSolidAngle(const float cosThetaMax)
+		{
+			return 2.f*Pi*(1.f-cosThetaMax);
+		}
+		// interior angles of the spherical triangle with unit vertices `A`, `B`, `C`, returns its solid angle
+		static inline float sphericalTriangleAngles(const float3& A, const float3& B, const float3& C, float& alpha, float& beta, float& gamma)
+		{
+			const float3 nAB = normalize(cross(A,B));
+			const float3 nBC = normalize(cross(B,C));
+			const float3 nCA = normalize(cross(C,A));
+			alpha = std::acos(std::clamp(-dot(nAB,nCA),-1.f,1.f));
+			beta = std::acos(std::clamp(-dot(nBC,nAB),-1.f,1.f));
+			gamma = std::acos(std::clamp(-dot(nCA,nBC),-1.f,1.f));
+			const float retval = alpha+beta+gamma-Pi;
+			return retval==retval ? retval:0.f;
+		}
+		// "Stratified Sampling of Spherical Triangles", Arvo 1995
+		static inline float3 sampleSphericalTriangle(const float3& A, const float3& B, const float3& C, const float alpha, const float solidAngle, const float u[2])
+		{
+			const float areaHat = u[0]*solidAngle;
+			const float s = std::sin(areaHat-alpha);
+			const float t = std::cos(areaHat-alpha);
+			const float cosAlpha = std::cos(alpha);
+			const float sinAlpha = std::sin(alpha);
+			const float uu = t-cosAlpha;
+			const float vv = s+sinAlpha*dot(A,B);
+			const float q = std::clamp(((vv*t-uu*s)*cosAlpha-vv)/((vv*s+uu*t)*sinAlpha),-1.f,1.f);
+			const float3 CHat = A*q+normalize(C-A*dot(C,A))*std::sqrt(1.f-q*q);
+			const float z = std::clamp(1.f-u[1]*(1.f-dot(CHat,B)),-1.f,1.f);
+			return B*z+normalize(CHat-B*dot(CHat,B))*std::sqrt(1.f-z*z);
+		}
+		// "An Area-Preserving Parametrization for Spherical Rectangles", Urena et al. 2013, needs the edges to be orthogonal
+		struct SSphericalRectangle
+		{
+			float3 ex, ey, ez;
+			float x0, y0, z0, x1, y1;
+			float b0, b1, k;
+			float solidAngle;
+		};
+		inline SSphericalRectangle getSphericalRectangle(const float3& origin) const
+		{
+			SSphericalRectangle retval;
+			const float exl = std::sqrt(dot(light.edge0,light.edge0));
+			const float eyl = std::sqrt(dot(light.edge1,light.edge1));
+			retval.ex = light.edge0/exl;
+			retval.ey = light.edge1/eyl;
+			retval.ez = cross(retval.ex,retval.ey);
+			const float3 d = light.offset-origin;
+			retval.x0 = dot(d,retval.ex);
+			retval.y0 = dot(d,retval.ey);
+			retval.z0 = dot(d,retval.ez);
+			if (retval.z0>0.f)
+			{
+				retval.z0 = -retval.z0;
+				retval.ez = -retval.ez;
+			}
+			retval.x1 = retval.x0+exl;
+			retval.y1 = retval.y0+eyl;
+			const float3 v00(retval.x0,retval.y0,retval.z0), v01(retval.x0,retval.y1,retval.z0);
+			const float3 v10(retval.x1,retval.y0,retval.z0), v11(retval.x1,retval.y1,retval.z0);
+			const float3 n0 = normalize(cross(v00,v10));
+			const float3 n1 = normalize(cross(v10,v11));
+			const float3 n2 = normalize(cross(v11,v01));
+			const float3 n3 = normalize(cross(v01,v00));
+			const float g0 = std::acos(std::clamp(-dot(n0,n1),-1.f,1.f));
+			const float g1 = std::acos(std::clamp(-dot(n1,n2),-1.f,1.f));
+			const float g2 = std::acos(std::clamp(-dot(n2,n3),-1.f,1.f));
+			const float g3 = std::acos(std::clamp(-dot(n3,n0),-1.f,1.f));
+			retval.b0 = n0.z;
+			retval.b1 = n2.z;
+			retval.k = 2.f*Pi-g2-g3;
+			retval.solidAngle = g0+g1-retval.k;
+			if (!(retval.solidAngle>FLT_MIN))
+				retval.solidAngle = 0.f;
+			return retval;
+		}
+		static inline float3 sampleSphericalRectangle(const SSphericalRectangle& rect, const float3& origin, const float u[2])
+		{
+			const float au = u[0]*rect.solidAngle+rect.k;
+			const float fu = (std::cos(au)*rect.b0-rect.b1)/std::sin(au);
+			const float cu = std::clamp(std::copysign(1.f,fu)/std::sqrt(fu*fu+rect.b0*rect.b0),-1.f,1.f);
+			const float xu = std::clamp(-(cu*rect.z0)/std::sqrt(std::max(1.f-cu*cu,FLT_MIN)),rect.x0,rect.x1);
+			const float d = std::sqrt(xu*xu+rect.z0*rect.z0);
+			const float h0 = rect.y0/std::sqrt(d*d+rect.y0*rect.y0);
+			const float h1 = rect.y1/std::sqrt(d*d+rect.y1*rect.y1);
+			const float hv = h0+u[1]*(h1-h0);
+			const float hv2 = hv*hv;
+			const float yv = hv2<1.f-0.0001f ? (hv*d/std::sqrt(1.f-hv2)):rect.y1;
+			return origin+rect.ex*xu+rect.ey*yv+rect.ez*rect.z0;
+		}
+
+		// `nbl_glsl_light_generate_and_pdf`, solid angle pdf and the distance to the light along `L`, pdf of 0 if it can't be sampled
+		inline float3 generateLightSample(float& pdf, float& maxT, const float3& origin, const float xi[3]) const
+		{
+			pdf = 0.f;
+			maxT = 0.f;
+			if (params.lightGeometry==ELG_SPHERE)
+			{
+				const SSphere& sphere = Spheres[sphereCount-1u];
+				float3 Z = sphere.position-origin;
+				const float distanceSq = dot(Z,Z);
+				const float cosThetaMax2 = 1.f-sphere.radius2/distanceSq;
+				if (!(cosThetaMax2>0.f))
+					return float3(0.f);
+				const float rcpDistance = 1.f/std::sqrt(distanceSq);
+				Z *= rcpDistance;
+				const float cosThetaMax = std::sqrt(cosThetaMax2);
+				const float cosTheta = 1.f+(cosThetaMax-1.f)*xi[0];
+				const float cosTheta2 = cosTheta*cosTheta;
+				const float sinTheta = std::sqrt(std::max(1.f-cosTheta2,0.f));
+				const float phi = 2.f*Pi*xi[1]-Pi;
+				float3 X, Y;
+				frisvad(Z,X,Y);
+				maxT = (cosTheta-std::sqrt(std::max(cosTheta2-cosThetaMax2,0.f)))/rcpDistance;
+				pdf = 1.f/sphereSolidAngle(cosThetaMax);
+				return Z*cosTheta+(X*std::cos(phi)+Y*std::sin(phi))*sinTheta;
+			}
+
+			const float3 N = getLightNormalTimesArea();
+			float3 L(0.f);
+			if (params.polygonMethod==EPM_AREA)
+			{
+				float3 point;
+				if (params.lightGeometry==ELG_TRIANGLE)
+				{
+					const float sqrtU = std::sqrt(xi[0]);
+					point = light.offset+light.edge0*(1.f-sqrtU)+light.edge1*(sqrtU*xi[1]);
+				}
+				else
+					point = light.offset+light.edge0*xi[0]+light.edge1*xi[1];
+				L = point-origin;
+				const float distanceSq = dot(L,L);
+				const float distance = std::sqrt(distanceSq);
+				L = L/distance;
+				const float cosArea = std::abs(dot(N,L));
+				if (!(cosArea>FLT_MIN))
+					return float3(0.f);
+				pdf = distanceSq/cosArea;
+				maxT = distance;
+				return L;
+			}
+			else if (params.lightGeometry==ELG_TRIANGLE)
+			{
+				const float3 A = normalize(light.offset-origin);
+				const float3 B = normalize(light.offset+light.edge0-origin);
+				const float3 C = normalize(light.offset+light.edge1-origin);
+				float alpha, beta, gamma;
+				const float solidAngle = sphericalTriangleAngles(A,B,C,alpha,beta,gamma);
+				if (!(solidAngle>FLT_MIN))
+					return float3(0.f);
+				L = sampleSphericalTriangle(A,B,C,alpha,solidAngle,xi);
+				pdf = 1.f/solidAngle;
+			}
+			else
+			{
+				const auto rect = getSphericalRectangle(origin);
+				if (rect.solidAngle==0.f)
+					return float3(0.f);
+				L = normalize(sampleSphericalRectangle(rect,origin,xi)-origin);
+				pdf = 1.f/rect.solidAngle;
+			}
+			maxT = dot(N,light.offset-origin)/dot(N,L);
+			return L;
+		}
+		// `nbl_glsl_light_deferred_pdf`, the probability of `generateLightSample` from `origin` having made a ray hit the light after `t`
+		inline float getLightPdf(const float3& origin, const float3& direction, const float t) const
+		{
+			if (params.lightGeometry==ELG_SPHERE)
+			{
+				const SSphere& sphere = Spheres[sphereCount-1u];
+				const float3 toCenter = sphere.position-origin;
+				const float cosThetaMax2 = 1.f-sphere.radius2/dot(toCenter,toCenter);
+				return cosThetaMax2>0.f ? (1.f/sphereSolidAngle(std::sqrt(cosThetaMax2))):0.f;
+			}
+			if (params.polygonMethod==EPM_AREA)
+				return t*t/std::abs(dot(getLightNormalTimesArea(),direction));
+			float solidAngle;
+			if (params.lightGeometry==ELG_TRIANGLE)
+			{
+				float alpha, beta, gamma;
+				solidAngle = sphericalTriangleAngles(
+					normalize(light.offset-origin),normalize(light.offset+light.edge0-origin),normalize(light.offset+light.edge1-origin),alpha,beta,gamma
+				);
+			}
+			else
+				solidAngle = getSphericalRectangle(origin).solidAngle;
+			return solidAngle>FLT_MIN ? (1.f/solidAngle):0.f;
+		}
+		inline float3 getLightNormalTimesArea() const
+		{
+			const float3 retval = cross(light.edge0,light.edge1);
+			return params.lightGeometry==ELG_TRIANGLE ? (retval*0.5f):retval;
+		}
+
+		void renderPixel(const uint32_t x, const uint32_t y, const uint32_t beginSample, const uint32_t endSample)
+		{
+			const size_t pixel = size_t(y)*params.width+x;
+			const float ndcX = 2.f*float(x)/float(params.width)-1.f;
+			const float ndcY = 2.f*float(y)/float(params.height)-1.f;
+			const float3 camPos = unprojectNDC(ndcX,ndcY,0.f);
+			const float pixOffsetParam[2] = {1.f/float(params.width),1.f/float(params.height)};
+
+			float3 pixelColor(color.data()+pixel*3u);
+			float pixelLumaSquared = meanLumaSquared[pixel];
+			for (uint32_t i=beginSample; i<endSample; i++)
+			{
+				uint32_t scrambleState[2] = {scrambles[pixel*2u],scrambles[pixel*2u+1u]};
+
+				// Gaussian reconstruction filter with the shaders' cutoff and deviation
+				float3 origin = camPos, direction;
+				{
+					float xi[2][3];
+					rand3d(xi,0u,i,scrambleState);
+					constexpr float GaussianFilterCutoff = 2.5f;
+					const float truncation = std::exp(-0.5f*GaussianFilterCutoff*GaussianFilterCutoff);
+					const float remapped = xi[0][0]*(1.f-truncation)+truncation;
+					const float radius = std::sqrt(-2.f*std::log(remapped))*1.5f;
+					const float phi = 2.f*Pi*xi[0][1]-Pi;
+					const float3 target = unprojectNDC(ndcX+pixOffsetParam[0]*radius*std::cos(phi),ndcY+pixOffsetParam[1]*radius*std::sin(phi),1.f);
+					direction = normalize(target-camPos);
+				}
+
+				float3 accumulation(0.f), throughput(1.f);
+				// pdf of the BSDF sample which made the current ray, 0 when there's no next event estimation to weigh against
+				float bsdfPdf = 0.f;
+				for (uint32_t depth=0u; depth<params.maxPathLength; depth++)
+				{
+					float t = FLT_MAX;
+					const int32_t objectID = traceRay(t,origin,direction);
+					if (objectID<0)
+					{
+						accumulation += throughput*EnvironmentRadiance;
+						break;
+					}
+					const float3 intersection = origin+direction*t;
+
+					SInteraction interaction;
+					uint16_t bsdfID, lightID;
+					if (objectID<int32_t(sphereCount))
+					{
+						const SSphere& sphere = Spheres[objectID];
+						interaction.N = (intersection-sphere.position)/std::sqrt(sphere.radius2);
+						bsdfID = sphere.bsdfID;
+						lightID = sphere.lightID;
+					}
+					else
+					{
+						interaction.N = normalize(getLightNormalTimesArea());
+						bsdfID = InvalidID;
+						lightID = 0u;
+					}
+					interaction.V = -direction;
+					interaction.NdotV = dot(interaction.V,interaction.N);
+					frisvad(interaction.N,interaction.T,interaction.B);
+
+					if (lightID!=InvalidID)
+					{
+						float weight = 1.f;
+						if (bsdfPdf>0.f)
+						{
+							const float lightPdf = getLightPdf(origin,direction,t);
+							weight = bsdfPdf*bsdfPdf/(bsdfPdf*bsdfPdf+lightPdf*lightPdf);
+						}
+						accumulation += LightRadiance*throughput*weight;
+					}
+					if (bsdfID==InvalidID)
+						break;
+					const SBSDF& bsdf = BSDFs[bsdfID];
+
+					float xi[2][3];
+					rand3d(xi,depth*2u+1u,i,scrambleState);
+					const float3 throughputCIE_Y = float3(0.2126729f,0.7151522f,0.0721750f)*throughput;
+					const float monochromeEta = dot(throughputCIE_Y,bsdf.realEta)/(throughputCIE_Y.x+throughputCIE_Y.y+throughputCIE_Y.z);
+					const bool lastHit = depth+1u==params.maxPathLength;
+
+					// next event estimation
+					{
+						float lightPdf, maxT;
+						const float3 L = generateLightSample(lightPdf,maxT,intersection,xi[0]);
+						maxT *= EndTolerance;
+						// no non watertight transmitters in this scene
+						if (lightPdf>0.f && lightPdf<FLT_MAX && dot(interaction.N,L)>FLT_MIN)
+						{
+							float neeBSDFPdf;
+							float3 contribution = evalBSDF(neeBSDFPdf,bsdf,interaction,L,monochromeEta)*throughput*LightRadiance/lightPdf;
+							if (!lastHit)
+								contribution *= lightPdf*lightPdf/(lightPdf*lightPdf+neeBSDFPdf*neeBSDFPdf);
+							if (neeBSDFPdf>0.f && neeBSDFPdf<FLT_MAX && getLuma(contribution)>LumaContributionThreshold && traceRay(maxT,intersection+L*(maxT*StartTolerance),L)==-1)
+								accumulation += contribution;
+						}
+					}
+					if (lastHit)
+						break;
+
+					float3 L;
+					throughput *= sampleBSDF(L,bsdfPdf,bsdf,interaction,xi[1],monochromeEta);
+					if (!(bsdfPdf>BSDFPdfThreshold && getLuma(throughput)>LumaContributionThreshold))
+						break;
+					origin = intersection+L*StartTolerance;
+					direction = L;
+				}
+
+				// running means like the shaders' `VISUALIZE_HIGH_VARIANCE`
+				const float rcpSampleSize = 1.f/float(i+1u);
+				pixelColor += (accumulation-pixelColor)*rcpSampleSize;
+				const float luma = getLuma(accumulation);
+				pixelLumaSquared += (luma*luma-pixelLumaSquared)*rcpSampleSize;
+			}
+			color[pixel*3u+0u] = pixelColor.x;
+			color[pixel*3u+1u] = pixelColor.y;
+			color[pixel*3u+2u] = pixelColor.z;
+			meanLumaSquared[pixel] = pixelLumaSquared;
+		}
+
+		const SParams params;
+		uint32_t sphereCount;
+		SPolygon light = {};
+		float unproject[16];
+		nbl::core::vector<uint32_t> sequence;
+		nbl::core::vector<uint32_t> scrambles;
+
+		uint32_t samples = 0u;
+		nbl::core::vector<float> color;
+		nbl::core::vector<float> meanLumaSquared;
+};
+
+#endif
@@ -6,6 +6,7 @@
 #include <nabla.h>
 
 #include "../common/CommonAPI.h"
+#include "../common/CShaderPermutationCompiler.h"
 #include "../common/Camera.hpp"
 #include "nbl/ext/ScreenShot/ScreenShot.h"
 #include "nbl/video/utilities/CDumbPresentationOracle.h"
@@ -86,7 +87,7 @@ DispatchInfo_t getDispatchInfo(uint32_t imgWidth, uint32_t imgHeight) {
 	return ret;
 }
 
-int main()
+int main(int argc, char** argv)
 {
 	system::IApplicationFramework::GlobalsInit();
 
@@ -185,17 +186,12 @@ int main()
 	auto gpuDescriptorSetLayout1 = device->createDescriptorSetLayout(&uboBinding, &uboBinding + 1u);
 	auto gpuDescriptorSetLayout2 = device->createDescriptorSetLayout(descriptorSet3Bindings, descriptorSet3Bindings+3u);
 
-	auto createGpuResources = [&](std::string pathToShader) -> core::smart_refctd_ptr<video::IGPUComputePipeline>
+	auto createGpuResources = [&](core::smart_refctd_ptr<asset::ICPUShader>&& spirv) -> core::smart_refctd_ptr<video::IGPUComputePipeline>
 	{
-		asset::IAssetLoader::SAssetLoadParams params{};
-		params.logger = logger.get();
-		//params.relativeDir = tmp.c_str();
-		auto spec = assetManager->getAsset(pathToShader,params).getContents();
-		
-		if (spec.empty())
+		if (!spirv)
 			assert(false);
 
-		auto cpuComputeSpecializedShader = core::smart_refctd_ptr_static_cast<asset::ICPUSpecializedShader>(*spec.begin());
+		auto cpuComputeSpecializedShader = core::make_smart_refctd_ptr<asset::ICPUSpecializedShader>(std::move(spirv),asset::ISpecializedShader::SInfo(nullptr,nullptr,"main"));
 
 		ISpecializedShader::SInfo info = cpuComputeSpecializedShader->getSpecializationInfo();
 		info.m_backingBuffer = core::make_smart_refctd_ptr<ICPUBuffer>(sizeof(ShaderParameters));
@@ -218,7 +214,22 @@ int main()
 
 	E_LIGHT_GEOMETRY lightGeom = ELG_SPHERE;
 	constexpr const char* shaderPaths[] = {"../litBySphere.comp","../litByTriangle.comp","../litByRectangle.comp"};
-	auto gpuComputePipeline = createGpuResources(shaderPaths[lightGeom]);
+	// all the light geometry variants get compiled together on all cores, and next time only if one of the files they include changed
+	core::smart_refctd_ptr<CShaderPermutationCompiler> permutationCompiler;
+	{
+		auto compilerSet = core::smart_refctd_ptr<asset::CCompilerSet>(assetManager->getCompilerSet());
+		asset::IShaderCompiler::SCompilerOptions options = {};
+		options.preprocessorOptions.logger = logger.get();
+		options.preprocessorOptions.includeFinder = compilerSet->getShaderCompiler(asset::IShader::E_CONTENT_TYPE::ECT_GLSL)->getDefaultIncludeFinder();
+		// next to the executable, like the `localOutputCWD` of the examples built on `CommonAPI`
+		const auto localOutputCWD = std::filesystem::path(argv[0]).parent_path();
+		auto spirvCache = core::make_smart_refctd_ptr<CSPIRVCompileCache>(std::move(compilerSet),localOutputCWD/"spirv_cache");
+		permutationCompiler = core::make_smart_refctd_ptr<CShaderPermutationCompiler>(std::move(spirvCache),options);
+		for (const auto* shaderPath : shaderPaths)
+			permutationCompiler->add({shaderPath,asset::IShader::ESS_COMPUTE,{}});
+		permutationCompiler->build();
+	}
+	auto gpuComputePipeline = createGpuResources(core::smart_refctd_ptr(permutationCompiler->getSPIRV(lightGeom)));
 
 	DispatchInfo_t dispatchInfo = getDispatchInfo(WIN_W, WIN_H);
 
@@ -0,0 +1,312 @@
+// Copyright (C) 2018-2020 - DevSH Graphics Programming Sp. z O.O.
+// This file is part of the "Nabla Engine".
+// For conditions of distribution and use, see copyright notice in nabla.h
+
+#ifndef _C_PARALLEL_SUMMED_AREA_TABLE_IMAGE_FILTER_H_INCLUDED_
+#define _C_PARALLEL_SUMMED_AREA_TABLE_IMAGE_FILTER_H_INCLUDED_
+
+#include <nabla.h>
+
+#include <numeric>
+#include <algorithm>
+#include <thread>
+#include <type_traits>
+
+
+//! 2D summed area table of whole mip levels which scales with cores, `CSummedAreaTableImageFilter` sums one axis after the other over the whole image.
+/** The rows of every layer are split into bands which are processed in two parallel passes:
+	1. every band sums its texels down the columns, a serial-per-column exclusive scan over the bands then turns that into the carry every
+	   band needs from the bands above it (this pass only reads the input)
+	2. every band computes its part of the table starting from its carry, column tile by column tile, so the running column sums of a tile
+	   stay in L1 while the rows are streamed through it; the horizontal prefix carries over from one tile to the next per row
+The output is written exactly once and all sums are done in `AccumulationType`, so with `double` and a 64bit float output the result
+doesn't lose precision with the image size.
+
+Any non block compressed input format is accepted, 32bit float inputs are read directly and everything else goes through `decodePixelsRuntime`.
+The output has to be `EF_R32*_SFLOAT` or `EF_R64*_SFLOAT`, its channel count decides how many channels get summed, missing input channels
+read as 0. Both images need a single region per mip level covering the whole mip, use `CSummedAreaTableImageFilter` for everything else
+(normalization, partial extents, 3D images). `ExclusiveMode` has the same meaning as there, texel `(x,y)` gets the sum over `[0,x)x[0,y)`. */
+template<bool ExclusiveMode, typename AccumulationType=double>
+class CParallelSummedAreaTableImageFilter
+{
+		static_assert(std::is_floating_point_v<AccumulationType>);
+
+	public:
+		class CState
+		{
+			public:
+				const nbl::asset::ICPUImage* inImage = nullptr;
+				nbl::asset::ICPUImage* outImage = nullptr;
+				uint32_t inMipLevel = 0u;
+				uint32_t outMipLevel = 0u;
+				uint32_t inBaseLayer = 0u;
+				uint32_t outBaseLayer = 0u;
+				uint32_t layerCount = 1u;
+				//! rows per band, 0 picks a height which gives every hardware thread a few bands
+				uint32_t bandHeight = 0u;
+				//! texels per column tile in the second pass
+				uint32_t tileWidth = 256u;
+		};
+		using state_type = CState;
+
+		static inline bool validate(state_type* state)
+		{
+			if (!state || !state->inImage || !state->outImage || state->layerCount==0u || state->tileWidth==0u)
+				return false;
+
+			const auto& inParams = state->inImage->getCreationParameters();
+			const auto& outParams = state->outImage->getCreationParameters();
+			if (nbl::asset::isBlockCompressionFormat(inParams.format) || getOutputBytesPerChannel(outParams.format)==0u)
+				return false;
+			if (state->inMipLevel>=inParams.mipLevels || state->outMipLevel>=outParams.mipLevels)
+				return false;
+			if (state->inBaseLayer+state->layerCount>inParams.arrayLayers || state->outBaseLayer+state->layerCount>outParams.arrayLayers)
+				return false;
+
+			const auto inExtent = state->inImage->getMipSize(state->inMipLevel);
+			const auto outExtent = state->outImage->getMipSize(state->outMipLevel);
+			if (inExtent.x!=outExtent.x || inExtent.y!=outExtent.y || inExtent.z!=1u || outExtent.z!=1u)
+				return false;
+
+			return findRegion(state->inImage,state->inMipLevel,state->inBaseLayer,state->layerCount) && findRegion(state->outImage,state->outMipLevel,state->outBaseLayer,state->layerCount);
+		}
+
+		template<class ExecutionPolicy>
+		static inline bool execute(ExecutionPolicy&& policy, state_type* state)
+		{
+			if (!validate(state))
+				return false;
+
+			const auto extent = state->inImage->getMipSize(state->inMipLevel);
+			SLayout in(state->inImage,state->inMipLevel,state->inBaseLayer);
+			SLayout out(state->outImage,state->outMipLevel,state->outBaseLayer);
+			const uint32_t channels = nbl::asset::getFormatChannelCount(out.format);
+
+			const uint32_t width = extent.x;
+			const uint32_t height = extent.y;
+			uint32_t bandHeight = state->bandHeight;
+			if (bandHeight==0u)
+			{
+				const uint32_t targetBands = nbl::core::max(std::thread::hardware_concurrency(),1u)*4u;
+				bandHeight = nbl::core::max((height+targetBands-1u)/targetBands,16u);
+			}
+			const uint32_t bandCount = (height+bandHeight-1u)/bandHeight;
+			const uint32_t tileWidth = nbl::core::min(state->tileWidth,width);
+			const size_t bandSumsStride = size_t(width)*channels;
+
+			// one row of column sums per band, scanned in place into the carries
+			nbl::core::vector<AccumulationType> carries(bandSumsStride*bandCount);
+			nbl::core::vector<uint32_t> bandIndices(bandCount);
+			std::iota(bandIndices.begin(),bandIndices.end(),0u);
+			constexpr uint32_t ColumnsPerScanJob = 512u;
+			nbl::core::vector<uint32_t> columnJobIndices((bandSumsStride+ColumnsPerScanJob-1u)/ColumnsPerScanJob);
+			std::iota(columnJobIndices.begin(),columnJobIndices.end(),0u);
+
+			for (uint32_t layer=0u; layer<state->layerCount; layer++)
+			{
+				std::for_each(policy,bandIndices.begin(),bandIndices.end(),[&](const uint32_t band) -> void
+				{
+					AccumulationType* sums = carries.data()+bandSumsStride*band;
+					std::fill_n(sums,bandSumsStride,AccumulationType(0));
+					nbl::core::vector<AccumulationType> row(size_t(tileWidth)*channels);
+					const uint32_t endY = nbl::core::min((band+1u)*bandHeight,height);
+					for (uint32_t x0=0u; x0<width; x0+=tileWidth)
+					{
+						const uint32_t tileTexels = nbl::core::min(tileWidth,width-x0);
+						for (uint32_t y=band*bandHeight; y<endY; y++)
+						{
+							in.readRow(row.data(),layer,x0,y,tileTexels,channels);
+							AccumulationType* tileSums = sums+size_t(x0)*channels;
+							for (size_t i=0ull; i<size_t(tileTexels)*channels; i++)
+								tileSums[i] += row[i];
+						}
+					}
+				});
+
+				std::for_each(policy,columnJobIndices.begin(),columnJobIndices.end(),[&](const uint32_t job) -> void
+				{
+					const size_t end = nbl::core::min<size_t>((job+1u)*ColumnsPerScanJob,bandSumsStride);
+					for (size_t i=job*ColumnsPerScanJob; i<end; i++)
+					{
+						AccumulationType running = 0;
+						for (uint32_t band=0u; band<bandCount; band++)
+						{
+							AccumulationType& value = carries[bandSumsStride*band+i];
+							const AccumulationType bandSum = value;
+							value = running;
+							running += bandSum;
+						}
+					}
+				});
+
+				std::for_each(policy,bandIndices.begin(),bandIndices.end(),[&](const uint32_t band) -> void
+				{
+					const AccumulationType* carry = carries.data()+bandSumsStride*band;
+					const uint32_t beginY = band*bandHeight;
+					const uint32_t endY = nbl::core::min(beginY+bandHeight,height);
+					nbl::core::vector<AccumulationType> row(size_t(tileWidth)*channels);
+					nbl::core::vector<AccumulationType> columnSums(size_t(tileWidth)*channels);
+					// the horizontal prefix of every row of the band up to the current tile
+					nbl::core::vector<AccumulationType> rowCarries(size_t(endY-beginY)*channels,AccumulationType(0));
+					AccumulationType aboveCarry[4] = {0,0,0,0};
+					for (uint32_t x0=0u; x0<width; x0+=tileWidth)
+					{
+						const uint32_t tileTexels = nbl::core::min(tileWidth,width-x0);
+						// the part of the table the rows above the band contribute
+						for (uint32_t x=0u; x<tileTexels; x++)
+						for (uint32_t c=0u; c<channels; c++)
+						{
+							const AccumulationType value = carry[size_t(x0+x)*channels+c];
+							if constexpr (ExclusiveMode)
+							{
+								columnSums[x*channels+c] = aboveCarry[c];
+								aboveCarry[c] += value;
+							}
+							else
+							{
+								aboveCarry[c] += value;
+								columnSums[x*channels+c] = aboveCarry[c];
+							}
+						}
+
+						for (uint32_t y=beginY; y<endY; y++)
+						{
+							in.readRow(row.data(),layer,x0,y,tileTexels,channels);
+							AccumulationType* rowCarry = rowCarries.data()+size_t(y-beginY)*channels;
+							for (uint32_t x=0u; x<tileTexels; x++)
+							for (uint32_t c=0u; c<channels; c++)
+							{
+								const size_t i = x*channels+c;
+								if constexpr (ExclusiveMode)
+								{
+									// the texel itself only counts for the texels below and to the right
+									const AccumulationType rowPrefix = rowCarry[c];
+									rowCarry[c] += row[i];
+									row[i] = columnSums[i];
+									columnSums[i] += rowPrefix;
+								}
+								else
+								{
+									rowCarry[c] += row[i];
+									columnSums[i] += rowCarry[c];
+									row[i] = columnSums[i];
+								}
+							}
+							out.writeRow(row.data(),layer,x0,y,tileTexels,channels);
+						}
+					}
+				});
+			}
+			return true;
+		}
+		static inline bool execute(state_type* state)
+		{
+			return execute(nbl::core::execution::par_unseq,state);
+		}
+
+	private:
+		static inline uint32_t getOutputBytesPerChannel(const nbl::asset::E_FORMAT format)
+		{
+			switch (format)
+			{
+				case nbl::asset::EF_R32_SFLOAT:
+				case nbl::asset::EF_R32G32_SFLOAT:
+				case nbl::asset::EF_R32G32B32_SFLOAT:
+				case nbl::asset::EF_R32G32B32A32_SFLOAT:
+					return sizeof(float);
+				case nbl::asset::EF_R64_SFLOAT:
+				case nbl::asset::EF_R64G64_SFLOAT:
+				case nbl::asset::EF_R64G64B64_SFLOAT:
+				case nbl::asset::EF_R64G64B64A64_SFLOAT:
+					return sizeof(double);
+				default:
+					return 0u;
+			}
+		}
+
+		static inline const nbl::asset::IImage::SBufferCopy* findRegion(const nbl::asset::ICPUImage* image, const uint32_t mipLevel, const uint32_t baseLayer, const uint32_t layerCount)
+		{
+			if (!image->getBuffer())
+				return nullptr;
+			const auto mipExtent = image->getMipSize(mipLevel);
+			const nbl::asset::IImage::SBufferCopy* found = nullptr;
+			for (const auto& region : image->getRegions())
+			{
+				if (region.imageSubresource.mipLevel!=mipLevel)
+					continue;
+				// a second region of the same mip would overlap or leave part of it to the serial filter
+				if (found)
+					return nullptr;
+				found = &region;
+			}
+			if (!found)
+				return nullptr;
+			const auto& subresource = found->imageSubresource;
+			if (subresource.baseArrayLayer>baseLayer || subresource.baseArrayLayer+subresource.layerCount<baseLayer+layerCount)
+				return nullptr;
+			if (found->imageOffset.x || found->imageOffset.y || found->imageOffset.z)
+				return nullptr;
+			if (found->imageExtent.width!=mipExtent.x || found->imageExtent.height!=mipExtent.y || found->imageExtent.depth!=mipExtent.z)
+				return nullptr;
+			return found;
+		}
+
+		struct SLayout
+		{
+			SLayout(const nbl::asset::ICPUImage* image, const uint32_t mipLevel, const uint32_t baseLayer)
+			{
+				const auto* region = findRegion(image,mipLevel,baseLayer,1u);
+				format = image->getCreationParameters().format;
+				texelBytesize = nbl::asset::getTexelOrBlockBytesize(format);
+				rowPitch = size_t(region->bufferRowLength ? region->bufferRowLength:region->imageExtent.width)*texelBytesize;
+				layerPitch = rowPitch*(region->bufferImageHeight ? region->bufferImageHeight:region->imageExtent.height);
+				const uint32_t channelCount = nbl::asset::getFormatChannelCount(format);
+				isFloat32 = texelBytesize==channelCount*sizeof(float) && nbl::asset::isFloatingPointFormat(format);
+				data = reinterpret_cast<uint8_t*>(const_cast<nbl::asset::ICPUBuffer*>(image->getBuffer())->getPointer())+region->bufferOffset+layerPitch*(baseLayer-region->imageSubresource.baseArrayLayer);
+			}
+
+			inline uint8_t* getTexel(const uint32_t layer, const uint32_t x, const uint32_t y) const
+			{
+				return data+layerPitch*layer+rowPitch*y+size_t(texelBytesize)*x;
+			}
+
+			inline void readRow(AccumulationType* dst, const uint32_t layer, const uint32_t x, const uint32_t y, const uint32_t texelCount, const uint32_t channels) const
+			{
+				const uint8_t* src = getTexel(layer,x,y);
+				const uint32_t formatChannels = nbl::asset::getFormatChannelCount(format);
+				if (isFloat32)
+				{
+					const float* texels = reinterpret_cast<const float*>(src);
+					for (uint32_t i=0u; i<texelCount; i++)
+					for (uint32_t c=0u; c<channels; c++)
+						dst[i*channels+c] = c<formatChannels ? AccumulationType(texels[i*formatChannels+c]):AccumulationType(0);
+					return;
+				}
+				for (uint32_t i=0u; i<texelCount; i++)
+				{
+					const void* srcPix[4] = {src+size_t(texelBytesize)*i,nullptr,nullptr,nullptr};
+					double decoded[4] = {0.0,0.0,0.0,0.0};
+					nbl::asset::decodePixelsRuntime<double>(format,srcPix,decoded,0u,0u);
+					for (uint32_t c=0u; c<channels; c++)
+						dst[i*channels+c] = c<formatChannels ? AccumulationType(decoded[c]):AccumulationType(0);
+				}
+			}
+
+			inline void writeRow(const AccumulationType* src, const uint32_t layer, const uint32_t x, const uint32_t y, const uint32_t texelCount, const uint32_t channels) const
+			{
+				uint8_t* dst = getTexel(layer,x,y);
+				if (texelBytesize==channels*sizeof(float))
+					std::transform(src,src+size_t(texelCount)*channels,reinterpret_cast<float*>(dst),[](const AccumulationType v){return float(v);});
+				else
+					std::transform(src,src+size_t(texelCount)*channels,reinterpret_cast<double*>(dst),[](const AccumulationType v){return double(v);});
+			}
+
+			nbl::asset::E_FORMAT format;
+			uint32_t texelBytesize;
+			size_t rowPitch,layerPitch;
+			bool isFloat32;
+			uint8_t* data;
+		};
+};
+
+#endif
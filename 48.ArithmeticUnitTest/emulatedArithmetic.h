@@ -0,0 +1,357 @@
+// Copyright (C) 2018-2020 - DevSH Graphics Programming Sp. z O.O.
+// This file is part of the "Nabla Engine".
+// For conditions of distribution and use, see copyright notice in nabla.h
+
+#ifndef _EMULATED_ARITHMETIC_H_INCLUDED_
+#define _EMULATED_ARITHMETIC_H_INCLUDED_
+
+#include <nabla.h>
+
+#include <bit>
+#include <limits>
+#include <numeric>
+#include <algorithm>
+#include <type_traits>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP>=2)
+#include <immintrin.h>
+#define _EMULATED_ARITHMETIC_SSE_
+// 32bit multiply, min and max only came with SSE4.1, MSVC doesn't have a macro for it but AVX implies it
+#if defined(__SSE4_1__) || defined(__AVX__)
+#define _EMULATED_ARITHMETIC_SSE4_1_
+#endif
+#endif
+
+
+// The binary operations of the GLSL subgroup and workgroup arithmetic, plus `simd` overloads working on 4 lanes of 32bit integers at once.
+// Those are only there for integer types, where the order of evaluation doesn't change the result, so the vectorized scans in `CPUScan`
+// stay bit exact with any GPU implementation. Floating point types always take the scalar path in `CPUScan`.
+template<typename T>
+struct and_op
+{
+	using type_t = T;
+	static inline constexpr T IdentityElement = std::bit_cast<T,uint32_t>(~0ull);
+
+	inline T operator()(T left, T right) { return left & right; }
+	#ifdef _EMULATED_ARITHMETIC_SSE_
+	static inline __m128i simd(__m128i left, __m128i right) requires (std::is_integral_v<T>&&sizeof(T)==4) { return _mm_and_si128(left,right); }
+	#endif
+	static inline constexpr bool runOPonFirst = false;
+	static inline constexpr const char* name = "and";
+};
+template<typename T>
+struct xor_op
+{
+	using type_t = T;
+	static inline const T IdentityElement = std::bit_cast<T,uint32_t>(0ull);
+
+	inline T operator()(T left, T right) { return left ^ right; }
+	#ifdef _EMULATED_ARITHMETIC_SSE_
+	static inline __m128i simd(__m128i left, __m128i right) requires (std::is_integral_v<T>&&sizeof(T)==4) { return _mm_xor_si128(left,right); }
+	#endif
+	static inline constexpr bool runOPonFirst = false;
+	static inline constexpr const char* name = "xor";
+};
+template<typename T>
+struct or_op
+{
+	using type_t = T;
+	static inline const T IdentityElement = std::bit_cast<T,uint32_t>(0ull);
+
+	inline T operator()(T left, T right) { return left | right; }
+	#ifdef _EMULATED_ARITHMETIC_SSE_
+	static inline __m128i simd(__m128i left, __m128i right) requires (std::is_integral_v<T>&&sizeof(T)==4) { return _mm_or_si128(left,right); }
+	#endif
+	static inline constexpr bool runOPonFirst = false;
+	static inline constexpr const char* name = "or";
+};
+template<typename T>
+struct add_op
+{
+	using type_t = T;
+	static inline constexpr T IdentityElement = T(0);
+
+	inline T operator()(T left, T right) { return left + right; }
+	#ifdef _EMULATED_ARITHMETIC_SSE_
+	static inline __m128i simd(__m128i left, __m128i right) requires (std::is_integral_v<T>&&sizeof(T)==4) { return _mm_add_epi32(left,right); }
+	#endif
+	static inline constexpr bool runOPonFirst = false;
+	static inline constexpr const char* name = "add";
+};
+template<typename T>
+struct mul_op
+{
+	using type_t = T;
+	static inline constexpr T IdentityElement = T(1);
+
+	inline T operator()(T left, T right) { return left * right; }
+	#ifdef _EMULATED_ARITHMETIC_SSE4_1_
+	static inline __m128i simd(__m128i left, __m128i right) requires (std::is_integral_v<T>&&sizeof(T)==4) { return _mm_mullo_epi32(left,right); }
+	#endif
+	static inline constexpr bool runOPonFirst = false;
+	static inline constexpr const char* name = "mul";
+};
+template<typename T>
+struct min_op
+{
+	using type_t = T;
+	static inline constexpr T IdentityElement = std::numeric_limits<T>::max();
+
+	inline T operator()(T left, T right) { return std::min<T>(left, right); }
+	#ifdef _EMULATED_ARITHMETIC_SSE4_1_
+	static inline __m128i simd(__m128i left, __m128i right) requires (std::is_integral_v<T>&&sizeof(T)==4)
+	{
+		if constexpr (std::is_signed_v<T>)
+			return _mm_min_epi32(left,right);
+		else
+			return _mm_min_epu32(left,right);
+	}
+	#endif
+	static inline constexpr bool runOPonFirst = false;
+	static inline constexpr const char* name = "min";
+};
+template<typename T>
+struct max_op
+{
+	using type_t = T;
+	static inline constexpr T IdentityElement = std::numeric_limits<T>::lowest();
+
+	inline T operator()(T left, T right) { return std::max<T>(left, right); }
+	#ifdef _EMULATED_ARITHMETIC_SSE4_1_
+	static inline __m128i simd(__m128i left, __m128i right) requires (std::is_integral_v<T>&&sizeof(T)==4)
+	{
+		if constexpr (std::is_signed_v<T>)
+			return _mm_max_epi32(left,right);
+		else
+			return _mm_max_epu32(left,right);
+	}
+	#endif
+	static inline constexpr bool runOPonFirst = false;
+	static inline constexpr const char* name = "max";
+};
+template<typename T>
+struct ballot : add_op<T> {};
+
+
+//! Reductions and scans of whole arrays with any of the above, 4 elements at a time where the operation has a `simd` overload.
+/** The vectorized scan is a Hillis-Steele scan within the register followed by applying the carry from the previous register, the tail and
+non vectorizable operations go through the plain loop. The policy overloads scan blocks in parallel: block reductions first, then a serial
+exclusive scan of those as the carries, then every block gets scanned again with its carry, so the input gets read twice.
+All of them work in-place too. */
+template<class OP>
+class CPUScan
+{
+	public:
+		using type_t = typename OP::type_t;
+
+		#ifdef _EMULATED_ARITHMETIC_SSE_
+		static inline constexpr bool Vectorized = requires(__m128i v) { OP::simd(v,v); };
+		#else
+		static inline constexpr bool Vectorized = false;
+		#endif
+
+		static inline type_t reduce(const type_t* in, const size_t count)
+		{
+			size_t i = 0ull;
+			type_t retval = OP::IdentityElement;
+			#ifdef _EMULATED_ARITHMETIC_SSE_
+			if constexpr (Vectorized)
+			{
+				__m128i acc = broadcast(OP::IdentityElement);
+				for (; i+4ull<=count; i+=4ull)
+					acc = OP::simd(acc,load(in+i));
+				acc = OP::simd(acc,_mm_shuffle_epi32(acc,_MM_SHUFFLE(1,0,3,2)));
+				acc = OP::simd(acc,_mm_shuffle_epi32(acc,_MM_SHUFFLE(2,3,0,1)));
+				retval = std::bit_cast<type_t>(_mm_cvtsi128_si32(acc));
+			}
+			#endif
+			for (; i<count; i++)
+				retval = OP()(retval,in[i]);
+			return retval;
+		}
+		static inline void inclusiveScan(type_t* out, const type_t* in, const size_t count)
+		{
+			scan<false>(out,in,count,OP::IdentityElement);
+		}
+		static inline void exclusiveScan(type_t* out, const type_t* in, const size_t count)
+		{
+			scan<true>(out,in,count,OP::IdentityElement);
+		}
+
+		template<class ExecutionPolicy>
+		static inline void inclusiveScan(ExecutionPolicy&& policy, type_t* out, const type_t* in, const size_t count)
+		{
+			parallelScan<false>(std::forward<ExecutionPolicy>(policy),out,in,count);
+		}
+		template<class ExecutionPolicy>
+		static inline void exclusiveScan(ExecutionPolicy&& policy, type_t* out, const type_t* in, const size_t count)
+		{
+			parallelScan<true>(std::forward<ExecutionPolicy>(policy),out,in,count);
+		}
+
+	private:
+		static inline constexpr size_t BlockSize = 0x1ull<<16ull;
+
+		#ifdef _EMULATED_ARITHMETIC_SSE_
+		static inline __m128i broadcast(const type_t value) {return _mm_set1_epi32(std::bit_cast<int32_t>(value));}
+		static inline __m128i load(const type_t* in) {return _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));}
+
+		// moves lanes up by `N`, the identity comes in at the bottom
+		template<int N>
+		static inline __m128i shiftIn(const __m128i v, const __m128i bottomIdentity)
+		{
+			return _mm_or_si128(_mm_slli_si128(v,N*4),bottomIdentity);
+		}
+		#endif
+
+		// returns the reduction of `carry` and all of `in`
+		template<bool Exclusive>
+		static inline type_t scan(type_t* out, const type_t* in, const size_t count, type_t carry)
+		{
+			size_t i = 0ull;
+			#ifdef _EMULATED_ARITHMETIC_SSE_
+			if constexpr (Vectorized)
+			{
+				const __m128i identity = broadcast(OP::IdentityElement);
+				const __m128i bottomIdentity1 = _mm_and_si128(identity,_mm_setr_epi32(-1,0,0,0));
+				const __m128i bottomIdentity2 = _mm_and_si128(identity,_mm_setr_epi32(-1,-1,0,0));
+				__m128i carries = broadcast(carry);
+				for (; i+4ull<=count; i+=4ull)
+				{
+					__m128i v = load(in+i);
+					v = OP::simd(v,shiftIn<1>(v,bottomIdentity1));
+					v = OP::simd(v,shiftIn<2>(v,bottomIdentity2));
+					const __m128i last = _mm_shuffle_epi32(v,_MM_SHUFFLE(3,3,3,3));
+					if constexpr (Exclusive)
+						v = shiftIn<1>(v,bottomIdentity1);
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(out+i),OP::simd(carries,v));
+					carries = OP::simd(carries,last);
+				}
+				carry = std::bit_cast<type_t>(_mm_cvtsi128_si32(carries));
+			}
+			#endif
+			for (; i<count; i++)
+			{
+				const type_t value = in[i];
+				const type_t next = OP()(carry,value);
+				out[i] = Exclusive ? carry:next;
+				carry = next;
+			}
+			return carry;
+		}
+
+		template<bool Exclusive, class ExecutionPolicy>
+		static inline void parallelScan(ExecutionPolicy&& policy, type_t* out, const type_t* in, const size_t count)
+		{
+			const size_t blockCount = (count+BlockSize-1ull)/BlockSize;
+			if (blockCount<2ull)
+			{
+				scan<Exclusive>(out,in,count,OP::IdentityElement);
+				return;
+			}
+
+			nbl::core::vector<uint32_t> blocks(blockCount);
+			std::iota(blocks.begin(),blocks.end(),0u);
+			nbl::core::vector<type_t> carries(blockCount);
+			auto blockSize = [&](const uint32_t block) -> size_t {return std::min(BlockSize,count-BlockSize*block);};
+			std::for_each(policy,blocks.begin(),blocks.end(),[&](const uint32_t block) -> void
+			{
+				carries[block] = reduce(in+BlockSize*block,blockSize(block));
+			});
+			scan<true>(carries.data(),carries.data(),blockCount,OP::IdentityElement);
+			std::for_each(policy,blocks.begin(),blocks.end(),[&](const uint32_t block) -> void
+			{
+				scan<Exclusive>(out+BlockSize*block,in+BlockSize*block,blockSize(block),carries[block]);
+			});
+		}
+};
+
+
+//subgroup method emulations on the CPU, to verify the results of the GPU methods
+template<class CRTP, typename T>
+struct emulatedSubgroupCommon
+{
+	using type_t = T;
+
+	inline void operator()(type_t* outputData, const type_t* workgroupData, uint32_t workgroupSize, uint32_t subgroupSize)
+	{
+		for (uint32_t pseudoSubgroupID=0u; pseudoSubgroupID<workgroupSize; pseudoSubgroupID+=subgroupSize)
+		{
+			type_t* outSubgroupData = outputData+pseudoSubgroupID;
+			const type_t* subgroupData = workgroupData+pseudoSubgroupID;
+			CRTP::impl(outSubgroupData,subgroupData,nbl::core::min<uint32_t>(subgroupSize,workgroupSize-pseudoSubgroupID));
+		}
+	}
+};
+template<class OP>
+struct emulatedSubgroupReduction : emulatedSubgroupCommon<emulatedSubgroupReduction<OP>,typename OP::type_t>
+{
+	using type_t = typename OP::type_t;
+
+	static inline void impl(type_t* outSubgroupData, const type_t* subgroupData, const uint32_t clampedSubgroupSize)
+	{
+		std::fill(outSubgroupData,outSubgroupData+clampedSubgroupSize,CPUScan<OP>::reduce(subgroupData,clampedSubgroupSize));
+	}
+	static inline constexpr const char* name = "subgroup reduction";
+};
+template<class OP>
+struct emulatedSubgroupScanExclusive : emulatedSubgroupCommon<emulatedSubgroupScanExclusive<OP>,typename OP::type_t>
+{
+	using type_t = typename OP::type_t;
+
+	static inline void impl(type_t* outSubgroupData, const type_t* subgroupData, const uint32_t clampedSubgroupSize)
+	{
+		CPUScan<OP>::exclusiveScan(outSubgroupData,subgroupData,clampedSubgroupSize);
+	}
+	static inline constexpr const char* name = "subgroup exclusive scan";
+};
+template<class OP>
+struct emulatedSubgroupScanInclusive : emulatedSubgroupCommon<emulatedSubgroupScanInclusive<OP>,typename OP::type_t>
+{
+	using type_t = typename OP::type_t;
+
+	static inline void impl(type_t* outSubgroupData, const type_t* subgroupData, const uint32_t clampedSubgroupSize)
+	{
+		CPUScan<OP>::inclusiveScan(outSubgroupData,subgroupData,clampedSubgroupSize);
+	}
+	static inline constexpr const char* name = "subgroup inclusive scan";
+};
+
+//workgroup methods
+template<class OP>
+struct emulatedWorkgroupReduction
+{
+	using type_t = typename OP::type_t;
+
+	inline void operator()(type_t* outputData, const type_t* workgroupData, uint32_t workgroupSize, uint32_t subgroupSize)
+	{
+		type_t red = CPUScan<OP>::reduce(workgroupData,workgroupSize);
+		if constexpr (OP::runOPonFirst)
+			red = OP()(0,red);
+		std::fill(outputData,outputData+workgroupSize,red);
+	}
+	static inline constexpr const char* name = "workgroup reduction";
+};
+template<class OP>
+struct emulatedWorkgroupScanExclusive
+{
+	using type_t = typename OP::type_t;
+
+	inline void operator()(type_t* outputData, const type_t* workgroupData, uint32_t workgroupSize, uint32_t subgroupSize)
+	{
+		CPUScan<OP>::exclusiveScan(outputData,workgroupData,workgroupSize);
+	}
+	static inline constexpr const char* name = "workgroup exclusive scan";
+};
+template<class OP>
+struct emulatedWorkgroupScanInclusive
+{
+	using type_t = typename OP::type_t;
+
+	inline void operator()(type_t* outputData, const type_t* workgroupData, uint32_t workgroupSize, uint32_t subgroupSize)
+	{
+		CPUScan<OP>::inclusiveScan(outputData,workgroupData,workgroupSize);
+	}
+	static inline constexpr const char* name = "workgroup inclusive scan";
+};
+
+#endif
@@ -3,185 +3,13 @@
 
 #include "../common/CommonAPI.h"
 
+#include "emulatedArithmetic.h"
+
 using namespace nbl;
 using namespace core;
 using namespace video;
 using namespace asset;
 
-template<typename T>
-struct and_op
-{
-	using type_t = T;
-	static inline constexpr T IdentityElement = std::bit_cast<T,uint32_t>(~0ull);
-
-	inline T operator()(T left, T right) { return left & right; }
-	static inline constexpr bool runOPonFirst = false;
-	static inline constexpr const char* name = "and";
-};
-template<typename T>
-struct xor_op
-{
-	using type_t = T;
-	static inline const T IdentityElement = std::bit_cast<T,uint32_t>(0ull);
-
-	inline T operator()(T left, T right) { return left ^ right; }
-	static inline constexpr bool runOPonFirst = false;
-	static inline constexpr const char* name = "xor";
-};
-template<typename T>
-struct or_op
-{
-	using type_t = T;
-	static inline const T IdentityElement = std::bit_cast<T,uint32_t>(0ull);
-
-	inline T operator()(T left, T right) { return left | right; }
-	static inline constexpr bool runOPonFirst = false;
-	static inline constexpr const char* name = "or";
-};
-template<typename T>
-struct add_op
-{
-	using type_t = T;
-	static inline constexpr T IdentityElement = T(0);
-
-	inline T operator()(T left, T right) { return left + right; }
-	static inline constexpr bool runOPonFirst = false;
-	static inline constexpr const char* name = "add";
-};
-template<typename T>
-struct mul_op
-{
-	using type_t = T;
-	static inline constexpr T IdentityElement = T(1);
-
-	inline T operator()(T left, T right) { return left * right; }
-	static inline constexpr bool runOPonFirst = false;
-	static inline constexpr const char* name = "mul";
-};
-template<typename T>
-struct min_op
-{
-	using type_t = T;
-	static inline constexpr T IdentityElement = std::numeric_limits<T>::max();
-
-	inline T operator()(T left, T right) { return std::min<T>(left, right); }
-	static inline constexpr bool runOPonFirst = false;
-	static inline constexpr const char* name = "min";
-};
-template<typename T>
-struct max_op
-{
-	using type_t = T;
-	static inline constexpr T IdentityElement = std::numeric_limits<T>::lowest();
-
-	inline T operator()(T left, T right) { return std::max<T>(left, right); }
-	static inline constexpr bool runOPonFirst = false;
-	static inline constexpr const char* name = "max";
-};
-template<typename T>
-struct ballot : add_op<T> {};
-
-
-//subgroup method emulations on the CPU, to verify the results of the GPU methods
-template<class CRTP, typename T>
-struct emulatedSubgroupCommon
-{
-	using type_t = T;
-
-	inline void operator()(type_t* outputData, const type_t* workgroupData, uint32_t workgroupSize, uint32_t subgroupSize)
-	{
-		for (uint32_t pseudoSubgroupID=0u; pseudoSubgroupID<workgroupSize; pseudoSubgroupID+=subgroupSize)
-		{
-			type_t* outSubgroupData = outputData+pseudoSubgroupID;
-			const type_t* subgroupData = workgroupData+pseudoSubgroupID;
-			CRTP::impl(outSubgroupData,subgroupData,core::min<uint32_t>(subgroupSize,workgroupSize-pseudoSubgroupID));
-		}
-	}
-};
-template<class OP>
-struct emulatedSubgroupReduction : emulatedSubgroupCommon<emulatedSubgroupReduction<OP>,typename OP::type_t>
-{
-	using type_t = typename OP::type_t;
-
-	static inline void impl(type_t* outSubgroupData, const type_t* subgroupData, const uint32_t clampedSubgroupSize)
-	{
-		type_t red = subgroupData[0];
-		for (auto i=1u; i<clampedSubgroupSize; i++)
-			red = OP()(red,subgroupData[i]);
-		std::fill(outSubgroupData,outSubgroupData+clampedSubgroupSize,red);
-	}
-	static inline constexpr const char* name = "subgroup reduction";
-};
-template<class OP>
-struct emulatedSubgroupScanExclusive : emulatedSubgroupCommon<emulatedSubgroupScanExclusive<OP>,typename OP::type_t>
-{
-	using type_t = typename OP::type_t;
-
-	static inline void impl(type_t* outSubgroupData, const type_t* subgroupData, const uint32_t clampedSubgroupSize)
-	{
-		outSubgroupData[0u] = OP::IdentityElement;
-		for (auto i=1u; i<clampedSubgroupSize; i++)
-			outSubgroupData[i] = OP()(outSubgroupData[i-1u],subgroupData[i-1u]);
-	}
-	static inline constexpr const char* name = "subgroup exclusive scan";
-};
-template<class OP>
-struct emulatedSubgroupScanInclusive : emulatedSubgroupCommon<emulatedSubgroupScanInclusive<OP>,typename OP::type_t>
-{
-	using type_t = typename OP::type_t;
-
-	static inline void impl(type_t* outSubgroupData, const type_t* subgroupData, const uint32_t clampedSubgroupSize)
-	{
-		outSubgroupData[0u] = subgroupData[0u];
-		for (auto i=1u; i<clampedSubgroupSize; i++)
-			outSubgroupData[i] = OP()(outSubgroupData[i-1u],subgroupData[i]);
-	}
-	static inline constexpr const char* name = "subgroup inclusive scan";
-};
-
-//workgroup methods
-template<class OP>
-struct emulatedWorkgroupReduction
-{
-	using type_t = typename OP::type_t;
-
-	inline void operator()(type_t* outputData, const type_t* workgroupData, uint32_t workgroupSize, uint32_t subgroupSize)
-	{
-		type_t red = OP::runOPonFirst ? OP()(0, workgroupData[0]) : workgroupData[0];
-		for (auto i=1u; i<workgroupSize; i++)
-			red = OP()(red,workgroupData[i]);
-		std::fill(outputData,outputData+workgroupSize,red);
-	}
-	static inline constexpr const char* name = "workgroup reduction";
-};
-template<class OP>
-struct emulatedWorkgroupScanExclusive
-{
-	using type_t = typename OP::type_t;
-
-	inline void operator()(type_t* outputData, const type_t* workgroupData, uint32_t workgroupSize, uint32_t subgroupSize)
-	{
-		outputData[0u] = OP::IdentityElement;
-		for (auto i=1u; i<workgroupSize; i++)
-			outputData[i] = OP()(outputData[i-1u],workgroupData[i-1u]);
-	}
-	static inline constexpr const char* name = "workgroup exclusive scan";
-};
-template<class OP>
-struct emulatedWorkgroupScanInclusive
-{
-	using type_t = typename OP::type_t;
-
-	inline void operator()(type_t* outputData, const type_t* workgroupData, uint32_t workgroupSize, uint32_t subgroupSize)
-	{
-		outputData[0u] = workgroupData[0u];
-		for (auto i=1u; i<workgroupSize; i++)
-			outputData[i] = OP()(outputData[i-1u],workgroupData[i]);
-	}
-	static inline constexpr const char* name = "workgroup inclusive scan";
-};
-
-
 #include "common.glsl"
 constexpr uint32_t kBufferSize = (1u+BUFFER_DWORD_COUNT)*sizeof(uint32_t);
 
@@ -9,6 +9,8 @@
 
 #include "nbl/ext/FFT/FFT.h"
 #include "../common/QToQuitEventReceiver.h"
+#include "../39.DenoiserTonemapper/CCPUFFTConvolution.h"
+#include "../39.DenoiserTonemapper/CCPUDenoiserTonemapper.h"
 
 using namespace nbl;
 using namespace nbl::core;
@@ -160,6 +162,88 @@ struct ivec2
 #include "extra_parameters.glsl"
 
 
+// Golden reference for the GPU convolution, runs the same convolution on the CPU, saves it next to the GPU result and reports the difference.
+// The CPU version computes the kernel spectrum at the padded image size instead of sampling it from the kernel's own FFT, and works in
+// full floats, so expect the differences of the half float storage and the spectrum interpolation, not bit exactness.
+static void compareWithCPUReference(IAssetManager* am, const ICPUImage* gpuResult, const ICPUImage* srcImage, const ICPUImage* kerImage, const float bloomScale)
+{
+	const auto& srcDim = srcImage->getCreationParameters().extent;
+	const auto& kerDim = kerImage->getCreationParameters().extent;
+	const uint32_t kernelWidth = core::max<uint32_t>(float(kerDim.width)*bloomScale,1u);
+	const uint32_t kernelHeight = core::max<uint32_t>(float(kerDim.height)*bloomScale,1u);
+
+	core::vector<float> psf,convolved,gpuConvolved;
+	if (!CCPUDenoiserTonemapper::decodeRGB(kerImage,psf) || !CCPUDenoiserTonemapper::decodeRGB(srcImage,convolved) || !CCPUDenoiserTonemapper::decodeRGB(gpuResult,gpuConvolved))
+	{
+		os::Printer::log("CPU reference: can't decode the images!", ELL_ERROR);
+		return;
+	}
+	core::vector<float> kernel(size_t(kernelWidth)*kernelHeight*3u);
+	CCPUFFTConvolution::scaleKernel(kernel.data(),kernelWidth,kernelHeight,psf.data(),kerDim.width,kerDim.height);
+	CCPUFFTConvolution convolution;
+	if (!convolution.setKernel(kernel.data(),kernelWidth,kernelHeight))
+	{
+		os::Printer::log("CPU reference: the kernel has no luminance!", ELL_ERROR);
+		return;
+	}
+	const auto start = std::chrono::high_resolution_clock::now();
+	convolution.convolve(convolved.data(),srcDim.width,srcDim.height);
+	const auto cpuTime = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now()-start).count();
+
+	double maxDifference = 0.0, sumSquaredDifference = 0.0, maxValue = 0.0;
+	for (size_t i=0ull; i<convolved.size(); i++)
+	{
+		const double difference = std::abs(double(gpuConvolved[i])-double(convolved[i]));
+		maxDifference = core::max(maxDifference,difference);
+		sumSquaredDifference += difference*difference;
+		maxValue = core::max(maxValue,double(std::abs(convolved[i])));
+	}
+	std::cout << "CPU reference convolution took " << cpuTime << " ms, GPU vs CPU max difference " << maxDifference
+		<< " (" << maxDifference/core::max(maxValue,1.0e-9)*100.0 << "% of the brightest texel), RMS " << sqrt(sumSquaredDifference/double(convolved.size())) << std::endl;
+
+	ICPUImage::SCreationParams imgParams;
+	imgParams.flags = static_cast<ICPUImage::E_CREATE_FLAGS>(0u);
+	imgParams.type = ICPUImage::ET_2D;
+	imgParams.format = EF_R32G32B32A32_SFLOAT;
+	imgParams.extent = srcDim;
+	imgParams.mipLevels = 1u;
+	imgParams.arrayLayers = 1u;
+	imgParams.samples = ICPUImage::ESCF_1_BIT;
+	auto image = ICPUImage::create(std::move(imgParams));
+	auto regions = core::make_refctd_dynamic_array<core::smart_refctd_dynamic_array<IImage::SBufferCopy> >(1u);
+	{
+		auto& region = regions->front();
+		region.bufferOffset = 0u;
+		region.bufferRowLength = 0u;
+		region.bufferImageHeight = 0u;
+		region.imageSubresource.mipLevel = 0u;
+		region.imageSubresource.baseArrayLayer = 0u;
+		region.imageSubresource.layerCount = 1u;
+		region.imageOffset = { 0u,0u,0u };
+		region.imageExtent = srcDim;
+	}
+	auto buffer = core::make_smart_refctd_ptr<ICPUBuffer>(size_t(srcDim.width)*srcDim.height*4u*sizeof(float));
+	auto* texels = reinterpret_cast<float*>(buffer->getPointer());
+	for (size_t i=0ull; i<size_t(srcDim.width)*srcDim.height; i++)
+	{
+		std::copy_n(convolved.data()+i*3u,3u,texels+i*4u);
+		texels[i*4u+3u] = 1.f;
+	}
+	image->setBufferAndRegions(std::move(buffer),regions);
+
+	ICPUImageView::SCreationParams imgViewParams;
+	imgViewParams.flags = static_cast<ICPUImageView::E_CREATE_FLAGS>(0u);
+	imgViewParams.format = EF_R32G32B32A32_SFLOAT;
+	imgViewParams.image = std::move(image);
+	imgViewParams.viewType = ICPUImageView::ET_2D;
+	imgViewParams.subresourceRange = {static_cast<IImage::E_ASPECT_FLAGS>(0u),0u,1u,0u,1u};
+	auto imageView = ICPUImageView::create(std::move(imgViewParams));
+
+	IAssetWriter::SAssetWriteParams wp(imageView.get());
+	if (!am->writeAsset("convolved_exr_cpu.exr", wp))
+		os::Printer::log("CPU reference: could not write convolved_exr_cpu.exr!", ELL_ERROR);
+}
+
 int main()
 {
 	nbl::SIrrlichtCreationParameters deviceParams;
@@ -742,6 +826,13 @@ int main()
 			IAssetWriter::SAssetWriteParams wp(imageView.get());
 			volatile bool success = am->writeAsset("convolved_exr.exr", wp);
 			assert(success);
+
+			compareWithCPUReference(
+				am,imageView->getCreationParameters().image.get(),
+				IAsset::castDown<ICPUImage>(srcImageBundle.getContents().begin()[0]).get(),
+				IAsset::castDown<ICPUImage>(kerImageBundle.getContents().begin()[0]).get(),
+				bloomScale
+			);
 		}
 		
 		driver->blitRenderTargets(blitFBO, nullptr, false, false);
@@ -0,0 +1,189 @@
+// Copyright (C) 2018-2020 - DevSH Graphics Programming Sp. z O.O.
+// This file is part of the "Nabla Engine".
+// For conditions of distribution and use, see copyright notice in nabla.h
+
+#ifndef _PARALLEL_RADIX_SORT_H_INCLUDED_
+#define _PARALLEL_RADIX_SORT_H_INCLUDED_
+
+#include <nabla.h>
+
+#include <array>
+#include <thread>
+#include <barrier>
+#include <cstring>
+#include <utility>
+#include <algorithm>
+
+
+//! Fewest passes with at most 2^11 buckets (histograms and write combining lines still fit in L1/L2), then the narrowest radix for that pass count.
+/** So 16-bit keys get 2x8, 24-bit get 3x8, 32-bit get 3x11 and 64-bit get 6x11 bit passes. */
+inline constexpr size_t default_radix_bits(const size_t keyBitCount)
+{
+	constexpr size_t MaxRadixBits = 11ull;
+	const size_t passCount = (keyBitCount+MaxRadixBits-1ull)/MaxRadixBits;
+	return (keyBitCount+passCount-1ull)/passCount;
+}
+
+//! Multi-threaded stable LSD radix sort, drop-in for `core::radix_sort` (same key accessor concept, same "returns whichever buffer ended up sorted" contract).
+/** Every pass runs in three phases separated by barriers:
+	1. each thread histograms its own contiguous chunk of the input
+	2. threads each take a slice of the buckets and scan it down the per-thread histograms, then the bucket totals get scanned once
+	3. each thread scatters its chunk, which keeps the sort stable since chunk `t` always lands before chunk `t+1` within a bucket
+The scatter goes through a cache line sized staging buffer per bucket (software write combining), so the destination sees full line writes
+instead of 256 interleaved streams of single elements.
+Histogramming isn't done with AVX2 as there's no conflict-free scatter-increment before AVX-512CD, it uses 4 interleaved sub-histograms
+instead to break the load-increment-store dependency chains on repeated digits.
+Passes where every element falls in the same bucket (i.e. that digit is constant across the range) are skipped, so unlike `core::radix_sort`
+which buffer gets returned is only known at runtime. */
+template<size_t RadixBitsOverride=0ull, typename T, class KeyAccessor>
+T* parallel_radix_sort(T* input, T* scratch, const size_t rangeSize, const KeyAccessor& comp, uint32_t threadCount=0u)
+{
+	constexpr size_t RadixBits = RadixBitsOverride ? RadixBitsOverride:default_radix_bits(KeyAccessor::key_bit_count);
+	static_assert(RadixBits>0ull && RadixBits<=16ull);
+	constexpr size_t BucketCount = 0x1ull<<RadixBits;
+	constexpr uint32_t RadixMask = uint32_t(BucketCount-1ull);
+	constexpr size_t PassCount = (KeyAccessor::key_bit_count+RadixBits-1ull)/RadixBits;
+	// below this many elements per thread the barriers cost more than the work
+	constexpr size_t MinElementsPerThread = 0x1ull<<16ull;
+	constexpr bool WriteCombine = std::is_trivially_copyable_v<T> && sizeof(T)<=64ull;
+	constexpr uint32_t WriteCombineElements = WriteCombine ? uint32_t(64ull/sizeof(T)):1u;
+
+	if (rangeSize<2ull)
+		return input;
+	if (threadCount==0u)
+		threadCount = std::max(std::thread::hardware_concurrency(),1u);
+	threadCount = uint32_t(std::clamp<size_t>(rangeSize/MinElementsPerThread,1ull,threadCount));
+
+	using histogram_t = std::array<size_t,BucketCount>;
+	nbl::core::vector<histogram_t> histograms(threadCount);
+	histogram_t bucketBase;
+	bool skipPass;
+	T* sorted = input;
+
+	auto scanBucketTotals = [&]() noexcept -> void
+	{
+		// after phase 2 every bucket's total count sits in the last thread's histogram slot, reused to save a separate array
+		size_t sum = 0ull;
+		skipPass = false;
+		for (size_t b=0ull; b<BucketCount; b++)
+		{
+			const size_t total = histograms[threadCount-1u][b];
+			bucketBase[b] = sum;
+			sum += total;
+			skipPass = skipPass || total==rangeSize;
+		}
+	};
+	std::barrier passBarrier(threadCount);
+	std::barrier scanBarrier(threadCount,scanBucketTotals);
+
+	auto work = [&](const uint32_t threadIx) -> void
+	{
+		const size_t begin = rangeSize*threadIx/threadCount;
+		const size_t end = rangeSize*(threadIx+1u)/threadCount;
+		const size_t bucketBegin = BucketCount*threadIx/threadCount;
+		const size_t bucketEnd = BucketCount*(threadIx+1u)/threadCount;
+		assert(end-begin<=~0u);
+
+		struct alignas(64) SWriteCombineLine
+		{
+			std::byte data[WriteCombineElements*sizeof(T)];
+		};
+		auto lines = std::make_unique<SWriteCombineLine[]>(WriteCombine ? BucketCount:0ull);
+		std::array<uint32_t,BucketCount> lineFill;
+		std::array<size_t,BucketCount> offsets;
+		auto counts = std::make_unique<std::array<uint32_t,BucketCount>[]>(4u);
+
+		T* src = input;
+		T* dst = scratch;
+		auto pass = [&]<size_t Pass>() -> void
+		{
+			auto digit = [&comp](const T& item) -> uint32_t
+			{
+				return uint32_t(comp.template operator()<Pass*RadixBits,RadixMask>(item));
+			};
+
+			// phase 1
+			for (uint32_t i=0u; i<4u; i++)
+				counts[i].fill(0u);
+			size_t i = begin;
+			for (; i+4ull<=end; i+=4ull)
+			{
+				counts[0][digit(src[i+0ull])]++;
+				counts[1][digit(src[i+1ull])]++;
+				counts[2][digit(src[i+2ull])]++;
+				counts[3][digit(src[i+3ull])]++;
+			}
+			for (; i<end; i++)
+				counts[0][digit(src[i])]++;
+			auto& histogram = histograms[threadIx];
+			for (size_t b=0ull; b<BucketCount; b++)
+				histogram[b] = size_t(counts[0][b])+counts[1][b]+counts[2][b]+counts[3][b];
+			passBarrier.arrive_and_wait();
+
+			// phase 2, exclusive scan down the threads turns counts into offsets within the bucket, the total goes to the last thread's slot
+			for (size_t b=bucketBegin; b<bucketEnd; b++)
+			{
+				size_t sum = 0ull;
+				for (uint32_t t=0u; t+1u<threadCount; t++)
+				{
+					const size_t count = histograms[t][b];
+					histograms[t][b] = sum;
+					sum += count;
+				}
+				histograms[threadCount-1u][b] += sum;
+			}
+			scanBarrier.arrive_and_wait();
+			// all threads see the same flag, so they all skip the scatter and the barrier after it together
+			if (skipPass)
+				return;
+
+			// phase 3, the last thread's slot holds the total, its own offset is total minus its count
+			for (size_t b=0ull; b<BucketCount; b++)
+				offsets[b] = bucketBase[b]+(threadIx+1u==threadCount ? (histogram[b]-size_t(counts[0][b])-counts[1][b]-counts[2][b]-counts[3][b]):histogram[b]);
+			if constexpr (WriteCombine)
+			{
+				lineFill.fill(0u);
+				for (size_t j=begin; j<end; j++)
+				{
+					const uint32_t b = digit(src[j]);
+					T* line = reinterpret_cast<T*>(lines[b].data);
+					line[lineFill[b]++] = src[j];
+					if (lineFill[b]==WriteCombineElements)
+					{
+						// not `sizeof(SWriteCombineLine)`, the alignment pads it past the elements when they don't divide 64 bytes
+						memcpy(dst+offsets[b],line,sizeof(T)*WriteCombineElements);
+						offsets[b] += WriteCombineElements;
+						lineFill[b] = 0u;
+					}
+				}
+				for (size_t b=0ull; b<BucketCount; b++)
+					memcpy(dst+offsets[b],lines[b].data,sizeof(T)*lineFill[b]);
+			}
+			else
+			{
+				for (size_t j=begin; j<end; j++)
+					dst[offsets[digit(src[j])]++] = src[j];
+			}
+			std::swap(src,dst);
+			passBarrier.arrive_and_wait();
+		};
+		[&]<size_t... Pass>(std::index_sequence<Pass...>) -> void
+		{
+			(pass.template operator()<Pass>(),...);
+		}(std::make_index_sequence<PassCount>{});
+		if (threadIx==0u)
+			sorted = src;
+	};
+
+	nbl::core::vector<std::thread> threads;
+	threads.reserve(threadCount-1u);
+	for (uint32_t t=1u; t<threadCount; t++)
+		threads.emplace_back(work,t);
+	work(0u);
+	for (auto& thread : threads)
+		thread.join();
+
+	return sorted;
+}
+
+#endif
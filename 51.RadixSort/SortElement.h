@@ -0,0 +1,89 @@
+// Copyright (C) 2018-2020 - DevSH Graphics Programming Sp. z O.O.
+// This file is part of the "Nabla Engine".
+// For conditions of distribution and use, see copyright notice in nabla.h
+
+#ifndef _SORT_ELEMENT_H_INCLUDED_
+#define _SORT_ELEMENT_H_INCLUDED_
+
+#include <nabla.h>
+
+#include <bit>
+#include <type_traits>
+
+
+//! Maps a key to an unsigned integer of the same size whose unsigned ordering matches the key's own `operator<`
+/** Unsigned integers map to themselves, signed ones get the sign bit flipped.
+Floats flip the sign bit when positive and all the bits when negative, so -0.0 sorts just before +0.0 and NaNs end up at either extreme. */
+template<typename Key>
+struct SRadixKeyTraits
+{
+	static_assert(std::is_integral_v<Key> && !std::is_same_v<Key,bool>, "Only integer and floating point keys are supported");
+	using unsigned_t = std::make_unsigned_t<Key>;
+
+	static inline constexpr unsigned_t encode(const Key key)
+	{
+		if constexpr (std::is_signed_v<Key>)
+			return unsigned_t(key)^(unsigned_t(1)<<(sizeof(Key)*8ull-1ull));
+		else
+			return key;
+	}
+};
+template<>
+struct SRadixKeyTraits<float>
+{
+	using unsigned_t = uint32_t;
+
+	static inline unsigned_t encode(const float key)
+	{
+		const uint32_t bits = std::bit_cast<uint32_t>(key);
+		return bits^((bits>>31u) ? ~0u:0x80000000u);
+	}
+};
+template<>
+struct SRadixKeyTraits<double>
+{
+	using unsigned_t = uint64_t;
+
+	static inline unsigned_t encode(const double key)
+	{
+		const uint64_t bits = std::bit_cast<uint64_t>(key);
+		return bits^((bits>>63ull) ? ~0ull:0x8000000000000000ull);
+	}
+};
+
+
+//! Key-value pair to sort, `Key` can be any integer or floating point type
+template<typename Key, typename Value=uint32_t>
+struct SortKeyValuePair
+{
+	Key key;
+	Value data;
+
+	bool operator!= (const SortKeyValuePair& other) const
+	{
+		return (key != other.key) || (data != other.data);
+	}
+};
+
+//! Key accessor for anything with a `key` member, works with both `core::radix_sort` and `parallel_radix_sort`
+/** `KeyBits` is how many low bits of the (encoded) key can be non-zero, the sort only does as many passes as it takes to cover those.
+So 16-bit material IDs or 24-bit Morton codes stored in a `uint32_t` should use `SortKeyAccessor<uint32_t,16>` or `SortKeyAccessor<uint32_t,24>`.
+Keep it at the full width for signed and floating point keys, the encoding puts the sign in the top bit. */
+template<typename Key, size_t KeyBits=sizeof(Key)*8ull>
+struct SortKeyAccessor
+{
+	static_assert(KeyBits>0ull && KeyBits<=sizeof(Key)*8ull);
+	_NBL_STATIC_INLINE_CONSTEXPR size_t key_bit_count = KeyBits;
+
+	template<auto bit_offset, auto radix_mask, typename T>
+	inline decltype(radix_mask) operator()(const T& item) const
+	{
+		return static_cast<decltype(radix_mask)>(SRadixKeyTraits<Key>::encode(item.key) >> static_cast<uint32_t>(bit_offset)) & radix_mask;
+	}
+};
+
+
+using SortElement = SortKeyValuePair<uint32_t>;
+using SortElementKeyAccessor = SortKeyAccessor<uint32_t>;
+
+#endif
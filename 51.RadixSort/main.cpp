@@ -4,6 +4,9 @@
 #include "nbl/ext/RadixSort/RadixSort.h"
 #include "../../source/Nabla/COpenGLDriver.h"
 
+#include "SortElement.h"
+#include "ParallelRadixSort.h"
+
 #include <chrono>
 #include <random>
 
@@ -17,27 +20,6 @@ using ScanClass = ext::RadixSort::ScanClass;
 
 #define WG_SIZE 256
 
-struct SortElement
-{
-	uint32_t key, data;
-
-	bool operator!= (const SortElement& other)
-	{
-		return (key != other.key) || (data != other.data);
-	}
-};
-
-struct SortElementKeyAccessor
-{
-	_NBL_STATIC_INLINE_CONSTEXPR size_t key_bit_count = 32ull;
-
-	template<auto bit_offset, auto radix_mask>
-	inline decltype(radix_mask) operator()(const SortElement& item) const
-	{
-		return static_cast<decltype(radix_mask)>(item.key >> static_cast<uint32_t>(bit_offset)) & radix_mask;
-	}
-};
-
 template <typename T>
 static T* DebugGPUBufferDownload(smart_refctd_ptr<IGPUBuffer> buffer_to_download, size_t buffer_size, IVideoDriver* driver)
 {
@@ -227,6 +209,21 @@ int main()
 
 		std::cout << "CPU sort end\nTime taken: " << std::chrono::duration_cast<std::chrono::milliseconds>(stop - start).count() << " ms" << std::endl;
 
+		{
+			SortElement* parallel_data = new SortElement[2 * (end - begin)];
+			memcpy(parallel_data, in + begin, sizeof(SortElement) * (end - begin));
+
+			start = std::chrono::high_resolution_clock::now();
+			SortElement* parallel_sorted = parallel_radix_sort(parallel_data, parallel_data + (end - begin), end - begin, SortElementKeyAccessor());
+			stop = std::chrono::high_resolution_clock::now();
+
+			std::cout << "Parallel CPU sort time taken: " << std::chrono::duration_cast<std::chrono::milliseconds>(stop - start).count() << " ms" << std::endl;
+			if (memcmp(parallel_sorted, in_data + begin, sizeof(SortElement) * (end - begin)) != 0)
+				std::cout << "Parallel CPU sort differs from core::radix_sort!" << std::endl;
+
+			delete[] parallel_data;
+		}
+
 		std::cout << "Testing: ";
 		DebugCompareGPUvsCPU<SortElement>(in_gpu, in_data, in_size, driver);
 
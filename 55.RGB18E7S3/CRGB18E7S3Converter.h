@@ -0,0 +1,337 @@
+// Copyright (C) 2018-2020 - DevSH Graphics Programming Sp. z O.O.
+// This file is part of the "Nabla Engine".
+// For conditions of distribution and use, see copyright notice in nabla.h
+
+#ifndef _C_RGB18E7S3_CONVERTER_H_INCLUDED_
+#define _C_RGB18E7S3_CONVERTER_H_INCLUDED_
+
+#include <nabla.h>
+
+#include <cstring>
+#include <numeric>
+#include <algorithm>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define _RGB18E7S3_CONVERTER_AVX2_
+#define _RGB18E7S3_CONVERTER_SSE_
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP>=2)
+#include <immintrin.h>
+#define _RGB18E7S3_CONVERTER_SSE_
+#endif
+
+
+//! Whole arrays of tightly packed RGB float triplets to and from RGB18E7S3, for converting frames of HDR accumulation buffers on the CPU.
+/** Same encoding as `core::rgb32f_to_rgb18e7s3` and `nbl_glsl_encodeRGB18E7S3`: 18bit unsigned mantissas for R, G and B in the lowest bits,
+then the 7bit shared exponent biased by 63 and the 3 sign bits at the top. The shared exponent is the one of the largest magnitude channel
+plus one, bumped once more if that channel's mantissa rounds up to 2^18. Mantissas round to nearest even, so every channel gets an absolute
+error of at most half a mantissa step of the largest one.
+
+Values clamp to `+-MaxValue`, infinities included, NaNs encode as 0 (what the GLSL version does with them is undefined) and anything
+smaller than 2^-82 flushes to 0, denormal inputs are fine. Blocks of 8 (AVX2) or 4 (SSE2) texels are converted at once, the ISA is picked
+at compile time and the scalar path handles the tail and builds without either. The policy overloads split the array into chunks over threads. */
+class CRGB18E7S3Converter
+{
+	public:
+		static inline constexpr uint32_t MantissaBits = 18u;
+		static inline constexpr uint32_t ExponentBits = 7u;
+		static inline constexpr int32_t ExponentBias = 63;
+		//! largest encodable magnitude, `(2^18-1)/2^18*2^64`
+		static inline constexpr float MaxValue = float((0x1u<<MantissaBits)-1u)*float(0x1ull<<(64u-MantissaBits));
+
+		static inline void encode(uint64_t* out, const float* rgb, const size_t count)
+		{
+			size_t i = 0ull;
+			#if defined(_RGB18E7S3_CONVERTER_AVX2_)
+			for (; i+8ull<=count; i+=8ull)
+				encodeBlock<SAVX2>(out+i,rgb+i*3ull);
+			#endif
+			#if defined(_RGB18E7S3_CONVERTER_SSE_)
+			for (; i+4ull<=count; i+=4ull)
+				encodeBlock<SSSE2>(out+i,rgb+i*3ull);
+			#endif
+			for (; i<count; i++)
+				out[i] = encode(rgb+i*3ull);
+		}
+		static inline void decode(float* rgb, const uint64_t* in, const size_t count)
+		{
+			size_t i = 0ull;
+			#if defined(_RGB18E7S3_CONVERTER_AVX2_)
+			for (; i+8ull<=count; i+=8ull)
+				decodeBlock<SAVX2>(rgb+i*3ull,in+i);
+			#endif
+			#if defined(_RGB18E7S3_CONVERTER_SSE_)
+			for (; i+4ull<=count; i+=4ull)
+				decodeBlock<SSSE2>(rgb+i*3ull,in+i);
+			#endif
+			for (; i<count; i++)
+				decode(rgb+i*3ull,in[i]);
+		}
+
+		template<class ExecutionPolicy>
+		static inline void encode(ExecutionPolicy&& policy, uint64_t* out, const float* rgb, const size_t count)
+		{
+			forEachChunk(std::forward<ExecutionPolicy>(policy),count,[&](const size_t begin, const size_t end) -> void
+			{
+				encode(out+begin,rgb+begin*3ull,end-begin);
+			});
+		}
+		template<class ExecutionPolicy>
+		static inline void decode(ExecutionPolicy&& policy, float* rgb, const uint64_t* in, const size_t count)
+		{
+			forEachChunk(std::forward<ExecutionPolicy>(policy),count,[&](const size_t begin, const size_t end) -> void
+			{
+				decode(rgb+begin*3ull,in+begin,end-begin);
+			});
+		}
+
+		//! single texel versions, bit exact with the block versions
+		static inline uint64_t encode(const float* rgb)
+		{
+			float magnitude[3];
+			uint32_t signs = 0u;
+			float maxMagnitude = 0.f;
+			for (auto c=0u; c<3u; c++)
+			{
+				// NaN fails the comparisons and ends up as 0
+				float value = rgb[c]==rgb[c] ? rgb[c]:0.f;
+				value = std::min(std::max(value,-MaxValue),MaxValue);
+				signs |= uint32_t(value<0.f)<<c;
+				magnitude[c] = std::abs(value);
+				maxMagnitude = std::max(maxMagnitude,magnitude[c]);
+			}
+
+			const uint32_t exponentBits = floatBits(std::max(maxMagnitude,MinSharedExponentValue))>>23u;
+			uint32_t scaleBits = ScaleBitsBase-(exponentBits<<23u);
+			uint32_t sharedExponent = exponentBits-(127u-ExponentBias-1u);
+			if (roundToInt(bitsFloat(scaleBits)*maxMagnitude)==(0x1u<<MantissaBits))
+			{
+				scaleBits -= 0x1u<<23u;
+				sharedExponent++;
+			}
+			const float scale = bitsFloat(scaleBits);
+
+			uint32_t mantissa[3];
+			for (auto c=0u; c<3u; c++)
+				mantissa[c] = roundToInt(magnitude[c]*scale);
+			return pack(mantissa[0]|(mantissa[1]<<18u),(mantissa[1]>>14u)|(mantissa[2]<<4u)|(sharedExponent<<22u)|(signs<<29u));
+		}
+		static inline void decode(float* rgb, const uint64_t encoded)
+		{
+			const uint32_t lo = uint32_t(encoded);
+			const uint32_t hi = uint32_t(encoded>>32ull);
+			const float scale = bitsFloat((((hi>>22u)&0x7fu)+DecodeScaleBias)<<23u);
+			const uint32_t mantissa[3] = {lo&MantissaMask,(lo>>18u)|((hi&0xfu)<<14u),(hi>>4u)&MantissaMask};
+			for (auto c=0u; c<3u; c++)
+				rgb[c] = bitsFloat(floatBits(float(mantissa[c])*scale)|(((hi>>(29u+c))&0x1u)<<31u));
+		}
+
+	private:
+		static inline constexpr uint32_t MantissaMask = (0x1u<<MantissaBits)-1u;
+		// 2^(-ExponentBias-1), smallest magnitude the shared exponent can represent
+		static inline constexpr float MinSharedExponentValue = 0x1p-64f;
+		// exponent field of `2^(MantissaBits-sharedExponent)` is `ScaleBitsBase-exponentBits` when shifted into place
+		static inline constexpr uint32_t ScaleBitsBase = ((127u+MantissaBits+126u)<<23u);
+		// exponent field of `2^(biasedExponent-ExponentBias-MantissaBits)` is `biasedExponent+DecodeScaleBias`
+		static inline constexpr uint32_t DecodeScaleBias = 127u-ExponentBias-MantissaBits;
+		static inline constexpr size_t ChunkTexels = 0x1ull<<14ull;
+
+		static inline uint32_t floatBits(const float value)
+		{
+			uint32_t retval;
+			memcpy(&retval,&value,sizeof(retval));
+			return retval;
+		}
+		static inline float bitsFloat(const uint32_t bits)
+		{
+			float retval;
+			memcpy(&retval,&bits,sizeof(retval));
+			return retval;
+		}
+		// scaling by a power of two is exact, so rounding once with the default round to nearest even is too, unlike adding a half and truncating
+		static inline uint32_t roundToInt(const float value)
+		{
+			return uint32_t(std::nearbyint(value));
+		}
+		static inline uint64_t pack(const uint32_t lo, const uint32_t hi)
+		{
+			return uint64_t(lo)|(uint64_t(hi)<<32ull);
+		}
+
+		template<class ExecutionPolicy, typename F>
+		static inline void forEachChunk(ExecutionPolicy&& policy, const size_t count, F&& f)
+		{
+			nbl::core::vector<uint32_t> chunks((count+ChunkTexels-1ull)/ChunkTexels);
+			std::iota(chunks.begin(),chunks.end(),0u);
+			std::for_each(std::forward<ExecutionPolicy>(policy),chunks.begin(),chunks.end(),[&](const uint32_t chunk) -> void
+			{
+				const size_t begin = ChunkTexels*chunk;
+				f(begin,std::min(begin+ChunkTexels,count));
+			});
+		}
+
+		#ifdef _RGB18E7S3_CONVERTER_SSE_
+		// the block code is written once against these, one lane per texel
+		struct SSSE2
+		{
+			static inline constexpr uint32_t Width = 4u;
+			using float_t = __m128;
+			using int_t = __m128i;
+
+			static inline float_t load(const float* p) {return _mm_load_ps(p);}
+			static inline void store(float* p, const float_t v) {_mm_store_ps(p,v);}
+			static inline float_t set1(const float v) {return _mm_set1_ps(v);}
+			static inline int_t set1i(const uint32_t v) {return _mm_set1_epi32(int32_t(v));}
+			static inline float_t mul(const float_t a, const float_t b) {return _mm_mul_ps(a,b);}
+			static inline float_t min(const float_t a, const float_t b) {return _mm_min_ps(a,b);}
+			static inline float_t max(const float_t a, const float_t b) {return _mm_max_ps(a,b);}
+			static inline float_t andf(const float_t a, const float_t b) {return _mm_and_ps(a,b);}
+			static inline float_t ordered(const float_t a) {return _mm_cmpord_ps(a,a);}
+			static inline float_t less(const float_t a, const float_t b) {return _mm_cmplt_ps(a,b);}
+			static inline int_t round(const float_t a) {return _mm_cvtps_epi32(a);}
+			static inline float_t toFloat(const int_t a) {return _mm_cvtepi32_ps(a);}
+			static inline int_t asInt(const float_t a) {return _mm_castps_si128(a);}
+			static inline float_t asFloat(const int_t a) {return _mm_castsi128_ps(a);}
+			static inline int_t addi(const int_t a, const int_t b) {return _mm_add_epi32(a,b);}
+			static inline int_t subi(const int_t a, const int_t b) {return _mm_sub_epi32(a,b);}
+			static inline int_t andi(const int_t a, const int_t b) {return _mm_and_si128(a,b);}
+			static inline int_t ori(const int_t a, const int_t b) {return _mm_or_si128(a,b);}
+			static inline int_t equal(const int_t a, const int_t b) {return _mm_cmpeq_epi32(a,b);}
+			template<int N> static inline int_t shl(const int_t a) {return _mm_slli_epi32(a,N);}
+			template<int N> static inline int_t shr(const int_t a) {return _mm_srli_epi32(a,N);}
+
+			// `Width` 64bit values to and from their low and high halves
+			static inline void storeEncoded(uint64_t* out, const int_t lo, const int_t hi)
+			{
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out),_mm_unpacklo_epi32(lo,hi));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out)+1,_mm_unpackhi_epi32(lo,hi));
+			}
+			static inline void loadEncoded(const uint64_t* in, int_t& lo, int_t& hi)
+			{
+				const __m128 a = _mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in)));
+				const __m128 b = _mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in)+1));
+				lo = _mm_castps_si128(_mm_shuffle_ps(a,b,_MM_SHUFFLE(2,0,2,0)));
+				hi = _mm_castps_si128(_mm_shuffle_ps(a,b,_MM_SHUFFLE(3,1,3,1)));
+			}
+		};
+		#endif
+		#ifdef _RGB18E7S3_CONVERTER_AVX2_
+		struct SAVX2
+		{
+			static inline constexpr uint32_t Width = 8u;
+			using float_t = __m256;
+			using int_t = __m256i;
+
+			static inline float_t load(const float* p) {return _mm256_load_ps(p);}
+			static inline void store(float* p, const float_t v) {_mm256_store_ps(p,v);}
+			static inline float_t set1(const float v) {return _mm256_set1_ps(v);}
+			static inline int_t set1i(const uint32_t v) {return _mm256_set1_epi32(int32_t(v));}
+			static inline float_t mul(const float_t a, const float_t b) {return _mm256_mul_ps(a,b);}
+			static inline float_t min(const float_t a, const float_t b) {return _mm256_min_ps(a,b);}
+			static inline float_t max(const float_t a, const float_t b) {return _mm256_max_ps(a,b);}
+			static inline float_t andf(const float_t a, const float_t b) {return _mm256_and_ps(a,b);}
+			static inline float_t ordered(const float_t a) {return _mm256_cmp_ps(a,a,_CMP_ORD_Q);}
+			static inline float_t less(const float_t a, const float_t b) {return _mm256_cmp_ps(a,b,_CMP_LT_OQ);}
+			static inline int_t round(const float_t a) {return _mm256_cvtps_epi32(a);}
+			static inline float_t toFloat(const int_t a) {return _mm256_cvtepi32_ps(a);}
+			static inline int_t asInt(const float_t a) {return _mm256_castps_si256(a);}
+			static inline float_t asFloat(const int_t a) {return _mm256_castsi256_ps(a);}
+			static inline int_t addi(const int_t a, const int_t b) {return _mm256_add_epi32(a,b);}
+			static inline int_t subi(const int_t a, const int_t b) {return _mm256_sub_epi32(a,b);}
+			static inline int_t andi(const int_t a, const int_t b) {return _mm256_and_si256(a,b);}
+			static inline int_t ori(const int_t a, const int_t b) {return _mm256_or_si256(a,b);}
+			static inline int_t equal(const int_t a, const int_t b) {return _mm256_cmpeq_epi32(a,b);}
+			template<int N> static inline int_t shl(const int_t a) {return _mm256_slli_epi32(a,N);}
+			template<int N> static inline int_t shr(const int_t a) {return _mm256_srli_epi32(a,N);}
+
+			// unpacking works within 128bit lanes, so the halves get swapped around after
+			static inline void storeEncoded(uint64_t* out, const int_t lo, const int_t hi)
+			{
+				const __m256i first = _mm256_unpacklo_epi32(lo,hi);
+				const __m256i second = _mm256_unpackhi_epi32(lo,hi);
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(out),_mm256_permute2x128_si256(first,second,0x20));
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(out)+1,_mm256_permute2x128_si256(first,second,0x31));
+			}
+			static inline void loadEncoded(const uint64_t* in, int_t& lo, int_t& hi)
+			{
+				const __m256 a = _mm256_castsi256_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(in)));
+				const __m256 b = _mm256_castsi256_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(in)+1));
+				lo = _mm256_permute4x64_epi64(_mm256_castps_si256(_mm256_shuffle_ps(a,b,_MM_SHUFFLE(2,0,2,0))),_MM_SHUFFLE(3,1,2,0));
+				hi = _mm256_permute4x64_epi64(_mm256_castps_si256(_mm256_shuffle_ps(a,b,_MM_SHUFFLE(3,1,3,1))),_MM_SHUFFLE(3,1,2,0));
+			}
+		};
+		#endif
+
+		template<class V>
+		static inline void encodeBlock(uint64_t* out, const float* rgb)
+		{
+			using float_t = typename V::float_t;
+			using int_t = typename V::int_t;
+
+			// deinterleaving through the stack is as fast as the shuffles, the loop gets vectorized
+			alignas(32) float channels[3][V::Width];
+			for (uint32_t i=0u; i<V::Width; i++)
+			for (auto c=0u; c<3u; c++)
+				channels[c][i] = rgb[i*3u+c];
+
+			const float_t zero = V::set1(0.f);
+			const float_t absMask = V::asFloat(V::set1i(0x7fffffffu));
+			float_t magnitude[3];
+			int_t signs = V::set1i(0u);
+			float_t maxMagnitude = zero;
+			for (auto c=0u; c<3u; c++)
+			{
+				float_t value = V::load(channels[c]);
+				value = V::andf(value,V::ordered(value));
+				value = V::min(V::max(value,V::set1(-MaxValue)),V::set1(MaxValue));
+				signs = V::ori(signs,V::andi(V::asInt(V::less(value,zero)),V::set1i(0x1u<<(29u+c))));
+				magnitude[c] = V::andf(value,absMask);
+				maxMagnitude = V::max(maxMagnitude,magnitude[c]);
+			}
+
+			const int_t exponentBits = V::template shr<23>(V::asInt(V::max(maxMagnitude,V::set1(MinSharedExponentValue))));
+			int_t scaleBits = V::subi(V::set1i(ScaleBitsBase),V::template shl<23>(exponentBits));
+			int_t sharedExponent = V::subi(exponentBits,V::set1i(127u-ExponentBias-1u));
+			const int_t needsBump = V::equal(V::round(V::mul(maxMagnitude,V::asFloat(scaleBits))),V::set1i(0x1u<<MantissaBits));
+			scaleBits = V::subi(scaleBits,V::andi(needsBump,V::set1i(0x1u<<23u)));
+			sharedExponent = V::subi(sharedExponent,needsBump);
+			const float_t scale = V::asFloat(scaleBits);
+
+			int_t mantissa[3];
+			for (auto c=0u; c<3u; c++)
+				mantissa[c] = V::round(V::mul(magnitude[c],scale));
+			const int_t lo = V::ori(mantissa[0],V::template shl<18>(mantissa[1]));
+			const int_t hi = V::ori(
+				V::ori(V::template shr<14>(mantissa[1]),V::template shl<4>(mantissa[2])),
+				V::ori(V::template shl<22>(sharedExponent),signs)
+			);
+			V::storeEncoded(out,lo,hi);
+		}
+
+		template<class V>
+		static inline void decodeBlock(float* rgb, const uint64_t* in)
+		{
+			using float_t = typename V::float_t;
+			using int_t = typename V::int_t;
+
+			int_t lo,hi;
+			V::loadEncoded(in,lo,hi);
+			const int_t mantissaMask = V::set1i(MantissaMask);
+			const int_t signMask = V::set1i(0x80000000u);
+			const float_t scale = V::asFloat(V::template shl<23>(V::addi(V::andi(V::template shr<22>(hi),V::set1i(0x7fu)),V::set1i(DecodeScaleBias))));
+			const int_t mantissa[3] = {
+				V::andi(lo,mantissaMask),
+				V::ori(V::template shr<18>(lo),V::template shl<14>(V::andi(hi,V::set1i(0xfu)))),
+				V::andi(V::template shr<4>(hi),mantissaMask)
+			};
+			const int_t signs[3] = {V::andi(V::template shl<2>(hi),signMask),V::andi(V::template shl<1>(hi),signMask),V::andi(hi,signMask)};
+
+			alignas(32) float channels[3][V::Width];
+			for (auto c=0u; c<3u; c++)
+				V::store(channels[c],V::asFloat(V::ori(V::asInt(V::mul(V::toFloat(mantissa[c]),scale)),signs[c])));
+			for (uint32_t i=0u; i<V::Width; i++)
+			for (auto c=0u; c<3u; c++)
+				rgb[i*3u+c] = channels[c][i];
+		}
+};
+
+#endif
@@ -0,0 +1,961 @@
+#ifndef _C_CPU_ACCELERATION_STRUCTURE_INCLUDED_
+#define _C_CPU_ACCELERATION_STRUCTURE_INCLUDED_
+
+#include "nabla.h"
+
+#include <cfloat>
+#include <cmath>
+#include <array>
+#include <thread>
+#include <numeric>
+#include <algorithm>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP>=2)
+#include <immintrin.h>
+#define _CPU_ACCELERATION_STRUCTURE_SSE_
+#endif
+
+
+// Host side build and traversal of the bottom and top level acceleration structures 56.RayQuery otherwise only gets from the GPU, for ray
+// queries (picking, occlusion, baking) on machines without ray tracing hardware.
+//
+// Takes the same `ICPUAccelerationStructure::HostBuildGeometryInfo` and `BuildRangeInfo`s as the GPU build: triangles with 3 or 4 float positions,
+// AABBs, or instances. Instances reference their bottom level structure by index into the `blases` passed to `create`, in place of the device
+// address in `accelerationStructureReference`, and the top level structure keeps those alive.
+//
+// The build is a binned SAH one: the top of the tree gets split serially, with the binning and bounds spread over threads, until there are
+// enough subtrees to build them all in parallel. The binary tree then gets collapsed into 4 wide nodes, which a single ray traverses testing
+// all 4 child boxes at once with SSE. Batches of rays get spread over threads.
+// AABB primitives need an intersector, like the intersection part of a ray query, the default one reports a hit where the ray enters the box.
+class CCPUAccelerationStructure : public nbl::core::IReferenceCounted
+{
+	public:
+		using HostBuildGeometryInfo = nbl::asset::ICPUAccelerationStructure::HostBuildGeometryInfo;
+		using BuildRangeInfo = nbl::asset::ICPUAccelerationStructure::BuildRangeInfo;
+		using Instance = nbl::asset::ICPUAccelerationStructure::Instance;
+		using type_t = decltype(HostBuildGeometryInfo::type);
+		using geometry_type_t = decltype(HostBuildGeometryInfo::Geom::type);
+
+		static inline constexpr uint32_t InvalidIndex = ~0u;
+		static inline constexpr uint32_t MaxPrimitiveCount = 0x1u<<27u;
+
+		struct SRay
+		{
+			float origin[3];
+			float tMin = 0.f;
+			// doesn't need to be normalized, `t` is in multiples of it
+			float direction[3];
+			float tMax = FLT_MAX;
+			// against the instance masks, only in top level structures
+			uint32_t mask = 0xffu;
+		};
+		struct SHit
+		{
+			float t;
+			// barycentrics of the second and third vertex, for triangles
+			float u = 0.f, v = 0.f;
+			uint32_t instanceIndex = InvalidIndex;
+			uint32_t instanceCustomIndex = InvalidIndex;
+			uint32_t geometryIndex = InvalidIndex;
+			uint32_t primitiveIndex = InvalidIndex;
+
+			inline bool valid() const {return primitiveIndex!=InvalidIndex;}
+		};
+		// an AABB primitive the ray entered, `ray` is in the space of the bottom level structure
+		struct SProceduralCandidate
+		{
+			const SRay& ray;
+			float tEnter;
+			const float* boxMin;
+			const float* boxMax;
+			uint32_t instanceIndex;
+			uint32_t geometryIndex;
+			uint32_t primitiveIndex;
+		};
+		// Intersectors return whether the primitive got hit and where, only hits in `[ray.tMin,tMax)` count. They get called from many threads at once.
+		struct SBoxIntersector
+		{
+			inline bool operator()(const SProceduralCandidate& candidate, const float tMax, float& t) const
+			{
+				t = candidate.tEnter;
+				return t<tMax;
+			}
+		};
+
+		// nullptr if the inputs can't be built, the reason gets logged
+		static nbl::core::smart_refctd_ptr<CCPUAccelerationStructure> create(
+			const HostBuildGeometryInfo& info, const BuildRangeInfo* ranges,
+			const nbl::core::smart_refctd_ptr<CCPUAccelerationStructure>* blases=nullptr, const uint32_t blasCount=0u,
+			nbl::system::logger_opt_ptr logger=nullptr
+		)
+		{
+			auto retval = nbl::core::smart_refctd_ptr<CCPUAccelerationStructure>(new CCPUAccelerationStructure(info.type),nbl::core::dont_grab);
+			if (!retval->gather(info,ranges,blases,blasCount,logger))
+				return nullptr;
+			retval->build();
+			return retval;
+		}
+
+		inline type_t getType() const {return type;}
+		inline uint32_t getPrimitiveCount() const {return primitiveCount;}
+		inline uint32_t getNodeCount() const {return nodes.size();}
+		inline nbl::core::aabbox3df getBounds() const
+		{
+			return nbl::core::aabbox3df(bounds.min[0],bounds.min[1],bounds.min[2],bounds.max[0],bounds.max[1],bounds.max[2]);
+		}
+
+		// closest hit, `t` is `ray.tMax` and the indices invalid on a miss
+		template<class Intersector=SBoxIntersector>
+		inline SHit intersect(const SRay& ray, const Intersector& intersector={}) const
+		{
+			SHit hit;
+			hit.t = ray.tMax;
+			traverse<false>(ray,hit,intersector,InvalidIndex);
+			return hit;
+		}
+		// any hit
+		template<class Intersector=SBoxIntersector>
+		inline bool occluded(const SRay& ray, const Intersector& intersector={}) const
+		{
+			SHit hit;
+			hit.t = ray.tMax;
+			return traverse<true>(ray,hit,intersector,InvalidIndex);
+		}
+
+		template<class Intersector=SBoxIntersector>
+		void intersect(const SRay* rays, SHit* hits, const uint32_t count, const Intersector& intersector={}) const
+		{
+			forChunks(count,RaysPerChunk,[&](const uint32_t begin, const uint32_t end) -> void
+			{
+				for (auto i=begin; i<end; i++)
+					hits[i] = intersect(rays[i],intersector);
+			});
+		}
+		// `occluded` is 1 where there was any hit, 0 otherwise
+		template<class Intersector=SBoxIntersector>
+		void occluded(const SRay* rays, uint8_t* occluded, const uint32_t count, const Intersector& intersector={}) const
+		{
+			forChunks(count,RaysPerChunk,[&](const uint32_t begin, const uint32_t end) -> void
+			{
+				for (auto i=begin; i<end; i++)
+					occluded[i] = this->occluded(rays[i],intersector) ? 1u:0u;
+			});
+		}
+
+	private:
+		static inline constexpr uint32_t BinCount = 16u;
+		static inline constexpr uint32_t MaxLeafSize = 8u;
+		// past it splits are made at the median, which bounds the depth of the tree and the traversal stack
+		static inline constexpr uint32_t MaxSAHDepth = 48u;
+		static inline constexpr uint32_t StackSize = 256u;
+		static inline constexpr uint32_t ChunkSize = 0x1u<<14u;
+		static inline constexpr uint32_t RaysPerChunk = 256u;
+		static inline constexpr float TraversalCost = 1.f;
+		static inline constexpr uint32_t LeafBit = 0x80000000u;
+		static inline constexpr uint32_t EmptyChild = ~0u;
+
+		struct SBounds
+		{
+			float min[3] = {FLT_MAX,FLT_MAX,FLT_MAX};
+			float max[3] = {-FLT_MAX,-FLT_MAX,-FLT_MAX};
+
+			inline void extend(const float* p)
+			{
+				for (auto c=0u; c<3u; c++)
+				{
+					min[c] = std::min(min[c],p[c]);
+					max[c] = std::max(max[c],p[c]);
+				}
+			}
+			inline void merge(const SBounds& other)
+			{
+				for (auto c=0u; c<3u; c++)
+				{
+					min[c] = std::min(min[c],other.min[c]);
+					max[c] = std::max(max[c],other.max[c]);
+				}
+			}
+			inline float area() const
+			{
+				if (min[0]>max[0])
+					return 0.f;
+				const float x = max[0]-min[0], y = max[1]-min[1], z = max[2]-min[2];
+				return x*y+y*z+z*x;
+			}
+		};
+		struct SPrimitiveRef
+		{
+			SBounds bounds;
+			float centroid[3];
+		};
+
+		struct STriangle
+		{
+			float v0[3];
+			float e1[3];
+			float e2[3];
+			uint32_t geometryIndex;
+			uint32_t primitiveIndex;
+		};
+		struct SBox
+		{
+			SBounds bounds;
+			uint32_t geometryIndex;
+			uint32_t primitiveIndex;
+		};
+		struct SInstance
+		{
+			// object to world only gets needed for the bounds
+			float worldToObject[3][4];
+			uint32_t index;
+			uint32_t customIndex;
+			uint32_t mask;
+			nbl::core::smart_refctd_ptr<const CCPUAccelerationStructure> blas;
+		};
+
+		// 4 children, bounds as rows of minX,maxX,minY,maxY,minZ,maxZ so the near and far planes can get picked by the ray direction's signs
+		struct alignas(16) SNode
+		{
+			float bounds[6][4];
+			// `LeafBit|(count-1)<<27|first` for leaves
+			uint32_t children[4];
+		};
+
+		struct SBuildNode
+		{
+			SBounds bounds;
+			uint32_t first = 0u;
+			// non zero for leaves
+			uint32_t count = 0u;
+			uint32_t children[2] = {InvalidIndex,InvalidIndex};
+			// placeholder for the subtree built by this task
+			uint32_t task = InvalidIndex;
+		};
+		struct STask
+		{
+			uint32_t* begin;
+			uint32_t* end;
+			uint32_t depth;
+		};
+		struct SBuildRef
+		{
+			uint32_t tree;
+			uint32_t node;
+		};
+
+		CCPUAccelerationStructure(const type_t _type) : type(_type) {}
+
+		template<typename F>
+		static inline void forChunks(const uint32_t count, const uint32_t chunkSize, F&& f)
+		{
+			if (count<=chunkSize)
+			{
+				f(0u,count);
+				return;
+			}
+			nbl::core::vector<uint32_t> chunks;
+			for (uint32_t begin=0u; begin<count; begin+=chunkSize)
+				chunks.push_back(begin);
+			std::for_each(nbl::core::execution::par_unseq,chunks.begin(),chunks.end(),[&](const uint32_t begin) -> void
+			{
+				f(begin,std::min(begin+chunkSize,count));
+			});
+		}
+
+		static inline void transformPoint(const float* matrix, const float* p, float* out)
+		{
+			for (auto r=0u; r<3u; r++)
+				out[r] = matrix[r*4u+0u]*p[0]+matrix[r*4u+1u]*p[1]+matrix[r*4u+2u]*p[2]+matrix[r*4u+3u];
+		}
+
+		// fills the primitive arrays in the order they come in and the references the tree gets built over
+		bool gather(const HostBuildGeometryInfo& info, const BuildRangeInfo* ranges, const nbl::core::smart_refctd_ptr<CCPUAccelerationStructure>* blases, const uint32_t blasCount, nbl::system::logger_opt_ptr logger)
+		{
+			using namespace nbl::asset;
+			const uint32_t geometryCount = info.geometries ? info.geometries->size():0u;
+			nbl::core::vector<uint32_t> offsets(geometryCount+1u,0u);
+			for (auto g=0u; g<geometryCount; g++)
+			{
+				const auto& geometry = info.geometries->operator[](g);
+				if (geometry.type!=info.geometries->operator[](0u).type)
+				{
+					logger.log("CCPUAccelerationStructure: all geometries of a structure need to be of the same type.",nbl::system::ILogger::ELL_ERROR);
+					return false;
+				}
+				switch (geometry.type)
+				{
+					case IAccelerationStructure::EGT_TRIANGLES:
+						if (type!=IAccelerationStructure::ET_BOTTOM_LEVEL || !geometry.data.triangles.vertexData.buffer)
+							return false;
+						if (geometry.data.triangles.vertexFormat!=EF_R32G32B32_SFLOAT && geometry.data.triangles.vertexFormat!=EF_R32G32B32A32_SFLOAT)
+						{
+							logger.log("CCPUAccelerationStructure: only 3 or 4 float vertex positions are supported.",nbl::system::ILogger::ELL_ERROR);
+							return false;
+						}
+						if (geometry.data.triangles.indexType!=EIT_UNKNOWN && !geometry.data.triangles.indexData.buffer)
+							return false;
+						break;
+					case IAccelerationStructure::EGT_AABBS:
+						if (type!=IAccelerationStructure::ET_BOTTOM_LEVEL || !geometry.data.aabbs.data.buffer)
+							return false;
+						break;
+					case IAccelerationStructure::EGT_INSTANCES:
+						if (type!=IAccelerationStructure::ET_TOP_LEVEL || !geometry.data.instances.data.buffer)
+							return false;
+						break;
+					default:
+						return false;
+				}
+				offsets[g+1u] = offsets[g]+ranges[g].primitiveCount;
+			}
+			primitiveCount = offsets[geometryCount];
+			if (primitiveCount>=MaxPrimitiveCount)
+			{
+				logger.log("CCPUAccelerationStructure: more than %u primitives.",nbl::system::ILogger::ELL_ERROR,MaxPrimitiveCount);
+				return false;
+			}
+			if (primitiveCount==0u)
+				return true;
+			geometryType = info.geometries->operator[](0u).type;
+			primitiveRefs.resize(primitiveCount);
+
+			// resolve the instances serially, as they can fail
+			if (geometryType==IAccelerationStructure::EGT_INSTANCES)
+			{
+				instances.resize(primitiveCount);
+				for (auto g=0u; g<geometryCount; g++)
+				{
+					const auto& data = info.geometries->operator[](g).data.instances.data;
+					const auto* src = reinterpret_cast<const Instance*>(reinterpret_cast<const uint8_t*>(data.buffer->getPointer())+data.offset+ranges[g].primitiveOffset);
+					for (auto p=0u; p<ranges[g].primitiveCount; p++)
+					{
+						const auto& instance = src[p];
+						const uint64_t blasIx = instance.accelerationStructureReference;
+						if (blasIx>=blasCount || !blases[blasIx] || blases[blasIx]->getType()!=IAccelerationStructure::ET_BOTTOM_LEVEL)
+						{
+							logger.log("CCPUAccelerationStructure: instance %u references %llu, which isn't one of the %u bottom level structures passed.",nbl::system::ILogger::ELL_ERROR,p,static_cast<unsigned long long>(blasIx),blasCount);
+							return false;
+						}
+						static_assert(sizeof(instance.mat)==sizeof(float)*12u);
+						const float* objectToWorld = reinterpret_cast<const float*>(&instance.mat);
+						auto& dst = instances[offsets[g]+p];
+						invertAffine(objectToWorld,&dst.worldToObject[0][0]);
+						dst.index = offsets[g]+p;
+						dst.customIndex = instance.instanceCustomIndex;
+						dst.mask = instance.mask;
+						dst.blas = blases[blasIx];
+
+						auto& ref = primitiveRefs[offsets[g]+p];
+						const auto& blasBounds = dst.blas->bounds;
+						if (blasBounds.min[0]<=blasBounds.max[0])
+						for (auto corner=0u; corner<8u; corner++)
+						{
+							const float local[3] = {
+								corner&0x1u ? blasBounds.max[0]:blasBounds.min[0],
+								corner&0x2u ? blasBounds.max[1]:blasBounds.min[1],
+								corner&0x4u ? blasBounds.max[2]:blasBounds.min[2]
+							};
+							float world[3];
+							transformPoint(objectToWorld,local,world);
+							ref.bounds.extend(world);
+						}
+					}
+				}
+			}
+			else if (geometryType==IAccelerationStructure::EGT_TRIANGLES)
+				triangles.resize(primitiveCount);
+			else
+				boxes.resize(primitiveCount);
+
+			forChunks(primitiveCount,ChunkSize,[&](const uint32_t begin, const uint32_t end) -> void
+			{
+				uint32_t g = std::upper_bound(offsets.begin(),offsets.end(),begin)-offsets.begin()-1u;
+				for (auto i=begin; i<end; i++)
+				{
+					while (i>=offsets[g+1u])
+						g++;
+					const uint32_t p = i-offsets[g];
+					const auto& geometry = info.geometries->operator[](g);
+					const auto& range = ranges[g];
+					auto& ref = primitiveRefs[i];
+					switch (geometryType)
+					{
+						case IAccelerationStructure::EGT_TRIANGLES:
+						{
+							const auto& data = geometry.data.triangles;
+							const uint8_t* vertices = reinterpret_cast<const uint8_t*>(data.vertexData.buffer->getPointer())+data.vertexData.offset;
+							float v[3][3];
+							for (auto k=0u; k<3u; k++)
+							{
+								const uint8_t* vertex;
+								if (data.indexType==EIT_UNKNOWN)
+									vertex = vertices+range.primitiveOffset+(size_t(range.firstVertex)+p*3u+k)*data.vertexStride;
+								else
+								{
+									const uint8_t* indices = reinterpret_cast<const uint8_t*>(data.indexData.buffer->getPointer())+data.indexData.offset+range.primitiveOffset;
+									const uint32_t index = data.indexType==EIT_16BIT ? reinterpret_cast<const uint16_t*>(indices)[p*3u+k]:reinterpret_cast<const uint32_t*>(indices)[p*3u+k];
+									vertex = vertices+(size_t(range.firstVertex)+index)*data.vertexStride;
+								}
+								memcpy(v[k],vertex,sizeof(float)*3u);
+							}
+							if (data.transformData.buffer)
+							{
+								const float* transform = reinterpret_cast<const float*>(reinterpret_cast<const uint8_t*>(data.transformData.buffer->getPointer())+data.transformData.offset+range.transformOffset);
+								for (auto k=0u; k<3u; k++)
+								{
+									float world[3];
+									transformPoint(transform,v[k],world);
+									memcpy(v[k],world,sizeof(world));
+								}
+							}
+							auto& triangle = triangles[i];
+							for (auto c=0u; c<3u; c++)
+							{
+								triangle.v0[c] = v[0][c];
+								triangle.e1[c] = v[1][c]-v[0][c];
+								triangle.e2[c] = v[2][c]-v[0][c];
+							}
+							triangle.geometryIndex = g;
+							triangle.primitiveIndex = p;
+							for (auto k=0u; k<3u; k++)
+								ref.bounds.extend(v[k]);
+							break;
+						}
+						case IAccelerationStructure::EGT_AABBS:
+						{
+							const auto& data = geometry.data.aabbs;
+							const float* box = reinterpret_cast<const float*>(reinterpret_cast<const uint8_t*>(data.data.buffer->getPointer())+data.data.offset+range.primitiveOffset+size_t(p)*data.stride);
+							auto& dst = boxes[i];
+							dst.bounds.extend(box);
+							dst.bounds.extend(box+3u);
+							dst.geometryIndex = g;
+							dst.primitiveIndex = p;
+							ref.bounds = dst.bounds;
+							break;
+						}
+						default:
+							break;
+					}
+					// instances whose structure is empty
+					if (ref.bounds.min[0]>ref.bounds.max[0])
+						ref.bounds.min[0] = ref.bounds.min[1] = ref.bounds.min[2] = ref.bounds.max[0] = ref.bounds.max[1] = ref.bounds.max[2] = 0.f;
+					for (auto c=0u; c<3u; c++)
+						ref.centroid[c] = (ref.bounds.min[c]+ref.bounds.max[c])*0.5f;
+				}
+			});
+			return true;
+		}
+
+		static inline void invertAffine(const float* m, float* out)
+		{
+			const float cofactors[3][3] = {
+				{m[5]*m[10]-m[6]*m[9], m[2]*m[9]-m[1]*m[10], m[1]*m[6]-m[2]*m[5]},
+				{m[6]*m[8]-m[4]*m[10], m[0]*m[10]-m[2]*m[8], m[2]*m[4]-m[0]*m[6]},
+				{m[4]*m[9]-m[5]*m[8], m[1]*m[8]-m[0]*m[9], m[0]*m[5]-m[1]*m[4]}
+			};
+			const float det = m[0]*cofactors[0][0]+m[1]*cofactors[1][0]+m[2]*cofactors[2][0];
+			const float rcpDet = det!=0.f ? 1.f/det:0.f;
+			for (auto r=0u; r<3u; r++)
+			{
+				for (auto c=0u; c<3u; c++)
+					out[r*4u+c] = cofactors[r][c]*rcpDet;
+				out[r*4u+3u] = -(out[r*4u+0u]*m[3]+out[r*4u+1u]*m[7]+out[r*4u+2u]*m[11]);
+			}
+		}
+
+		void build()
+		{
+			if (primitiveCount==0u)
+				return;
+			order.resize(primitiveCount);
+			std::iota(order.begin(),order.end(),0u);
+
+			// enough subtrees to keep every thread busy even when they come out unbalanced
+			const uint32_t threadCount = std::max(std::thread::hardware_concurrency(),1u);
+			const uint32_t taskSize = std::max(primitiveCount/(threadCount*8u),1024u);
+			nbl::core::vector<STask> tasks;
+			trees.resize(1u);
+			buildNode(order.data(),order.data()+primitiveCount,0u,trees[0],&tasks,taskSize);
+			trees.resize(tasks.size()+1u);
+			nbl::core::vector<uint32_t> taskIxs(tasks.size());
+			std::iota(taskIxs.begin(),taskIxs.end(),0u);
+			std::for_each(nbl::core::execution::par_unseq,taskIxs.begin(),taskIxs.end(),[&](const uint32_t t) -> void
+			{
+				buildNode(tasks[t].begin,tasks[t].end,tasks[t].depth,trees[t+1u],nullptr,0u);
+			});
+
+			const auto root = resolve({0u,0u});
+			bounds = getBuildNode(root).bounds;
+			if (getBuildNode(root).count)
+			{
+				nodes.emplace_back();
+				initNode(nodes.back());
+				setChild(nodes.back(),0u,getBuildNode(root));
+			}
+			else
+				collapse(root);
+			trees.clear();
+			primitiveRefs.clear();
+
+			// primitives in the order the leaves reference them
+			auto reorder = [this](auto& primitives) -> void
+			{
+				std::remove_reference_t<decltype(primitives)> sorted(primitives.size());
+				forChunks(primitiveCount,ChunkSize,[&](const uint32_t begin, const uint32_t end) -> void
+				{
+					for (auto i=begin; i<end; i++)
+						sorted[i] = primitives[order[i]];
+				});
+				primitives = std::move(sorted);
+			};
+			if (!triangles.empty())
+				reorder(triangles);
+			if (!boxes.empty())
+				reorder(boxes);
+			if (!instances.empty())
+				reorder(instances);
+			order.clear();
+		}
+
+		inline std::pair<SBounds,SBounds> computeBounds(const uint32_t* begin, const uint32_t* end, const bool parallel) const
+		{
+			auto computeRange = [this](const uint32_t* begin, const uint32_t* end) -> std::pair<SBounds,SBounds>
+			{
+				std::pair<SBounds,SBounds> retval;
+				for (auto it=begin; it!=end; it++)
+				{
+					retval.first.merge(primitiveRefs[*it].bounds);
+					retval.second.extend(primitiveRefs[*it].centroid);
+				}
+				return retval;
+			};
+			const uint32_t count = end-begin;
+			if (!parallel || count<=ChunkSize)
+				return computeRange(begin,end);
+			nbl::core::vector<std::pair<SBounds,SBounds>> partial((count-1u)/ChunkSize+1u);
+			forChunks(count,ChunkSize,[&](const uint32_t first, const uint32_t last) -> void
+			{
+				partial[first/ChunkSize] = computeRange(begin+first,begin+last);
+			});
+			std::pair<SBounds,SBounds> retval;
+			for (const auto& bounds : partial)
+			{
+				retval.first.merge(bounds.first);
+				retval.second.merge(bounds.second);
+			}
+			return retval;
+		}
+
+		struct SBin
+		{
+			SBounds bounds;
+			uint32_t count = 0u;
+		};
+		using bins_t = std::array<std::array<SBin,BinCount>,3u>;
+
+		// nullptr if making a leaf is cheaper or no split could be found
+		uint32_t* splitSAH(uint32_t* begin, uint32_t* end, const SBounds& nodeBounds, const SBounds& centroidBounds, const bool parallel) const
+		{
+			const uint32_t count = end-begin;
+			float scale[3];
+			for (auto c=0u; c<3u; c++)
+			{
+				const float extent = centroidBounds.max[c]-centroidBounds.min[c];
+				scale[c] = extent>0.f ? float(BinCount)*(1.f-FLT_EPSILON)/extent:0.f;
+			}
+			auto binOf = [&](const float* centroid, const uint32_t axis) -> uint32_t
+			{
+				return std::min(static_cast<uint32_t>((centroid[axis]-centroidBounds.min[axis])*scale[axis]),BinCount-1u);
+			};
+			auto binRange = [&](const uint32_t* begin, const uint32_t* end) -> bins_t
+			{
+				bins_t bins;
+				for (auto it=begin; it!=end; it++)
+				{
+					const auto& ref = primitiveRefs[*it];
+					for (auto axis=0u; axis<3u; axis++)
+					{
+						auto& bin = bins[axis][binOf(ref.centroid,axis)];
+						bin.bounds.merge(ref.bounds);
+						bin.count++;
+					}
+				}
+				return bins;
+			};
+			bins_t bins;
+			if (!parallel || count<=ChunkSize)
+				bins = binRange(begin,end);
+			else
+			{
+				nbl::core::vector<bins_t> partial((count-1u)/ChunkSize+1u);
+				forChunks(count,ChunkSize,[&](const uint32_t first, const uint32_t last) -> void
+				{
+					partial[first/ChunkSize] = binRange(begin+first,begin+last);
+				});
+				for (const auto& part : partial)
+				for (auto axis=0u; axis<3u; axis++)
+				for (auto b=0u; b<BinCount; b++)
+				{
+					bins[axis][b].bounds.merge(part[axis][b].bounds);
+					bins[axis][b].count += part[axis][b].count;
+				}
+			}
+
+			float bestCost = FLT_MAX;
+			uint32_t bestAxis = InvalidIndex, bestBin = 0u;
+			for (auto axis=0u; axis<3u; axis++)
+			{
+				if (scale[axis]==0.f)
+					continue;
+				// cost of everything right of the split, swept from the right
+				float rightCost[BinCount];
+				{
+					SBounds right;
+					uint32_t rightCount = 0u;
+					for (auto b=BinCount-1u; b>0u; b--)
+					{
+						right.merge(bins[axis][b].bounds);
+						rightCount += bins[axis][b].count;
+						rightCost[b] = right.area()*float(rightCount);
+					}
+				}
+				SBounds left;
+				uint32_t leftCount = 0u;
+				for (auto b=1u; b<BinCount; b++)
+				{
+					left.merge(bins[axis][b-1u].bounds);
+					leftCount += bins[axis][b-1u].count;
+					const float cost = left.area()*float(leftCount)+rightCost[b];
+					if (cost<bestCost && leftCount && leftCount<count)
+					{
+						bestCost = cost;
+						bestAxis = axis;
+						bestBin = b;
+					}
+				}
+			}
+			if (bestAxis==InvalidIndex)
+				return nullptr;
+			const float area = nodeBounds.area();
+			if (count<=MaxLeafSize && TraversalCost*area+bestCost>=area*float(count))
+				return nullptr;
+			uint32_t* mid = std::partition(begin,end,[&](const uint32_t ix) -> bool {return binOf(primitiveRefs[ix].centroid,bestAxis)<bestBin;});
+			return mid==begin || mid==end ? nullptr:mid;
+		}
+
+		uint32_t* splitMedian(uint32_t* begin, uint32_t* end, const SBounds& centroidBounds) const
+		{
+			uint32_t axis = 0u;
+			for (auto c=1u; c<3u; c++)
+			if (centroidBounds.max[c]-centroidBounds.min[c]>centroidBounds.max[axis]-centroidBounds.min[axis])
+				axis = c;
+			uint32_t* mid = begin+(end-begin)/2u;
+			std::nth_element(begin,mid,end,[&](const uint32_t a, const uint32_t b) -> bool {return primitiveRefs[a].centroid[axis]<primitiveRefs[b].centroid[axis];});
+			return mid;
+		}
+
+		// `tasks` only for the top of the tree, ranges up to `taskSize` get left to a task
+		uint32_t buildNode(uint32_t* begin, uint32_t* end, const uint32_t depth, nbl::core::vector<SBuildNode>& tree, nbl::core::vector<STask>* tasks, const uint32_t taskSize)
+		{
+			const uint32_t count = end-begin;
+			const uint32_t nodeIx = tree.size();
+			tree.emplace_back();
+			if (tasks && count<=taskSize)
+			{
+				tree[nodeIx].task = tasks->size();
+				tasks->push_back({begin,end,depth});
+				return nodeIx;
+			}
+			const auto [nodeBounds,centroidBounds] = computeBounds(begin,end,tasks!=nullptr);
+			tree[nodeIx].bounds = nodeBounds;
+			uint32_t* mid = nullptr;
+			if (count>1u && depth<MaxSAHDepth)
+				mid = splitSAH(begin,end,nodeBounds,centroidBounds,tasks!=nullptr);
+			if (!mid && count>MaxLeafSize)
+				mid = splitMedian(begin,end,centroidBounds);
+			if (!mid)
+			{
+				tree[nodeIx].first = begin-order.data();
+				tree[nodeIx].count = count;
+				return nodeIx;
+			}
+			const uint32_t left = buildNode(begin,mid,depth+1u,tree,tasks,taskSize);
+			const uint32_t right = buildNode(mid,end,depth+1u,tree,tasks,taskSize);
+			tree[nodeIx].children[0] = left;
+			tree[nodeIx].children[1] = right;
+			return nodeIx;
+		}
+
+		inline const SBuildNode& getBuildNode(const SBuildRef& ref) const {return trees[ref.tree][ref.node];}
+		inline SBuildRef resolve(const SBuildRef& ref) const
+		{
+			const auto& node = getBuildNode(ref);
+			return node.task!=InvalidIndex ? SBuildRef{node.task+1u,0u}:ref;
+		}
+
+		static inline void initNode(SNode& node)
+		{
+			for (auto i=0u; i<4u; i++)
+			{
+				for (auto c=0u; c<3u; c++)
+				{
+					node.bounds[c*2u+0u][i] = FLT_MAX;
+					node.bounds[c*2u+1u][i] = -FLT_MAX;
+				}
+				node.children[i] = EmptyChild;
+			}
+		}
+		static inline void setChild(SNode& node, const uint32_t i, const SBuildNode& child, const uint32_t wideIx=InvalidIndex)
+		{
+			for (auto c=0u; c<3u; c++)
+			{
+				node.bounds[c*2u+0u][i] = child.bounds.min[c];
+				node.bounds[c*2u+1u][i] = child.bounds.max[c];
+			}
+			node.children[i] = child.count ? (LeafBit|(child.count-1u)<<27u|child.first):wideIx;
+		}
+
+		// pulls the largest grandchildren up until there are 4 children
+		uint32_t collapse(const SBuildRef& ref)
+		{
+			const auto& node = getBuildNode(ref);
+			SBuildRef children[4] = {resolve({ref.tree,node.children[0]}),resolve({ref.tree,node.children[1]})};
+			uint32_t childCount = 2u;
+			while (childCount<4u)
+			{
+				uint32_t largest = InvalidIndex;
+				float largestArea = -1.f;
+				for (auto i=0u; i<childCount; i++)
+				{
+					const auto& child = getBuildNode(children[i]);
+					if (!child.count && child.bounds.area()>largestArea)
+					{
+						largest = i;
+						largestArea = child.bounds.area();
+					}
+				}
+				if (largest==InvalidIndex)
+					break;
+				const auto expanded = children[largest];
+				const auto& child = getBuildNode(expanded);
+				children[largest] = resolve({expanded.tree,child.children[0]});
+				children[childCount++] = resolve({expanded.tree,child.children[1]});
+			}
+
+			const uint32_t nodeIx = nodes.size();
+			nodes.emplace_back();
+			initNode(nodes[nodeIx]);
+			for (auto i=0u; i<childCount; i++)
+			{
+				const auto& child = getBuildNode(children[i]);
+				const uint32_t wideIx = child.count ? InvalidIndex:collapse(children[i]);
+				setChild(nodes[nodeIx],i,child,wideIx);
+			}
+			return nodeIx;
+		}
+
+		template<bool AnyHit, class Intersector>
+		bool traverse(const SRay& ray, SHit& hit, const Intersector& intersector, const uint32_t instanceIndex) const
+		{
+			if (nodes.empty())
+				return false;
+
+			float rcpDir[3], originRcpDir[3];
+			uint32_t nearRow[3], farRow[3];
+			for (auto c=0u; c<3u; c++)
+			{
+				const float d = std::abs(ray.direction[c])>1e-30f ? ray.direction[c]:std::copysign(1e-30f,ray.direction[c]);
+				rcpDir[c] = 1.f/d;
+				originRcpDir[c] = ray.origin[c]*rcpDir[c];
+				nearRow[c] = c*2u+(rcpDir[c]<0.f ? 1u:0u);
+				farRow[c] = c*2u+(rcpDir[c]<0.f ? 0u:1u);
+			}
+
+			struct SEntry
+			{
+				uint32_t child;
+				float tNear;
+			};
+			SEntry stack[StackSize];
+			uint32_t stackSize = 0u;
+			// root is a wide node
+			stack[stackSize++] = {0u,ray.tMin};
+			bool found = false;
+			while (stackSize)
+			{
+				const auto entry = stack[--stackSize];
+				if (entry.tNear>hit.t)
+					continue;
+				if (entry.child&LeafBit)
+				{
+					const uint32_t first = entry.child&(MaxPrimitiveCount-1u);
+					const uint32_t last = first+((entry.child>>27u)&0xfu)+1u;
+					if (intersectLeaf<AnyHit>(first,last,ray,hit,intersector,instanceIndex,rcpDir,originRcpDir))
+					{
+						found = true;
+						if constexpr (AnyHit)
+							return true;
+					}
+					continue;
+				}
+
+				const SNode& node = nodes[entry.child];
+				alignas(16) float tNear[4];
+				uint32_t hitMask;
+				// scaled up far distances make the slab test conservative against rounding, Ize 2013
+				constexpr float FarScale = 1.f+2.f*3.f*FLT_EPSILON;
+				#ifdef _CPU_ACCELERATION_STRUCTURE_SSE_
+				{
+					__m128 vNear = _mm_set1_ps(ray.tMin);
+					__m128 vFar = _mm_set1_ps(hit.t);
+					for (auto c=0u; c<3u; c++)
+					{
+						const __m128 rcp = _mm_set1_ps(rcpDir[c]);
+						const __m128 offset = _mm_set1_ps(originRcpDir[c]);
+						vNear = _mm_max_ps(vNear,_mm_sub_ps(_mm_mul_ps(_mm_load_ps(node.bounds[nearRow[c]]),rcp),offset));
+						vFar = _mm_min_ps(vFar,_mm_mul_ps(_mm_sub_ps(_mm_mul_ps(_mm_load_ps(node.bounds[farRow[c]]),rcp),offset),_mm_set1_ps(FarScale)));
+					}
+					_mm_store_ps(tNear,vNear);
+					hitMask = _mm_movemask_ps(_mm_cmple_ps(vNear,vFar));
+				}
+				#else
+				hitMask = 0u;
+				for (auto i=0u; i<4u; i++)
+				{
+					float tFar = hit.t;
+					tNear[i] = ray.tMin;
+					for (auto c=0u; c<3u; c++)
+					{
+						tNear[i] = std::max(tNear[i],node.bounds[nearRow[c]][i]*rcpDir[c]-originRcpDir[c]);
+						tFar = std::min(tFar,(node.bounds[farRow[c]][i]*rcpDir[c]-originRcpDir[c])*FarScale);
+					}
+					if (tNear[i]<=tFar)
+						hitMask |= 0x1u<<i;
+				}
+				#endif
+
+				// furthest pushed first so the nearest gets popped first
+				SEntry children[4];
+				uint32_t childCount = 0u;
+				for (auto i=0u; i<4u; i++)
+				if (hitMask&(0x1u<<i) && node.children[i]!=EmptyChild)
+				{
+					auto j = childCount++;
+					for (; j>0u && children[j-1u].tNear<tNear[i]; j--)
+						children[j] = children[j-1u];
+					children[j] = {node.children[i],tNear[i]};
+				}
+				for (auto i=0u; i<childCount; i++)
+					stack[stackSize++] = children[i];
+			}
+			return found;
+		}
+
+		template<bool AnyHit, class Intersector>
+		bool intersectLeaf(const uint32_t first, const uint32_t last, const SRay& ray, SHit& hit, const Intersector& intersector, const uint32_t instanceIndex, const float* rcpDir, const float* originRcpDir) const
+		{
+			bool found = false;
+			switch (geometryType)
+			{
+				case nbl::asset::IAccelerationStructure::EGT_TRIANGLES:
+					for (auto i=first; i<last; i++)
+					{
+						// Moller-Trumbore
+						const auto& triangle = triangles[i];
+						const float* d = ray.direction;
+						const float p[3] = {d[1]*triangle.e2[2]-d[2]*triangle.e2[1],d[2]*triangle.e2[0]-d[0]*triangle.e2[2],d[0]*triangle.e2[1]-d[1]*triangle.e2[0]};
+						const float det = triangle.e1[0]*p[0]+triangle.e1[1]*p[1]+triangle.e1[2]*p[2];
+						if (det==0.f)
+							continue;
+						const float rcpDet = 1.f/det;
+						const float s[3] = {ray.origin[0]-triangle.v0[0],ray.origin[1]-triangle.v0[1],ray.origin[2]-triangle.v0[2]};
+						const float u = (s[0]*p[0]+s[1]*p[1]+s[2]*p[2])*rcpDet;
+						if (u<0.f || u>1.f)
+							continue;
+						const float q[3] = {s[1]*triangle.e1[2]-s[2]*triangle.e1[1],s[2]*triangle.e1[0]-s[0]*triangle.e1[2],s[0]*triangle.e1[1]-s[1]*triangle.e1[0]};
+						const float v = (d[0]*q[0]+d[1]*q[1]+d[2]*q[2])*rcpDet;
+						if (v<0.f || u+v>1.f)
+							continue;
+						const float t = (triangle.e2[0]*q[0]+triangle.e2[1]*q[1]+triangle.e2[2]*q[2])*rcpDet;
+						if (t<ray.tMin || t>=hit.t)
+							continue;
+						hit.t = t;
+						hit.u = u;
+						hit.v = v;
+						hit.instanceIndex = instanceIndex;
+						hit.geometryIndex = triangle.geometryIndex;
+						hit.primitiveIndex = triangle.primitiveIndex;
+						if constexpr (AnyHit)
+							return true;
+						found = true;
+					}
+					break;
+				case nbl::asset::IAccelerationStructure::EGT_AABBS:
+					for (auto i=first; i<last; i++)
+					{
+						const auto& box = boxes[i];
+						float tEnter = ray.tMin, tExit = hit.t;
+						for (auto c=0u; c<3u; c++)
+						{
+							const float t0 = box.bounds.min[c]*rcpDir[c]-originRcpDir[c];
+							const float t1 = box.bounds.max[c]*rcpDir[c]-originRcpDir[c];
+							tEnter = std::max(tEnter,std::min(t0,t1));
+							tExit = std::min(tExit,std::max(t0,t1));
+						}
+						if (tEnter>tExit)
+							continue;
+						float t;
+						const SProceduralCandidate candidate = {ray,tEnter,box.bounds.min,box.bounds.max,instanceIndex,box.geometryIndex,box.primitiveIndex};
+						if (!intersector(candidate,hit.t,t) || t<ray.tMin || t>=hit.t)
+							continue;
+						hit.t = t;
+						hit.u = hit.v = 0.f;
+						hit.instanceIndex = instanceIndex;
+						hit.geometryIndex = box.geometryIndex;
+						hit.primitiveIndex = box.primitiveIndex;
+						if constexpr (AnyHit)
+							return true;
+						found = true;
+					}
+					break;
+				case nbl::asset::IAccelerationStructure::EGT_INSTANCES:
+					for (auto i=first; i<last; i++)
+					{
+						const auto& instance = instances[i];
+						if (!(instance.mask&ray.mask))
+							continue;
+						// not normalized, so distances stay the same in both spaces
+						SRay objectRay = ray;
+						transformPoint(&instance.worldToObject[0][0],ray.origin,objectRay.origin);
+						for (auto r=0u; r<3u; r++)
+							objectRay.direction[r] = instance.worldToObject[r][0]*ray.direction[0]+instance.worldToObject[r][1]*ray.direction[1]+instance.worldToObject[r][2]*ray.direction[2];
+						if (!instance.blas->template traverse<AnyHit>(objectRay,hit,intersector,instance.index))
+							continue;
+						hit.instanceCustomIndex = instance.customIndex;
+						if constexpr (AnyHit)
+							return true;
+						found = true;
+					}
+					break;
+				default:
+					break;
+			}
+			return found;
+		}
+
+		const type_t type;
+		geometry_type_t geometryType = nbl::asset::IAccelerationStructure::EGT_TRIANGLES;
+		uint32_t primitiveCount = 0u;
+		SBounds bounds;
+		nbl::core::vector<SNode> nodes;
+		// only the ones of `geometryType` get used
+		nbl::core::vector<STriangle> triangles;
+		nbl::core::vector<SBox> boxes;
+		nbl::core::vector<SInstance> instances;
+
+		// only while building
+		nbl::core::vector<SPrimitiveRef> primitiveRefs;
+		nbl::core::vector<uint32_t> order;
+		nbl::core::vector<nbl::core::vector<SBuildNode>> trees;
+};
+
+#endif
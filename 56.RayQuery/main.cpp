@@ -7,6 +7,7 @@
 #include <nabla.h>
 
 #include "../common/CommonAPI.h"
+#include "../common/CShaderPermutationCompiler.h"
 #include "../common/Camera.hpp"
 #include "nbl/ext/ScreenShot/ScreenShot.h"
 #include "nbl/video/utilities/CDumbPresentationOracle.h"
@@ -605,17 +606,12 @@ public:
 		auto gpuDescriptorSetLayout1 = logicalDevice->createDescriptorSetLayout(&uboBinding, &uboBinding + 1u);
 		auto gpuDescriptorSetLayout2 = logicalDevice->createDescriptorSetLayout(descriptorSet3Bindings, descriptorSet3Bindings+5u);
 
-		auto createGpuResources = [&](std::string pathToShader) -> core::smart_refctd_ptr<video::IGPUComputePipeline>
+		auto createGpuResources = [&](core::smart_refctd_ptr<asset::ICPUShader>&& spirv) -> core::smart_refctd_ptr<video::IGPUComputePipeline>
 		{
-			asset::IAssetLoader::SAssetLoadParams params{};
-			params.logger = logger.get();
-			//params.relativeDir = tmp.c_str();
-			auto spec = assetManager->getAsset(pathToShader,params).getContents();
-		
-			if (spec.empty())
+			if (!spirv)
 				assert(false);
 
-			auto cpuComputeSpecializedShader = core::smart_refctd_ptr_static_cast<asset::ICPUSpecializedShader>(*spec.begin());
+			auto cpuComputeSpecializedShader = core::make_smart_refctd_ptr<asset::ICPUSpecializedShader>(std::move(spirv),asset::ISpecializedShader::SInfo(nullptr,nullptr,"main"));
 
 			ISpecializedShader::SInfo info = cpuComputeSpecializedShader->getSpecializationInfo();
 			info.m_backingBuffer = core::make_smart_refctd_ptr<ICPUBuffer>(sizeof(ShaderParameters));
@@ -638,7 +634,20 @@ public:
 
 		E_LIGHT_GEOMETRY lightGeom = ELG_SPHERE;
 		constexpr const char* shaderPaths[] = {"../litBySphere.comp","../litByTriangle.comp","../litByRectangle.comp"};
-		gpuComputePipeline = createGpuResources(shaderPaths[lightGeom]);
+		// all the light geometry variants get compiled together on all cores, and next time only if one of the files they include changed
+		core::smart_refctd_ptr<CShaderPermutationCompiler> permutationCompiler;
+		{
+			auto compilerSet = core::smart_refctd_ptr<asset::CCompilerSet>(assetManager->getCompilerSet());
+			asset::IShaderCompiler::SCompilerOptions options = {};
+			options.preprocessorOptions.logger = logger.get();
+			options.preprocessorOptions.includeFinder = compilerSet->getShaderCompiler(asset::IShader::E_CONTENT_TYPE::ECT_GLSL)->getDefaultIncludeFinder();
+			auto spirvCache = core::make_smart_refctd_ptr<CSPIRVCompileCache>(std::move(compilerSet),localOutputCWD/"spirv_cache");
+			permutationCompiler = core::make_smart_refctd_ptr<CShaderPermutationCompiler>(std::move(spirvCache),options);
+			for (const auto* shaderPath : shaderPaths)
+				permutationCompiler->add({shaderPath,asset::IShader::ESS_COMPUTE,{}});
+			permutationCompiler->build();
+		}
+		gpuComputePipeline = createGpuResources(core::smart_refctd_ptr(permutationCompiler->getSPIRV(lightGeom)));
 
 		dispatchInfo = getDispatchInfo(WIN_W, WIN_H);
 
@@ -0,0 +1,279 @@
+// Copyright (C) 2018-2020 - DevSH Graphics Programming Sp. z O.O.
+// This file is part of the "Nabla Engine".
+// For conditions of distribution and use, see copyright notice in nabla.h
+
+#ifndef _C_STREAMING_BLIT_IMAGE_FILTER_H_INCLUDED_
+#define _C_STREAMING_BLIT_IMAGE_FILTER_H_INCLUDED_
+
+#include <nabla.h>
+
+#include <numeric>
+#include <memory>
+#include <cmath>
+
+
+//! Single layer, single mip 2D image on disk as a small header followed by tightly packed rows
+/** Any band of rows can be read or written without touching the rest of the file, which is the whole point, so the image never has to fit in RAM.
+Block compressed formats aren't supported as a band would have to start and end on a block row. */
+class CRawImageFile
+{
+	public:
+		static inline constexpr uint32_t Magic = 0x474d4952u; // "RIMG"
+
+		struct SHeader
+		{
+			uint32_t magic;
+			nbl::asset::E_FORMAT format;
+			uint32_t width;
+			uint32_t height;
+		};
+
+		//! Creates (or truncates) the file and writes the header, rows are left for `writeRows`
+		static std::unique_ptr<CRawImageFile> create(nbl::system::ISystem* system, const nbl::system::path& path, const nbl::asset::E_FORMAT format, const uint32_t width, const uint32_t height)
+		{
+			if (nbl::asset::isBlockCompressionFormat(format) || width==0u || height==0u)
+				return nullptr;
+
+			auto file = openFile(system,path,nbl::system::IFile::ECF_READ_WRITE);
+			if (!file)
+				return nullptr;
+
+			const SHeader header = {Magic,format,width,height};
+			nbl::system::IFile::success_t success;
+			file->write(success,&header,0ull,sizeof(header));
+			if (!success)
+				return nullptr;
+			return std::unique_ptr<CRawImageFile>(new CRawImageFile(std::move(file),header));
+		}
+
+		static std::unique_ptr<CRawImageFile> open(nbl::system::ISystem* system, const nbl::system::path& path)
+		{
+			auto file = openFile(system,path,nbl::system::IFile::ECF_READ);
+			if (!file || file->getSize()<sizeof(SHeader))
+				return nullptr;
+
+			SHeader header;
+			nbl::system::IFile::success_t success;
+			file->read(success,&header,0ull,sizeof(header));
+			if (!success || header.magic!=Magic || nbl::asset::isBlockCompressionFormat(header.format))
+				return nullptr;
+
+			auto retval = std::unique_ptr<CRawImageFile>(new CRawImageFile(std::move(file),header));
+			if (retval->file->getSize()<sizeof(SHeader)+retval->getRowByteSize()*header.height)
+				return nullptr;
+			return retval;
+		}
+
+		inline nbl::asset::E_FORMAT getFormat() const {return header.format;}
+		inline uint32_t getWidth() const {return header.width;}
+		inline uint32_t getHeight() const {return header.height;}
+		inline size_t getRowByteSize() const {return size_t(nbl::asset::getTexelOrBlockBytesize(header.format))*header.width;}
+
+		inline bool readRows(const uint32_t y, const uint32_t rowCount, void* dst)
+		{
+			assert(y+rowCount<=header.height);
+			nbl::system::IFile::success_t success;
+			file->read(success,dst,getRowOffset(y),getRowByteSize()*rowCount);
+			return bool(success);
+		}
+
+		inline bool writeRows(const uint32_t y, const uint32_t rowCount, const void* src)
+		{
+			assert(y+rowCount<=header.height);
+			nbl::system::IFile::success_t success;
+			file->write(success,src,getRowOffset(y),getRowByteSize()*rowCount);
+			return bool(success);
+		}
+
+	private:
+		CRawImageFile(nbl::core::smart_refctd_ptr<nbl::system::IFile>&& _file, const SHeader& _header) : file(std::move(_file)), header(_header) {}
+
+		static nbl::core::smart_refctd_ptr<nbl::system::IFile> openFile(nbl::system::ISystem* system, const nbl::system::path& path, const nbl::system::IFile::E_CREATE_FLAGS flags)
+		{
+			nbl::system::ISystem::future_t<nbl::core::smart_refctd_ptr<nbl::system::IFile>> future;
+			system->createFile(future,path,nbl::core::bitflag(flags));
+			if (auto pFile=future.acquire())
+				return *pFile;
+			return nullptr;
+		}
+
+		inline size_t getRowOffset(const uint32_t y) const {return sizeof(SHeader)+getRowByteSize()*y;}
+
+		nbl::core::smart_refctd_ptr<nbl::system::IFile> file;
+		SHeader header;
+};
+
+
+//! Runs a `CBlitImageFilter` over a disk backed image one band of output rows at a time
+/** Only the input rows a band needs (its footprint plus the kernel's support on either side) and the band's output rows are ever resident,
+so the peak memory is bounded by `SState::memoryBudget` rather than the image size.
+
+Every band is blitted with exactly the same in/out scale as the whole image, with band boundaries falling on a multiple of the period of
+the phased kernel LUT (`outHeight/gcd(inHeight,outHeight)` rows), so the kernels and LUT made for the full image stay valid and the output
+matches a regular in-memory blit. For awkward ratios where that period is large the bands get correspondingly taller.
+
+Alpha coverage preservation needs a histogram of the whole output, so only `EAS_NONE_OR_PREMULTIPLIED` is supported. */
+template<class BlitFilter>
+class CStreamingBlitImageFilter
+{
+	public:
+		using blit_utils_t = typename BlitFilter::blit_utils_t;
+
+		struct SState
+		{
+			SState(const typename blit_utils_t::convolution_kernels_t& _kernels) : kernels(_kernels) {}
+
+			CRawImageFile* input = nullptr;
+			CRawImageFile* output = nullptr;
+			//! Must have been made for the full input and output extents, the band halo comes from their support
+			typename blit_utils_t::convolution_kernels_t kernels;
+			//! Bytes allowed for the resident input and output bands plus the blit's scratch, not a hard limit when a single aligned band won't fit
+			size_t memoryBudget = 256ull<<20ull;
+
+			//! Filled in by `execute`
+			uint32_t bandCount = 0u;
+			size_t peakResidentBytes = 0ull;
+		};
+
+		//! Output rows after which the kernel phases repeat, every band but the last is a multiple of this
+		static inline uint32_t getBandAlignment(const uint32_t inHeight, const uint32_t outHeight)
+		{
+			return outHeight/std::gcd(inHeight,outHeight);
+		}
+
+		//! Input rows of kernel support needed above and below a band's own footprint
+		/** The kernels from `getConvolutionKernels` are already stretched by the scale of the blit, so their support is in input texels. */
+		static inline uint32_t getHaloRows(const typename blit_utils_t::convolution_kernels_t& kernels)
+		{
+			const auto& kernelY = std::get<1>(kernels);
+			return uint32_t(std::ceil(std::max(-kernelY.getMinSupport(),kernelY.getMaxSupport())))+1u;
+		}
+
+		static bool execute(SState* state)
+		{
+			if (!state || !state->input || !state->output)
+				return false;
+			auto* const input = state->input;
+			auto* const output = state->output;
+			const uint32_t inHeight = input->getHeight();
+			const uint32_t outHeight = output->getHeight();
+
+			const uint32_t alignment = getBandAlignment(inHeight,outHeight);
+			const uint32_t haloRows = getHaloRows(state->kernels);
+			auto getBandInRows = [&](const uint32_t outY, const uint32_t outRows) -> std::pair<uint32_t,uint32_t>
+			{
+				const uint32_t inY = uint32_t(uint64_t(outY)*inHeight/outHeight);
+				const uint32_t inEnd = uint32_t(uint64_t(outY+outRows)*inHeight/outHeight);
+				return {inY,inEnd-inY};
+			};
+
+			// largest multiple of the alignment that fits the budget, scratch size depends on the band so it has to be queried per candidate
+			uint32_t bandRows = outHeight;
+			size_t bandBytes = 0ull;
+			for (;;)
+			{
+				bandBytes = getResidentBytes(state,bandRows,haloRows,getBandInRows(0u,bandRows).second);
+				if (bandBytes<=state->memoryBudget || bandRows<=alignment)
+					break;
+				const uint64_t bytesPerAlignment = std::max<uint64_t>(bandBytes/(bandRows/alignment),1ull);
+				const uint32_t fitting = uint32_t(std::max<uint64_t>(state->memoryBudget/bytesPerAlignment,1ull));
+				bandRows = std::min(bandRows-alignment,fitting*alignment);
+			}
+
+			state->bandCount = 0u;
+			state->peakResidentBytes = 0ull;
+			for (uint32_t outY=0u; outY<outHeight; outY+=bandRows)
+			{
+				const uint32_t outRows = std::min(bandRows,outHeight-outY);
+				const auto [inY,inRows] = getBandInRows(outY,outRows);
+				// clipping the halo at the real image edges leaves the edge wrapping to behave like it does on the full image
+				const uint32_t residentBegin = inY>haloRows ? (inY-haloRows):0u;
+				const uint32_t residentEnd = std::min(inY+inRows+haloRows,inHeight);
+
+				auto inBand = createBandImage(input->getFormat(),input->getWidth(),residentEnd-residentBegin);
+				auto outBand = createBandImage(output->getFormat(),output->getWidth(),outRows);
+				if (!inBand || !outBand)
+					return false;
+				if (!input->readRows(residentBegin,residentEnd-residentBegin,inBand->getBuffer()->getPointer()))
+					return false;
+
+				typename BlitFilter::state_type blitState(state->kernels);
+				blitState.inImage = inBand.get();
+				blitState.inOffsetBaseLayer = nbl::core::vectorSIMDu32(0u,inY-residentBegin,0u,0u);
+				blitState.inExtentLayerCount = nbl::core::vectorSIMDu32(input->getWidth(),inRows,1u,1u);
+				blitState.outImage = outBand.get();
+				blitState.outOffsetBaseLayer = nbl::core::vectorSIMDu32();
+				blitState.outExtentLayerCount = nbl::core::vectorSIMDu32(output->getWidth(),outRows,1u,1u);
+				blitState.axisWraps[0] = nbl::asset::ISampler::ETC_CLAMP_TO_EDGE;
+				blitState.axisWraps[1] = nbl::asset::ISampler::ETC_CLAMP_TO_EDGE;
+				blitState.axisWraps[2] = nbl::asset::ISampler::ETC_CLAMP_TO_EDGE;
+				blitState.alphaSemantic = nbl::asset::IBlitUtilities::EAS_NONE_OR_PREMULTIPLIED;
+
+				blitState.scratchMemoryByteSize = BlitFilter::getRequiredScratchByteSize(&blitState);
+				blitState.scratchMemory = reinterpret_cast<uint8_t*>(_NBL_ALIGNED_MALLOC(blitState.scratchMemoryByteSize,32));
+				bool success = blit_utils_t::computeScaledKernelPhasedLUT(
+					blitState.scratchMemory+BlitFilter::getScratchOffset(&blitState,BlitFilter::ESU_SCALED_KERNEL_PHASED_LUT),
+					blitState.inExtentLayerCount,blitState.outExtentLayerCount,nbl::asset::IImage::ET_2D,state->kernels
+				);
+				success = success && BlitFilter::execute(nbl::core::execution::par_unseq,&blitState);
+				_NBL_ALIGNED_FREE(blitState.scratchMemory);
+				if (!success || !output->writeRows(outY,outRows,outBand->getBuffer()->getPointer()))
+					return false;
+
+				state->bandCount++;
+				state->peakResidentBytes = std::max(state->peakResidentBytes,inBand->getBuffer()->getSize()+outBand->getBuffer()->getSize()+blitState.scratchMemoryByteSize);
+			}
+			return true;
+		}
+
+	private:
+		static size_t getResidentBytes(const SState* state, const uint32_t outRows, const uint32_t haloRows, const uint32_t inRows)
+		{
+			const uint32_t residentInRows = std::min(inRows+haloRows*2u,state->input->getHeight());
+			// only the creation parameters matter for the scratch size query, so the images are created without backing memory
+			typename BlitFilter::state_type blitState(state->kernels);
+			nbl::core::smart_refctd_ptr<nbl::asset::ICPUImage> inQuery = createBandImage(state->input->getFormat(),state->input->getWidth(),residentInRows,false);
+			nbl::core::smart_refctd_ptr<nbl::asset::ICPUImage> outQuery = createBandImage(state->output->getFormat(),state->output->getWidth(),outRows,false);
+			blitState.inImage = inQuery.get();
+			blitState.inOffsetBaseLayer = nbl::core::vectorSIMDu32();
+			blitState.inExtentLayerCount = nbl::core::vectorSIMDu32(state->input->getWidth(),inRows,1u,1u);
+			blitState.outImage = outQuery.get();
+			blitState.outOffsetBaseLayer = nbl::core::vectorSIMDu32();
+			blitState.outExtentLayerCount = nbl::core::vectorSIMDu32(state->output->getWidth(),outRows,1u,1u);
+			return state->input->getRowByteSize()*residentInRows+state->output->getRowByteSize()*outRows+BlitFilter::getRequiredScratchByteSize(&blitState);
+		}
+
+		static nbl::core::smart_refctd_ptr<nbl::asset::ICPUImage> createBandImage(const nbl::asset::E_FORMAT format, const uint32_t width, const uint32_t height, const bool allocate=true)
+		{
+			nbl::asset::IImage::SCreationParams imageParams = {};
+			imageParams.flags = static_cast<nbl::asset::IImage::E_CREATE_FLAGS>(0u);
+			imageParams.type = nbl::asset::IImage::ET_2D;
+			imageParams.format = format;
+			imageParams.extent = {width,height,1u};
+			imageParams.mipLevels = 1u;
+			imageParams.arrayLayers = 1u;
+			imageParams.samples = nbl::asset::ICPUImage::ESCF_1_BIT;
+			imageParams.usage = nbl::asset::IImage::EUF_SAMPLED_BIT;
+
+			auto image = nbl::asset::ICPUImage::create(std::move(imageParams));
+			if (!image || !allocate)
+				return image;
+
+			auto regions = nbl::core::make_refctd_dynamic_array<nbl::core::smart_refctd_dynamic_array<nbl::asset::IImage::SBufferCopy>>(1ull);
+			auto& region = regions->front();
+			region.bufferOffset = 0ull;
+			region.bufferRowLength = width;
+			region.bufferImageHeight = 0u;
+			region.imageSubresource.aspectMask = nbl::asset::IImage::EAF_COLOR_BIT;
+			region.imageSubresource.mipLevel = 0u;
+			region.imageSubresource.baseArrayLayer = 0u;
+			region.imageSubresource.layerCount = 1u;
+			region.imageOffset = {0u,0u,0u};
+			region.imageExtent = {width,height,1u};
+			auto buffer = nbl::core::make_smart_refctd_ptr<nbl::asset::ICPUBuffer>(size_t(nbl::asset::getTexelOrBlockBytesize(format))*width*height);
+			image->setBufferAndRegions(std::move(buffer),std::move(regions));
+			return image;
+		}
+};
+
+#endif
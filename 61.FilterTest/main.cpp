@@ -11,6 +11,8 @@
 #include "../common/CommonAPI.h"
 #include "nbl/ext/ScreenShot/ScreenShot.h"
 
+#include "CStreamingBlitImageFilter.h"
+
 using namespace nbl;
 using namespace nbl::asset;
 using namespace nbl::core;
@@ -176,6 +178,129 @@ class BlitFilterTestApp : public ApplicationBase
 		const uint32_t								m_alphaBinCount;
 	};
 
+	// Streams the input from disk band by band under a memory budget a fraction of the image size, then checks against a regular in-memory blit
+	template <typename BlitUtilities>
+	class CStreamingBlitImageFilterTest : public ITest
+	{
+		using blit_utils_t = BlitUtilities;
+		using blit_filter_t = asset::CBlitImageFilter<asset::VoidSwizzle, asset::IdentityDither, void, false, blit_utils_t>;
+		using streaming_filter_t = CStreamingBlitImageFilter<blit_filter_t>;
+
+	public:
+		CStreamingBlitImageFilterTest(
+			core::smart_refctd_ptr<asset::ICPUImage>&&				inImage,
+			BlitFilterTestApp*										parentApp,
+			const core::vectorSIMDu32&								outImageDim,
+			const char*												writeImagePath,
+			const typename blit_utils_t::convolution_kernels_t&		convolutionKernels,
+			const size_t											memoryBudget)
+			: ITest(std::move(inImage), parentApp), m_outImageDim(outImageDim), m_writeImagePath(writeImagePath),
+			m_convolutionKernels(convolutionKernels), m_memoryBudget(memoryBudget)
+		{}
+
+		bool run() override
+		{
+			const auto& inParams = m_inImage->getCreationParameters();
+			assert(inParams.type == asset::IImage::ET_2D && inParams.arrayLayers == 1u && inParams.mipLevels == 1u);
+
+			// the disk backed images are as big as the in-memory ones, so they get deleted once closed, declared first to be destroyed last
+			struct SScratchFiles
+			{
+				~SScratchFiles()
+				{
+					std::error_code ec;
+					for (const auto& path : paths)
+						std::filesystem::remove(path, ec);
+				}
+				system::path paths[2];
+			} scratchFiles = { { m_parentApp->localOutputCWD / "CStreamingBlitImageFilter_in.raw", m_parentApp->localOutputCWD / "CStreamingBlitImageFilter_out.raw" } };
+
+			auto input = CRawImageFile::create(m_parentApp->system.get(), scratchFiles.paths[0], inParams.format, inParams.extent.width, inParams.extent.height);
+			auto output = CRawImageFile::create(m_parentApp->system.get(), scratchFiles.paths[1], inParams.format, m_outImageDim.x, m_outImageDim.y);
+			if (!input || !output || !input->writeRows(0u, inParams.extent.height, m_inImage->getBuffer()->getPointer()))
+			{
+				m_parentApp->logger->log("Failed to create the disk backed images.", system::ILogger::ELL_ERROR);
+				return false;
+			}
+
+			typename streaming_filter_t::SState streamingState(m_convolutionKernels);
+			streamingState.input = input.get();
+			streamingState.output = output.get();
+			streamingState.memoryBudget = m_memoryBudget;
+			if (!streaming_filter_t::execute(&streamingState))
+			{
+				m_parentApp->logger->log("Failed to stream blit", system::ILogger::ELL_ERROR);
+				return false;
+			}
+			m_parentApp->logger->log("Streamed in %u bands, peak resident %zu bytes for a %zu byte input.", system::ILogger::ELL_INFO,
+				streamingState.bandCount, streamingState.peakResidentBytes, m_inImage->getBuffer()->getSize());
+
+			// reference
+			auto refImage = m_parentApp->createCPUImage(m_outImageDim, inParams.type, inParams.format);
+			if (!refImage)
+				return false;
+			{
+				typename blit_filter_t::state_type blitFilterState(m_convolutionKernels);
+				blitFilterState.inOffsetBaseLayer = core::vectorSIMDu32();
+				blitFilterState.inExtentLayerCount = core::vectorSIMDu32(0u, 0u, 0u, 1u) + m_inImage->getMipSize();
+				blitFilterState.inImage = m_inImage.get();
+				blitFilterState.outImage = refImage.get();
+				blitFilterState.outOffsetBaseLayer = core::vectorSIMDu32();
+				blitFilterState.outExtentLayerCount = m_outImageDim;
+				blitFilterState.axisWraps[0] = asset::ISampler::ETC_CLAMP_TO_EDGE;
+				blitFilterState.axisWraps[1] = asset::ISampler::ETC_CLAMP_TO_EDGE;
+				blitFilterState.axisWraps[2] = asset::ISampler::ETC_CLAMP_TO_EDGE;
+
+				blitFilterState.scratchMemoryByteSize = blit_filter_t::getRequiredScratchByteSize(&blitFilterState);
+				blitFilterState.scratchMemory = reinterpret_cast<uint8_t*>(_NBL_ALIGNED_MALLOC(blitFilterState.scratchMemoryByteSize, 32));
+				bool success = blit_utils_t::computeScaledKernelPhasedLUT(blitFilterState.scratchMemory + blit_filter_t::getScratchOffset(&blitFilterState, blit_filter_t::ESU_SCALED_KERNEL_PHASED_LUT), blitFilterState.inExtentLayerCount, blitFilterState.outExtentLayerCount, inParams.type, m_convolutionKernels);
+				success = success && blit_filter_t::execute(core::execution::par_unseq, &blitFilterState);
+				_NBL_ALIGNED_FREE(blitFilterState.scratchMemory);
+				if (!success)
+				{
+					m_parentApp->logger->log("Failed to blit", system::ILogger::ELL_ERROR);
+					return false;
+				}
+			}
+
+			auto outImage = m_parentApp->createCPUImage(m_outImageDim, inParams.type, inParams.format);
+			if (!outImage || !output->readRows(0u, m_outImageDim.y, outImage->getBuffer()->getPointer()))
+				return false;
+
+			const uint32_t channelCount = asset::getFormatChannelCount(inParams.format);
+			const auto texelSize = asset::getTexelOrBlockBytesize(inParams.format);
+			const auto* streamed = reinterpret_cast<const uint8_t*>(outImage->getBuffer()->getPointer());
+			const auto* reference = reinterpret_cast<const uint8_t*>(refImage->getBuffer()->getPointer());
+			double maxError = 0.0;
+			for (size_t i = 0ull; i < outImage->getBuffer()->getSize() / texelSize; ++i)
+			{
+				double streamedPixel[4] = { 0.0 }, referencePixel[4] = { 0.0 };
+				const void* streamedSrc = streamed + i * texelSize;
+				const void* referenceSrc = reference + i * texelSize;
+				asset::decodePixelsRuntime(inParams.format, &streamedSrc, streamedPixel, 0u, 0u);
+				asset::decodePixelsRuntime(inParams.format, &referenceSrc, referencePixel, 0u, 0u);
+				for (uint32_t ch = 0u; ch < channelCount; ++ch)
+					maxError = std::max(maxError, std::abs(streamedPixel[ch] - referencePixel[ch]) / std::max(std::abs(referencePixel[ch]), 1.0));
+			}
+
+			writeImage(std::move(outImage), m_writeImagePath);
+
+			constexpr double MaxAllowedError = 1e-4;
+			if (maxError > MaxAllowedError)
+			{
+				m_parentApp->logger->log("Streamed blit differs from the in-memory blit by up to %f relative error.", system::ILogger::ELL_ERROR, maxError);
+				return false;
+			}
+			return true;
+		}
+
+	private:
+		const core::vectorSIMDu32								m_outImageDim;
+		const char*												m_writeImagePath;
+		const typename blit_utils_t::convolution_kernels_t		m_convolutionKernels;
+		const size_t											m_memoryBudget;
+	};
+
 	class CFlattenRegionsImageFilterTest : public ITest
 	{
 	public:
@@ -950,6 +1075,7 @@ public:
 		inputSystem = std::move(initOutput.inputSystem);
 
 		constexpr bool TestCPUBlitFilter = true;
+		constexpr bool TestStreamingBlitFilter = true;
 		constexpr bool TestFlattenFilter = true;
 		constexpr bool TestSwizzleAndConvertFilter = true;
 		constexpr bool TestGPUBlitFilter = true;
@@ -1067,6 +1193,50 @@ public:
 			runTests(TestCount, tests);
 		}
 
+		if (TestStreamingBlitFilter)
+		{
+			using namespace asset;
+
+			logger->log("CStreamingBlitImageFilter", system::ILogger::ELL_INFO);
+
+			constexpr uint32_t TestCount = 2;
+			std::unique_ptr<ITest> tests[TestCount] = { nullptr };
+
+			// Test 0: 4x downscale with Mitchell, band budget at a sixteenth of the input
+			{
+				const auto inImageDim = core::vectorSIMDu32(4096u, 2048u, 1u, 1u);
+				const auto outImageDim = core::vectorSIMDu32(1024u, 512u, 1u, 1u);
+				auto inImage = createCPUImage(inImageDim, asset::IImage::ET_2D, asset::EF_R32G32B32A32_SFLOAT, true);
+
+				using BlitUtilities = CBlitUtilities<CDefaultChannelIndependentWeightFunction1D<CConvolutionWeightFunction1D<CWeightFunction1D<SMitchellFunction<>>, CWeightFunction1D<SMitchellFunction<>>>>>;
+				auto convolutionKernels = BlitUtilities::getConvolutionKernels<CWeightFunction1D<SMitchellFunction<>>>(inImageDim, outImageDim);
+
+				if (inImage)
+				{
+					const size_t memoryBudget = inImage->getBuffer()->getSize() / 16ull;
+					tests[0] = std::make_unique<CStreamingBlitImageFilterTest<BlitUtilities>>(std::move(inImage), this, outImageDim, "CStreamingBlitImageFilter_0.exr", convolutionKernels, memoryBudget);
+				}
+			}
+
+			// Test 1: Non-integer 3:2 downscale with Kaiser, bands have to stay aligned to the kernel phase period
+			{
+				const auto inImageDim = core::vectorSIMDu32(1536u, 1536u, 1u, 1u);
+				const auto outImageDim = core::vectorSIMDu32(1024u, 1024u, 1u, 1u);
+				auto inImage = createCPUImage(inImageDim, asset::IImage::ET_2D, asset::EF_R16G16B16A16_SFLOAT, true);
+
+				using BlitUtilities = CBlitUtilities<CDefaultChannelIndependentWeightFunction1D<CConvolutionWeightFunction1D<CWeightFunction1D<SKaiserFunction>, CWeightFunction1D<SKaiserFunction>>>>;
+				auto convolutionKernels = BlitUtilities::getConvolutionKernels<CWeightFunction1D<SKaiserFunction>>(inImageDim, outImageDim);
+
+				if (inImage)
+				{
+					const size_t memoryBudget = inImage->getBuffer()->getSize() / 8ull;
+					tests[1] = std::make_unique<CStreamingBlitImageFilterTest<BlitUtilities>>(std::move(inImage), this, outImageDim, "CStreamingBlitImageFilter_1.exr", convolutionKernels, memoryBudget);
+				}
+			}
+
+			runTests(TestCount, tests);
+		}
+
 		if (TestFlattenFilter)
 		{
 			auto getFillValueAsFirstBlockOrTexel = [](asset::IImageFilter::IState::ColorValue& result, asset::ICPUImage* image)
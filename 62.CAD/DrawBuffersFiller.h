@@ -0,0 +1,1045 @@
+// Copyright (C) 2018-2020 - DevSH Graphics Programming Sp. z O.O.
+// This file is part of the "Nabla Engine".
+// For conditions of distribution and use, see copyright notice in nabla.h
+
+#ifndef _CAD_DRAW_BUFFERS_FILLER_H_INCLUDED_
+#define _CAD_DRAW_BUFFERS_FILLER_H_INCLUDED_
+
+#include <nabla.h>
+
+#include <numeric>
+
+struct double4x4
+{
+	double _r0[4u];
+	double _r1[4u];
+	double _r2[4u];
+	double _r3[4u];
+};
+
+struct float4
+{
+	float4() {}
+
+	float4(const float x, const float y, const float z, const float w)
+	{
+		val[0u] = x;
+		val[1u] = y;
+		val[2u] = z;
+		val[3u] = w;
+	}
+
+	float val[4u];
+
+	inline bool operator ==(const float4& other) const
+	{
+		return val[0u] == other.val[0u];
+	}
+};
+
+typedef nbl::core::vector2d<double> double2;
+typedef nbl::core::vector2d<uint32_t> uint2;
+
+#include "common.hlsl"
+
+static_assert(sizeof(DrawObject) == 16u);
+static_assert(sizeof(PackedEllipseInfo) == 48u);
+static_assert(sizeof(Globals) == 152u);
+static_assert(sizeof(LineStyle) == 32u);
+
+constexpr double maxEllipticalArcAngle = nbl::core::PI<double>() / 2.0f;
+static_assert(maxEllipticalArcAngle <= nbl::core::PI<double>()); // !important cause our shaders will be messed up with arcs > 180 degrees
+
+// It is not optimized because how you feed a Polyline to our cad renderer is your choice. this is just for convenience
+// This is a Nabla Polyline used to feed to our CAD renderer. You can convert your Polyline to this class. or just use it directly.
+class CPolyline
+{
+public:
+
+	// each section consists of multiple connected lines or multiple connected ellipses
+	struct SectionInfo
+	{
+		ObjectType	type;
+		uint32_t	index; // can't make this a void* cause of vector resize
+		uint32_t	count;
+	};
+
+	struct EllipticalArcInfo
+	{
+		double2 majorAxis;
+		double2 center;
+		double2 angleBounds; // [0, 2Pi)
+		double eccentricity; // (0, 1]
+
+		bool isValid() const
+		{
+			if (eccentricity > 1.0 || eccentricity < 0.0)
+				return false;
+			if (angleBounds.Y < angleBounds.X)
+				return false;
+			if ((angleBounds.Y - angleBounds.X) > 2 * nbl::core::PI<double>())
+				return false;
+			return true;
+		}
+	};
+
+	size_t getSectionsCount() const { return m_sections.size(); }
+
+	const SectionInfo& getSectionInfoAt(const uint32_t idx) const
+	{
+		return m_sections[idx];
+	}
+
+	const PackedEllipseInfo& getEllipseInfoAt(const uint32_t idx) const
+	{
+		return m_ellipses[idx];
+	}
+
+	const QuadraticBezierInfo& getQuadBezierInfoAt(const uint32_t idx) const
+	{
+		return m_quadBeziers[idx];
+	}
+
+	const CubicBezierInfo& getCubicBezierInfoAt(const uint32_t idx) const
+	{
+		return m_cubicBeziers[idx];
+	}
+
+	const double2& getLinePointAt(const uint32_t idx) const
+	{
+		return m_linePoints[idx];
+	}
+
+	void clearEverything()
+	{
+		m_sections.clear();
+		m_linePoints.clear();
+		m_ellipses.clear();
+	}
+
+	// Reserves memory with worst case
+	void reserveMemory(uint32_t noOfLines, uint32_t noOfEllipses)
+	{
+		m_sections.reserve(noOfLines + noOfEllipses); // worst case
+		m_linePoints.reserve(noOfLines * 2u); // worst case
+		const uint32_t maxEllipseParts = std::ceil((2.0 * nbl::core::PI<double>()) / maxEllipticalArcAngle);
+		m_ellipses.reserve(noOfEllipses * maxEllipseParts); // "* maxEllipseParts" because we will chop up the arcs
+	}
+
+	void addLinePoints(std::vector<double2>&& linePoints)
+	{
+		if (linePoints.size() <= 1u)
+			return;
+
+		bool addNewSection = m_sections.size() == 0u || m_sections[m_sections.size() - 1u].type != ObjectType::LINE;
+		if (addNewSection)
+		{
+			SectionInfo newSection = {};
+			newSection.type = ObjectType::LINE;
+			newSection.index = m_linePoints.size();
+			newSection.count = linePoints.size() - 1u;
+			m_sections.push_back(newSection);
+		}
+		else
+		{
+			m_sections[m_sections.size() - 1u].count += linePoints.size();
+		}
+		m_linePoints.insert(m_linePoints.end(), linePoints.begin(), linePoints.end());
+	}
+
+	void addEllipticalArcs(std::vector<EllipticalArcInfo>&& ellipses)
+	{
+		std::vector<PackedEllipseInfo> packedEllipses;
+		// We will chop up the ellipses
+		const uint32_t maxEllipseParts = std::ceil((2.0 * nbl::core::PI<double>()) / maxEllipticalArcAngle);
+		for (uint32_t i = 0u; i < ellipses.size(); ++i)
+		{
+			const auto& mainEllipse = ellipses[i];
+			assert(mainEllipse.isValid());
+			const double endAngle = mainEllipse.angleBounds.Y;
+			double startAngle = mainEllipse.angleBounds.X;
+			for (uint32_t e = 0u; e < maxEllipseParts && startAngle < endAngle; e++)
+			{
+				double maxNextAngle = startAngle + maxEllipticalArcAngle;
+				double nextEndAngle = nbl::core::min(maxNextAngle, mainEllipse.angleBounds.Y);
+
+				constexpr double twoPi = nbl::core::PI<double>() * 2.0;
+				PackedEllipseInfo packedInfo = {};
+				packedInfo.center = mainEllipse.center;
+				packedInfo.majorAxis = mainEllipse.majorAxis;
+				packedInfo.angleBoundsPacked.X = static_cast<uint32_t>((startAngle / twoPi) * UINT32_MAX);
+				packedInfo.angleBoundsPacked.Y = static_cast<uint32_t>((nextEndAngle / twoPi) * UINT32_MAX);
+				packedInfo.eccentricityPacked = static_cast<uint32_t>(mainEllipse.eccentricity * UINT32_MAX);
+				packedEllipses.push_back(packedInfo);
+
+				startAngle = nextEndAngle;
+			}
+		}
+		addEllipticalArcs_Internal(std::move(packedEllipses));
+	}
+
+	void addQuadBeziers(std::vector<QuadraticBezierInfo>&& quadBeziers)
+	{
+		bool addNewSection = m_sections.size() == 0u || m_sections[m_sections.size() - 1u].type != ObjectType::QUAD_BEZIER;
+		if (addNewSection)
+		{
+			SectionInfo newSection = {};
+			newSection.type = ObjectType::QUAD_BEZIER;
+			newSection.index = m_quadBeziers.size();
+			newSection.count = quadBeziers.size();
+			m_sections.push_back(newSection);
+		}
+		else
+		{
+			m_sections[m_sections.size() - 1u].count += quadBeziers.size();
+		}
+		m_quadBeziers.insert(m_quadBeziers.end(), quadBeziers.begin(), quadBeziers.end());
+	}
+
+	void addCubicBeziers(std::vector<CubicBezierInfo>&& cubicBeziers)
+	{
+		bool addNewSection = m_sections.size() == 0u || m_sections[m_sections.size() - 1u].type != ObjectType::CUBIC_BEZIER;
+		if (addNewSection)
+		{
+			SectionInfo newSection = {};
+			newSection.type = ObjectType::CUBIC_BEZIER;
+			newSection.index = m_cubicBeziers.size();
+			newSection.count = cubicBeziers.size();
+			m_sections.push_back(newSection);
+		}
+		else
+		{
+			m_sections[m_sections.size() - 1u].count += cubicBeziers.size();
+		}
+		m_cubicBeziers.insert(m_cubicBeziers.end(), cubicBeziers.begin(), cubicBeziers.end());
+	}
+
+protected:
+
+	void addEllipticalArcs_Internal(std::vector<PackedEllipseInfo>&& ellipses)
+	{
+		bool addNewSection = m_sections.size() == 0u || m_sections[m_sections.size() - 1u].type != ObjectType::ELLIPSE;
+		if (addNewSection)
+		{
+			SectionInfo newSection = {};
+			newSection.type = ObjectType::ELLIPSE;
+			newSection.index = m_ellipses.size();
+			newSection.count = ellipses.size();
+			m_sections.push_back(newSection);
+		}
+		else
+		{
+			m_sections[m_sections.size() - 1u].count += ellipses.size();
+		}
+		m_ellipses.insert(m_ellipses.end(), ellipses.begin(), ellipses.end());
+	}
+
+	std::vector<SectionInfo> m_sections;
+	std::vector<double2> m_linePoints;
+	std::vector<PackedEllipseInfo> m_ellipses;
+	std::vector<QuadraticBezierInfo> m_quadBeziers;
+	std::vector<CubicBezierInfo> m_cubicBeziers;
+};
+
+template <typename BufferType>
+struct DrawBuffers
+{
+	nbl::core::smart_refctd_ptr<BufferType> indexBuffer;
+	nbl::core::smart_refctd_ptr<BufferType> drawObjectsBuffer;
+	nbl::core::smart_refctd_ptr<BufferType> geometryBuffer;
+	nbl::core::smart_refctd_ptr<BufferType> lineStylesBuffer;
+};
+
+// ! this is just a buffers filler with autosubmission features used for convenience to how you feed our CAD renderer
+struct DrawBuffersFiller
+{
+public:
+
+	typedef uint32_t index_buffer_type;
+
+	DrawBuffersFiller() {}
+
+	DrawBuffersFiller(nbl::core::smart_refctd_ptr<nbl::video::IUtilities>&& utils)
+	{
+		utilities = utils;
+	}
+
+	typedef std::function<nbl::video::IGPUQueue::SSubmitInfo(nbl::video::IGPUQueue*, nbl::video::IGPUFence*, nbl::video::IGPUQueue::SSubmitInfo)> SubmitFunc;
+
+	// function is called when buffer is filled and we should submit draws and clear the buffers and continue filling
+	void setSubmitDrawsFunction(SubmitFunc func)
+	{
+		submitDraws = func;
+	}
+
+	void allocateIndexBuffer(nbl::core::smart_refctd_ptr<nbl::video::ILogicalDevice> logicalDevice, uint32_t indices)
+	{
+		maxIndices = indices;
+		const size_t indexBufferSize = maxIndices * sizeof(uint32_t);
+
+		nbl::video::IGPUBuffer::SCreationParams indexBufferCreationParams = {};
+		indexBufferCreationParams.size = indexBufferSize;
+		indexBufferCreationParams.usage = nbl::video::IGPUBuffer::EUF_INDEX_BUFFER_BIT | nbl::video::IGPUBuffer::EUF_TRANSFER_DST_BIT;
+		gpuDrawBuffers.indexBuffer = logicalDevice->createBuffer(std::move(indexBufferCreationParams));
+		gpuDrawBuffers.indexBuffer->setObjectDebugName("indexBuffer");
+
+		nbl::video::IDeviceMemoryBacked::SDeviceMemoryRequirements memReq = gpuDrawBuffers.indexBuffer->getMemoryReqs();
+		memReq.memoryTypeBits &= logicalDevice->getPhysicalDevice()->getDeviceLocalMemoryTypeBits();
+		auto indexBufferMem = logicalDevice->allocate(memReq, gpuDrawBuffers.indexBuffer.get());
+
+		cpuDrawBuffers.indexBuffer = nbl::core::make_smart_refctd_ptr<nbl::asset::ICPUBuffer>(indexBufferSize);
+	}
+
+	void allocateDrawObjectsBuffer(nbl::core::smart_refctd_ptr<nbl::video::ILogicalDevice> logicalDevice, uint32_t drawObjects)
+	{
+		maxDrawObjects = drawObjects;
+		size_t drawObjectsBufferSize = drawObjects * sizeof(DrawObject);
+
+		nbl::video::IGPUBuffer::SCreationParams drawObjectsCreationParams = {};
+		drawObjectsCreationParams.size = drawObjectsBufferSize;
+		drawObjectsCreationParams.usage = nbl::video::IGPUBuffer::EUF_STORAGE_BUFFER_BIT | nbl::video::IGPUBuffer::EUF_TRANSFER_DST_BIT;
+		gpuDrawBuffers.drawObjectsBuffer = logicalDevice->createBuffer(std::move(drawObjectsCreationParams));
+		gpuDrawBuffers.drawObjectsBuffer->setObjectDebugName("drawObjectsBuffer");
+
+		nbl::video::IDeviceMemoryBacked::SDeviceMemoryRequirements memReq = gpuDrawBuffers.drawObjectsBuffer->getMemoryReqs();
+		memReq.memoryTypeBits &= logicalDevice->getPhysicalDevice()->getDeviceLocalMemoryTypeBits();
+		auto drawObjectsBufferMem = logicalDevice->allocate(memReq, gpuDrawBuffers.drawObjectsBuffer.get());
+
+		cpuDrawBuffers.drawObjectsBuffer = nbl::core::make_smart_refctd_ptr<nbl::asset::ICPUBuffer>(drawObjectsBufferSize);
+	}
+
+	void allocateGeometryBuffer(nbl::core::smart_refctd_ptr<nbl::video::ILogicalDevice> logicalDevice, size_t size)
+	{
+		maxGeometryBufferSize = size;
+
+		nbl::video::IGPUBuffer::SCreationParams geometryCreationParams = {};
+		geometryCreationParams.size = size;
+		geometryCreationParams.usage = nbl::core::bitflag(nbl::video::IGPUBuffer::EUF_STORAGE_BUFFER_BIT) | nbl::video::IGPUBuffer::EUF_SHADER_DEVICE_ADDRESS_BIT | nbl::video::IGPUBuffer::EUF_TRANSFER_DST_BIT;
+		gpuDrawBuffers.geometryBuffer = logicalDevice->createBuffer(std::move(geometryCreationParams));
+		gpuDrawBuffers.geometryBuffer->setObjectDebugName("geometryBuffer");
+
+		nbl::video::IDeviceMemoryBacked::SDeviceMemoryRequirements memReq = gpuDrawBuffers.geometryBuffer->getMemoryReqs();
+		memReq.memoryTypeBits &= logicalDevice->getPhysicalDevice()->getDeviceLocalMemoryTypeBits();
+		auto geometryBufferMem = logicalDevice->allocate(memReq, gpuDrawBuffers.geometryBuffer.get(), nbl::video::IDeviceMemoryAllocation::EMAF_DEVICE_ADDRESS_BIT);
+		geometryBufferAddress = logicalDevice->getBufferDeviceAddress(gpuDrawBuffers.geometryBuffer.get());
+
+		cpuDrawBuffers.geometryBuffer = nbl::core::make_smart_refctd_ptr<nbl::asset::ICPUBuffer>(size);
+	}
+
+	void allocateStylesBuffer(nbl::core::smart_refctd_ptr<nbl::video::ILogicalDevice> logicalDevice, uint32_t stylesCount)
+	{
+		maxLineStyles = stylesCount;
+		size_t lineStylesBufferSize = stylesCount * sizeof(LineStyle);
+
+		nbl::video::IGPUBuffer::SCreationParams lineStylesCreationParams = {};
+		lineStylesCreationParams.size = lineStylesBufferSize;
+		lineStylesCreationParams.usage = nbl::video::IGPUBuffer::EUF_STORAGE_BUFFER_BIT | nbl::video::IGPUBuffer::EUF_TRANSFER_DST_BIT;
+		gpuDrawBuffers.lineStylesBuffer = logicalDevice->createBuffer(std::move(lineStylesCreationParams));
+		gpuDrawBuffers.lineStylesBuffer->setObjectDebugName("lineStylesBuffer");
+
+		nbl::video::IDeviceMemoryBacked::SDeviceMemoryRequirements memReq = gpuDrawBuffers.lineStylesBuffer->getMemoryReqs();
+		memReq.memoryTypeBits &= logicalDevice->getPhysicalDevice()->getDeviceLocalMemoryTypeBits();
+		auto stylesBufferMem = logicalDevice->allocate(memReq, gpuDrawBuffers.lineStylesBuffer.get());
+
+		cpuDrawBuffers.lineStylesBuffer = nbl::core::make_smart_refctd_ptr<nbl::asset::ICPUBuffer>(lineStylesBufferSize);
+	}
+
+	uint32_t getIndexCount() const { return currentIndexCount; }
+
+	//! this function fills buffers required for drawing a polyline and submits a draw through provided callback when there is not enough memory.
+	//! polylines that fit in the remaining memory are written in parallel by `addPolylineInParallel_Internal`, with the same result.
+	nbl::video::IGPUQueue::SSubmitInfo drawPolyline(
+		const CPolyline& polyline,
+		const LineStyle& lineStyle,
+		nbl::video::IGPUQueue* submissionQueue,
+		nbl::video::IGPUFence* submissionFence,
+		nbl::video::IGPUQueue::SSubmitInfo intendedNextSubmit)
+	{
+		uint32_t styleIdx;
+		intendedNextSubmit = addLineStyle_SubmitIfNeeded(lineStyle, styleIdx, submissionQueue, submissionFence, intendedNextSubmit);
+
+		if (!addPolylineInParallel_Internal(polyline, styleIdx))
+			intendedNextSubmit = addPolyline_SubmitIfNeeded(polyline, styleIdx, submissionQueue, submissionFence, intendedNextSubmit);
+		return intendedNextSubmit;
+	}
+
+	nbl::video::IGPUQueue::SSubmitInfo finalizeIndexCopiesToGPU(
+		nbl::video::IGPUQueue* submissionQueue,
+		nbl::video::IGPUFence* submissionFence,
+		nbl::video::IGPUQueue::SSubmitInfo intendedNextSubmit)
+	{
+		// Copy Indices
+		uint32_t remainingIndexCount = currentIndexCount - inMemIndexCount;
+		nbl::asset::SBufferRange<nbl::video::IGPUBuffer> indicesRange = { sizeof(index_buffer_type) * inMemIndexCount, sizeof(index_buffer_type) * remainingIndexCount, gpuDrawBuffers.indexBuffer };
+		const index_buffer_type* srcIndexData = reinterpret_cast<index_buffer_type*>(cpuDrawBuffers.indexBuffer->getPointer()) + inMemIndexCount;
+		if (indicesRange.size > 0u)
+			intendedNextSubmit = utilities->updateBufferRangeViaStagingBuffer(indicesRange, srcIndexData, submissionQueue, submissionFence, intendedNextSubmit);
+		inMemIndexCount = currentIndexCount;
+		return intendedNextSubmit;
+	}
+
+	nbl::video::IGPUQueue::SSubmitInfo finalizeLineStyleCopiesToGPU(
+		nbl::video::IGPUQueue* submissionQueue,
+		nbl::video::IGPUFence* submissionFence,
+		nbl::video::IGPUQueue::SSubmitInfo intendedNextSubmit)
+	{
+		// Copy LineStyles
+		uint32_t remainingLineStyles = currentLineStylesCount - inMemLineStylesCount;
+		nbl::asset::SBufferRange<nbl::video::IGPUBuffer> stylesRange = { sizeof(LineStyle) * inMemLineStylesCount, sizeof(LineStyle) * remainingLineStyles, gpuDrawBuffers.lineStylesBuffer };
+		const LineStyle* srcLineStylesData = reinterpret_cast<LineStyle*>(cpuDrawBuffers.lineStylesBuffer->getPointer()) + inMemLineStylesCount;
+		if (stylesRange.size > 0u)
+			intendedNextSubmit = utilities->updateBufferRangeViaStagingBuffer(stylesRange, srcLineStylesData, submissionQueue, submissionFence, intendedNextSubmit);
+		inMemLineStylesCount = currentLineStylesCount;
+		return intendedNextSubmit;
+	}
+
+	nbl::video::IGPUQueue::SSubmitInfo finalizeGeometryCopiesToGPU(
+		nbl::video::IGPUQueue* submissionQueue,
+		nbl::video::IGPUFence* submissionFence,
+		nbl::video::IGPUQueue::SSubmitInfo intendedNextSubmit)
+	{
+		// Copy DrawBuffers
+		uint32_t remainingDrawObjects = currentDrawObjectCount - inMemDrawObjectCount;
+		nbl::asset::SBufferRange<nbl::video::IGPUBuffer> drawObjectsRange = { sizeof(DrawObject) * inMemDrawObjectCount, sizeof(DrawObject) * remainingDrawObjects, gpuDrawBuffers.drawObjectsBuffer };
+		const DrawObject* srcDrawObjData = reinterpret_cast<DrawObject*>(cpuDrawBuffers.drawObjectsBuffer->getPointer()) + inMemDrawObjectCount;
+		if (drawObjectsRange.size > 0u)
+			intendedNextSubmit = utilities->updateBufferRangeViaStagingBuffer(drawObjectsRange, srcDrawObjData, submissionQueue, submissionFence, intendedNextSubmit);
+		inMemDrawObjectCount = currentDrawObjectCount;
+
+		// Copy GeometryBuffer
+		uint32_t remainingGeometrySize = currentGeometryBufferSize - inMemGeometryBufferSize;
+		nbl::asset::SBufferRange<nbl::video::IGPUBuffer> geomRange = { inMemGeometryBufferSize, remainingGeometrySize, gpuDrawBuffers.geometryBuffer };
+		const uint8_t* srcGeomData = reinterpret_cast<uint8_t*>(cpuDrawBuffers.geometryBuffer->getPointer()) + inMemGeometryBufferSize;
+		if (geomRange.size > 0u)
+			intendedNextSubmit = utilities->updateBufferRangeViaStagingBuffer(geomRange, srcGeomData, submissionQueue, submissionFence, intendedNextSubmit);
+		inMemGeometryBufferSize = currentGeometryBufferSize;
+
+		return intendedNextSubmit;
+	}
+
+	nbl::video::IGPUQueue::SSubmitInfo finalizeAllCopiesToGPU(
+		nbl::video::IGPUQueue* submissionQueue,
+		nbl::video::IGPUFence* submissionFence,
+		nbl::video::IGPUQueue::SSubmitInfo intendedNextSubmit)
+	{
+		intendedNextSubmit = finalizeIndexCopiesToGPU(submissionQueue, submissionFence, intendedNextSubmit);
+		intendedNextSubmit = finalizeGeometryCopiesToGPU(submissionQueue, submissionFence, intendedNextSubmit);
+		intendedNextSubmit = finalizeLineStyleCopiesToGPU(submissionQueue, submissionFence, intendedNextSubmit);
+
+		return intendedNextSubmit;
+	}
+
+	size_t getCurrentIndexBufferSize() const
+	{
+		return sizeof(index_buffer_type) * currentIndexCount;
+	}
+
+	size_t getCurrentLineStylesBufferSize() const
+	{
+		return sizeof(LineStyle) * currentLineStylesCount;
+	}
+
+	size_t getCurrentDrawObjectsBufferSize() const
+	{
+		return sizeof(DrawObject) * currentDrawObjectCount;
+	}
+
+	size_t getCurrentGeometryBufferSize() const
+	{
+		return currentGeometryBufferSize;
+	}
+
+
+	void reset()
+	{
+		resetAllCounters();
+	}
+
+	DrawBuffers<nbl::asset::ICPUBuffer> cpuDrawBuffers;
+	DrawBuffers<nbl::video::IGPUBuffer> gpuDrawBuffers;
+
+protected:
+
+	SubmitFunc submitDraws;
+
+	static constexpr uint32_t InvalidLineStyleIdx = ~0u;
+
+	nbl::video::IGPUQueue::SSubmitInfo addLineStyle_SubmitIfNeeded(
+		const LineStyle& lineStyle,
+		uint32_t& outLineStyleIdx,
+		nbl::video::IGPUQueue* submissionQueue,
+		nbl::video::IGPUFence* submissionFence,
+		nbl::video::IGPUQueue::SSubmitInfo intendedNextSubmit)
+	{
+		outLineStyleIdx = addLineStyle_Internal(lineStyle);
+		if (outLineStyleIdx == InvalidLineStyleIdx)
+		{
+			intendedNextSubmit = finalizeAllCopiesToGPU(submissionQueue, submissionFence, intendedNextSubmit);
+			intendedNextSubmit = submitDraws(submissionQueue, submissionFence, intendedNextSubmit);
+			resetAllCounters();
+			outLineStyleIdx = addLineStyle_Internal(lineStyle);
+			assert(outLineStyleIdx != InvalidLineStyleIdx);
+		}
+		return intendedNextSubmit;
+	}
+
+	uint32_t addLineStyle_Internal(const LineStyle& lineStyle)
+	{
+		LineStyle* stylesArray = reinterpret_cast<LineStyle*>(cpuDrawBuffers.lineStylesBuffer->getPointer());
+		for (uint32_t i = 0u; i < currentLineStylesCount; ++i)
+		{
+			const LineStyle& itr = stylesArray[i];
+			if (lineStyle.screenSpaceLineWidth == itr.screenSpaceLineWidth)
+				if (lineStyle.worldSpaceLineWidth == itr.worldSpaceLineWidth)
+					if (lineStyle.color == itr.color)
+						return i;
+		}
+
+		if (currentLineStylesCount >= maxLineStyles)
+			return InvalidLineStyleIdx;
+
+		void* dst = stylesArray + currentLineStylesCount;
+		memcpy(dst, &lineStyle, sizeof(LineStyle));
+		return currentLineStylesCount++;
+	}
+
+	nbl::video::IGPUQueue::SSubmitInfo addPolyline_SubmitIfNeeded(
+		const CPolyline& polyline,
+		uint32_t styleIdx,
+		nbl::video::IGPUQueue* submissionQueue,
+		nbl::video::IGPUFence* submissionFence,
+		nbl::video::IGPUQueue::SSubmitInfo intendedNextSubmit)
+	{
+		const auto sectionsCount = polyline.getSectionsCount();
+
+		// We keep track of the last section and object, to know which geometries are still available in memory
+		uint32_t startDrawObjectCount = currentDrawObjectCount;
+		uint32_t previousSectionIdx = 0u;
+		uint32_t previousObjectInSection = 0u;
+
+		// Fill all back faces (and draw when overflow)
+		// backface is our slang for even provoking vertex
+		{
+			uint32_t currentSectionIdx = 0u;
+			uint32_t currentObjectInSection = 0u; // Object here refers to DrawObject used in vertex shader. You can think of it as a Cage.
+
+			while (currentSectionIdx < sectionsCount)
+			{
+				bool shouldSubmit = false;
+				const auto& currentSection = polyline.getSectionInfoAt(currentSectionIdx);
+				addObjects_Internal(polyline, currentSection, currentObjectInSection, styleIdx, false);
+				
+				if (currentObjectInSection >= currentSection.count)
+				{
+					currentSectionIdx++;
+					currentObjectInSection = 0u;
+				}
+				else
+					shouldSubmit = true;
+
+				if (shouldSubmit)
+				{
+					intendedNextSubmit = finalizeLineStyleCopiesToGPU(submissionQueue, submissionFence, intendedNextSubmit);
+					intendedNextSubmit = finalizeIndexCopiesToGPU(submissionQueue, submissionFence, intendedNextSubmit);
+					intendedNextSubmit = finalizeGeometryCopiesToGPU(submissionQueue, submissionFence, intendedNextSubmit);
+					intendedNextSubmit = submitDraws(submissionQueue, submissionFence, intendedNextSubmit);
+					resetIndexCounters();
+					resetGeometryCounters();
+
+					startDrawObjectCount = 0u;
+					previousSectionIdx = currentSectionIdx;
+					previousObjectInSection = currentObjectInSection;
+
+					shouldSubmit = false;
+				}
+			}
+		}
+
+		// Fill all front faces (and draw when overflow)
+		// frontface is our slang for odd provoking vertex
+		{
+			// all front faces only using index buffer for those object that are already in cpu memory (ready for upload)
+			{
+				uint32_t currentSectionIdx = previousSectionIdx;
+				uint32_t currentObjectInSection = previousObjectInSection;
+
+				while (currentSectionIdx < sectionsCount)
+				{
+					bool shouldSubmit = false;
+					const auto& currentSection = polyline.getSectionInfoAt(currentSectionIdx);
+
+					// we only care about indices because the geometry and drawData is already in memory
+					const uint32_t uploadableObjects = (maxIndices - currentIndexCount) / 6u;
+					const auto objectsRemaining = currentSection.count - currentObjectInSection;
+					const auto objectsToUpload = nbl::core::min(uploadableObjects, objectsRemaining);
+
+					addObjectIndices_Internal(true, startDrawObjectCount, objectsToUpload);
+
+					currentObjectInSection += objectsToUpload;
+
+					if (currentObjectInSection >= currentSection.count)
+					{
+						currentSectionIdx++;
+						currentObjectInSection = 0u;
+					}
+					else
+						shouldSubmit = true;
+
+					startDrawObjectCount += objectsToUpload;
+
+					if (shouldSubmit)
+					{
+						intendedNextSubmit = finalizeGeometryCopiesToGPU(submissionQueue, submissionFence, intendedNextSubmit);
+						intendedNextSubmit = finalizeLineStyleCopiesToGPU(submissionQueue, submissionFence, intendedNextSubmit);
+						intendedNextSubmit = finalizeIndexCopiesToGPU(submissionQueue, submissionFence, intendedNextSubmit);
+						intendedNextSubmit = submitDraws(submissionQueue, submissionFence, intendedNextSubmit);
+						resetIndexCounters();
+						// we don't reset the geometry counters cause we overflowed on index memory not geometry memory
+
+						shouldSubmit = false;
+					}
+				}
+			}
+			// remaining front faces where their geometry is non-existent in memory due to previous submit clears
+			{
+				const uint32_t lastSectionIdx = previousSectionIdx;
+				const uint32_t lastObjectInSection = previousObjectInSection;
+
+				uint32_t currentSectionIdx = 0u;
+				uint32_t currentObjectInSection = 0u; // Object here refers to DrawObject used in vertex shader. You can think of it as a Cage.
+
+				while (currentSectionIdx < lastSectionIdx || (currentSectionIdx == lastSectionIdx && lastObjectInSection > 0u))
+				{
+					bool shouldSubmit = false;
+					auto currentSection = polyline.getSectionInfoAt(currentSectionIdx);
+					if (currentSectionIdx == lastSectionIdx)
+						currentSection.count = lastObjectInSection;
+
+					addObjects_Internal(polyline, currentSection, currentObjectInSection, styleIdx, true);
+
+					if (currentObjectInSection >= currentSection.count)
+					{
+						currentSectionIdx++;
+						currentObjectInSection = 0u;
+					}
+					else
+						shouldSubmit = true;
+
+					if (shouldSubmit)
+					{
+						intendedNextSubmit = finalizeLineStyleCopiesToGPU(submissionQueue, submissionFence, intendedNextSubmit);
+						intendedNextSubmit = finalizeIndexCopiesToGPU(submissionQueue, submissionFence, intendedNextSubmit);
+						intendedNextSubmit = finalizeGeometryCopiesToGPU(submissionQueue, submissionFence, intendedNextSubmit);
+						intendedNextSubmit = submitDraws(submissionQueue, submissionFence, intendedNextSubmit);
+						resetIndexCounters();
+						resetGeometryCounters();
+						shouldSubmit = false;
+					}
+				}
+			}
+		}
+
+		return intendedNextSubmit;
+	}
+
+	// Sections are split into chunks of at most this many objects for `addPolylineInParallel_Internal`
+	static constexpr uint32_t ObjectsPerParallelChunk = 4096u;
+
+	static size_t getObjectGeometrySize(ObjectType type)
+	{
+		switch (type)
+		{
+		case ObjectType::LINE:
+			return sizeof(double2);
+		case ObjectType::ELLIPSE:
+			return sizeof(PackedEllipseInfo);
+		case ObjectType::QUAD_BEZIER:
+			return sizeof(QuadraticBezierInfo);
+		case ObjectType::CUBIC_BEZIER:
+			return sizeof(CubicBezierInfo);
+		default:
+			assert(false); // we don't handle other object types
+			return 0u;
+		}
+	}
+
+	// Writes the whole polyline if it fits in the remaining memory, returns false without touching anything otherwise.
+	// The output is what `addPolyline_SubmitIfNeeded` writes when it doesn't need to submit: DrawObjects and geometry of all sections in order,
+	// then the indices of all objects with even provoking vertex followed by the ones with odd provoking vertex.
+	// An exclusive prefix sum over the sections gives every chunk its exact offsets in all three buffers, so the chunks are then written in parallel.
+	bool addPolylineInParallel_Internal(const CPolyline& polyline, uint32_t styleIdx)
+	{
+		struct Chunk
+		{
+			uint32_t sectionIdx;
+			uint32_t firstObjectInSection;
+			uint32_t objectCount;
+			uint32_t drawObjectIdx;
+			uint64_t geometryOffset;
+		};
+		nbl::core::vector<Chunk> chunks;
+
+		uint64_t objectCount = 0u;
+		uint64_t geometrySize = 0u;
+		const auto sectionsCount = polyline.getSectionsCount();
+		for (uint32_t sectionIdx = 0u; sectionIdx < sectionsCount; ++sectionIdx)
+		{
+			const auto& section = polyline.getSectionInfoAt(sectionIdx);
+			const size_t objectGeometrySize = getObjectGeometrySize(section.type);
+			for (uint32_t firstObject = 0u; firstObject < section.count; firstObject += ObjectsPerParallelChunk)
+			{
+				Chunk chunk;
+				chunk.sectionIdx = sectionIdx;
+				chunk.firstObjectInSection = firstObject;
+				chunk.objectCount = nbl::core::min(ObjectsPerParallelChunk, section.count - firstObject);
+				chunk.drawObjectIdx = currentDrawObjectCount + objectCount + firstObject;
+				chunk.geometryOffset = currentGeometryBufferSize + geometrySize + objectGeometrySize * firstObject;
+				chunks.push_back(chunk);
+			}
+			objectCount += section.count;
+			geometrySize += objectGeometrySize * section.count;
+			// connected lines share points, so a section of them has one more point than lines
+			if (section.type == ObjectType::LINE)
+				geometrySize += sizeof(double2);
+		}
+
+		if (currentIndexCount + objectCount * 12u > maxIndices)
+			return false;
+		if (currentDrawObjectCount + objectCount > maxDrawObjects)
+			return false;
+		if (currentGeometryBufferSize + geometrySize > maxGeometryBufferSize)
+			return false;
+
+		DrawObject* drawObjects = reinterpret_cast<DrawObject*>(cpuDrawBuffers.drawObjectsBuffer->getPointer());
+		uint8_t* geometry = reinterpret_cast<uint8_t*>(cpuDrawBuffers.geometryBuffer->getPointer());
+		index_buffer_type* evenIndices = reinterpret_cast<index_buffer_type*>(cpuDrawBuffers.indexBuffer->getPointer()) + currentIndexCount;
+		index_buffer_type* oddIndices = evenIndices + objectCount * 6u;
+		nbl::core::vector<uint32_t> chunkIndices(chunks.size());
+		std::iota(chunkIndices.begin(), chunkIndices.end(), 0u);
+		std::for_each(nbl::core::execution::par_unseq, chunkIndices.begin(), chunkIndices.end(), [&](const uint32_t chunkIdx)
+			{
+				const Chunk& chunk = chunks[chunkIdx];
+				const auto& section = polyline.getSectionInfoAt(chunk.sectionIdx);
+				const size_t objectGeometrySize = getObjectGeometrySize(section.type);
+
+				DrawObject drawObj = {};
+				drawObj.type = section.type;
+				drawObj.address = geometryBufferAddress + chunk.geometryOffset;
+				drawObj.styleIdx = styleIdx;
+				for (uint32_t i = 0u; i < chunk.objectCount; ++i)
+				{
+					drawObjects[chunk.drawObjectIdx + i] = drawObj;
+					drawObj.address += objectGeometrySize;
+				}
+
+				const uint32_t srcIdx = section.index + chunk.firstObjectInSection;
+				size_t geometryByteSize = objectGeometrySize * chunk.objectCount;
+				const void* src = nullptr;
+				if (section.type == ObjectType::LINE)
+				{
+					src = &polyline.getLinePointAt(srcIdx);
+					if (chunk.firstObjectInSection + chunk.objectCount == section.count)
+						geometryByteSize += sizeof(double2);
+				}
+				else if (section.type == ObjectType::ELLIPSE)
+					src = &polyline.getEllipseInfoAt(srcIdx);
+				else if (section.type == ObjectType::QUAD_BEZIER)
+					src = &polyline.getQuadBezierInfoAt(srcIdx);
+				else if (section.type == ObjectType::CUBIC_BEZIER)
+					src = &polyline.getCubicBezierInfoAt(srcIdx);
+				memcpy(geometry + chunk.geometryOffset, src, geometryByteSize);
+
+				const uint32_t indexOffset = (chunk.drawObjectIdx - currentDrawObjectCount) * 6u;
+				fillObjectIndices(evenIndices + indexOffset, false, chunk.drawObjectIdx, chunk.objectCount);
+				fillObjectIndices(oddIndices + indexOffset, true, chunk.drawObjectIdx, chunk.objectCount);
+			}
+		);
+
+		currentIndexCount += objectCount * 12u;
+		currentDrawObjectCount += objectCount;
+		currentGeometryBufferSize += geometrySize;
+		return true;
+	}
+
+	//@param oddProvokingVertex is used for our polyline-wide transparency algorithm where we draw the object twice, once to resolve the alpha and another time to draw them
+	void addObjects_Internal(const CPolyline& polyline, const CPolyline::SectionInfo& section, uint32_t& currentObjectInSection, uint32_t styleIdx, bool oddProvokingVertex)
+	{
+		if (section.type == ObjectType::LINE)
+			addLines_Internal(polyline, section, currentObjectInSection, styleIdx, oddProvokingVertex);
+		else if (section.type == ObjectType::ELLIPSE)
+			addEllipses_Internal(polyline, section, currentObjectInSection, styleIdx, oddProvokingVertex);
+		else if (section.type == ObjectType::QUAD_BEZIER)
+			addQuadBeziers_Internal(polyline, section, currentObjectInSection, styleIdx, oddProvokingVertex);
+		else if (section.type == ObjectType::CUBIC_BEZIER)
+			addCubicBeziers_Internal(polyline, section, currentObjectInSection, styleIdx, oddProvokingVertex);
+		else
+			assert(false); // we don't handle other object types
+	}
+
+	//@param oddProvokingVertex is used for our polyline-wide transparency algorithm where we draw the object twice, once to resolve the alpha and another time to draw them
+	void addLines_Internal(const CPolyline& polyline, const CPolyline::SectionInfo& section, uint32_t& currentObjectInSection, uint32_t styleIdx, bool oddProvokingVertex)
+	{
+		assert(section.count >= 1u);
+		assert(section.type == ObjectType::LINE);
+
+		const auto maxGeometryBufferPoints = (maxGeometryBufferSize - currentGeometryBufferSize) / sizeof(double2);
+		const auto maxGeometryBufferLines = (maxGeometryBufferPoints <= 1u) ? 0u : maxGeometryBufferPoints - 1u;
+
+		uint32_t uploadableObjects = (maxIndices - currentIndexCount) / 6u;
+		uploadableObjects = nbl::core::min(uploadableObjects, maxGeometryBufferLines);
+		uploadableObjects = nbl::core::min(uploadableObjects, maxDrawObjects - currentDrawObjectCount);
+
+		const auto lineCount = section.count;
+		const auto remainingObjects = lineCount - currentObjectInSection;
+		uint32_t objectsToUpload = nbl::core::min(uploadableObjects, remainingObjects);
+
+		// Add Indices
+		addObjectIndices_Internal(oddProvokingVertex, currentDrawObjectCount, objectsToUpload);
+
+		// Add DrawObjs
+		DrawObject drawObj = {};
+		drawObj.type = ObjectType::LINE;
+		drawObj.address = geometryBufferAddress + currentGeometryBufferSize;
+		drawObj.styleIdx = styleIdx;
+		for (uint32_t i = 0u; i < objectsToUpload; ++i)
+		{
+			void* dst = reinterpret_cast<DrawObject*>(cpuDrawBuffers.drawObjectsBuffer->getPointer()) + currentDrawObjectCount;
+			memcpy(dst, &drawObj, sizeof(DrawObject));
+			currentDrawObjectCount += 1u;
+			drawObj.address += sizeof(double2);
+		}
+
+		// Add Geometry
+		if (objectsToUpload > 0u)
+		{
+			const auto pointsByteSize = sizeof(double2) * (objectsToUpload + 1u);
+			void* dst = reinterpret_cast<char*>(cpuDrawBuffers.geometryBuffer->getPointer()) + currentGeometryBufferSize;
+			auto& linePoint = polyline.getLinePointAt(section.index + currentObjectInSection);
+			memcpy(dst, &linePoint, pointsByteSize);
+			currentGeometryBufferSize += pointsByteSize;
+		}
+
+		currentObjectInSection += objectsToUpload;
+	}
+
+	//@param oddProvokingVertex is used for our polyline-wide transparency algorithm where we draw the object twice, once to resolve the alpha and another time to draw them
+	void addEllipses_Internal(const CPolyline& polyline, const CPolyline::SectionInfo& section, uint32_t& currentObjectInSection, uint32_t styleIdx, bool oddProvokingVertex)
+	{
+		assert(section.type == ObjectType::ELLIPSE);
+
+		const auto maxGeometryBufferEllipses = (maxGeometryBufferSize - currentGeometryBufferSize) / sizeof(PackedEllipseInfo);
+
+		uint32_t uploadableObjects = (maxIndices - currentIndexCount) / 6u;
+		uploadableObjects = nbl::core::min(uploadableObjects, maxGeometryBufferEllipses);
+		uploadableObjects = nbl::core::min(uploadableObjects, maxDrawObjects - currentDrawObjectCount);
+
+		const auto ellipseCount = section.count;
+		const auto remainingObjects = ellipseCount - currentObjectInSection;
+		uint32_t objectsToUpload = nbl::core::min(uploadableObjects, remainingObjects);
+
+		// Add Indices
+		addObjectIndices_Internal(oddProvokingVertex, currentDrawObjectCount, objectsToUpload);
+
+		// Add DrawObjs
+		DrawObject drawObj = {};
+		drawObj.type = ObjectType::ELLIPSE;
+		drawObj.address = geometryBufferAddress + currentGeometryBufferSize;
+		drawObj.styleIdx = styleIdx;
+		for (uint32_t i = 0u; i < objectsToUpload; ++i)
+		{
+			void* dst = reinterpret_cast<DrawObject*>(cpuDrawBuffers.drawObjectsBuffer->getPointer()) + currentDrawObjectCount;
+			memcpy(dst, &drawObj, sizeof(DrawObject));
+			currentDrawObjectCount += 1u;
+			drawObj.address += sizeof(PackedEllipseInfo);
+		}
+
+		// Add Geometry
+		if (objectsToUpload > 0u)
+		{
+			const auto ellipsesByteSize = sizeof(PackedEllipseInfo) * (objectsToUpload);
+			void* dst = reinterpret_cast<char*>(cpuDrawBuffers.geometryBuffer->getPointer()) + currentGeometryBufferSize;
+			auto& ellipse = polyline.getEllipseInfoAt(section.index + currentObjectInSection);
+			memcpy(dst, &ellipse, ellipsesByteSize);
+			currentGeometryBufferSize += ellipsesByteSize;
+		}
+
+		currentObjectInSection += objectsToUpload;
+	}
+
+	//@param oddProvokingVertex is used for our polyline-wide transparency algorithm where we draw the object twice, once to resolve the alpha and another time to draw them
+	void addQuadBeziers_Internal(const CPolyline& polyline, const CPolyline::SectionInfo& section, uint32_t& currentObjectInSection, uint32_t styleIdx, bool oddProvokingVertex)
+	{
+		assert(section.type == ObjectType::QUAD_BEZIER);
+
+		const auto maxGeometryBufferEllipses = (maxGeometryBufferSize - currentGeometryBufferSize) / sizeof(QuadraticBezierInfo);
+
+		uint32_t uploadableObjects = (maxIndices - currentIndexCount) / 6u;
+		uploadableObjects = nbl::core::min(uploadableObjects, maxGeometryBufferEllipses);
+		uploadableObjects = nbl::core::min(uploadableObjects, maxDrawObjects - currentDrawObjectCount);
+
+		const auto beziersCount = section.count;
+		const auto remainingObjects = beziersCount - currentObjectInSection;
+		uint32_t objectsToUpload = nbl::core::min(uploadableObjects, remainingObjects);
+
+		// Add Indices
+		addObjectIndices_Internal(oddProvokingVertex, currentDrawObjectCount, objectsToUpload);
+
+		// Add DrawObjs
+		DrawObject drawObj = {};
+		drawObj.type = ObjectType::QUAD_BEZIER;
+		drawObj.address = geometryBufferAddress + currentGeometryBufferSize;
+		drawObj.styleIdx = styleIdx;
+		for (uint32_t i = 0u; i < objectsToUpload; ++i)
+		{
+			void* dst = reinterpret_cast<DrawObject*>(cpuDrawBuffers.drawObjectsBuffer->getPointer()) + currentDrawObjectCount;
+			memcpy(dst, &drawObj, sizeof(DrawObject));
+			currentDrawObjectCount += 1u;
+			drawObj.address += sizeof(QuadraticBezierInfo);
+		}
+
+		// Add Geometry
+		if (objectsToUpload > 0u)
+		{
+			const auto beziersByteSize = sizeof(QuadraticBezierInfo) * (objectsToUpload);
+			void* dst = reinterpret_cast<char*>(cpuDrawBuffers.geometryBuffer->getPointer()) + currentGeometryBufferSize;
+			auto& quadBezier = polyline.getQuadBezierInfoAt(section.index + currentObjectInSection);
+			memcpy(dst, &quadBezier, beziersByteSize);
+			currentGeometryBufferSize += beziersByteSize;
+		}
+
+		currentObjectInSection += objectsToUpload;
+	}
+
+	//@param oddProvokingVertex is used for our polyline-wide transparency algorithm where we draw the object twice, once to resolve the alpha and another time to draw them
+	void addCubicBeziers_Internal(const CPolyline& polyline, const CPolyline::SectionInfo& section, uint32_t& currentObjectInSection, uint32_t styleIdx, bool oddProvokingVertex)
+	{
+		assert(section.type == ObjectType::CUBIC_BEZIER);
+
+		const auto maxGeometryBufferEllipses = (maxGeometryBufferSize - currentGeometryBufferSize) / sizeof(CubicBezierInfo);
+
+		uint32_t uploadableObjects = (maxIndices - currentIndexCount) / 6u;
+		uploadableObjects = nbl::core::min(uploadableObjects, maxGeometryBufferEllipses);
+		uploadableObjects = nbl::core::min(uploadableObjects, maxDrawObjects - currentDrawObjectCount);
+
+		const auto beziersCount = section.count;
+		const auto remainingObjects = beziersCount - currentObjectInSection;
+		uint32_t objectsToUpload = nbl::core::min(uploadableObjects, remainingObjects);
+
+		// Add Indices
+		addObjectIndices_Internal(oddProvokingVertex, currentDrawObjectCount, objectsToUpload);
+
+		// Add DrawObjs
+		DrawObject drawObj = {};
+		drawObj.type = ObjectType::CUBIC_BEZIER;
+		drawObj.address = geometryBufferAddress + currentGeometryBufferSize;
+		drawObj.styleIdx = styleIdx;
+		for (uint32_t i = 0u; i < objectsToUpload; ++i)
+		{
+			void* dst = reinterpret_cast<DrawObject*>(cpuDrawBuffers.drawObjectsBuffer->getPointer()) + currentDrawObjectCount;
+			memcpy(dst, &drawObj, sizeof(DrawObject));
+			currentDrawObjectCount += 1u;
+			drawObj.address += sizeof(CubicBezierInfo);
+		}
+
+		// Add Geometry
+		if (objectsToUpload > 0u)
+		{
+			const auto beziersByteSize = sizeof(CubicBezierInfo) * (objectsToUpload);
+			void* dst = reinterpret_cast<char*>(cpuDrawBuffers.geometryBuffer->getPointer()) + currentGeometryBufferSize;
+			auto& cubicBezier = polyline.getCubicBezierInfoAt(section.index + currentObjectInSection);
+			memcpy(dst, &cubicBezier, beziersByteSize);
+			currentGeometryBufferSize += beziersByteSize;
+		}
+
+		currentObjectInSection += objectsToUpload;
+	}
+
+	//@param oddProvokingVertex is used for our polyline-wide transparency algorithm where we draw the object twice, once to resolve the alpha and another time to draw them
+	void addObjectIndices_Internal(bool oddProvokingVertex, uint32_t startObject, uint32_t objectCount)
+	{
+		index_buffer_type* indices = reinterpret_cast<index_buffer_type*>(cpuDrawBuffers.indexBuffer->getPointer()) + currentIndexCount;
+		fillObjectIndices(indices, oddProvokingVertex, startObject, objectCount);
+		currentIndexCount += objectCount * 6u;
+	}
+
+	static void fillObjectIndices(index_buffer_type* indices, bool oddProvokingVertex, uint32_t startObject, uint32_t objectCount)
+	{
+		for (uint32_t i = 0u; i < objectCount; ++i)
+		{
+			index_buffer_type objIndex = startObject + i;
+			if(oddProvokingVertex)
+			{
+				indices[i * 6] = objIndex * 4u + 1u;
+				indices[i * 6 + 1u] = objIndex * 4u + 0u;
+			}
+			else
+			{
+				indices[i * 6] = objIndex * 4u + 0u;
+				indices[i * 6 + 1u] = objIndex * 4u + 1u;
+			}
+			indices[i * 6 + 2u] = objIndex * 4u + 2u;
+
+			if (oddProvokingVertex)
+			{
+				indices[i * 6 + 3u] = objIndex * 4u + 1u;
+				indices[i * 6 + 4u] = objIndex * 4u + 2u;
+			}
+			else
+			{
+				indices[i * 6 + 3u] = objIndex * 4u + 2u;
+				indices[i * 6 + 4u] = objIndex * 4u + 1u;
+			}
+			indices[i * 6 + 5u] = objIndex * 4u + 3u;
+		}
+	}
+
+	void resetAllCounters()
+	{
+		resetGeometryCounters();
+		resetIndexCounters();
+		resetStyleCounters();
+	}
+
+	void resetGeometryCounters()
+	{
+		inMemDrawObjectCount = 0u;
+		inMemGeometryBufferSize = 0u;
+		currentDrawObjectCount = 0u;
+		currentGeometryBufferSize = 0u;
+	}
+
+	void resetIndexCounters()
+	{
+		inMemIndexCount = 0u;
+		currentIndexCount = 0u;
+	}
+
+	void resetStyleCounters()
+	{
+		currentLineStylesCount = 0u;
+		inMemLineStylesCount = 0u;
+	}
+
+	nbl::core::smart_refctd_ptr<nbl::video::IUtilities> utilities;
+	nbl::core::smart_refctd_ptr<nbl::video::ILogicalDevice> device;
+
+	uint32_t inMemIndexCount = 0u;
+	uint32_t currentIndexCount = 0u;
+	uint32_t maxIndices = 0u;
+
+	uint32_t inMemDrawObjectCount = 0u;
+	uint32_t currentDrawObjectCount = 0u;
+	uint32_t maxDrawObjects = 0u;
+
+	uint32_t inMemLineStylesCount = 0u;
+	uint32_t currentLineStylesCount = 0u;
+	uint32_t maxLineStyles = 0u;
+
+	uint64_t geometryBufferAddress = 0u;
+
+	uint64_t inMemGeometryBufferSize = 0u;
+	uint64_t currentGeometryBufferSize = 0u;
+	uint64_t maxGeometryBufferSize = 0u;
+};
+
+#endif
@@ -0,0 +1,614 @@
+#ifndef _C_BOUNDING_VOLUME_BATCH_INCLUDED_
+#define _C_BOUNDING_VOLUME_BATCH_INCLUDED_
+
+#include "nabla.h"
+
+#include <cfloat>
+#include <numeric>
+#include <algorithm>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP>=2)
+#include <immintrin.h>
+#define _BOUNDING_VOLUME_BATCH_SSE_
+#endif
+
+
+// Computes the AABBs and optionally OBBs of many meshbuffers, or index ranges of them, at once. Where `IMeshManipulator::calculateBoundingBox`
+// and `IMeshManipulator::calculateOBB` are called one meshbuffer at a time, here all the jobs get split into chunks of vertices spread over
+// threads, so tens of thousands of meshlets cost about as much as one mesh with the same vertex count.
+//
+// Positions in 3 or 4 floats get fetched 4 vertices at a time with SSE, any other format goes through `ICPUMeshBuffer::getAttribute`.
+// The OBB is found the DiTO-14 way: the extremal vertices along 7 fixed directions get found in the same pass as the AABB, the axes get chosen
+// by trying the edges of the big triangle and ditetrahedron they make, then a second pass over all the vertices fits the box to the chosen axes.
+// If that ends up with more surface area than the AABB, the AABB is returned as the OBB.
+class CBoundingVolumeBatch
+{
+	public:
+		struct SJob
+		{
+			const uint8_t* positions = nullptr;
+			uint32_t stride = 0u;
+			nbl::asset::E_FORMAT format = nbl::asset::EF_UNKNOWN;
+			// only needed for formats without a fast path
+			const nbl::asset::ICPUMeshBuffer* meshBuffer = nullptr;
+			uint32_t positionAttributeIx = ~0u;
+			// nullptr for non-indexed meshbuffers, then `first` and `count` are in vertices
+			const uint8_t* indices = nullptr;
+			nbl::asset::E_INDEX_TYPE indexType = nbl::asset::EIT_UNKNOWN;
+			int32_t baseVertex = 0;
+			uint32_t first = 0u;
+			uint32_t count = 0u;
+		};
+
+		// The same vertices `IMeshManipulator::calculateBoundingBox` would visit.
+		static inline SJob makeJob(const nbl::asset::ICPUMeshBuffer* meshBuffer)
+		{
+			return makeJob(meshBuffer,0u,meshBuffer->getIndexCount());
+		}
+		// Only the indices `[firstIndex,firstIndex+indexCount)`, so the meshbuffer doesn't need its index binding changed to get the bounds of a batch.
+		static inline SJob makeJob(const nbl::asset::ICPUMeshBuffer* meshBuffer, const uint32_t firstIndex, const uint32_t indexCount)
+		{
+			SJob job;
+			job.meshBuffer = meshBuffer;
+			job.positionAttributeIx = meshBuffer->getPositionAttributeIx();
+			if (job.positionAttributeIx>=nbl::asset::SVertexInputParams::MAX_VERTEX_ATTRIB_COUNT || !meshBuffer->isAttributeEnabled(job.positionAttributeIx))
+				return job;
+			job.positions = meshBuffer->getAttribPointer(job.positionAttributeIx);
+			if (!job.positions)
+				return job;
+			job.stride = meshBuffer->getAttribStride(job.positionAttributeIx);
+			job.format = meshBuffer->getAttribFormat(job.positionAttributeIx);
+			job.indexType = meshBuffer->getIndexType();
+			if (job.indexType!=nbl::asset::EIT_UNKNOWN)
+				job.indices = reinterpret_cast<const uint8_t*>(meshBuffer->getIndices());
+			job.baseVertex = meshBuffer->getBaseVertex();
+			job.first = firstIndex;
+			job.count = indexCount;
+			return job;
+		}
+
+		// `outOBBs` map the unit cube `[0,1]^3` onto the box, the way 63.OBB draws them. Jobs without any vertices get empty boxes at the origin.
+		// AABBs don't depend on the chunk size or thread count.
+		void compute(const SJob* jobsBegin, const SJob* jobsEnd, nbl::core::aabbox3df* outAABBs, nbl::core::matrix3x4SIMD* outOBBs=nullptr, const uint32_t verticesPerChunk=VerticesPerChunk)
+		{
+			assert(verticesPerChunk%4u==0u);
+			const uint32_t jobCount = static_cast<uint32_t>(jobsEnd-jobsBegin);
+			chunks.clear();
+			jobStates.resize(jobCount);
+			for (uint32_t j=0u; j<jobCount; j++)
+			{
+				const SJob& job = jobsBegin[j];
+				jobStates[j].firstChunk = static_cast<uint32_t>(chunks.size());
+				if (job.positions)
+				for (uint32_t first=0u; first<job.count; first+=verticesPerChunk)
+					chunks.push_back({&job,j,first,std::min(first+verticesPerChunk,job.count)});
+				jobStates[j].chunkCount = static_cast<uint32_t>(chunks.size())-jobStates[j].firstChunk;
+			}
+
+			std::for_each(nbl::core::execution::par_unseq,chunks.begin(),chunks.end(),[](SChunk& chunk) -> void
+			{
+				sweepExtremes(*chunk.job,chunk.begin,chunk.end,chunk.extremes);
+			});
+
+			jobIndices.resize(jobCount);
+			std::iota(jobIndices.begin(),jobIndices.end(),0u);
+			std::for_each(nbl::core::execution::par_unseq,jobIndices.begin(),jobIndices.end(),[&](const uint32_t j) -> void
+			{
+				SJobState& state = jobStates[j];
+				if (state.chunkCount==0u)
+				{
+					outAABBs[j] = nbl::core::aabbox3df(0.f,0.f,0.f,0.f,0.f,0.f);
+					if (outOBBs)
+						outOBBs[j] = zeroScaleMatrix(nbl::core::vectorSIMDf(0.f));
+					return;
+				}
+				SExtremes extremes = chunks[state.firstChunk].extremes;
+				for (auto c=1u; c<state.chunkCount; c++)
+					extremes.merge(chunks[state.firstChunk+c].extremes);
+				outAABBs[j] = nbl::core::aabbox3df(extremes.min[0],extremes.min[1],extremes.min[2],extremes.max[0],extremes.max[1],extremes.max[2]);
+				if (outOBBs)
+					chooseAxes(jobsBegin[j],extremes,state.axes);
+			});
+			if (!outOBBs)
+				return;
+
+			std::for_each(nbl::core::execution::par_unseq,chunks.begin(),chunks.end(),[&](SChunk& chunk) -> void
+			{
+				sweepProjections(*chunk.job,chunk.begin,chunk.end,jobStates[chunk.jobIx].axes,chunk.projections);
+			});
+
+			std::for_each(nbl::core::execution::par_unseq,jobIndices.begin(),jobIndices.end(),[&](const uint32_t j) -> void
+			{
+				const SJobState& state = jobStates[j];
+				if (state.chunkCount==0u)
+					return;
+				SProjections projections = chunks[state.firstChunk].projections;
+				for (auto c=1u; c<state.chunkCount; c++)
+					projections.merge(chunks[state.firstChunk+c].projections);
+
+				float extent[3];
+				for (auto a=0u; a<3u; a++)
+					extent[a] = projections.max[a]-projections.min[a];
+				const auto& aabb = outAABBs[j];
+				const float aabbExtent[3] = {aabb.MaxEdge.X-aabb.MinEdge.X,aabb.MaxEdge.Y-aabb.MinEdge.Y,aabb.MaxEdge.Z-aabb.MinEdge.Z};
+				// NaN extents fail the comparison and fall back to the AABB too, so do directions without any extremal vertex (see `chooseAxes`)
+				if (!(halfSurfaceArea(extent)<halfSurfaceArea(aabbExtent)))
+				{
+					outOBBs[j] = nbl::core::matrix3x4SIMD(
+						nbl::core::vectorSIMDf(aabbExtent[0],0.f,0.f,aabb.MinEdge.X),
+						nbl::core::vectorSIMDf(0.f,aabbExtent[1],0.f,aabb.MinEdge.Y),
+						nbl::core::vectorSIMDf(0.f,0.f,aabbExtent[2],aabb.MinEdge.Z)
+					);
+					return;
+				}
+
+				nbl::core::vectorSIMDf column[3];
+				nbl::core::vectorSIMDf corner(0.f);
+				for (auto a=0u; a<3u; a++)
+				{
+					column[a] = state.axes[a]*extent[a];
+					corner += state.axes[a]*projections.min[a];
+				}
+				outOBBs[j] = nbl::core::matrix3x4SIMD(
+					nbl::core::vectorSIMDf(column[0].x,column[1].x,column[2].x,corner.x),
+					nbl::core::vectorSIMDf(column[0].y,column[1].y,column[2].y,corner.y),
+					nbl::core::vectorSIMDf(column[0].z,column[1].z,column[2].z,corner.z)
+				);
+			});
+		}
+
+	private:
+		static inline constexpr uint32_t VerticesPerChunk = 0x1u<<14u;
+		// the DiTO-14 directions, the axes and the 4 cube diagonals
+		static inline constexpr uint32_t DirectionCount = 7u;
+
+		// AABB and the extremal vertices, stored as positions within the job so ties can always be broken towards the first one
+		struct SExtremes
+		{
+			float min[3] = {FLT_MAX,FLT_MAX,FLT_MAX};
+			float max[3] = {-FLT_MAX,-FLT_MAX,-FLT_MAX};
+			float lowest[DirectionCount];
+			float highest[DirectionCount];
+			uint32_t lowestIx[DirectionCount];
+			uint32_t highestIx[DirectionCount];
+
+			SExtremes()
+			{
+				std::fill_n(lowest,DirectionCount,FLT_MAX);
+				std::fill_n(highest,DirectionCount,-FLT_MAX);
+				std::fill_n(lowestIx,DirectionCount,~0u);
+				std::fill_n(highestIx,DirectionCount,~0u);
+			}
+
+			inline void add(const float* p, const uint32_t i)
+			{
+				for (auto c=0u; c<3u; c++)
+				{
+					min[c] = std::min(min[c],p[c]);
+					max[c] = std::max(max[c],p[c]);
+				}
+				float projection[DirectionCount];
+				project(p[0],p[1],p[2],projection);
+				for (auto d=0u; d<DirectionCount; d++)
+				{
+					addLowest(d,projection[d],i);
+					addHighest(d,projection[d],i);
+				}
+			}
+			inline void addLowest(const uint32_t d, const float value, const uint32_t i)
+			{
+				if (value<lowest[d] || (value==lowest[d] && i<lowestIx[d]))
+				{
+					lowest[d] = value;
+					lowestIx[d] = i;
+				}
+			}
+			inline void addHighest(const uint32_t d, const float value, const uint32_t i)
+			{
+				if (value>highest[d] || (value==highest[d] && i<highestIx[d]))
+				{
+					highest[d] = value;
+					highestIx[d] = i;
+				}
+			}
+			inline void merge(const SExtremes& other)
+			{
+				for (auto c=0u; c<3u; c++)
+				{
+					min[c] = std::min(min[c],other.min[c]);
+					max[c] = std::max(max[c],other.max[c]);
+				}
+				for (auto d=0u; d<DirectionCount; d++)
+				{
+					addLowest(d,other.lowest[d],other.lowestIx[d]);
+					addHighest(d,other.highest[d],other.highestIx[d]);
+				}
+			}
+		};
+		struct SProjections
+		{
+			float min[3] = {FLT_MAX,FLT_MAX,FLT_MAX};
+			float max[3] = {-FLT_MAX,-FLT_MAX,-FLT_MAX};
+
+			inline void merge(const SProjections& other)
+			{
+				for (auto a=0u; a<3u; a++)
+				{
+					min[a] = std::min(min[a],other.min[a]);
+					max[a] = std::max(max[a],other.max[a]);
+				}
+			}
+		};
+		struct SChunk
+		{
+			const SJob* job;
+			uint32_t jobIx;
+			uint32_t begin,end;
+			SExtremes extremes = {};
+			SProjections projections = {};
+		};
+		struct SJobState
+		{
+			uint32_t firstChunk;
+			uint32_t chunkCount;
+			nbl::core::vectorSIMDf axes[3];
+		};
+
+		// not normalized as only the order of the projections matters, written out the same way as the SSE path so both give bit exact projections
+		static inline void project(const float x, const float y, const float z, float* out)
+		{
+			out[0] = x;
+			out[1] = y;
+			out[2] = z;
+			out[3] = (x+y)+z;
+			out[4] = (x+y)-z;
+			out[5] = (x-y)+z;
+			out[6] = (x-y)-z;
+		}
+
+		static inline bool hasFastPath(const SJob& job)
+		{
+			return job.format==nbl::asset::EF_R32G32B32_SFLOAT || job.format==nbl::asset::EF_R32G32B32A32_SFLOAT;
+		}
+		static inline uint32_t getVertexID(const SJob& job, const uint32_t i)
+		{
+			const uint32_t element = job.first+i;
+			switch (job.indexType)
+			{
+				case nbl::asset::EIT_16BIT:
+					return static_cast<uint32_t>(job.baseVertex+int32_t(reinterpret_cast<const uint16_t*>(job.indices)[element]));
+				case nbl::asset::EIT_32BIT:
+					return static_cast<uint32_t>(job.baseVertex+int32_t(reinterpret_cast<const uint32_t*>(job.indices)[element]));
+				default:
+					return static_cast<uint32_t>(job.baseVertex)+element;
+			}
+		}
+		static inline const float* getFastPosition(const SJob& job, const uint32_t i)
+		{
+			return reinterpret_cast<const float*>(job.positions+size_t(getVertexID(job,i))*job.stride);
+		}
+		static inline nbl::core::vectorSIMDf getPosition(const SJob& job, const uint32_t i)
+		{
+			if (hasFastPath(job))
+			{
+				const float* p = getFastPosition(job,i);
+				return nbl::core::vectorSIMDf(p[0],p[1],p[2]);
+			}
+			nbl::core::vectorSIMDf p;
+			job.meshBuffer->getAttribute(p,job.positionAttributeIx,getVertexID(job,i));
+			return p;
+		}
+
+		static inline void sweepExtremes(const SJob& job, const uint32_t begin, const uint32_t end, SExtremes& extremes)
+		{
+			auto i = begin;
+			if (hasFastPath(job))
+			{
+				#ifdef _BOUNDING_VOLUME_BATCH_SSE_
+				if (begin+4u<=end)
+				{
+					__m128 minP[3],maxP[3];
+					__m128 lowest[DirectionCount],highest[DirectionCount];
+					__m128i lowestIx[DirectionCount],highestIx[DirectionCount];
+					for (auto c=0u; c<3u; c++)
+					{
+						minP[c] = _mm_set1_ps(FLT_MAX);
+						maxP[c] = _mm_set1_ps(-FLT_MAX);
+					}
+					for (auto d=0u; d<DirectionCount; d++)
+					{
+						lowest[d] = _mm_set1_ps(FLT_MAX);
+						highest[d] = _mm_set1_ps(-FLT_MAX);
+						lowestIx[d] = highestIx[d] = _mm_set1_epi32(-1);
+					}
+					__m128i ix = _mm_setr_epi32(begin,begin+1u,begin+2u,begin+3u);
+					const __m128i four = _mm_set1_epi32(4);
+					for (; i+4u<=end; i+=4u)
+					{
+						const float* p[4] = {getFastPosition(job,i),getFastPosition(job,i+1u),getFastPosition(job,i+2u),getFastPosition(job,i+3u)};
+						const __m128 x = _mm_setr_ps(p[0][0],p[1][0],p[2][0],p[3][0]);
+						const __m128 y = _mm_setr_ps(p[0][1],p[1][1],p[2][1],p[3][1]);
+						const __m128 z = _mm_setr_ps(p[0][2],p[1][2],p[2][2],p[3][2]);
+						// new value first, so a NaN keeps the old one like `std::min` does
+						minP[0] = _mm_min_ps(x,minP[0]); maxP[0] = _mm_max_ps(x,maxP[0]);
+						minP[1] = _mm_min_ps(y,minP[1]); maxP[1] = _mm_max_ps(y,maxP[1]);
+						minP[2] = _mm_min_ps(z,minP[2]); maxP[2] = _mm_max_ps(z,maxP[2]);
+						const __m128 xPlusY = _mm_add_ps(x,y);
+						const __m128 xMinusY = _mm_sub_ps(x,y);
+						const __m128 projection[DirectionCount] = {
+							x,y,z,_mm_add_ps(xPlusY,z),_mm_sub_ps(xPlusY,z),_mm_add_ps(xMinusY,z),_mm_sub_ps(xMinusY,z)
+						};
+						// every lane sees increasing positions, so strictly better is enough to keep the first
+						for (auto d=0u; d<DirectionCount; d++)
+						{
+							const __m128 lower = _mm_cmplt_ps(projection[d],lowest[d]);
+							lowest[d] = select(lowest[d],projection[d],lower);
+							lowestIx[d] = select(lowestIx[d],ix,_mm_castps_si128(lower));
+							const __m128 higher = _mm_cmpgt_ps(projection[d],highest[d]);
+							highest[d] = select(highest[d],projection[d],higher);
+							highestIx[d] = select(highestIx[d],ix,_mm_castps_si128(higher));
+						}
+						ix = _mm_add_epi32(ix,four);
+					}
+
+					alignas(16) float values[4];
+					alignas(16) uint32_t indices[4];
+					for (auto c=0u; c<3u; c++)
+					{
+						_mm_store_ps(values,minP[c]);
+						for (auto l=0u; l<4u; l++)
+							extremes.min[c] = std::min(extremes.min[c],values[l]);
+						_mm_store_ps(values,maxP[c]);
+						for (auto l=0u; l<4u; l++)
+							extremes.max[c] = std::max(extremes.max[c],values[l]);
+					}
+					for (auto d=0u; d<DirectionCount; d++)
+					{
+						_mm_store_ps(values,lowest[d]);
+						_mm_store_si128(reinterpret_cast<__m128i*>(indices),lowestIx[d]);
+						for (auto l=0u; l<4u; l++)
+							extremes.addLowest(d,values[l],indices[l]);
+						_mm_store_ps(values,highest[d]);
+						_mm_store_si128(reinterpret_cast<__m128i*>(indices),highestIx[d]);
+						for (auto l=0u; l<4u; l++)
+							extremes.addHighest(d,values[l],indices[l]);
+					}
+				}
+				#endif
+				for (; i<end; i++)
+					extremes.add(getFastPosition(job,i),i);
+			}
+			else
+			{
+				for (; i<end; i++)
+				{
+					const auto p = getPosition(job,i);
+					extremes.add(p.pointer,i);
+				}
+			}
+		}
+
+		static inline void sweepProjections(const SJob& job, const uint32_t begin, const uint32_t end, const nbl::core::vectorSIMDf* axes, SProjections& projections)
+		{
+			auto add = [&](const float x, const float y, const float z) -> void
+			{
+				for (auto a=0u; a<3u; a++)
+				{
+					const float projection = (x*axes[a].x+y*axes[a].y)+z*axes[a].z;
+					projections.min[a] = std::min(projections.min[a],projection);
+					projections.max[a] = std::max(projections.max[a],projection);
+				}
+			};
+			auto i = begin;
+			if (hasFastPath(job))
+			{
+				#ifdef _BOUNDING_VOLUME_BATCH_SSE_
+				if (begin+4u<=end)
+				{
+					__m128 axis[3][3],minP[3],maxP[3];
+					for (auto a=0u; a<3u; a++)
+					{
+						for (auto c=0u; c<3u; c++)
+							axis[a][c] = _mm_set1_ps(axes[a].pointer[c]);
+						minP[a] = _mm_set1_ps(FLT_MAX);
+						maxP[a] = _mm_set1_ps(-FLT_MAX);
+					}
+					for (; i+4u<=end; i+=4u)
+					{
+						const float* p[4] = {getFastPosition(job,i),getFastPosition(job,i+1u),getFastPosition(job,i+2u),getFastPosition(job,i+3u)};
+						const __m128 x = _mm_setr_ps(p[0][0],p[1][0],p[2][0],p[3][0]);
+						const __m128 y = _mm_setr_ps(p[0][1],p[1][1],p[2][1],p[3][1]);
+						const __m128 z = _mm_setr_ps(p[0][2],p[1][2],p[2][2],p[3][2]);
+						for (auto a=0u; a<3u; a++)
+						{
+							const __m128 projection = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x,axis[a][0]),_mm_mul_ps(y,axis[a][1])),_mm_mul_ps(z,axis[a][2]));
+							minP[a] = _mm_min_ps(projection,minP[a]);
+							maxP[a] = _mm_max_ps(projection,maxP[a]);
+						}
+					}
+					alignas(16) float values[4];
+					for (auto a=0u; a<3u; a++)
+					{
+						_mm_store_ps(values,minP[a]);
+						for (auto l=0u; l<4u; l++)
+							projections.min[a] = std::min(projections.min[a],values[l]);
+						_mm_store_ps(values,maxP[a]);
+						for (auto l=0u; l<4u; l++)
+							projections.max[a] = std::max(projections.max[a],values[l]);
+					}
+				}
+				#endif
+				for (; i<end; i++)
+				{
+					const float* p = getFastPosition(job,i);
+					add(p[0],p[1],p[2]);
+				}
+			}
+			else
+			{
+				for (; i<end; i++)
+				{
+					const auto p = getPosition(job,i);
+					add(p.x,p.y,p.z);
+				}
+			}
+		}
+
+		static inline float halfSurfaceArea(const float* extent)
+		{
+			return extent[0]*extent[1]+extent[1]*extent[2]+extent[2]*extent[0];
+		}
+
+		static inline void chooseAxes(const SJob& job, const SExtremes& extremes, nbl::core::vectorSIMDf* axes)
+		{
+			using namespace nbl::core;
+			// no finite extreme along some direction (every position NaN or infinite along it), there are no points to fit to,
+			// the world axes make the projections match the AABB so the AABB gets used
+			for (auto d=0u; d<DirectionCount; d++)
+			if (extremes.lowestIx[d]==~0u || extremes.highestIx[d]==~0u)
+			{
+				axes[0] = vectorSIMDf(1.f,0.f,0.f);
+				axes[1] = vectorSIMDf(0.f,1.f,0.f);
+				axes[2] = vectorSIMDf(0.f,0.f,1.f);
+				return;
+			}
+			vectorSIMDf points[DirectionCount*2u];
+			for (auto d=0u; d<DirectionCount; d++)
+			{
+				points[d*2u] = getPosition(job,extremes.lowestIx[d]);
+				points[d*2u+1u] = getPosition(job,extremes.highestIx[d]);
+			}
+			// surface area of the box the extremal points would need around the given orthonormal axes
+			float bestArea = FLT_MAX;
+			auto tryAxes = [&](const vectorSIMDf& u, const vectorSIMDf& v, const vectorSIMDf& w) -> void
+			{
+				const vectorSIMDf candidate[3] = {u,v,w};
+				float extent[3];
+				for (auto a=0u; a<3u; a++)
+				{
+					float lo = FLT_MAX, hi = -FLT_MAX;
+					for (const auto& p : points)
+					{
+						const float projection = dot(p,candidate[a]).x;
+						lo = std::min(lo,projection);
+						hi = std::max(hi,projection);
+					}
+					extent[a] = hi-lo;
+				}
+				const float area = halfSurfaceArea(extent);
+				if (area<bestArea)
+				{
+					bestArea = area;
+					std::copy_n(candidate,3u,axes);
+				}
+			};
+			tryAxes(vectorSIMDf(1.f,0.f,0.f),vectorSIMDf(0.f,1.f,0.f),vectorSIMDf(0.f,0.f,1.f));
+
+			// the most distant pair of extremal points along the same direction makes the first edge
+			uint32_t farthest = 0u;
+			float farthestDistance = 0.f;
+			for (auto d=0u; d<DirectionCount; d++)
+			{
+				const auto diff = points[d*2u+1u]-points[d*2u];
+				const float distance = dot(diff,diff).x;
+				if (distance>farthestDistance)
+				{
+					farthestDistance = distance;
+					farthest = d;
+				}
+			}
+			// all the vertices are in one place
+			if (!(farthestDistance>0.f))
+				return;
+			const vectorSIMDf p0 = points[farthest*2u];
+			const vectorSIMDf p1 = points[farthest*2u+1u];
+			const vectorSIMDf e0 = normalize(p1-p0);
+			const float epsilon = farthestDistance*1e-10f;
+
+			vectorSIMDf p2;
+			float p2Distance = 0.f;
+			for (const auto& p : points)
+			{
+				const auto offLine = cross(p-p0,e0);
+				const float distance = dot(offLine,offLine).x;
+				if (distance>p2Distance)
+				{
+					p2Distance = distance;
+					p2 = p;
+				}
+			}
+			if (!(p2Distance>epsilon))
+			{
+				// collinear, any axes perpendicular to the line will do
+				const vectorSIMDf v = normalize(cross(e0,std::abs(e0.x)<0.9f ? vectorSIMDf(1.f,0.f,0.f):vectorSIMDf(0.f,1.f,0.f)));
+				tryAxes(e0,v,cross(e0,v));
+				return;
+			}
+
+			auto tryTriangle = [&](const vectorSIMDf& a, const vectorSIMDf& b, const vectorSIMDf& c) -> void
+			{
+				const auto n = cross(b-a,c-a);
+				if (!(dot(n,n).x>epsilon*epsilon))
+					return;
+				const auto normal = normalize(n);
+				for (const auto& edge : {b-a,c-b,a-c})
+				{
+					const auto u = normalize(edge);
+					tryAxes(u,cross(normal,u),normal);
+				}
+			};
+			tryTriangle(p0,p1,p2);
+			// the extremal points furthest from the base triangle's plane on both sides make the ditetrahedron
+			const auto normal = normalize(cross(p1-p0,p2-p0));
+			const float planeDistance = dot(normal,p0).x;
+			vectorSIMDf q[2] = {p0,p0};
+			float qDistance[2] = {0.f,0.f};
+			for (const auto& p : points)
+			{
+				const float distance = dot(normal,p).x-planeDistance;
+				if (distance<qDistance[0])
+				{
+					qDistance[0] = distance;
+					q[0] = p;
+				}
+				if (distance>qDistance[1])
+				{
+					qDistance[1] = distance;
+					q[1] = p;
+				}
+			}
+			for (auto s=0u; s<2u; s++)
+			{
+				if (!(qDistance[s]*qDistance[s]>epsilon))
+					continue;
+				tryTriangle(p0,p1,q[s]);
+				tryTriangle(p1,p2,q[s]);
+				tryTriangle(p2,p0,q[s]);
+			}
+		}
+
+		static inline nbl::core::matrix3x4SIMD zeroScaleMatrix(const nbl::core::vectorSIMDf& corner)
+		{
+			return nbl::core::matrix3x4SIMD(
+				nbl::core::vectorSIMDf(0.f,0.f,0.f,corner.x),
+				nbl::core::vectorSIMDf(0.f,0.f,0.f,corner.y),
+				nbl::core::vectorSIMDf(0.f,0.f,0.f,corner.z)
+			);
+		}
+
+		#ifdef _BOUNDING_VOLUME_BATCH_SSE_
+		static inline __m128 select(const __m128 a, const __m128 b, const __m128 mask)
+		{
+			return _mm_or_ps(_mm_andnot_ps(mask,a),_mm_and_ps(mask,b));
+		}
+		static inline __m128i select(const __m128i a, const __m128i b, const __m128i mask)
+		{
+			return _mm_or_si128(_mm_andnot_si128(mask,a),_mm_and_si128(mask,b));
+		}
+		#endif
+
+		nbl::core::vector<SChunk> chunks;
+		nbl::core::vector<SJobState> jobStates;
+		nbl::core::vector<uint32_t> jobIndices;
+};
+
+#endif
@@ -13,6 +13,8 @@
 #include "nbl/asset/ICPUMeshBuffer.h"
 #include <nbl/asset/bawformat/legacy/CBAWLegacy.h>
 
+#include "CBoundingVolumeBatch.h"
+
 
 using namespace nbl;
 using namespace core;
@@ -279,12 +281,19 @@ public:
         }
 
         TransMat = new core::matrix3x4SIMD[meshRaw->getMeshBuffers().size()];
-        // Fix FrontFace and BlendParams for meshBuffers
-        for (size_t i = 0ull; i < meshRaw->getMeshBuffers().size(); ++i)
         {
-            auto& meshBuffer = meshRaw->getMeshBuffers().begin()[i];
-            meshBuffer->getPipeline()->getRasterizationParams().frontFaceIsCCW = false;
-            TransMat[i] = nbl::asset::IMeshManipulator::calculateOBB(meshBuffer);
+            core::vector<CBoundingVolumeBatch::SJob> obbJobs;
+            obbJobs.reserve(meshRaw->getMeshBuffers().size());
+            // Fix FrontFace and BlendParams for meshBuffers
+            for (size_t i = 0ull; i < meshRaw->getMeshBuffers().size(); ++i)
+            {
+                auto& meshBuffer = meshRaw->getMeshBuffers().begin()[i];
+                meshBuffer->getPipeline()->getRasterizationParams().frontFaceIsCCW = false;
+                obbJobs.push_back(CBoundingVolumeBatch::makeJob(meshBuffer));
+            }
+            // all the meshbuffers at once
+            core::vector<core::aabbox3df> aabbs(obbJobs.size());
+            CBoundingVolumeBatch().compute(obbJobs.data(), obbJobs.data() + obbJobs.size(), aabbs.data(), TransMat);
         }
 
         // we can safely assume that all meshbuffers within mesh loaded from OBJ has same DS1 layout (used for camera-specific data)
@@ -392,14 +401,16 @@ public:
                         Col[i] = Index % 2;
                         Index /= 2;
                     }
-                    core::vectorSIMDf V0 = core::vectorSIMDf(0, 0, 0); TransMat[i3].transformVect(V0); V0 -= TransMat[i3].getTranslation(); Verts[0] = V0;
-                    V0 = core::vectorSIMDf(1, 0, 0); TransMat[i3].transformVect(V0); V0 -= TransMat[i3].getTranslation(); Verts[1] = V0;
-                    V0 = core::vectorSIMDf(1, 0, 1); TransMat[i3].transformVect(V0); V0 -= TransMat[i3].getTranslation(); Verts[2] = V0;
-                    V0 = core::vectorSIMDf(0, 0, 1); TransMat[i3].transformVect(V0); V0 -= TransMat[i3].getTranslation(); Verts[3] = V0;
-                    V0 = core::vectorSIMDf(1, 1, 1); TransMat[i3].transformVect(V0); V0 -= TransMat[i3].getTranslation(); Verts[4] = V0;
-                    V0 = core::vectorSIMDf(0, 1, 1); TransMat[i3].transformVect(V0); V0 -= TransMat[i3].getTranslation(); Verts[5] = V0;
-                    V0 = core::vectorSIMDf(0, 1, 0); TransMat[i3].transformVect(V0); V0 -= TransMat[i3].getTranslation(); Verts[6] = V0;
-                    V0 = core::vectorSIMDf(1, 1, 0); TransMat[i3].transformVect(V0); V0 -= TransMat[i3].getTranslation(); Verts[7] = V0;
+                    // the OBB maps the unit cube onto the box, corners are points so W is 1 to get the translation applied
+                    const core::vectorSIMDf UnitCubeCorners[8] = {
+                        core::vectorSIMDf(0, 0, 0, 1), core::vectorSIMDf(1, 0, 0, 1), core::vectorSIMDf(1, 0, 1, 1), core::vectorSIMDf(0, 0, 1, 1),
+                        core::vectorSIMDf(1, 1, 1, 1), core::vectorSIMDf(0, 1, 1, 1), core::vectorSIMDf(0, 1, 0, 1), core::vectorSIMDf(1, 1, 0, 1)
+                    };
+                    for (int i = 0; i < 8; i++)
+                    {
+                        Verts[i] = UnitCubeCorners[i];
+                        TransMat[i3].transformVect(Verts[i]);
+                    }
                     AddTriangle(Verts[0], Verts[1], Verts[2], Col);
                     AddTriangle(Verts[0], Verts[2], Verts[3], Col);
                     AddTriangle(Verts[6], Verts[5], Verts[4], Col);
@@ -0,0 +1,211 @@
+#define _NBL_STATIC_LIB_
+#include <nabla.h>
+#include <random>
+#include <chrono>
+#include "../common/CommonAPI.h"
+
+#include "../51.RadixSort/SortElement.h"
+#include "../51.RadixSort/ParallelRadixSort.h"
+
+using namespace nbl;
+using namespace core;
+
+
+// Headless CPU-only counterpart of 51.RadixSort, no GPU or window needed so it can run on any build machine.
+// Usage: `[-MAX_COUNT=n] [-THREADS=n] [-SEED=n]`, sizes go from 1M up to `n` (default 256M) elements in steps of 4x.
+// Afterwards a sweep over key types and widths shows what the pass count specialization and single-bucket pass skipping buy.
+class CPURadixSortBenchmarkApp : public NonGraphicalApplicationBase
+{
+	using clock_t = std::chrono::high_resolution_clock;
+
+	// 12 and 24 byte elements don't divide the 64 byte write combining lines, so a flush mustn't write past the last element of a line
+	template<typename Key, uint32_t PayloadCount>
+	struct SPaddedKeyValuePair
+	{
+		Key key;
+		uint32_t data;
+		uint32_t payload[PayloadCount];
+	};
+
+	core::smart_refctd_ptr<nbl::system::ISystem> system;
+
+public:
+
+	void setSystem(core::smart_refctd_ptr<nbl::system::ISystem>&& system) override
+	{
+		system = std::move(system);
+	}
+
+	NON_GRAPHICAL_APP_CONSTRUCTOR(CPURadixSortBenchmarkApp);
+
+	void onAppInitialized_impl() override
+	{
+		size_t maxCount = 256ull<<20ull;
+		uint32_t threadCount = 0u;
+		uint32_t seed = 0x45u;
+		for (const auto& arg : argv)
+		{
+			if (arg.rfind("-MAX_COUNT=",0)==0)
+				maxCount = std::stoull(arg.substr(11));
+			else if (arg.rfind("-THREADS=",0)==0)
+				threadCount = std::stoul(arg.substr(9));
+			else if (arg.rfind("-SEED=",0)==0)
+				seed = std::stoul(arg.substr(6));
+		}
+		printf("Threads: %u\n",threadCount ? threadCount:std::max(std::thread::hardware_concurrency(),1u));
+
+		for (size_t count=1ull<<20ull; count<=maxCount; count<<=2ull)
+		{
+			core::vector<SortElement> original(count);
+			{
+				std::mt19937 mt(seed);
+				std::uniform_int_distribution<uint32_t> distribution(0u,~0u);
+				for (size_t i=0ull; i<count; i++)
+					original[i] = {distribution(mt),uint32_t(i)};
+			}
+			core::vector<SortElement> work(count), scratch(count);
+
+			// small sizes are over too quickly to time once, best of a few runs then
+			const uint32_t repeats = uint32_t(std::max<size_t>((16ull<<20ull)/count,1ull));
+			auto bestMkeysPerSecond = [&](auto&& sort) -> double
+			{
+				double bestUs = std::numeric_limits<double>::max();
+				for (uint32_t r=0u; r<repeats; r++)
+				{
+					std::copy(original.begin(),original.end(),work.begin());
+					const auto start = clock_t::now();
+					sort();
+					bestUs = std::min(bestUs,double(std::chrono::duration_cast<std::chrono::microseconds>(clock_t::now()-start).count()));
+				}
+				return double(count)/std::max(bestUs,1.0);
+			};
+
+			const double stdSort = bestMkeysPerSecond([&]() -> void
+			{
+				std::sort(work.begin(),work.end(),[](const SortElement& lhs, const SortElement& rhs) -> bool {return lhs.key<rhs.key;});
+			});
+			const double coreRadixSort = bestMkeysPerSecond([&]() -> void
+			{
+				core::radix_sort(work.data(),scratch.data(),count,SortElementKeyAccessor());
+			});
+			SortElement* sorted = nullptr;
+			const double parallelRadixSort = bestMkeysPerSecond([&]() -> void
+			{
+				sorted = parallel_radix_sort(work.data(),scratch.data(),count,SortElementKeyAccessor(),threadCount);
+			});
+
+			printf(
+				"%10zu keys | std::sort %8.2f Mkeys/s core::radix_sort %8.2f Mkeys/s parallel_radix_sort %8.2f Mkeys/s (%5.2fx)\n",
+				count,stdSort,coreRadixSort,parallelRadixSort,parallelRadixSort/coreRadixSort
+			);
+
+			if (!validate(original,sorted))
+			{
+				printf("parallel_radix_sort output is not a stable sort of the input!\n");
+				exit(0x45);
+			}
+		}
+
+		const size_t count = std::min<size_t>(16ull<<20ull,maxCount);
+		printf("\nKey width sweep, %zu keys, 8-bit radix vs. radix picked from the key width\n",count);
+		runKeyWidth<uint32_t,16ull>("uint32_t 16-bit material ID",count,seed,threadCount);
+		runKeyWidth<uint32_t,24ull>("uint32_t 24-bit Morton code",count,seed,threadCount);
+		runKeyWidth<uint32_t,32ull>("uint32_t",count,seed,threadCount);
+		runKeyWidth<uint64_t,64ull>("uint64_t",count,seed,threadCount);
+		runKeyWidth<int32_t,32ull>("int32_t",count,seed,threadCount);
+		runKeyWidth<float,32ull>("float",count,seed,threadCount);
+		runKeyWidth<double,64ull>("double",count,seed,threadCount);
+		// full width accessor but the top half is always zero, the early-out has to catch it at runtime
+		runKeyWidth<uint32_t,16ull,SortKeyAccessor<uint32_t>>("uint32_t 16-bit, full width accessor",count,seed,threadCount);
+		runKeyWidth<uint32_t,32ull,SortKeyAccessor<uint32_t>,SPaddedKeyValuePair<uint32_t,1u>>("uint32_t, 12 byte elements",count,seed,threadCount);
+		runKeyWidth<uint32_t,32ull,SortKeyAccessor<uint32_t>,SPaddedKeyValuePair<uint32_t,4u>>("uint32_t, 24 byte elements",count,seed,threadCount);
+	}
+
+	template<typename Key, size_t KeyBits, class KeyAccessor=SortKeyAccessor<Key,KeyBits>, typename Element=SortKeyValuePair<Key>>
+	static void runKeyWidth(const char* name, const size_t count, const uint32_t seed, const uint32_t threadCount)
+	{
+		using element_t = Element;
+		core::vector<element_t> original(count);
+		{
+			std::mt19937_64 mt(seed);
+			for (size_t i=0ull; i<count; i++)
+			{
+				if constexpr (std::is_floating_point_v<Key>)
+					original[i] = {std::uniform_real_distribution<Key>(-1000000.0,1000000.0)(mt),uint32_t(i)};
+				else
+				{
+					constexpr uint64_t mask = KeyBits<64ull ? ((0x1ull<<KeyBits)-1ull):~0ull;
+					original[i] = {Key(mt()&mask),uint32_t(i)};
+				}
+			}
+		}
+		// one guard element past the end of both buffers, the sort must never touch it
+		core::vector<element_t> work(count+1ull), scratch(count+1ull);
+		const uint32_t guard = ~0u;
+		work.back().data = scratch.back().data = guard;
+
+		auto timeSort = [&](auto&& sort) -> double
+		{
+			std::copy(original.begin(),original.end(),work.begin());
+			const auto start = clock_t::now();
+			const element_t* sorted = sort();
+			const double us = std::max(double(std::chrono::duration_cast<std::chrono::microseconds>(clock_t::now()-start).count()),1.0);
+			if (!validate(original,sorted) || work.back().data!=guard || scratch.back().data!=guard)
+			{
+				printf("parallel_radix_sort output for %s keys is not a stable sort of the input!\n",name);
+				exit(0x45);
+			}
+			return double(count)/us;
+		};
+		const double fixedRadix = timeSort([&]() -> element_t*
+		{
+			return parallel_radix_sort<8ull>(work.data(),scratch.data(),count,KeyAccessor(),threadCount);
+		});
+		const double autoRadix = timeSort([&]() -> element_t*
+		{
+			return parallel_radix_sort(work.data(),scratch.data(),count,KeyAccessor(),threadCount);
+		});
+
+		constexpr size_t keyBits = KeyAccessor::key_bit_count;
+		constexpr size_t radixBits = default_radix_bits(keyBits);
+		printf(
+			"%-40s | %zu x 8-bit %8.2f Mkeys/s | %zu x %zu-bit %8.2f Mkeys/s (%5.2fx)\n",name,
+			size_t((keyBits+7ull)/8ull),fixedRadix,size_t((keyBits+radixBits-1ull)/radixBits),radixBits,autoRadix,autoRadix/fixedRadix
+		);
+	}
+
+	// data is the original index, so a stable sort is sorted by key, ties in increasing data and a permutation where every key matches its origin
+	template<typename Element>
+	static bool validate(const core::vector<Element>& original, const Element* sorted)
+	{
+		using key_traits_t = SRadixKeyTraits<decltype(Element::key)>;
+		core::vector<bool> seen(original.size(),false);
+		for (size_t i=0ull; i<original.size(); i++)
+		{
+			const auto& item = sorted[i];
+			if (item.data>=original.size() || seen[item.data] || original[item.data].key!=item.key)
+				return false;
+			seen[item.data] = true;
+			const auto prevKey = i ? key_traits_t::encode(sorted[i-1ull].key):0u;
+			const auto key = key_traits_t::encode(item.key);
+			if (i && (prevKey>key || (prevKey==key && sorted[i-1ull].data>item.data)))
+				return false;
+		}
+		return true;
+	}
+
+	void onAppTerminated_impl() override
+	{
+	}
+
+	void workLoopBody() override
+	{
+	}
+
+	bool keepRunning() override
+	{
+		return false;
+	}
+};
+
+NBL_COMMON_API_MAIN(CPURadixSortBenchmarkApp)
@@ -0,0 +1,380 @@
+#define _NBL_STATIC_LIB_
+#include <nabla.h>
+#include <random>
+#include <chrono>
+#include <thread>
+#include <fstream>
+#include "../common/CommonAPI.h"
+
+using namespace nbl;
+using namespace nbl::asset;
+using namespace nbl::core;
+
+
+/*
+	Discrete convolution from 43.SumAndCDFFilters (recovers the input image from its summed area table), as a 1D weight function for CBlitUtilities
+
+	- (weight = -1) in [-1.5,-0.5]
+	- (weight = 1) in [-0.5,0.5]
+	- (weight = 0) everywhere else
+*/
+struct SDiscreteConvolutionFunction
+{
+	using value_t = double;
+
+	static inline constexpr float min_support = -1.5f;
+	static inline constexpr float max_support = +0.5f;
+	static inline constexpr uint32_t k_smoothness = 0u;
+
+	template <int32_t derivative = 0>
+	static inline value_t weight(const float x)
+	{
+		if constexpr (derivative != 0)
+			return 0.0;
+		if (x >= -1.5f && x < -0.5f)
+			return -1.0;
+		else if (x >= -0.5f && x <= 0.5f)
+			return 1.0;
+		return 0.0;
+	}
+};
+
+template <class Function1D>
+using blit_utils_for_t = CBlitUtilities<CDefaultChannelIndependentWeightFunction1D<CConvolutionWeightFunction1D<CWeightFunction1D<Function1D>, CWeightFunction1D<Function1D>>>>;
+
+
+// Headless throughput matrix of the CPU `CBlitImageFilter` over kernels, formats, scale factors, alpha semantics and threading.
+// Usage: `[-SIZE=n] [-REPEATS=n] [-OUTPUT=path.json]`, synthetic inputs are `n`x`n` (default 1024), BC input comes from the media folder.
+// `execution::par_unseq` can't be told how many threads to use, so thread scaling is measured the way mip generation scales in practice:
+// N threads each running their own sequential blit of the same input at once.
+class CPUBlitBenchmarkApp : public NonGraphicalApplicationBase
+{
+	using clock_t = std::chrono::high_resolution_clock;
+
+	core::smart_refctd_ptr<nbl::system::ISystem> system;
+	core::smart_refctd_ptr<nbl::asset::IAssetManager> assetManager;
+	core::smart_refctd_ptr<nbl::system::ILogger> logger;
+
+	struct SResult
+	{
+		std::string kernel;
+		E_FORMAT inFormat;
+		E_FORMAT outFormat;
+		core::vectorSIMDu32 inExtent;
+		core::vectorSIMDu32 outExtent;
+		IBlitUtilities::E_ALPHA_SEMANTIC alphaSemantic;
+		const char* mode;
+		uint32_t threadCount;
+		double seconds;
+		double megapixelsPerSecond;
+	};
+	core::vector<SResult> results;
+	uint32_t repeats = 3u;
+	bool failed = false;
+
+public:
+
+	void setSystem(core::smart_refctd_ptr<nbl::system::ISystem>&& _system) override
+	{
+		system = std::move(_system);
+	}
+
+	NON_GRAPHICAL_APP_CONSTRUCTOR(CPUBlitBenchmarkApp);
+
+	void onAppInitialized_impl() override
+	{
+		CommonAPI::InitParams initParams;
+		initParams.apiType = video::EAT_VULKAN;
+		initParams.appName = { "65.CPUBlitBenchmark" };
+		// CPU only, no Vulkan device needed
+		auto initOutput = CommonAPI::Init<false>(std::move(initParams));
+
+		system = std::move(initOutput.system);
+		assetManager = std::move(initOutput.assetManager);
+		logger = std::move(initOutput.logger);
+
+		uint32_t size = 1024u;
+		std::string outputPath = "blit_benchmark.json";
+		for (const auto& arg : argv)
+		{
+			if (arg.rfind("-SIZE=",0)==0)
+				size = std::stoul(arg.substr(6));
+			else if (arg.rfind("-REPEATS=",0)==0)
+				repeats = std::max<uint32_t>(std::stoul(arg.substr(9)),1u);
+			else if (arg.rfind("-OUTPUT=",0)==0)
+				outputPath = arg.substr(8);
+		}
+
+		core::vector<core::smart_refctd_ptr<ICPUImage>> inputs;
+		inputs.push_back(createRandomImage(size,size,EF_R8G8B8A8_SRGB));
+		inputs.push_back(createRandomImage(size,size,EF_R32G32B32A32_SFLOAT));
+		if (auto bcImage=loadImage("../../media/GLI/kueken7_rgba_dxt5_unorm.dds"))
+			inputs.push_back(std::move(bcImage));
+		else
+			logger->log("Couldn't load the BC input, skipping the BC format.",system::ILogger::ELL_WARNING);
+
+		for (const auto& input : inputs)
+		{
+			runKernel<SMitchellFunction<>>("Mitchell",input.get());
+			runKernel<SKaiserFunction>("Kaiser",input.get());
+			runKernel<SBoxFunction>("Box",input.get());
+			runKernel<SDiscreteConvolutionFunction>("DiscreteConvolution",input.get());
+		}
+
+		writeJSON(outputPath);
+		if (failed)
+			exit(0x45);
+	}
+
+	template <class Function1D>
+	void runKernel(const char* kernelName, ICPUImage* inImage)
+	{
+		using blit_utils_t = blit_utils_for_t<Function1D>;
+		using blit_filter_t = CBlitImageFilter<VoidSwizzle,IdentityDither,void,false,blit_utils_t>;
+
+		const auto& inParams = inImage->getCreationParameters();
+		const core::vectorSIMDu32 inExtent(inParams.extent.width,inParams.extent.height,1u,1u);
+		// BC can only be read, for everything else the mip chain keeps the input format
+		const E_FORMAT outFormat = isBlockCompressionFormat(inParams.format) ? EF_R8G8B8A8_SRGB:inParams.format;
+
+		// 1/2 is a mip level, 1/4 skips one, 3/4 has a non-trivial kernel phase pattern and 2 is an upscale
+		constexpr std::pair<uint32_t,uint32_t> Scales[] = {{1u,2u},{1u,4u},{3u,4u},{2u,1u}};
+		for (const auto& [numerator,denominator] : Scales)
+		{
+			const core::vectorSIMDu32 outExtent(std::max(inExtent.x*numerator/denominator,1u),std::max(inExtent.y*numerator/denominator,1u),1u,1u);
+			const auto kernels = blit_utils_t::template getConvolutionKernels<CWeightFunction1D<Function1D>>(inExtent,outExtent);
+
+			for (const auto alphaSemantic : {IBlitUtilities::EAS_NONE_OR_PREMULTIPLIED,IBlitUtilities::EAS_REFERENCE_OR_COVERAGE})
+			{
+				struct SJob
+				{
+					core::smart_refctd_ptr<ICPUImage> outImage;
+					typename blit_filter_t::state_type state;
+				};
+				auto createJob = [&]() -> std::unique_ptr<SJob>
+				{
+					auto job = std::unique_ptr<SJob>(new SJob{createImage(outExtent.x,outExtent.y,outFormat),typename blit_filter_t::state_type(kernels)});
+					auto& state = job->state;
+					state.inOffsetBaseLayer = core::vectorSIMDu32();
+					state.inExtentLayerCount = inExtent;
+					state.inImage = inImage;
+					state.outImage = job->outImage.get();
+					state.outOffsetBaseLayer = core::vectorSIMDu32();
+					state.outExtentLayerCount = outExtent;
+					state.axisWraps[0] = ISampler::ETC_CLAMP_TO_EDGE;
+					state.axisWraps[1] = ISampler::ETC_CLAMP_TO_EDGE;
+					state.axisWraps[2] = ISampler::ETC_CLAMP_TO_EDGE;
+					state.alphaSemantic = alphaSemantic;
+					state.alphaRefValue = 0.5f;
+					state.alphaBinCount = IBlitUtilities::DefaultAlphaBinCount;
+					state.scratchMemoryByteSize = blit_filter_t::getRequiredScratchByteSize(&state);
+					state.scratchMemory = reinterpret_cast<uint8_t*>(_NBL_ALIGNED_MALLOC(state.scratchMemoryByteSize,32));
+					if (!blit_utils_t::computeScaledKernelPhasedLUT(state.scratchMemory+blit_filter_t::getScratchOffset(&state,blit_filter_t::ESU_SCALED_KERNEL_PHASED_LUT),inExtent,outExtent,IImage::ET_2D,kernels))
+					{
+						_NBL_ALIGNED_FREE(state.scratchMemory);
+						return nullptr;
+					}
+					return job;
+				};
+				auto destroyJob = [](std::unique_ptr<SJob>& job) -> void
+				{
+					if (job)
+						_NBL_ALIGNED_FREE(job->state.scratchMemory);
+					job = nullptr;
+				};
+
+				SResult result = {kernelName,inParams.format,outFormat,inExtent,outExtent,alphaSemantic,nullptr,1u,0.0,0.0};
+				auto record = [&](const char* mode, const uint32_t threadCount, const double seconds) -> void
+				{
+					result.mode = mode;
+					result.threadCount = threadCount;
+					result.seconds = seconds;
+					result.megapixelsPerSecond = double(outExtent.x)*outExtent.y*threadCount/std::max(seconds,1e-9)*1e-6;
+					logger->log(
+						"%-20s %-26s -> %-26s %5ux%-5u -> %5ux%-5u %-10s %-10s x%-3u %10.3f ms %10.2f MP/s",system::ILogger::ELL_INFO,
+						kernelName,getFormatName(inParams.format).c_str(),getFormatName(outFormat).c_str(),inExtent.x,inExtent.y,outExtent.x,outExtent.y,
+						alphaSemantic==IBlitUtilities::EAS_REFERENCE_OR_COVERAGE ? "coverage":"none",mode,threadCount,seconds*1000.0,result.megapixelsPerSecond
+					);
+					results.push_back(result);
+				};
+
+				// sequential and par_unseq on a single blit
+				auto job = createJob();
+				if (!job)
+				{
+					logger->log("Failed to compute the LUT for blitting",system::ILogger::ELL_ERROR);
+					failed = true;
+					continue;
+				}
+				auto timeBest = [&](auto&& f) -> double
+				{
+					double best = std::numeric_limits<double>::max();
+					for (uint32_t r=0u; r<repeats; r++)
+					{
+						const auto start = clock_t::now();
+						if (!f())
+						{
+							failed = true;
+							return 0.0;
+						}
+						best = std::min(best,std::chrono::duration<double>(clock_t::now()-start).count());
+					}
+					return best;
+				};
+				record("seq",1u,timeBest([&]() -> bool {return blit_filter_t::execute(core::execution::seq,&job->state);}));
+				record("par_unseq",1u,timeBest([&]() -> bool {return blit_filter_t::execute(core::execution::par_unseq,&job->state);}));
+				destroyJob(job);
+
+				// N independent sequential blits at once
+				const uint32_t maxThreads = std::max(std::thread::hardware_concurrency(),1u);
+				for (uint32_t threadCount=2u; threadCount<=maxThreads; threadCount=threadCount<maxThreads ? std::min(threadCount*2u,maxThreads):threadCount+1u)
+				{
+					core::vector<std::unique_ptr<SJob>> jobs(threadCount);
+					for (auto& j : jobs)
+						j = createJob();
+					const double seconds = timeBest([&]() -> bool
+					{
+						std::atomic_bool success = true;
+						core::vector<std::thread> threads;
+						for (auto& j : jobs)
+							threads.emplace_back([&success,&j]() -> void
+							{
+								if (!j || !blit_filter_t::execute(core::execution::seq,&j->state))
+									success = false;
+							});
+						for (auto& thread : threads)
+							thread.join();
+						return success;
+					});
+					record("threads",threadCount,seconds);
+					for (auto& j : jobs)
+						destroyJob(j);
+				}
+			}
+		}
+	}
+
+	void writeJSON(const std::string& path)
+	{
+		std::ofstream file(path);
+		if (!file)
+		{
+			logger->log("Couldn't open %s for writing.",system::ILogger::ELL_ERROR,path.c_str());
+			failed = true;
+			return;
+		}
+
+		file << "{\n\t\"repeats\": " << repeats << ",\n\t\"hardwareConcurrency\": " << std::thread::hardware_concurrency() << ",\n\t\"results\": [\n";
+		for (size_t i=0ull; i<results.size(); i++)
+		{
+			const auto& r = results[i];
+			file << "\t\t{\"kernel\": \"" << r.kernel << "\", \"inFormat\": \"" << getFormatName(r.inFormat) << "\", \"outFormat\": \"" << getFormatName(r.outFormat)
+				<< "\", \"inExtent\": [" << r.inExtent.x << ", " << r.inExtent.y << "], \"outExtent\": [" << r.outExtent.x << ", " << r.outExtent.y
+				<< "], \"alphaSemantic\": \"" << (r.alphaSemantic==IBlitUtilities::EAS_REFERENCE_OR_COVERAGE ? "coverage":"none")
+				<< "\", \"mode\": \"" << r.mode << "\", \"threads\": " << r.threadCount << ", \"seconds\": " << r.seconds
+				<< ", \"megapixelsPerSecond\": " << r.megapixelsPerSecond << "}" << (i+1ull<results.size() ? ",\n":"\n");
+		}
+		file << "\t]\n}\n";
+		logger->log("Wrote %zu results to %s",system::ILogger::ELL_INFO,results.size(),path.c_str());
+	}
+
+	static std::string getFormatName(const E_FORMAT format)
+	{
+		switch (format)
+		{
+			case EF_R8G8B8A8_SRGB:
+				return "R8G8B8A8_SRGB";
+			case EF_R32G32B32A32_SFLOAT:
+				return "R32G32B32A32_SFLOAT";
+			case EF_BC1_RGBA_UNORM_BLOCK:
+				return "BC1_RGBA_UNORM";
+			case EF_BC3_UNORM_BLOCK:
+				return "BC3_UNORM";
+			default:
+				return "E_FORMAT("+std::to_string(format)+")";
+		}
+	}
+
+	core::smart_refctd_ptr<ICPUImage> loadImage(const char* path)
+	{
+		constexpr auto cachingFlags = static_cast<IAssetLoader::E_CACHING_FLAGS>(IAssetLoader::ECF_DONT_CACHE_REFERENCES & IAssetLoader::ECF_DONT_CACHE_TOP_LEVEL);
+		IAssetLoader::SAssetLoadParams loadParams(0ull,nullptr,cachingFlags);
+		auto contents = assetManager->getAsset(path,loadParams).getContents();
+		if (contents.empty())
+			return nullptr;
+
+		auto asset = *contents.begin();
+		if (asset->getAssetType()==IAsset::ET_IMAGE_VIEW)
+			return core::smart_refctd_ptr_static_cast<ICPUImageView>(asset)->getCreationParameters().image;
+		else if (asset->getAssetType()==IAsset::ET_IMAGE)
+			return core::smart_refctd_ptr_static_cast<ICPUImage>(asset);
+		return nullptr;
+	}
+
+	static core::smart_refctd_ptr<ICPUImage> createImage(const uint32_t width, const uint32_t height, const E_FORMAT format)
+	{
+		IImage::SCreationParams imageParams = {};
+		imageParams.flags = static_cast<IImage::E_CREATE_FLAGS>(0u);
+		imageParams.type = IImage::ET_2D;
+		imageParams.format = format;
+		imageParams.extent = {width,height,1u};
+		imageParams.mipLevels = 1u;
+		imageParams.arrayLayers = 1u;
+		imageParams.samples = ICPUImage::ESCF_1_BIT;
+		imageParams.usage = IImage::EUF_SAMPLED_BIT;
+
+		auto regions = core::make_refctd_dynamic_array<core::smart_refctd_dynamic_array<IImage::SBufferCopy>>(1ull);
+		auto& region = regions->front();
+		region.bufferOffset = 0ull;
+		region.bufferRowLength = width;
+		region.bufferImageHeight = 0u;
+		region.imageSubresource.aspectMask = IImage::EAF_COLOR_BIT;
+		region.imageSubresource.mipLevel = 0u;
+		region.imageSubresource.baseArrayLayer = 0u;
+		region.imageSubresource.layerCount = 1u;
+		region.imageOffset = {0u,0u,0u};
+		region.imageExtent = {width,height,1u};
+
+		auto image = ICPUImage::create(std::move(imageParams));
+		if (image)
+			image->setBufferAndRegions(core::make_smart_refctd_ptr<ICPUBuffer>(size_t(getTexelOrBlockBytesize(format))*width*height),std::move(regions));
+		return image;
+	}
+
+	// fixed seed so runs stay comparable, alpha is uniform so the coverage adjustment has something to do
+	static core::smart_refctd_ptr<ICPUImage> createRandomImage(const uint32_t width, const uint32_t height, const E_FORMAT format)
+	{
+		auto image = createImage(width,height,format);
+		if (!image)
+			return nullptr;
+
+		std::mt19937 prng(0x45u);
+		std::uniform_real_distribution<double> dist(0.0,isNormalizedFormat(format) ? 1.0:20.0);
+		auto* const texels = reinterpret_cast<uint8_t*>(image->getBuffer()->getPointer());
+		const auto texelSize = getTexelOrBlockBytesize(format);
+		for (size_t i=0ull; i<size_t(width)*height; i++)
+		{
+			double decodedPixel[4];
+			for (uint32_t ch=0u; ch<4u; ch++)
+				decodedPixel[ch] = dist(prng);
+			decodedPixel[3] = std::min(decodedPixel[3],1.0);
+			encodePixelsRuntime(format,texels+i*texelSize,decodedPixel);
+		}
+		return image;
+	}
+
+	void onAppTerminated_impl() override
+	{
+	}
+
+	void workLoopBody() override
+	{
+	}
+
+	bool keepRunning() override
+	{
+		return false;
+	}
+};
+
+NBL_COMMON_API_MAIN(CPUBlitBenchmarkApp)
@@ -0,0 +1,222 @@
+#define _NBL_STATIC_LIB_
+#include <nabla.h>
+#include <random>
+#include <chrono>
+#include "../common/CommonAPI.h"
+
+#include "../22.RaytracedAO/CVertexAttributeRepacker.h"
+
+using namespace nbl;
+using namespace core;
+using namespace asset;
+
+
+// Headless check that `CVertexAttributeRepacker` produces exactly the same combined normal and UV stream as the serial loop
+// 22.RaytracedAO used to run in `Renderer::initSceneObjects`, and how much faster it does it.
+// Usage: `[-VERTICES=n] [-SEED=n]`, `n` is the vertex count of the biggest meshbuffer (default 4M).
+class VertexAttributeRepackTestApp : public NonGraphicalApplicationBase
+{
+	using clock_t = std::chrono::high_resolution_clock;
+	using combined_t = CVertexAttributeRepacker::SCombinedNormalUV;
+
+	static inline constexpr uint32_t PositionAttributeIx = 0u;
+	static inline constexpr uint32_t UVAttributeIx = 2u;
+	static inline constexpr uint32_t NormalAttributeIx = 3u;
+
+	core::smart_refctd_ptr<nbl::system::ISystem> system;
+
+public:
+
+	void setSystem(core::smart_refctd_ptr<nbl::system::ISystem>&& system) override
+	{
+		system = std::move(system);
+	}
+
+	NON_GRAPHICAL_APP_CONSTRUCTOR(VertexAttributeRepackTestApp);
+
+	void onAppInitialized_impl() override
+	{
+		uint32_t maxVertexCount = 4u<<20u;
+		uint32_t seed = 0x45u;
+		for (const auto& arg : argv)
+		{
+			if (arg.rfind("-VERTICES=",0)==0)
+				maxVertexCount = std::stoul(arg.substr(10));
+			else if (arg.rfind("-SEED=",0)==0)
+				seed = std::stoul(arg.substr(6));
+		}
+
+		std::mt19937 mt(seed);
+		// odd counts to exercise the scalar tails, one mesh without UVs and one with float normals which the old loop couldn't handle
+		struct SMeshDesc
+		{
+			uint32_t vertexCount;
+			bool hasUV;
+			E_FORMAT normalFormat;
+		};
+		const SMeshDesc descs[] = {
+			{maxVertexCount,true,EF_A2B10G10R10_SNORM_PACK32},
+			{maxVertexCount/3u+1u,true,EF_A2B10G10R10_SNORM_PACK32},
+			{4099u,false,EF_A2B10G10R10_SNORM_PACK32},
+			{3u,true,EF_A2B10G10R10_SNORM_PACK32},
+			{maxVertexCount/7u+2u,true,EF_R32G32B32_SFLOAT}
+		};
+		bool allPassed = true;
+		for (const auto& desc : descs)
+		{
+			auto meshBuffer = createMeshBuffer(desc.vertexCount,desc.hasUV,desc.normalFormat,mt);
+
+			core::vector<combined_t> repacked(desc.vertexCount);
+			CVertexAttributeRepacker repacker;
+			const auto job = CVertexAttributeRepacker::makeJob(meshBuffer.get(),UVAttributeIx,repacked.data(),desc.vertexCount);
+			const auto repackStart = clock_t::now();
+			repacker.repack(&job,&job+1);
+			const auto repackUs = std::chrono::duration_cast<std::chrono::microseconds>(clock_t::now()-repackStart).count();
+
+			// the float normal mesh has no serial reference, the old loop reinterpreted whatever was there as packed, compare to the scalar quantization
+			core::vector<combined_t> reference(desc.vertexCount);
+			const auto serialStart = clock_t::now();
+			if (desc.normalFormat==EF_R32G32B32_SFLOAT)
+				repackReferenceFloatNormals(meshBuffer.get(),reference.data(),desc.vertexCount);
+			else
+				repackSerial(meshBuffer.get(),reference.data(),desc.vertexCount);
+			const auto serialUs = std::chrono::duration_cast<std::chrono::microseconds>(clock_t::now()-serialStart).count();
+
+			const bool passed = memcmp(repacked.data(),reference.data(),sizeof(combined_t)*desc.vertexCount)==0;
+			printf(
+				"%10u vertices, %s, %s normals | serial %8lld us, repacker %8lld us | %s\n",desc.vertexCount,
+				desc.hasUV ? "with UVs":" no UVs ",desc.normalFormat==EF_R32G32B32_SFLOAT ? "float ":"packed",
+				static_cast<long long>(serialUs),static_cast<long long>(repackUs),passed ? "PASSED":"FAILED"
+			);
+			allPassed = allPassed && passed;
+		}
+		if (!allPassed)
+			exit(0x45);
+	}
+
+	static core::smart_refctd_ptr<ICPUMeshBuffer> createMeshBuffer(const uint32_t vertexCount, const bool hasUV, const E_FORMAT normalFormat, std::mt19937& mt)
+	{
+		// interleaved like the loaders produce them
+		const uint32_t normalSize = getTexelOrBlockBytesize(normalFormat);
+		const uint32_t uvOffset = sizeof(float)*3u;
+		const uint32_t normalOffset = uvOffset+(hasUV ? sizeof(float)*2u:0u);
+		const uint32_t stride = normalOffset+normalSize;
+
+		auto buffer = core::make_smart_refctd_ptr<ICPUBuffer>(size_t(stride)*vertexCount);
+		{
+			std::uniform_real_distribution<float> position(-100.f,100.f);
+			// UVs are often outside [0,1], plus some denormal and out of half range values to check the rounding corner cases
+			std::uniform_real_distribution<float> uv(-4.f,4.f);
+			std::uniform_real_distribution<float> normal(-1.f,1.f);
+			auto* data = reinterpret_cast<uint8_t*>(buffer->getPointer());
+			for (uint32_t i=0u; i<vertexCount; i++)
+			{
+				auto* vertex = data+size_t(i)*stride;
+				float* pos = reinterpret_cast<float*>(vertex);
+				for (auto c=0u; c<3u; c++)
+					pos[c] = position(mt);
+				if (hasUV)
+				{
+					float* tc = reinterpret_cast<float*>(vertex+uvOffset);
+					for (auto c=0u; c<2u; c++)
+					{
+						switch (mt()%16u)
+						{
+							case 0u:
+								tc[c] = uv(mt)*1e-6f;
+								break;
+							case 1u:
+								tc[c] = uv(mt)*20000.f;
+								break;
+							default:
+								tc[c] = uv(mt);
+								break;
+						}
+					}
+				}
+				vectorSIMDf n(normal(mt),normal(mt),normal(mt));
+				n = core::normalize(n);
+				if (normalFormat==EF_R32G32B32_SFLOAT)
+					memcpy(vertex+normalOffset,n.pointer,sizeof(float)*3u);
+				else
+				{
+					const uint32_t packed = CVertexAttributeRepacker::quantizeNormal(n.x,n.y,n.z);
+					memcpy(vertex+normalOffset,&packed,sizeof(packed));
+				}
+			}
+		}
+
+		SVertexInputParams vertexInput;
+		vertexInput.enabledBindingFlags = 0x1u;
+		vertexInput.bindings[0].inputRate = EVIR_PER_VERTEX;
+		vertexInput.bindings[0].stride = stride;
+		auto setAttribute = [&vertexInput](const uint32_t attributeIx, const E_FORMAT format, const uint32_t offset) -> void
+		{
+			vertexInput.enabledAttribFlags |= 0x1u<<attributeIx;
+			vertexInput.attributes[attributeIx].binding = 0u;
+			vertexInput.attributes[attributeIx].format = format;
+			vertexInput.attributes[attributeIx].relativeOffset = offset;
+		};
+		setAttribute(PositionAttributeIx,EF_R32G32B32_SFLOAT,0u);
+		if (hasUV)
+			setAttribute(UVAttributeIx,EF_R32G32_SFLOAT,uvOffset);
+		setAttribute(NormalAttributeIx,normalFormat,normalOffset);
+
+		// creating pipeline just to forward vtx params
+		auto pipeline = core::make_smart_refctd_ptr<ICPURenderpassIndependentPipeline>(
+			nullptr,nullptr,nullptr,
+			vertexInput,SBlendParams(),SPrimitiveAssemblyParams(),SRasterizationParams()
+		);
+		auto meshBuffer = core::make_smart_refctd_ptr<ICPUMeshBuffer>();
+		meshBuffer->setPipeline(std::move(pipeline));
+		meshBuffer->setVertexBufferBinding({0u,std::move(buffer)},0u);
+		meshBuffer->setNormalAttributeIx(NormalAttributeIx);
+		return meshBuffer;
+	}
+
+	// the loop `Renderer::initSceneObjects` used to run, verbatim apart from the output offset
+	static void repackSerial(ICPUMeshBuffer* meshBuffer, combined_t* dst, const uint32_t vertexCount)
+	{
+		auto& vertexInput = meshBuffer->getPipeline()->getVertexInputParams();
+		const auto normalAttr = meshBuffer->getNormalAttributeIx();
+		const auto origFormat = vertexInput.attributes[normalAttr].format;
+		vertexInput.attributes[normalAttr].format = EF_R32_UINT;
+		for (auto i=0u; i<vertexCount; i++)
+		{
+			meshBuffer->getAttribute(&dst[i].nml,normalAttr,i);
+			core::vectorSIMDf uv;
+			meshBuffer->getAttribute(uv,UVAttributeIx,i);
+			dst[i].u = core::Float16Compressor::compress(uv.x);
+			dst[i].v = core::Float16Compressor::compress(uv.y);
+		}
+		vertexInput.attributes[normalAttr].format = origFormat;
+	}
+
+	static void repackReferenceFloatNormals(const ICPUMeshBuffer* meshBuffer, combined_t* dst, const uint32_t vertexCount)
+	{
+		for (auto i=0u; i<vertexCount; i++)
+		{
+			core::vectorSIMDf n,uv;
+			meshBuffer->getAttribute(n,meshBuffer->getNormalAttributeIx(),i);
+			meshBuffer->getAttribute(uv,UVAttributeIx,i);
+			dst[i].nml = CVertexAttributeRepacker::quantizeNormal(n.x,n.y,n.z);
+			dst[i].u = core::Float16Compressor::compress(uv.x);
+			dst[i].v = core::Float16Compressor::compress(uv.y);
+		}
+	}
+
+	void onAppTerminated_impl() override
+	{
+	}
+
+	void workLoopBody() override
+	{
+	}
+
+	bool keepRunning() override
+	{
+		return false;
+	}
+};
+
+NBL_COMMON_API_MAIN(VertexAttributeRepackTestApp)
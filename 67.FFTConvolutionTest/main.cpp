@@ -0,0 +1,227 @@
+#define _NBL_STATIC_LIB_
+#include <nabla.h>
+#include <random>
+#include <chrono>
+#include "../common/CommonAPI.h"
+
+#include "../39.DenoiserTonemapper/CCPUFFTConvolution.h"
+
+using namespace nbl;
+using namespace core;
+
+
+// Headless check of `CCPUFFTConvolution` against a direct spatial convolution with the same kernel normalization and mirror padding,
+// on small images with odd, even and degenerate extents. Also times one full HD bloom to keep an eye on the CPU cost.
+// Usage: `[-SEED=n] [-TOLERANCE=x]`, `x` is the allowed error relative to the brightest reference texel (default 1e-4).
+class FFTConvolutionTestApp : public NonGraphicalApplicationBase
+{
+	using clock_t = std::chrono::high_resolution_clock;
+
+	core::smart_refctd_ptr<nbl::system::ISystem> system;
+
+public:
+
+	void setSystem(core::smart_refctd_ptr<nbl::system::ISystem>&& system) override
+	{
+		system = std::move(system);
+	}
+
+	NON_GRAPHICAL_APP_CONSTRUCTOR(FFTConvolutionTestApp);
+
+	void onAppInitialized_impl() override
+	{
+		uint32_t seed = 0x45u;
+		float tolerance = 1e-4f;
+		for (const auto& arg : argv)
+		{
+			if (arg.rfind("-SEED=",0)==0)
+				seed = std::stoul(arg.substr(6));
+			else if (arg.rfind("-TOLERANCE=",0)==0)
+				tolerance = std::stof(arg.substr(11));
+		}
+
+		std::mt19937 mt(seed);
+		bool allPassed = testRoundTrip(mt,tolerance);
+
+		struct SCase
+		{
+			uint32_t width,height;
+			uint32_t kernelWidth,kernelHeight;
+			float intensity;
+		};
+		const SCase cases[] = {
+			{17u,9u,3u,3u,1.f},
+			{32u,32u,5u,4u,0.5f},
+			{7u,31u,8u,2u,0.25f},
+			{64u,48u,13u,11u,1.f},
+			// kernels bigger than the image need repeated mirroring
+			{5u,6u,16u,9u,0.75f},
+			{1u,5u,2u,3u,1.f},
+			{100u,3u,2u,2u,0.1f},
+			{1u,1u,1u,1u,1.f}
+		};
+		CCPUFFTConvolution convolution;
+		for (const auto& c : cases)
+		{
+			const auto image = randomRGB(c.width,c.height,mt,8.f);
+			const auto kernel = randomRGB(c.kernelWidth,c.kernelHeight,mt,1.f);
+			if (!convolution.setKernel(kernel.data(),c.kernelWidth,c.kernelHeight,c.intensity))
+			{
+				printf("%3ux%-3u kernel %2ux%-2u | setKernel failed | FAILED\n",c.width,c.height,c.kernelWidth,c.kernelHeight);
+				allPassed = false;
+				continue;
+			}
+			const auto reference = convolveDirect(image,c.width,c.height,kernel,c.kernelWidth,c.kernelHeight,c.intensity);
+
+			// twice, the second run uses the cached kernel spectra
+			float maxError = 0.f;
+			for (auto run=0u; run<2u; run++)
+			{
+				auto result = image;
+				convolution.convolve(result.data(),c.width,c.height);
+				maxError = core::max(maxError,relativeError(result,reference));
+			}
+			const bool passed = maxError<=tolerance;
+			printf(
+				"%3ux%-3u kernel %2ux%-2u intensity %.2f | max relative error %.3e | %s\n",
+				c.width,c.height,c.kernelWidth,c.kernelHeight,c.intensity,maxError,passed ? "PASSED":"FAILED"
+			);
+			allPassed = allPassed && passed;
+		}
+
+		// a PSF with no luminance can't be normalized
+		{
+			const core::vector<float> black(4u*4u*3u,0.f);
+			const bool rejected = !CCPUFFTConvolution().setKernel(black.data(),4u,4u);
+			printf("black kernel rejected | %s\n",rejected ? "PASSED":"FAILED");
+			allPassed = allPassed && rejected;
+		}
+
+		// the cost of a typical bloom, not a pass/fail criterion
+		{
+			constexpr uint32_t Width = 1920u;
+			constexpr uint32_t Height = 1080u;
+			const auto psf = randomRGB(256u,256u,mt,1.f);
+			uint32_t kernelWidth,kernelHeight;
+			CCPUFFTConvolution::computeKernelExtent(kernelWidth,kernelHeight,Width,Height,256u,256u,0.1f);
+			core::vector<float> kernel(size_t(kernelWidth)*kernelHeight*3u);
+			CCPUFFTConvolution::scaleKernel(kernel.data(),kernelWidth,kernelHeight,psf.data(),256u,256u);
+			auto image = randomRGB(Width,Height,mt,8.f);
+
+			CCPUFFTConvolution bloom;
+			bloom.setKernel(kernel.data(),kernelWidth,kernelHeight,0.1f);
+			const auto firstStart = clock_t::now();
+			bloom.convolve(image.data(),Width,Height);
+			const auto cachedStart = clock_t::now();
+			bloom.convolve(image.data(),Width,Height);
+			const auto end = clock_t::now();
+			printf(
+				"%ux%u bloom, kernel %ux%u | first %lld ms, with cached kernel spectra %lld ms\n",Width,Height,kernelWidth,kernelHeight,
+				static_cast<long long>(std::chrono::duration_cast<std::chrono::milliseconds>(cachedStart-firstStart).count()),
+				static_cast<long long>(std::chrono::duration_cast<std::chrono::milliseconds>(end-cachedStart).count())
+			);
+		}
+
+		if (!allPassed)
+			exit(0x45);
+	}
+
+	static bool testRoundTrip(std::mt19937& mt, const float tolerance)
+	{
+		constexpr uint32_t Log2Width = 6u;
+		constexpr uint32_t Log2Height = 3u;
+		constexpr uint32_t Count = 0x1u<<(Log2Width+Log2Height);
+		std::uniform_real_distribution<float> dist(-1.f,1.f);
+		core::vector<CCPUFFTConvolution::complex_t> data(Count);
+		for (auto& value : data)
+			value = {dist(mt),dist(mt)};
+		const auto original = data;
+
+		CCPUFFTConvolution::fft2D(data.data(),Log2Width,Log2Height,false);
+		// DC has to be the sum
+		CCPUFFTConvolution::complex_t sum = {0.f,0.f};
+		for (const auto& value : original)
+			sum += value;
+		float maxError = std::abs(data[0]-sum)/float(Count);
+
+		CCPUFFTConvolution::fft2D(data.data(),Log2Width,Log2Height,true);
+		for (uint32_t i=0u; i<Count; i++)
+			maxError = core::max(maxError,std::abs(data[i]/float(Count)-original[i]));
+		const bool passed = maxError<=tolerance;
+		printf("fft2D round trip | max error %.3e | %s\n",maxError,passed ? "PASSED":"FAILED");
+		return passed;
+	}
+
+	static core::vector<float> randomRGB(const uint32_t width, const uint32_t height, std::mt19937& mt, const float maxValue)
+	{
+		std::uniform_real_distribution<float> dist(0.f,maxValue);
+		core::vector<float> retval(size_t(width)*height*3u);
+		for (auto& value : retval)
+			value = dist(mt);
+		return retval;
+	}
+
+	static uint32_t mirror(int32_t x, const int32_t size)
+	{
+		const int32_t period = size*2;
+		x %= period;
+		if (x<0)
+			x += period;
+		return x<size ? x:(period-1-x);
+	}
+
+	// what the FFT path has to be equivalent to, in double precision
+	static core::vector<float> convolveDirect(const core::vector<float>& image, const uint32_t width, const uint32_t height, const core::vector<float>& kernel, const uint32_t kernelWidth, const uint32_t kernelHeight, const float intensity)
+	{
+		double sum[3] = {0.0,0.0,0.0};
+		for (size_t i=0ull; i<size_t(kernelWidth)*kernelHeight; i++)
+		for (auto c=0u; c<3u; c++)
+			sum[c] += kernel[i*3u+c];
+		const double power = 0.2126729*sum[0]+0.7151522*sum[1]+0.0721750*sum[2];
+
+		const int32_t centerX = kernelWidth>>1u;
+		const int32_t centerY = kernelHeight>>1u;
+		core::vector<float> retval(image.size());
+		for (int32_t y=0; y<int32_t(height); y++)
+		for (int32_t x=0; x<int32_t(width); x++)
+		for (auto c=0u; c<3u; c++)
+		{
+			double value = (1.0-intensity)*image[(size_t(y)*width+x)*3u+c];
+			for (int32_t j=0; j<int32_t(kernelHeight); j++)
+			for (int32_t i=0; i<int32_t(kernelWidth); i++)
+			{
+				const uint32_t srcX = mirror(x-(i-centerX),width);
+				const uint32_t srcY = mirror(y-(j-centerY),height);
+				value += intensity/power*kernel[(size_t(j)*kernelWidth+i)*3u+c]*image[(size_t(srcY)*width+srcX)*3u+c];
+			}
+			retval[(size_t(y)*width+x)*3u+c] = float(value);
+		}
+		return retval;
+	}
+
+	static float relativeError(const core::vector<float>& result, const core::vector<float>& reference)
+	{
+		float maxReference = 0.f, maxError = 0.f;
+		for (size_t i=0ull; i<reference.size(); i++)
+		{
+			maxReference = core::max(maxReference,std::abs(reference[i]));
+			maxError = core::max(maxError,std::abs(result[i]-reference[i]));
+		}
+		return maxError/core::max(maxReference,FLT_MIN);
+	}
+
+	void onAppTerminated_impl() override
+	{
+	}
+
+	void workLoopBody() override
+	{
+	}
+
+	bool keepRunning() override
+	{
+		return false;
+	}
+};
+
+NBL_COMMON_API_MAIN(FFTConvolutionTestApp)
@@ -0,0 +1,250 @@
+#define _NBL_STATIC_LIB_
+#include <nabla.h>
+#include <random>
+#include <chrono>
+#include <thread>
+#include <numeric>
+#include <cfloat>
+#include "../common/CommonAPI.h"
+
+#include "nbl/asset/filters/CSummedAreaTableImageFilter.h"
+#include "../43.SumAndCDFFilters/CParallelSummedAreaTableImageFilter.h"
+
+using namespace nbl;
+using namespace nbl::asset;
+using namespace nbl::core;
+
+
+// Headless timings of summed area tables of square random float images from 1K to 16K, inclusive and exclusive:
+//	- `CParallelSummedAreaTableImageFilter` with double accumulation into a 64bit float image
+//	- `CParallelSummedAreaTableImageFilter` with float accumulation into a 32bit float image
+//	- `CSummedAreaTableImageFilter` into a 32bit float image, only up to `-REFERENCE_MAX_SIZE` as it doesn't scale, it also serves as the
+//	  reference the double accumulating filter gets checked against
+// Usage: `[-MIN_SIZE=n] [-MAX_SIZE=n] [-REFERENCE_MAX_SIZE=n] [-CHANNELS=n] [-REPEATS=n]`, defaults 1024, 16384, 4096, 1 and 3.
+// A 16K single channel run needs about 4GB of RAM for the input and the two outputs.
+class CPUSummedAreaTableBenchmarkApp : public NonGraphicalApplicationBase
+{
+	using clock_t = std::chrono::high_resolution_clock;
+
+	core::smart_refctd_ptr<nbl::system::ISystem> system;
+	core::smart_refctd_ptr<nbl::asset::IAssetManager> assetManager;
+	core::smart_refctd_ptr<nbl::system::ILogger> logger;
+
+	uint32_t repeats = 3u;
+	bool failed = false;
+
+public:
+
+	void setSystem(core::smart_refctd_ptr<nbl::system::ISystem>&& _system) override
+	{
+		system = std::move(_system);
+	}
+
+	NON_GRAPHICAL_APP_CONSTRUCTOR(CPUSummedAreaTableBenchmarkApp);
+
+	void onAppInitialized_impl() override
+	{
+		CommonAPI::InitParams initParams;
+		initParams.apiType = video::EAT_VULKAN;
+		initParams.appName = { "68.CPUSummedAreaTableBenchmark" };
+		// CPU only, no Vulkan device needed
+		auto initOutput = CommonAPI::Init<false>(std::move(initParams));
+
+		system = std::move(initOutput.system);
+		assetManager = std::move(initOutput.assetManager);
+		logger = std::move(initOutput.logger);
+
+		uint32_t minSize = 1024u;
+		uint32_t maxSize = 16384u;
+		uint32_t referenceMaxSize = 4096u;
+		uint32_t channels = 1u;
+		for (const auto& arg : argv)
+		{
+			if (arg.rfind("-MIN_SIZE=",0)==0)
+				minSize = std::max<uint32_t>(std::stoul(arg.substr(10)),1u);
+			else if (arg.rfind("-MAX_SIZE=",0)==0)
+				maxSize = std::stoul(arg.substr(10));
+			else if (arg.rfind("-REFERENCE_MAX_SIZE=",0)==0)
+				referenceMaxSize = std::stoul(arg.substr(20));
+			else if (arg.rfind("-CHANNELS=",0)==0)
+				channels = std::clamp<uint32_t>(std::stoul(arg.substr(10)),1u,4u);
+			else if (arg.rfind("-REPEATS=",0)==0)
+				repeats = std::max<uint32_t>(std::stoul(arg.substr(9)),1u);
+		}
+
+		constexpr E_FORMAT Float32Formats[] = {EF_R32_SFLOAT,EF_R32G32_SFLOAT,EF_R32G32B32_SFLOAT,EF_R32G32B32A32_SFLOAT};
+		constexpr E_FORMAT Float64Formats[] = {EF_R64_SFLOAT,EF_R64G64_SFLOAT,EF_R64G64B64_SFLOAT,EF_R64G64B64A64_SFLOAT};
+		logger->log("%u hardware threads, %u channel(s), best of %u runs",system::ILogger::ELL_INFO,std::thread::hardware_concurrency(),channels,repeats);
+		for (uint32_t size=minSize; size<=maxSize; size<<=1u)
+		{
+			auto input = createRandomImage(size,Float32Formats[channels-1u]);
+			auto output64 = createImage(size,Float64Formats[channels-1u]);
+			auto output32 = createImage(size,Float32Formats[channels-1u]);
+			if (!input || !output64 || !output32)
+			{
+				logger->log("Couldn't allocate the %ux%u images, stopping.",system::ILogger::ELL_ERROR,size,size);
+				failed = true;
+				break;
+			}
+			const bool runReference = size<=referenceMaxSize;
+			runMode<false>(input.get(),output64.get(),output32.get(),runReference);
+			runMode<true>(input.get(),output64.get(),output32.get(),runReference);
+		}
+
+		if (failed)
+			exit(0x45);
+	}
+
+	template<bool Exclusive>
+	void runMode(const ICPUImage* input, ICPUImage* output64, ICPUImage* output32, const bool runReference)
+	{
+		const char* modeName = Exclusive ? "exclusive":"inclusive";
+		const uint32_t size = input->getCreationParameters().extent.width;
+		const double megatexels = double(size)*double(size)/1000000.0;
+		auto report = [&](const char* filterName, const double seconds) -> void
+		{
+			logger->log("%5ux%-5u %s %-28s %9.2f ms %9.1f MTexel/s",system::ILogger::ELL_PERFORMANCE,size,size,modeName,filterName,seconds*1000.0,megatexels/seconds);
+		};
+
+		{
+			using filter_t = CParallelSummedAreaTableImageFilter<Exclusive,float>;
+			typename filter_t::state_type state;
+			state.inImage = input;
+			state.outImage = output32;
+			report("parallel, float accumulation",timeBest([&]() -> bool {return filter_t::execute(core::execution::par_unseq,&state);}));
+		}
+		// last so the double output is left around for the comparison
+		{
+			using filter_t = CParallelSummedAreaTableImageFilter<Exclusive,double>;
+			typename filter_t::state_type state;
+			state.inImage = input;
+			state.outImage = output64;
+			report("parallel, double accumulation",timeBest([&]() -> bool {return filter_t::execute(core::execution::par_unseq,&state);}));
+		}
+
+		if (!runReference)
+			return;
+
+		using reference_filter_t = CSummedAreaTableImageFilter<Exclusive>;
+		reference_filter_t referenceFilter;
+		typename reference_filter_t::state_type state;
+		state.inImage = const_cast<ICPUImage*>(input);
+		state.outImage = output32;
+		state.inOffset = {0,0,0};
+		state.inBaseLayer = 0;
+		state.outOffset = {0,0,0};
+		state.outBaseLayer = 0;
+		state.extent = {size,size,1u};
+		state.layerCount = 1u;
+		state.inMipLevel = 0u;
+		state.outMipLevel = 0u;
+		state.axesToSum = (1u<<1u)|(1u<<0u);
+		state.scratchMemoryByteSize = state.getRequiredScratchByteSize(state.inImage,state.extent);
+		state.scratchMemory = reinterpret_cast<uint8_t*>(_NBL_ALIGNED_MALLOC(state.scratchMemoryByteSize,32));
+		report("CSummedAreaTableImageFilter",timeBest([&]() -> bool {return referenceFilter.execute(core::execution::par_unseq,&state);}));
+		_NBL_ALIGNED_FREE(state.scratchMemory);
+
+		// the reference is only float, so the difference is judged relative to the total sum, which is what the float rounding scales with
+		const uint32_t channels = getFormatChannelCount(output64->getCreationParameters().format);
+		const size_t valueCount = size_t(size)*size*channels;
+		const auto* sums = reinterpret_cast<const double*>(output64->getBuffer()->getPointer());
+		const auto* referenceSums = reinterpret_cast<const float*>(output32->getBuffer()->getPointer());
+		double maxDifference = 0.0, maxSum = 0.0;
+		for (size_t i=0ull; i<valueCount; i++)
+		{
+			maxDifference = std::max(maxDifference,std::abs(sums[i]-double(referenceSums[i])));
+			maxSum = std::max(maxSum,std::abs(sums[i]));
+		}
+		const double relativeDifference = maxDifference/std::max(maxSum,DBL_MIN);
+		constexpr double Tolerance = 1e-5;
+		if (relativeDifference>Tolerance)
+		{
+			logger->log("%ux%u %s: the parallel filter differs from CSummedAreaTableImageFilter by %e of the total sum!",system::ILogger::ELL_ERROR,size,size,modeName,relativeDifference);
+			failed = true;
+		}
+	}
+
+	template<typename F>
+	double timeBest(F&& f)
+	{
+		double best = DBL_MAX;
+		for (uint32_t i=0u; i<repeats; i++)
+		{
+			const auto start = clock_t::now();
+			if (!f())
+			{
+				logger->log("Filter failed to execute!",system::ILogger::ELL_ERROR);
+				failed = true;
+				return 0.0;
+			}
+			best = std::min(best,std::chrono::duration<double>(clock_t::now()-start).count());
+		}
+		return best;
+	}
+
+	static core::smart_refctd_ptr<ICPUImage> createImage(const uint32_t size, const E_FORMAT format)
+	{
+		IImage::SCreationParams imageParams = {};
+		imageParams.flags = static_cast<IImage::E_CREATE_FLAGS>(0u);
+		imageParams.type = IImage::ET_2D;
+		imageParams.format = format;
+		imageParams.extent = {size,size,1u};
+		imageParams.mipLevels = 1u;
+		imageParams.arrayLayers = 1u;
+		imageParams.samples = ICPUImage::ESCF_1_BIT;
+		imageParams.usage = IImage::EUF_SAMPLED_BIT;
+
+		auto regions = core::make_refctd_dynamic_array<core::smart_refctd_dynamic_array<IImage::SBufferCopy>>(1ull);
+		auto& region = regions->front();
+		region.bufferOffset = 0ull;
+		region.bufferRowLength = size;
+		region.bufferImageHeight = 0u;
+		region.imageSubresource.aspectMask = IImage::EAF_COLOR_BIT;
+		region.imageSubresource.mipLevel = 0u;
+		region.imageSubresource.baseArrayLayer = 0u;
+		region.imageSubresource.layerCount = 1u;
+		region.imageOffset = {0u,0u,0u};
+		region.imageExtent = {size,size,1u};
+
+		auto image = ICPUImage::create(std::move(imageParams));
+		if (image)
+			image->setBufferAndRegions(core::make_smart_refctd_ptr<ICPUBuffer>(size_t(getTexelOrBlockBytesize(format))*size*size),std::move(regions));
+		return image;
+	}
+
+	// fixed seed so runs stay comparable, one generator per row so filling a 16K image doesn't take longer than summing it
+	static core::smart_refctd_ptr<ICPUImage> createRandomImage(const uint32_t size, const E_FORMAT format)
+	{
+		auto image = createImage(size,format);
+		if (!image)
+			return nullptr;
+
+		const size_t rowValues = size_t(size)*getFormatChannelCount(format);
+		auto* const values = reinterpret_cast<float*>(image->getBuffer()->getPointer());
+		core::vector<uint32_t> rows(size);
+		std::iota(rows.begin(),rows.end(),0u);
+		std::for_each(core::execution::par_unseq,rows.begin(),rows.end(),[&](const uint32_t y) -> void
+		{
+			std::mt19937 prng(0x45u+y);
+			std::uniform_real_distribution<float> dist(0.f,1.f);
+			for (size_t i=0ull; i<rowValues; i++)
+				values[rowValues*y+i] = dist(prng);
+		});
+		return image;
+	}
+
+	void onAppTerminated_impl() override
+	{
+	}
+
+	void workLoopBody() override
+	{
+	}
+
+	bool keepRunning() override
+	{
+		return false;
+	}
+};
+
+NBL_COMMON_API_MAIN(CPUSummedAreaTableBenchmarkApp)
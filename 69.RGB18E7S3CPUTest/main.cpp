@@ -0,0 +1,352 @@
+#define _NBL_STATIC_LIB_
+#include <nabla.h>
+#include <random>
+#include <chrono>
+#include <cfloat>
+#include <cstring>
+#include <numeric>
+#include "../common/CommonAPI.h"
+
+#include "../55.RGB18E7S3/CRGB18E7S3Converter.h"
+
+using namespace nbl;
+using namespace core;
+
+
+// CPU only validation of `CRGB18E7S3Converter`, no device needed, in four parts:
+//	- every float exponent including denormals, for a few mantissas, with the other channels a range of octaves smaller and all sign combinations
+//	- all 2^23 denormal mantissas
+//	- NaN, infinities, negative zero and the values around the clamp
+//	- random bit patterns, `-RANDOM_COUNT` texels (default 100M) in batches, so every exponent and special value shows up
+// Each encoded texel is checked against the single texel encode bit for bit, each decoded one against `core::rgb18e7s3_to_rgb32f`, and
+// the round trip error against half a mantissa step of the largest channel. Differences from `core::rgb32f_to_rgb18e7s3` only get counted,
+// its rounding isn't a contract. Finishes with the encode and decode throughput of the engine functions, the block path and the threaded one.
+// Usage: `[-RANDOM_COUNT=n] [-SEED=n]`
+class RGB18E7S3CPUTestApp : public NonGraphicalApplicationBase
+{
+	using clock_t = std::chrono::high_resolution_clock;
+	using converter_t = CRGB18E7S3Converter;
+
+	core::smart_refctd_ptr<nbl::system::ISystem> system;
+
+	struct SStats
+	{
+		size_t texels = 0ull;
+		size_t encodeMismatches = 0ull;
+		size_t decodeMismatches = 0ull;
+		size_t engineEncodeDifferences = 0ull;
+		size_t boundViolations = 0ull;
+		double maxRelativeError = 0.0;
+
+		void merge(const SStats& other)
+		{
+			texels += other.texels;
+			encodeMismatches += other.encodeMismatches;
+			decodeMismatches += other.decodeMismatches;
+			engineEncodeDifferences += other.engineEncodeDifferences;
+			boundViolations += other.boundViolations;
+			maxRelativeError = core::max(maxRelativeError,other.maxRelativeError);
+		}
+		bool passed() const
+		{
+			return encodeMismatches==0ull && decodeMismatches==0ull && boundViolations==0ull;
+		}
+	};
+
+	// big enough to keep all threads busy, small enough that 100M texels don't need gigabytes
+	static inline constexpr size_t BatchTexels = 0x1ull<<22ull;
+
+public:
+
+	void setSystem(core::smart_refctd_ptr<nbl::system::ISystem>&& system) override
+	{
+		system = std::move(system);
+	}
+
+	NON_GRAPHICAL_APP_CONSTRUCTOR(RGB18E7S3CPUTestApp);
+
+	void onAppInitialized_impl() override
+	{
+		size_t randomCount = 100000000ull;
+		uint32_t seed = 0x45u;
+		for (const auto& arg : argv)
+		{
+			if (arg.rfind("-RANDOM_COUNT=",0)==0)
+				randomCount = std::stoull(arg.substr(14));
+			else if (arg.rfind("-SEED=",0)==0)
+				seed = std::stoul(arg.substr(6));
+		}
+
+		bool allPassed = true;
+		auto report = [&](const char* name, const SStats& stats) -> void
+		{
+			printf(
+				"%-24s | %11zu texels | max relative error %.3e | encode mismatches %zu, decode mismatches %zu, bound violations %zu | differs from engine encode %zu | %s\n",
+				name,stats.texels,stats.maxRelativeError,stats.encodeMismatches,stats.decodeMismatches,stats.boundViolations,stats.engineEncodeDifferences,
+				stats.passed() ? "PASSED":"FAILED"
+			);
+			allPassed = allPassed && stats.passed();
+		};
+
+		report("exponent sweep",check(exponentSweep()));
+		{
+			core::vector<float> denormals(3ull<<23ull);
+			for (uint32_t mantissa=0u; mantissa<(0x1u<<23u); mantissa++)
+			{
+				float* const texel = denormals.data()+size_t(mantissa)*3ull;
+				texel[0] = fromBits(mantissa);
+				texel[1] = -fromBits(mantissa>>7u);
+				texel[2] = fromBits((0x1u<<23u)-1u-mantissa);
+			}
+			report("denormals",check(denormals));
+		}
+		allPassed = checkSpecialValues() && allPassed;
+		{
+			SStats stats;
+			core::vector<float> batch;
+			for (size_t offset=0ull; offset<randomCount; offset+=BatchTexels)
+			{
+				randomBits(batch,std::min(BatchTexels,randomCount-offset),seed+uint32_t(offset/BatchTexels));
+				stats.merge(check(batch));
+			}
+			report("random bit patterns",stats);
+		}
+
+		benchmark(seed);
+
+		if (!allPassed)
+			exit(0x45);
+	}
+
+	static float fromBits(const uint32_t bits)
+	{
+		float retval;
+		memcpy(&retval,&bits,sizeof(retval));
+		return retval;
+	}
+	static uint32_t toBits(const float value)
+	{
+		uint32_t retval;
+		memcpy(&retval,&value,sizeof(retval));
+		return retval;
+	}
+
+	static core::vector<float> exponentSweep()
+	{
+		constexpr uint32_t Mantissas[] = {0x0u,0x1u,0x400000u,0x7fffe0u,0x7fffffu};
+		constexpr uint32_t Octaves[] = {0u,1u,7u,17u,18u,19u,40u};
+		core::vector<float> retval;
+		for (uint32_t exponent=0u; exponent<0xffu; exponent++)
+		for (const auto mantissa : Mantissas)
+		for (const auto octave : Octaves)
+		for (auto largest=0u; largest<3u; largest++)
+		for (auto signs=0u; signs<8u; signs++)
+		{
+			const float value = fromBits((exponent<<23u)|mantissa);
+			const float other = std::ldexp(value,-int32_t(octave));
+			for (auto c=0u; c<3u; c++)
+			{
+				const float magnitude = c==largest ? value:other;
+				retval.push_back((signs>>c)&0x1u ? -magnitude:magnitude);
+			}
+		}
+		return retval;
+	}
+
+	static void randomBits(core::vector<float>& batch, const size_t texelCount, const uint32_t seed)
+	{
+		constexpr size_t ChunkValues = 0x1ull<<16ull;
+		batch.resize(texelCount*3ull);
+		core::vector<uint32_t> chunks((batch.size()+ChunkValues-1ull)/ChunkValues);
+		std::iota(chunks.begin(),chunks.end(),0u);
+		std::for_each(core::execution::par_unseq,chunks.begin(),chunks.end(),[&](const uint32_t chunk) -> void
+		{
+			std::mt19937 mt(seed*0x9e3779b9u+chunk);
+			const size_t end = std::min(ChunkValues*(chunk+1u),batch.size());
+			for (size_t i=ChunkValues*chunk; i<end; i++)
+				batch[i] = fromBits(mt());
+		});
+	}
+
+	// what the encoder promises to preserve, NaN as 0 and magnitudes clamped
+	static float sanitize(const float value)
+	{
+		if (std::isnan(value))
+			return 0.f;
+		return std::clamp(value,-converter_t::MaxValue,converter_t::MaxValue);
+	}
+
+	static SStats check(const core::vector<float>& rgb)
+	{
+		const size_t texelCount = rgb.size()/3ull;
+		core::vector<uint64_t> encoded(texelCount);
+		core::vector<float> decoded(rgb.size());
+		converter_t::encode(core::execution::par_unseq,encoded.data(),rgb.data(),texelCount);
+		converter_t::decode(core::execution::par_unseq,decoded.data(),encoded.data(),texelCount);
+
+		constexpr size_t ChunkTexels = 0x1ull<<14ull;
+		core::vector<uint32_t> chunks((texelCount+ChunkTexels-1ull)/ChunkTexels);
+		core::vector<SStats> chunkStats(chunks.size());
+		std::iota(chunks.begin(),chunks.end(),0u);
+		std::for_each(core::execution::par_unseq,chunks.begin(),chunks.end(),[&](const uint32_t chunk) -> void
+		{
+			auto& stats = chunkStats[chunk];
+			const size_t end = std::min(ChunkTexels*(chunk+1u),texelCount);
+			for (size_t i=ChunkTexels*chunk; i<end; i++)
+			{
+				const float* const in = rgb.data()+i*3ull;
+				const float* const out = decoded.data()+i*3ull;
+				if (encoded[i]!=converter_t::encode(in))
+					stats.encodeMismatches++;
+				const bool finite = std::isfinite(in[0]) && std::isfinite(in[1]) && std::isfinite(in[2]);
+				if (finite && encoded[i]!=rgb32f_to_rgb18e7s3(in[0],in[1],in[2]))
+					stats.engineEncodeDifferences++;
+				const auto engineDecoded = rgb18e7s3_to_rgb32f(encoded[i]);
+				if (toBits(out[0])!=toBits(engineDecoded.x) || toBits(out[1])!=toBits(engineDecoded.y) || toBits(out[2])!=toBits(engineDecoded.z))
+					stats.decodeMismatches++;
+
+				double maxMagnitude = 0.0, maxError = 0.0;
+				for (auto c=0u; c<3u; c++)
+				{
+					const double expected = sanitize(in[c]);
+					maxMagnitude = core::max(maxMagnitude,std::abs(expected));
+					maxError = core::max(maxError,std::abs(double(out[c])-expected));
+				}
+				// half a mantissa step of the largest channel, a hair more when it rounded up into the next exponent, 2^-82 below the exponent range
+				const double bound = core::max(std::ldexp(maxMagnitude,-18)*(1.0+std::ldexp(1.0,-16)),std::ldexp(1.0,-82));
+				if (maxError>bound)
+					stats.boundViolations++;
+				if (maxMagnitude>=std::ldexp(1.0,-64))
+					stats.maxRelativeError = core::max(stats.maxRelativeError,maxError/maxMagnitude);
+			}
+			stats.texels = end-ChunkTexels*chunk;
+		});
+
+		SStats retval;
+		for (const auto& stats : chunkStats)
+			retval.merge(stats);
+		return retval;
+	}
+
+	static bool checkSpecialValues()
+	{
+		const float inf = std::numeric_limits<float>::infinity();
+		const float nan = std::numeric_limits<float>::quiet_NaN();
+		const float maxValue = converter_t::MaxValue;
+		struct SCase
+		{
+			const char* name;
+			float in[3];
+			float expected[3];
+		};
+		const SCase cases[] = {
+			{"zero",{0.f,0.f,0.f},{0.f,0.f,0.f}},
+			{"negative zero",{-0.f,-0.f,-0.f},{0.f,0.f,0.f}},
+			{"NaN",{nan,1.f,-nan},{0.f,1.f,0.f}},
+			{"infinities",{inf,-inf,1.f},{maxValue,-maxValue,0.f}},
+			{"largest value",{maxValue,-maxValue,maxValue},{maxValue,-maxValue,maxValue}},
+			{"FLT_MAX",{FLT_MAX,-FLT_MAX,0.f},{maxValue,-maxValue,0.f}},
+			{"rounds up an exponent",{1.999999f,0.f,-1.f},{2.f,0.f,-1.f}},
+			{"flushed to zero",{std::ldexp(1.f,-84),std::ldexp(1.f,-90),FLT_TRUE_MIN},{0.f,0.f,0.f}},
+			{"smallest nonzero",{std::ldexp(1.f,-81),0.f,0.f},{std::ldexp(1.f,-81),0.f,0.f}}
+		};
+
+		bool allPassed = true;
+		for (const auto& c : cases)
+		{
+			// both paths, a block is only used for whole groups of 4 or 8
+			float in[8*3], out[8*3];
+			for (auto i=0u; i<8u; i++)
+				memcpy(in+i*3u,c.in,sizeof(c.in));
+			uint64_t encoded[8];
+			converter_t::encode(encoded,in,8u);
+			converter_t::decode(out,encoded,8u);
+
+			bool passed = encoded[0]==converter_t::encode(c.in);
+			for (auto i=0u; i<8u; i++)
+			for (auto c2=0u; c2<3u; c2++)
+				passed = passed && toBits(out[i*3u+c2])==toBits(c.expected[c2]) && encoded[i]==encoded[0];
+			printf(
+				"%-24s | in (%g,%g,%g) out (%g,%g,%g) encoded 0x%016llx | %s\n",c.name,c.in[0],c.in[1],c.in[2],out[0],out[1],out[2],
+				static_cast<unsigned long long>(encoded[0]),passed ? "PASSED":"FAILED"
+			);
+			allPassed = allPassed && passed;
+		}
+		return allPassed;
+	}
+
+	// not a pass/fail criterion
+	void benchmark(const uint32_t seed)
+	{
+		constexpr size_t Texels = 0x1ull<<24ull;
+		core::vector<float> rgb(Texels*3ull);
+		{
+			std::mt19937 mt(seed);
+			std::uniform_real_distribution<float> dist(0.f,1.f);
+			// HDR like, a few orders of magnitude around 1
+			for (auto& value : rgb)
+				value = std::exp2(dist(mt)*24.f-12.f);
+		}
+		core::vector<uint64_t> encoded(Texels);
+		core::vector<float> decoded(rgb.size());
+
+		auto time = [](auto&& f) -> double
+		{
+			double best = DBL_MAX;
+			for (auto i=0u; i<3u; i++)
+			{
+				const auto start = clock_t::now();
+				f();
+				best = core::min(best,std::chrono::duration<double>(clock_t::now()-start).count());
+			}
+			return double(Texels)/best*1e-9;
+		};
+		const double engineEncode = time([&]() -> void
+		{
+			for (size_t i=0ull; i<Texels; i++)
+				encoded[i] = rgb32f_to_rgb18e7s3(rgb[i*3ull],rgb[i*3ull+1ull],rgb[i*3ull+2ull]);
+		});
+		const double engineDecode = time([&]() -> void
+		{
+			for (size_t i=0ull; i<Texels; i++)
+			{
+				const auto value = rgb18e7s3_to_rgb32f(encoded[i]);
+				decoded[i*3ull] = value.x;
+				decoded[i*3ull+1ull] = value.y;
+				decoded[i*3ull+2ull] = value.z;
+			}
+		});
+		const double bulkEncode = time([&]() -> void {converter_t::encode(encoded.data(),rgb.data(),Texels);});
+		const double bulkDecode = time([&]() -> void {converter_t::decode(decoded.data(),encoded.data(),Texels);});
+		const double parallelEncode = time([&]() -> void {converter_t::encode(core::execution::par_unseq,encoded.data(),rgb.data(),Texels);});
+		const double parallelDecode = time([&]() -> void {converter_t::decode(core::execution::par_unseq,decoded.data(),encoded.data(),Texels);});
+
+		const char* isa =
+		#if defined(_RGB18E7S3_CONVERTER_AVX2_)
+			"AVX2";
+		#elif defined(_RGB18E7S3_CONVERTER_SSE_)
+			"SSE2";
+		#else
+			"scalar";
+		#endif
+		printf("%zu texels, Gtexel/s           |    encode |    decode\n",Texels);
+		printf("engine scalar functions        | %9.3f | %9.3f\n",engineEncode,engineDecode);
+		printf("CRGB18E7S3Converter %-10s | %9.3f | %9.3f\n",isa,bulkEncode,bulkDecode);
+		printf("CRGB18E7S3Converter threaded   | %9.3f | %9.3f\n",parallelEncode,parallelDecode);
+	}
+
+	void onAppTerminated_impl() override
+	{
+	}
+
+	void workLoopBody() override
+	{
+	}
+
+	bool keepRunning() override
+	{
+		return false;
+	}
+};
+
+NBL_COMMON_API_MAIN(RGB18E7S3CPUTestApp)
@@ -0,0 +1,233 @@
+#define _NBL_STATIC_LIB_
+#include <nabla.h>
+#include <random>
+#include <chrono>
+#include <cfloat>
+#include "../common/CommonAPI.h"
+
+#include "../48.ArithmeticUnitTest/emulatedArithmetic.h"
+
+using namespace nbl;
+using namespace core;
+
+
+// Headless check and benchmark of `CPUScan` and the subgroup/workgroup emulation from 48.ArithmeticUnitTest.
+//	- every operation on 32bit unsigned and signed integers, the subgroup and workgroup emulations at subgroup sizes 4 to 128 against plain
+//	  loops, and the parallel scans against `std::inclusive_scan` and `std::exclusive_scan`, all bit exact
+//	- throughput of the add scans on `-COUNT` elements, `std` algorithms sequential and with `par_unseq` against `CPUScan`
+// Usage: `[-COUNT=n] [-SEED=n] [-REPEATS=n]`, defaults 64M, 0x45 and 5.
+class CPUScanBenchmarkApp : public NonGraphicalApplicationBase
+{
+	using clock_t = std::chrono::high_resolution_clock;
+
+	core::smart_refctd_ptr<nbl::system::ISystem> system;
+
+	uint32_t repeats = 5u;
+
+public:
+
+	void setSystem(core::smart_refctd_ptr<nbl::system::ISystem>&& system) override
+	{
+		system = std::move(system);
+	}
+
+	NON_GRAPHICAL_APP_CONSTRUCTOR(CPUScanBenchmarkApp);
+
+	void onAppInitialized_impl() override
+	{
+		size_t count = 64ull<<20ull;
+		uint32_t seed = 0x45u;
+		for (const auto& arg : argv)
+		{
+			if (arg.rfind("-COUNT=",0)==0)
+				count = std::max<size_t>(std::stoull(arg.substr(7)),1ull);
+			else if (arg.rfind("-SEED=",0)==0)
+				seed = std::stoul(arg.substr(6));
+			else if (arg.rfind("-REPEATS=",0)==0)
+				repeats = std::max<uint32_t>(std::stoul(arg.substr(9)),1u);
+		}
+
+		std::mt19937 mt(seed);
+		bool allPassed = true;
+		allPassed = testOperation<and_op<uint32_t>>(mt) && allPassed;
+		allPassed = testOperation<xor_op<uint32_t>>(mt) && allPassed;
+		allPassed = testOperation<or_op<uint32_t>>(mt) && allPassed;
+		allPassed = testOperation<add_op<uint32_t>>(mt) && allPassed;
+		allPassed = testOperation<mul_op<uint32_t>>(mt) && allPassed;
+		allPassed = testOperation<min_op<uint32_t>>(mt) && allPassed;
+		allPassed = testOperation<max_op<uint32_t>>(mt) && allPassed;
+		allPassed = testOperation<add_op<int32_t>>(mt) && allPassed;
+		allPassed = testOperation<min_op<int32_t>>(mt) && allPassed;
+		allPassed = testOperation<max_op<int32_t>>(mt) && allPassed;
+
+		benchmark(mt,count);
+
+		if (!allPassed)
+			exit(0x45);
+	}
+
+	template<class OP>
+	static core::vector<typename OP::type_t> randomData(std::mt19937& mt, const size_t count)
+	{
+		using type_t = typename OP::type_t;
+		core::vector<type_t> retval(count);
+		for (auto& value : retval)
+		{
+			value = static_cast<type_t>(mt());
+			// full range products would all be 0 after a few dozen elements
+			if constexpr (std::is_same_v<OP,mul_op<type_t>>)
+				value |= 0x1u;
+		}
+		return retval;
+	}
+
+	// the way the GPU test used to compute its references
+	template<class OP>
+	static void referenceScan(typename OP::type_t* out, const typename OP::type_t* in, const uint32_t count, const bool exclusive)
+	{
+		auto carry = OP::IdentityElement;
+		for (auto i=0u; i<count; i++)
+		{
+			const auto next = OP()(carry,in[i]);
+			out[i] = exclusive ? carry:next;
+			carry = next;
+		}
+	}
+
+	template<class OP>
+	static bool testOperation(std::mt19937& mt)
+	{
+		using type_t = typename OP::type_t;
+		constexpr uint32_t SubgroupSizes[] = {4u,8u,16u,32u,64u,128u};
+		constexpr uint32_t WorkgroupSizes[] = {1u,3u,45u,64u,257u,1024u};
+
+		size_t failures = 0ull;
+		const auto input = randomData<OP>(mt,1024u);
+		core::vector<type_t> result(input.size()), expected(input.size());
+		auto compare = [&](const uint32_t count) -> void
+		{
+			if (!std::equal(result.begin(),result.begin()+count,expected.begin()))
+				failures++;
+		};
+		for (const auto workgroupSize : WorkgroupSizes)
+		{
+			for (const auto subgroupSize : SubgroupSizes)
+			{
+				for (auto first=0u; first<workgroupSize; first+=subgroupSize)
+				{
+					const uint32_t size = core::min(subgroupSize,workgroupSize-first);
+					std::fill_n(expected.begin()+first,size,std::accumulate(input.begin()+first+1u,input.begin()+first+size,input[first],OP()));
+				}
+				emulatedSubgroupReduction<OP>()(result.data(),input.data(),workgroupSize,subgroupSize);
+				compare(workgroupSize);
+
+				for (const bool exclusive : {false,true})
+				{
+					for (auto first=0u; first<workgroupSize; first+=subgroupSize)
+						referenceScan<OP>(expected.data()+first,input.data()+first,core::min(subgroupSize,workgroupSize-first),exclusive);
+					if (exclusive)
+						emulatedSubgroupScanExclusive<OP>()(result.data(),input.data(),workgroupSize,subgroupSize);
+					else
+						emulatedSubgroupScanInclusive<OP>()(result.data(),input.data(),workgroupSize,subgroupSize);
+					compare(workgroupSize);
+				}
+			}
+
+			std::fill_n(expected.begin(),workgroupSize,std::accumulate(input.begin()+1u,input.begin()+workgroupSize,input[0],OP()));
+			emulatedWorkgroupReduction<OP>()(result.data(),input.data(),workgroupSize,32u);
+			compare(workgroupSize);
+			for (const bool exclusive : {false,true})
+			{
+				referenceScan<OP>(expected.data(),input.data(),workgroupSize,exclusive);
+				if (exclusive)
+					emulatedWorkgroupScanExclusive<OP>()(result.data(),input.data(),workgroupSize,32u);
+				else
+					emulatedWorkgroupScanInclusive<OP>()(result.data(),input.data(),workgroupSize,32u);
+				compare(workgroupSize);
+			}
+		}
+
+		// several blocks and a partial one, in-place for the exclusive scan
+		{
+			const auto large = randomData<OP>(mt,(0x1ull<<20ull)+13ull);
+			core::vector<type_t> largeResult(large.size()), largeExpected(large.size());
+			std::inclusive_scan(large.begin(),large.end(),largeExpected.begin(),OP());
+			CPUScan<OP>::inclusiveScan(core::execution::par_unseq,largeResult.data(),large.data(),large.size());
+			if (largeResult!=largeExpected)
+				failures++;
+			std::exclusive_scan(large.begin(),large.end(),largeExpected.begin(),OP::IdentityElement,OP());
+			largeResult = large;
+			CPUScan<OP>::exclusiveScan(core::execution::par_unseq,largeResult.data(),largeResult.data(),largeResult.size());
+			if (largeResult!=largeExpected)
+				failures++;
+		}
+
+		printf(
+			"%-3s %-8s | %s | %zu mismatching case(s) | %s\n",OP::name,std::is_signed_v<type_t> ? "int32":"uint32",
+			CPUScan<OP>::Vectorized ? "SIMD  ":"scalar",failures,failures ? "FAILED":"PASSED"
+		);
+		return failures==0ull;
+	}
+
+	// not a pass/fail criterion, apart from all the scans having to agree
+	void benchmark(std::mt19937& mt, const size_t count)
+	{
+		using op_t = add_op<uint32_t>;
+		const auto input = randomData<op_t>(mt,count);
+		core::vector<uint32_t> inclusive(count), exclusive(count), result(count);
+		std::inclusive_scan(input.begin(),input.end(),inclusive.begin());
+		std::exclusive_scan(input.begin(),input.end(),exclusive.begin(),0u);
+
+		printf("%zu elements, add, best of %u runs\n",count,repeats);
+		auto run = [&](const char* name, const core::vector<uint32_t>& expected, auto&& f) -> void
+		{
+			double best = DBL_MAX;
+			for (auto i=0u; i<repeats; i++)
+			{
+				const auto start = clock_t::now();
+				f();
+				best = core::min(best,std::chrono::duration<double>(clock_t::now()-start).count());
+			}
+			printf("%-40s | %9.2f ms | %6.3f Gelement/s%s\n",name,best*1000.0,double(count)/best*1e-9,result==expected ? "":" | WRONG RESULT");
+		};
+		run("std::inclusive_scan",inclusive,[&]() -> void {std::inclusive_scan(input.begin(),input.end(),result.begin());});
+		run("std::inclusive_scan par_unseq",inclusive,[&]() -> void {std::inclusive_scan(core::execution::par_unseq,input.begin(),input.end(),result.begin());});
+		run("CPUScan::inclusiveScan",inclusive,[&]() -> void {CPUScan<op_t>::inclusiveScan(result.data(),input.data(),count);});
+		run("CPUScan::inclusiveScan par_unseq",inclusive,[&]() -> void {CPUScan<op_t>::inclusiveScan(core::execution::par_unseq,result.data(),input.data(),count);});
+		run("std::exclusive_scan",exclusive,[&]() -> void {std::exclusive_scan(input.begin(),input.end(),result.begin(),0u);});
+		run("std::exclusive_scan par_unseq",exclusive,[&]() -> void {std::exclusive_scan(core::execution::par_unseq,input.begin(),input.end(),result.begin(),0u);});
+		run("CPUScan::exclusiveScan",exclusive,[&]() -> void {CPUScan<op_t>::exclusiveScan(result.data(),input.data(),count);});
+		run("CPUScan::exclusiveScan par_unseq",exclusive,[&]() -> void {CPUScan<op_t>::exclusiveScan(core::execution::par_unseq,result.data(),input.data(),count);});
+
+		// what validating a whole dispatch of the GPU test costs, 1024 invocation workgroups of 32 wide subgroups
+		const uint32_t workgroupCount = uint32_t(count/1024ull);
+		if (workgroupCount)
+		{
+			for (auto i=0u; i<workgroupCount; i++)
+			for (auto first=0u; first<1024u; first+=32u)
+				referenceScan<op_t>(inclusive.data()+i*1024u+first,input.data()+i*1024u+first,32u,false);
+			std::copy(input.begin()+workgroupCount*1024ull,input.end(),inclusive.begin()+workgroupCount*1024ull);
+			std::copy(input.begin()+workgroupCount*1024ull,input.end(),result.begin()+workgroupCount*1024ull);
+			run("emulatedSubgroupScanInclusive, 32 wide",inclusive,[&]() -> void
+			{
+				for (auto i=0u; i<workgroupCount; i++)
+					emulatedSubgroupScanInclusive<op_t>()(result.data()+i*1024u,input.data()+i*1024u,1024u,32u);
+			});
+		}
+	}
+
+	void onAppTerminated_impl() override
+	{
+	}
+
+	void workLoopBody() override
+	{
+	}
+
+	bool keepRunning() override
+	{
+		return false;
+	}
+};
+
+NBL_COMMON_API_MAIN(CPUScanBenchmarkApp)
@@ -0,0 +1,235 @@
+#define _NBL_STATIC_LIB_
+#include <nabla.h>
+#include <random>
+#include <chrono>
+#include "../common/CommonAPI.h"
+
+#include "../62.CAD/DrawBuffersFiller.h"
+
+using namespace nbl;
+using namespace core;
+
+
+// Headless check that the parallel polyline path of 62.CAD's `DrawBuffersFiller` writes exactly the same index, DrawObject and geometry
+// buffers as the serial one, for random mixes of lines, elliptical arcs and beziers drawn one after another into the same buffers,
+// with sections both smaller and larger than a parallel chunk. Also checks that a polyline which doesn't fit is left to the serial path
+// and times both paths on one big polyline.
+// Usage: `[-SEED=n] [-SEGMENTS=n]`, `n` segments in the timed polyline (default 2M).
+class CADPolylineFillTestApp : public NonGraphicalApplicationBase
+{
+	using clock_t = std::chrono::high_resolution_clock;
+
+	core::smart_refctd_ptr<nbl::system::ISystem> system;
+
+	// CPU buffers only, so none of the paths that would submit can be taken
+	class CTestFiller : public DrawBuffersFiller
+	{
+	public:
+		CTestFiller(const uint32_t indices, const uint32_t drawObjects, const size_t geometrySize, const uint32_t lineStyles)
+		{
+			maxIndices = indices;
+			maxDrawObjects = drawObjects;
+			maxGeometryBufferSize = geometrySize;
+			maxLineStyles = lineStyles;
+			cpuDrawBuffers.indexBuffer = core::make_smart_refctd_ptr<asset::ICPUBuffer>(sizeof(index_buffer_type) * indices);
+			cpuDrawBuffers.drawObjectsBuffer = core::make_smart_refctd_ptr<asset::ICPUBuffer>(sizeof(DrawObject) * drawObjects);
+			cpuDrawBuffers.geometryBuffer = core::make_smart_refctd_ptr<asset::ICPUBuffer>(geometrySize);
+			cpuDrawBuffers.lineStylesBuffer = core::make_smart_refctd_ptr<asset::ICPUBuffer>(sizeof(LineStyle) * lineStyles);
+			// something recognizable instead of a device address
+			geometryBufferAddress = 0x45000000ull;
+		}
+
+		void addSerial(const CPolyline& polyline, const LineStyle& lineStyle)
+		{
+			addPolyline_SubmitIfNeeded(polyline, addLineStyle_Internal(lineStyle), nullptr, nullptr, {});
+		}
+		bool addParallel(const CPolyline& polyline, const LineStyle& lineStyle)
+		{
+			return addPolylineInParallel_Internal(polyline, addLineStyle_Internal(lineStyle));
+		}
+
+		bool matches(const CTestFiller& other) const
+		{
+			if (getIndexCount() != other.getIndexCount() || getCurrentDrawObjectsBufferSize() != other.getCurrentDrawObjectsBufferSize())
+				return false;
+			if (getCurrentGeometryBufferSize() != other.getCurrentGeometryBufferSize() || getCurrentLineStylesBufferSize() != other.getCurrentLineStylesBufferSize())
+				return false;
+			auto same = [](const asset::ICPUBuffer* a, const asset::ICPUBuffer* b, const size_t size) -> bool
+			{
+				return memcmp(a->getPointer(), b->getPointer(), size) == 0;
+			};
+			return same(cpuDrawBuffers.indexBuffer.get(), other.cpuDrawBuffers.indexBuffer.get(), getCurrentIndexBufferSize()) &&
+				same(cpuDrawBuffers.drawObjectsBuffer.get(), other.cpuDrawBuffers.drawObjectsBuffer.get(), getCurrentDrawObjectsBufferSize()) &&
+				same(cpuDrawBuffers.geometryBuffer.get(), other.cpuDrawBuffers.geometryBuffer.get(), getCurrentGeometryBufferSize()) &&
+				same(cpuDrawBuffers.lineStylesBuffer.get(), other.cpuDrawBuffers.lineStylesBuffer.get(), getCurrentLineStylesBufferSize());
+		}
+	};
+
+public:
+
+	void setSystem(core::smart_refctd_ptr<nbl::system::ISystem>&& system) override
+	{
+		system = std::move(system);
+	}
+
+	NON_GRAPHICAL_APP_CONSTRUCTOR(CADPolylineFillTestApp);
+
+	void onAppInitialized_impl() override
+	{
+		uint32_t seed = 0x45u;
+		uint32_t segments = 2000000u;
+		for (const auto& arg : argv)
+		{
+			if (arg.rfind("-SEED=",0)==0)
+				seed = std::stoul(arg.substr(6));
+			else if (arg.rfind("-SEGMENTS=",0)==0)
+				segments = std::max<uint32_t>(std::stoul(arg.substr(10)),1u);
+		}
+
+		std::mt19937 mt(seed);
+		bool allPassed = true;
+
+		// polylines drawn one after another, so later ones start at nonzero offsets
+		{
+			const uint32_t MaxSectionSizes[] = {1u, 7u, 300u, 5000u, 10000u};
+			CTestFiller serial(1u << 24u, 1u << 22u, 256ull << 20ull, 16u);
+			CTestFiller parallel(1u << 24u, 1u << 22u, 256ull << 20ull, 16u);
+			for (auto i = 0u; i < 20u; i++)
+			{
+				const auto polyline = randomPolyline(mt, 1u + mt() % 12u, MaxSectionSizes[i % 5u]);
+				const auto lineStyle = randomLineStyle(mt);
+				serial.addSerial(polyline, lineStyle);
+				const bool added = parallel.addParallel(polyline, lineStyle);
+				const bool passed = added && serial.matches(parallel);
+				printf(
+					"polyline %2u | %3zu sections | %8u indices, %9zu geometry bytes in total | %s\n", i, polyline.getSectionsCount(),
+					parallel.getIndexCount(), size_t(parallel.getCurrentGeometryBufferSize()), passed ? "PASSED" : "FAILED"
+				);
+				allPassed = allPassed && passed;
+			}
+		}
+
+		// too big for what's left, nothing may be written
+		{
+			CTestFiller filler(6000u, 1000u, 64000u, 4u);
+			const auto polyline = randomPolyline(mt, 4u, 300u);
+			const bool rejected = !filler.addParallel(polyline, randomLineStyle(mt));
+			const bool untouched = filler.getIndexCount() == 0u && filler.getCurrentDrawObjectsBufferSize() == 0u && filler.getCurrentGeometryBufferSize() == 0u;
+			printf("overflowing polyline left to the serial path | %s\n", rejected && untouched ? "PASSED" : "FAILED");
+			allPassed = allPassed && rejected && untouched;
+		}
+
+		// the cost, not a pass/fail criterion apart from the results having to match
+		{
+			CPolyline polyline;
+			std::uniform_real_distribution<double> dist(-100.0, 100.0);
+			std::vector<double2> points(segments + 1u);
+			for (auto& point : points)
+				point = double2(dist(mt), dist(mt));
+			polyline.addLinePoints(std::move(points));
+
+			const auto lineStyle = randomLineStyle(mt);
+			const uint32_t maxObjects = segments + 1u;
+			CTestFiller serial(maxObjects * 12u, maxObjects, sizeof(double2) * (maxObjects + 1ull), 1u);
+			CTestFiller parallel(maxObjects * 12u, maxObjects, sizeof(double2) * (maxObjects + 1ull), 1u);
+			const auto serialStart = clock_t::now();
+			serial.addSerial(polyline, lineStyle);
+			const auto parallelStart = clock_t::now();
+			const bool added = parallel.addParallel(polyline, lineStyle);
+			const auto end = clock_t::now();
+			const bool passed = added && serial.matches(parallel);
+			printf(
+				"%u segments | serial %.2f ms, parallel %.2f ms | %s\n", segments,
+				std::chrono::duration<double, std::milli>(parallelStart - serialStart).count(),
+				std::chrono::duration<double, std::milli>(end - parallelStart).count(), passed ? "PASSED" : "FAILED"
+			);
+			allPassed = allPassed && passed;
+		}
+
+		if (!allPassed)
+			exit(0x45);
+	}
+
+	static LineStyle randomLineStyle(std::mt19937& mt)
+	{
+		std::uniform_real_distribution<float> dist(0.f, 1.f);
+		LineStyle retval = {};
+		// `float4::operator==` only compares the first component, so a few styles get reused
+		retval.color = float4(float(mt() % 4u) * 0.25f, dist(mt), dist(mt), 0.5f);
+		retval.screenSpaceLineWidth = float(mt() % 2u) + 1.f;
+		retval.worldSpaceLineWidth = 0.f;
+		return retval;
+	}
+
+	static CPolyline randomPolyline(std::mt19937& mt, const uint32_t additions, const uint32_t maxSectionSize)
+	{
+		std::uniform_real_distribution<double> dist(-100.0, 100.0);
+		std::uniform_real_distribution<double> unit(0.0, 1.0);
+		auto randomPoint = [&]() -> double2 { return double2(dist(mt), dist(mt)); };
+
+		CPolyline retval;
+		for (auto i = 0u; i < additions; i++)
+		{
+			const uint32_t count = 1u + mt() % maxSectionSize;
+			switch (mt() % 4u)
+			{
+			case 0u:
+			{
+				std::vector<double2> points(count + 1u);
+				for (auto& point : points)
+					point = randomPoint();
+				retval.addLinePoints(std::move(points));
+				break;
+			}
+			case 1u:
+			{
+				std::vector<CPolyline::EllipticalArcInfo> ellipses(count);
+				for (auto& ellipse : ellipses)
+				{
+					ellipse.majorAxis = randomPoint();
+					ellipse.center = randomPoint();
+					ellipse.angleBounds.X = unit(mt) * core::PI<double>();
+					ellipse.angleBounds.Y = ellipse.angleBounds.X + unit(mt) * core::PI<double>();
+					ellipse.eccentricity = unit(mt);
+				}
+				retval.addEllipticalArcs(std::move(ellipses));
+				break;
+			}
+			case 2u:
+			{
+				std::vector<QuadraticBezierInfo> beziers(count);
+				for (auto& bezier : beziers)
+				for (auto& p : bezier.p)
+					p = randomPoint();
+				retval.addQuadBeziers(std::move(beziers));
+				break;
+			}
+			default:
+			{
+				std::vector<CubicBezierInfo> beziers(count);
+				for (auto& bezier : beziers)
+				for (auto& p : bezier.p)
+					p = randomPoint();
+				retval.addCubicBeziers(std::move(beziers));
+				break;
+			}
+			}
+		}
+		return retval;
+	}
+
+	void onAppTerminated_impl() override
+	{
+	}
+
+	void workLoopBody() override
+	{
+	}
+
+	bool keepRunning() override
+	{
+		return false;
+	}
+};
+
+NBL_COMMON_API_MAIN(CADPolylineFillTestApp)
@@ -0,0 +1,328 @@
+#define _NBL_STATIC_LIB_
+#include <nabla.h>
+#include <chrono>
+#include <cfloat>
+#include "../common/CommonAPI.h"
+#include "nbl/ext/MitsubaLoader/CMitsubaLoader.h"
+
+#include "../63.OBB/CBoundingVolumeBatch.h"
+
+using namespace nbl;
+using namespace core;
+using namespace asset;
+
+
+// Headless check and benchmark of `CBoundingVolumeBatch` on sponza and the Mitsuba bathroom, every meshbuffer whole and split into meshlets.
+//	- AABBs have to be bit exact with a serial `ICPUMeshBuffer::getAttribute` loop over the same indices, and with what the serial
+//	  `IMeshManipulator::calculateBoundingBox` calls return
+//	- OBBs have to contain every vertex and can't have more surface area than the AABB
+//	- the time the serial `IMeshManipulator` calls take is printed next to the batched computation for the same work
+// Usage: `[-MESHLET=n] [-REPEATS=n]`, `n` indices per meshlet (default 372, 124 triangles) and best of `n` runs (default 5).
+class BoundingVolumeBenchmarkApp : public NonGraphicalApplicationBase
+{
+	using clock_t = std::chrono::high_resolution_clock;
+
+	core::smart_refctd_ptr<nbl::system::ISystem> system;
+	core::smart_refctd_ptr<nbl::asset::IAssetManager> assetManager;
+	core::smart_refctd_ptr<nbl::system::ILogger> logger;
+
+	uint32_t repeats = 5u;
+
+public:
+
+	void setSystem(core::smart_refctd_ptr<nbl::system::ISystem>&& _system) override
+	{
+		system = std::move(_system);
+	}
+
+	NON_GRAPHICAL_APP_CONSTRUCTOR(BoundingVolumeBenchmarkApp);
+
+	void onAppInitialized_impl() override
+	{
+		CommonAPI::InitParams initParams;
+		initParams.apiType = video::EAT_VULKAN;
+		initParams.appName = { "72.BoundingVolumeBenchmark" };
+		// CPU only, no Vulkan device needed
+		auto initOutput = CommonAPI::Init<false>(std::move(initParams));
+
+		system = std::move(initOutput.system);
+		assetManager = std::move(initOutput.assetManager);
+		logger = std::move(initOutput.logger);
+
+		uint32_t meshletIndices = 372u;
+		for (const auto& arg : argv)
+		{
+			if (arg.rfind("-MESHLET=",0)==0)
+				meshletIndices = std::max<uint32_t>(std::stoul(arg.substr(9))/3u*3u,3u);
+			else if (arg.rfind("-REPEATS=",0)==0)
+				repeats = std::max<uint32_t>(std::stoul(arg.substr(9)),1u);
+		}
+
+		{
+			auto serializedLoader = core::make_smart_refctd_ptr<nbl::ext::MitsubaLoader::CSerializedLoader>(assetManager.get());
+			auto mitsubaLoader = core::make_smart_refctd_ptr<nbl::ext::MitsubaLoader::CMitsubaLoader>(assetManager.get(),system.get());
+			serializedLoader->initialize();
+			mitsubaLoader->initialize();
+			assetManager->addAssetLoader(std::move(serializedLoader));
+			assetManager->addAssetLoader(std::move(mitsubaLoader));
+		}
+
+		bool allPassed = true;
+		auto runIfLoaded = [&](const char* name, const core::vector<core::smart_refctd_ptr<ICPUMeshBuffer>>& meshBuffers) -> void
+		{
+			if (meshBuffers.empty())
+				logger->log("Couldn't load %s, skipping it.",system::ILogger::ELL_WARNING,name);
+			else
+				allPassed = runScene(name,meshBuffers,meshletIndices) && allPassed;
+		};
+		runIfLoaded("sponza",loadSponza());
+		runIfLoaded("bathroom",loadMitsubaScene(sharedInputCWD/"mitsuba/bathroom.zip"));
+
+		if (!allPassed)
+			exit(0x45);
+	}
+
+	// the way 63.OBB loads it
+	core::vector<core::smart_refctd_ptr<ICPUMeshBuffer>> loadSponza()
+	{
+		auto archive = system->openFileArchive(sharedInputCWD/"sponza.zip");
+		if (!archive)
+			return {};
+		system->mount(std::move(archive));
+		IAssetLoader::SAssetLoadParams loadParams;
+		loadParams.workingDirectory = sharedInputCWD;
+		loadParams.logger = logger.get();
+		return getMeshBuffers(assetManager->getAsset((sharedInputCWD/"sponza.zip/sponza.obj").string(),loadParams));
+	}
+
+	// the way 18.MitsubaLoader loads it, the first XML in the archive
+	core::vector<core::smart_refctd_ptr<ICPUMeshBuffer>> loadMitsubaScene(const system::path& archivePath)
+	{
+		auto archive = system->openFileArchive(archivePath);
+		if (!archive)
+			return {};
+		auto files = archive->getArchivedFiles();
+		system->mount(std::move(archive),"resources");
+		const auto xml = std::find_if(files.begin(),files.end(),[](const auto& file) -> bool {return core::hasFileExtension(file.fullName,"xml","XML");});
+		if (xml==files.end())
+			return {};
+		IAssetLoader::SAssetLoadParams loadParams;
+		loadParams.workingDirectory = "resources"/xml->fullName.parent_path();
+		loadParams.logger = logger.get();
+		return getMeshBuffers(assetManager->getAsset(xml->name.string(),loadParams));
+	}
+
+	static core::vector<core::smart_refctd_ptr<ICPUMeshBuffer>> getMeshBuffers(const SAssetBundle& bundle)
+	{
+		core::vector<core::smart_refctd_ptr<ICPUMeshBuffer>> retval;
+		for (const auto& asset : bundle.getContents())
+		{
+			if (asset->getAssetType()!=IAsset::ET_MESH)
+				continue;
+			for (const auto& meshBuffer : static_cast<ICPUMesh*>(asset.get())->getMeshBuffers())
+				retval.push_back(core::smart_refctd_ptr<ICPUMeshBuffer>(meshBuffer));
+		}
+		return retval;
+	}
+
+	bool runScene(const char* name, const core::vector<core::smart_refctd_ptr<ICPUMeshBuffer>>& meshBuffers, const uint32_t meshletIndices)
+	{
+		core::vector<CBoundingVolumeBatch::SJob> wholeJobs, meshletJobs;
+		size_t indexCount = 0ull;
+		for (const auto& meshBuffer : meshBuffers)
+		{
+			wholeJobs.push_back(CBoundingVolumeBatch::makeJob(meshBuffer.get()));
+			const uint32_t count = meshBuffer->getIndexCount();
+			for (uint32_t first=0u; first<count; first+=meshletIndices)
+				meshletJobs.push_back(CBoundingVolumeBatch::makeJob(meshBuffer.get(),first,core::min(count-first,meshletIndices)));
+			indexCount += count;
+		}
+		printf("%s | %zu meshbuffers, %zu meshlets, %zu indices, best of %u runs\n",name,wholeJobs.size(),meshletJobs.size(),indexCount,repeats);
+
+		CBoundingVolumeBatch batch;
+		bool passed = true;
+		auto run = [&](const char* what, auto&& f) -> void
+		{
+			double best = DBL_MAX;
+			for (auto i=0u; i<repeats; i++)
+			{
+				const auto start = clock_t::now();
+				f();
+				best = core::min(best,std::chrono::duration<double>(clock_t::now()-start).count());
+			}
+			printf("\t%-52s | %9.3f ms\n",what,best*1000.0);
+		};
+
+		// kept apart so the batch can't overwrite what it gets compared against
+		core::vector<aabbox3df> serialAABBs(wholeJobs.size());
+		core::vector<aabbox3df> aabbs(wholeJobs.size());
+		core::vector<matrix3x4SIMD> obbs(wholeJobs.size());
+		run("IMeshManipulator::calculateBoundingBox, serial",[&]() -> void
+		{
+			for (size_t i=0ull; i<meshBuffers.size(); i++)
+				serialAABBs[i] = IMeshManipulator::calculateBoundingBox(meshBuffers[i].get());
+		});
+		run("IMeshManipulator::calculateOBB, serial",[&]() -> void
+		{
+			for (size_t i=0ull; i<meshBuffers.size(); i++)
+				obbs[i] = IMeshManipulator::calculateOBB(meshBuffers[i].get());
+		});
+		run("CBoundingVolumeBatch AABBs",[&]() -> void {batch.compute(wholeJobs.data(),wholeJobs.data()+wholeJobs.size(),aabbs.data());});
+		run("CBoundingVolumeBatch AABBs and OBBs",[&]() -> void {batch.compute(wholeJobs.data(),wholeJobs.data()+wholeJobs.size(),aabbs.data(),obbs.data());});
+		passed = check("whole meshbuffers",wholeJobs,serialAABBs,aabbs,obbs) && passed;
+
+		serialAABBs.resize(meshletJobs.size());
+		aabbs.resize(meshletJobs.size());
+		obbs.resize(meshletJobs.size());
+		// what 11.LoDSystem used to do for every batch
+		run("calculateBoundingBox per meshlet, serial",[&]() -> void
+		{
+			size_t meshlet = 0ull;
+			for (const auto& meshBuffer : meshBuffers)
+			{
+				const bool indexed = meshBuffer->getIndexType()!=EIT_UNKNOWN;
+				const auto oldBinding = meshBuffer->getIndexBufferBinding();
+				const auto oldIndexCount = meshBuffer->getIndexCount();
+				const auto oldBaseVertex = meshBuffer->getBaseVertex();
+				const size_t indexSize = meshBuffer->getIndexType()==EIT_16BIT ? sizeof(uint16_t):sizeof(uint32_t);
+				for (uint32_t first=0u; first<oldIndexCount; first+=meshletIndices)
+				{
+					if (indexed)
+						meshBuffer->setIndexBufferBinding({oldBinding.offset+first*indexSize,oldBinding.buffer});
+					else
+						meshBuffer->setBaseVertex(oldBaseVertex+int32_t(first));
+					meshBuffer->setIndexCount(core::min(oldIndexCount-first,meshletIndices));
+					serialAABBs[meshlet++] = IMeshManipulator::calculateBoundingBox(meshBuffer.get());
+				}
+				meshBuffer->setIndexCount(oldIndexCount);
+				meshBuffer->setBaseVertex(oldBaseVertex);
+				if (indexed)
+					meshBuffer->setIndexBufferBinding(SBufferBinding<ICPUBuffer>(oldBinding));
+			}
+		});
+		run("CBoundingVolumeBatch meshlet AABBs",[&]() -> void {batch.compute(meshletJobs.data(),meshletJobs.data()+meshletJobs.size(),aabbs.data());});
+		run("CBoundingVolumeBatch meshlet AABBs and OBBs",[&]() -> void {batch.compute(meshletJobs.data(),meshletJobs.data()+meshletJobs.size(),aabbs.data(),obbs.data());});
+		passed = check("meshlets",meshletJobs,serialAABBs,aabbs,obbs) && passed;
+		return passed;
+	}
+
+	static vectorSIMDf getPosition(const CBoundingVolumeBatch::SJob& job, const uint32_t i)
+	{
+		uint32_t vertex = job.first+i;
+		if (job.indexType==EIT_16BIT)
+			vertex = reinterpret_cast<const uint16_t*>(job.indices)[vertex];
+		else if (job.indexType==EIT_32BIT)
+			vertex = reinterpret_cast<const uint32_t*>(job.indices)[vertex];
+		vectorSIMDf retval;
+		job.meshBuffer->getAttribute(retval,job.positionAttributeIx,static_cast<uint32_t>(job.baseVertex+int32_t(vertex)));
+		return retval;
+	}
+
+	static bool check(const char* what, const core::vector<CBoundingVolumeBatch::SJob>& jobs, const core::vector<aabbox3df>& serialAABBs, const core::vector<aabbox3df>& aabbs, const core::vector<matrix3x4SIMD>& obbs)
+	{
+		size_t aabbFailures = 0ull, serialFailures = 0ull, obbFailures = 0ull;
+		double aabbArea = 0.0, obbArea = 0.0;
+		for (size_t j=0ull; j<jobs.size(); j++)
+		{
+			const auto& job = jobs[j];
+			if (!job.positions || job.count==0u)
+				continue;
+
+			vectorSIMDf lo(FLT_MAX), hi(-FLT_MAX);
+			for (auto i=0u; i<job.count; i++)
+			{
+				const auto p = getPosition(job,i);
+				for (auto c=0u; c<3u; c++)
+				{
+					lo.pointer[c] = std::min(lo.pointer[c],p.pointer[c]);
+					hi.pointer[c] = std::max(hi.pointer[c],p.pointer[c]);
+				}
+			}
+			const auto& aabb = aabbs[j];
+			if (aabb.MinEdge.X!=lo.x || aabb.MinEdge.Y!=lo.y || aabb.MinEdge.Z!=lo.z || aabb.MaxEdge.X!=hi.x || aabb.MaxEdge.Y!=hi.y || aabb.MaxEdge.Z!=hi.z)
+				aabbFailures++;
+			// per component, `vector3df::operator==` has a tolerance
+			const auto& serial = serialAABBs[j];
+			if (aabb.MinEdge.X!=serial.MinEdge.X || aabb.MinEdge.Y!=serial.MinEdge.Y || aabb.MinEdge.Z!=serial.MinEdge.Z || aabb.MaxEdge.X!=serial.MaxEdge.X || aabb.MaxEdge.Y!=serial.MaxEdge.Y || aabb.MaxEdge.Z!=serial.MaxEdge.Z)
+				serialFailures++;
+
+			// the unit cube's edges, normalized back into axes, a flat box has a zero edge which is perpendicular to the others
+			const auto& obb = obbs[j];
+			vectorSIMDf axes[3];
+			float extent[3];
+			for (auto a=0u; a<3u; a++)
+			{
+				vectorSIMDf corner(0.f,0.f,0.f,1.f);
+				corner.pointer[a] = 1.f;
+				obb.transformVect(corner);
+				axes[a] = corner-obb.getTranslation();
+				axes[a].w = 0.f;
+				extent[a] = core::length(axes[a]).x;
+				if (extent[a]>0.f)
+					axes[a] /= extent[a];
+			}
+			bool valid[3] = {extent[0]>0.f,extent[1]>0.f,extent[2]>0.f};
+			for (auto a=0u; a<3u; a++)
+			{
+				if (valid[a])
+					continue;
+				const uint32_t next = (a+1u)%3u;
+				const uint32_t prev = (a+2u)%3u;
+				if (valid[next] && valid[prev])
+					axes[a] = core::normalize(core::cross(axes[next],axes[prev]));
+				else if (valid[next] || valid[prev])
+				{
+					const auto& other = axes[valid[next] ? next:prev];
+					axes[a] = core::normalize(core::cross(other,std::abs(other.x)<0.9f ? vectorSIMDf(1.f,0.f,0.f):vectorSIMDf(0.f,1.f,0.f)));
+				}
+				else
+				{
+					axes[a] = vectorSIMDf(0.f,0.f,0.f);
+					axes[a].pointer[a] = 1.f;
+				}
+				valid[a] = true;
+			}
+			const float size = core::max(core::max(core::max(hi.x-lo.x,hi.y-lo.y),hi.z-lo.z),core::max(core::length(lo).x,core::length(hi).x));
+			const float tolerance = core::max(size,1.f)*1e-5f;
+			auto origin = obb.getTranslation();
+			origin.w = 0.f;
+			bool contained = true;
+			for (auto i=0u; i<job.count && contained; i++)
+			{
+				const auto p = getPosition(job,i)-origin;
+				for (auto a=0u; a<3u; a++)
+				{
+					const float projection = core::dot(p,axes[a]).x;
+					contained = contained && projection>=-tolerance && projection<=extent[a]+tolerance;
+				}
+			}
+			const float aabbHalfArea = (hi.x-lo.x)*(hi.y-lo.y)+(hi.y-lo.y)*(hi.z-lo.z)+(hi.z-lo.z)*(hi.x-lo.x);
+			const float obbHalfArea = extent[0]*extent[1]+extent[1]*extent[2]+extent[2]*extent[0];
+			if (!contained || obbHalfArea>aabbHalfArea*(1.f+1e-5f)+tolerance*tolerance)
+				obbFailures++;
+			aabbArea += aabbHalfArea;
+			obbArea += obbHalfArea;
+		}
+		printf(
+			"\t%-18s | AABB %s | IMeshManipulator AABB %s | OBB %s, %5.1f%% of the AABB surface area\n",what,
+			aabbFailures ? "FAILED":"PASSED",serialFailures ? "FAILED":"PASSED",obbFailures ? "FAILED":"PASSED",
+			aabbArea>0.0 ? obbArea/aabbArea*100.0:100.0
+		);
+		return aabbFailures==0ull && serialFailures==0ull && obbFailures==0ull;
+	}
+
+	void onAppTerminated_impl() override
+	{
+	}
+
+	void workLoopBody() override
+	{
+	}
+
+	bool keepRunning() override
+	{
+		return false;
+	}
+};
+
+NBL_COMMON_API_MAIN(BoundingVolumeBenchmarkApp)
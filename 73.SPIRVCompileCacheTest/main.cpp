@@ -0,0 +1,259 @@
+#define _NBL_STATIC_LIB_
+#include <nabla.h>
+#include <chrono>
+#include <fstream>
+#include <latch>
+#include "../common/CommonAPI.h"
+
+#include "../common/CSPIRVCompileCache.h"
+
+using namespace nbl;
+using namespace core;
+using namespace asset;
+
+
+// Headless check of `CSPIRVCompileCache`, on a compute shader with an include, in a scratch directory which gets wiped first.
+//	- the first compile misses, the same compile again hits memory, a new cache on the same directory (what the next start sees) hits disk
+//	  and gives the same SPIR-V
+//	- changing the included file, the debug info flags or the compiler version misses
+//	- a corrupted file gets detected, recompiled and rewritten
+//	- over the directory size cap the least recently used files get evicted
+//	- many threads asking for the same shader at once compile it only once
+class SPIRVCompileCacheTestApp : public NonGraphicalApplicationBase
+{
+	using clock_t = std::chrono::high_resolution_clock;
+
+	static inline constexpr const char* ShaderSource = R"===(#version 460 core
+#include "spirv_cache_test.glsl"
+layout(local_size_x=WORKGROUP_SIZE) in;
+layout(set=0, binding=0, std430) restrict buffer Data
+{
+	uint data[];
+};
+void main()
+{
+	data[gl_GlobalInvocationID.x] = scale(data[gl_GlobalInvocationID.x]);
+}
+)===";
+
+	core::smart_refctd_ptr<nbl::system::ISystem> system;
+	core::smart_refctd_ptr<nbl::asset::CCompilerSet> compilerSet;
+	core::smart_refctd_ptr<nbl::system::ILogger> logger;
+
+	std::filesystem::path scratch;
+	std::string shaderPath;
+	bool allPassed = true;
+
+public:
+
+	void setSystem(core::smart_refctd_ptr<nbl::system::ISystem>&& _system) override
+	{
+		system = std::move(_system);
+	}
+
+	NON_GRAPHICAL_APP_CONSTRUCTOR(SPIRVCompileCacheTestApp);
+
+	void onAppInitialized_impl() override
+	{
+		CommonAPI::InitParams initParams;
+		initParams.apiType = video::EAT_VULKAN;
+		initParams.appName = { "73.SPIRVCompileCacheTest" };
+		// CPU only, no Vulkan device needed
+		auto initOutput = CommonAPI::Init<false>(std::move(initParams));
+
+		system = std::move(initOutput.system);
+		compilerSet = std::move(initOutput.compilerSet);
+		logger = std::move(initOutput.logger);
+
+		scratch = localOutputCWD/"spirv_cache_test";
+		std::filesystem::remove_all(scratch);
+		std::filesystem::create_directories(scratch);
+		shaderPath = (scratch/"spirv_cache_test.comp").string();
+		writeFile(shaderPath,ShaderSource);
+		writeInclude(3u);
+		const auto cacheDir = scratch/"cache";
+
+		auto shader = core::make_smart_refctd_ptr<ICPUShader>(ShaderSource,IShader::ESS_COMPUTE,IShader::E_CONTENT_TYPE::ECT_GLSL,std::string(shaderPath));
+		const auto options = getOptions();
+		core::smart_refctd_ptr<ICPUShader> reference;
+		{
+			auto cache = makeCache(cacheDir,"compiler 1");
+			const auto coldStart = clock_t::now();
+			reference = cache->compileToSPIRV(shader.get(),options);
+			const auto coldEnd = clock_t::now();
+			auto again = cache->compileToSPIRV(shader.get(),options);
+			const auto warmEnd = clock_t::now();
+			report("first compile misses",isSPIRV(reference.get()) && counts(cache.get(),0u,0u,1u,0u));
+			report("same compile again hits memory",again==reference && counts(cache.get(),1u,0u,1u,0u));
+			printf(
+				"compile %.3f ms, memory hit %.3f ms\n",std::chrono::duration<double,std::milli>(coldEnd-coldStart).count(),
+				std::chrono::duration<double,std::milli>(warmEnd-coldEnd).count()
+			);
+		}
+		{
+			auto cache = makeCache(cacheDir,"compiler 1");
+			const auto start = clock_t::now();
+			auto loaded = cache->compileToSPIRV(shader.get(),options);
+			const auto end = clock_t::now();
+			report("next start hits disk with the same SPIR-V",sameContent(loaded.get(),reference.get()) && counts(cache.get(),0u,1u,0u,0u));
+			printf("disk hit %.3f ms\n",std::chrono::duration<double,std::milli>(end-start).count());
+
+			writeInclude(5u);
+			auto changedInclude = cache->compileToSPIRV(shader.get(),options);
+			report("changed include misses",isSPIRV(changedInclude.get()) && !sameContent(changedInclude.get(),reference.get()) && counts(cache.get(),0u,1u,1u,0u));
+			writeInclude(3u);
+			auto restoredInclude = cache->compileToSPIRV(shader.get(),options);
+			report("restored include hits memory",sameContent(restoredInclude.get(),reference.get()) && counts(cache.get(),1u,1u,1u,0u));
+
+			auto noDebugInfo = options;
+			noDebugInfo.debugInfoFlags = IShaderCompiler::E_DEBUG_INFO_FLAGS::EDIF_NONE;
+			auto withoutDebugInfo = cache->compileToSPIRV(shader.get(),noDebugInfo);
+			report("changed debug info flags miss",isSPIRV(withoutDebugInfo.get()) && counts(cache.get(),1u,1u,2u,0u));
+		}
+		{
+			auto cache = makeCache(cacheDir,"compiler 2");
+			auto otherCompiler = cache->compileToSPIRV(shader.get(),options);
+			report("changed compiler version misses",isSPIRV(otherCompiler.get()) && counts(cache.get(),0u,0u,1u,0u));
+		}
+		{
+			auto cache = makeCache(cacheDir,"compiler 1");
+			auto preprocessed = compilerSet->preprocessShader(shader.get(),options.preprocessorOptions);
+			const auto path = cache->getPath(cache->makeKey(preprocessed.get(),options));
+			{
+				// flip a bit in the last SPIR-V word
+				std::fstream file(path,std::ios::binary|std::ios::in|std::ios::out);
+				file.seekg(-1,std::ios::end);
+				const char last = static_cast<char>(file.get()^0x1);
+				file.seekp(-1,std::ios::end);
+				file.put(last);
+			}
+			auto recompiled = cache->compileToSPIRV(shader.get(),options);
+			report("corrupted file gets recompiled",sameContent(recompiled.get(),reference.get()) && counts(cache.get(),0u,0u,1u,1u));
+		}
+		{
+			auto cache = makeCache(cacheDir,"compiler 1");
+			auto loaded = cache->compileToSPIRV(shader.get(),options);
+			report("and rewritten",sameContent(loaded.get(),reference.get()) && counts(cache.get(),0u,1u,0u,0u));
+		}
+		{
+			// the disk hit above made the reference the most recently used of the 4 files, a cap of its size only leaves it
+			std::filesystem::path referencePath;
+			{
+				auto cache = makeCache(cacheDir,"compiler 1");
+				auto preprocessed = compilerSet->preprocessShader(shader.get(),options.preprocessorOptions);
+				referencePath = cache->getPath(cache->makeKey(preprocessed.get(),options));
+			}
+			const uint32_t filesBefore = countCacheFiles(cacheDir);
+			auto cache = makeCache(cacheDir,"compiler 1",std::filesystem::file_size(referencePath));
+			const bool evicted = filesBefore==4u && cache->getStats().evicted==3u && countCacheFiles(cacheDir)==1u && std::filesystem::exists(referencePath);
+			auto loaded = cache->compileToSPIRV(shader.get(),options);
+			report("over the size cap the least recently used get evicted",evicted && sameContent(loaded.get(),reference.get()) && counts(cache.get(),0u,1u,0u,0u));
+		}
+		{
+			// memory only, so all the threads have to wait for the one compiling, and they all start at once so they race for the key
+			auto cache = makeCache({},"compiler 1");
+			constexpr uint32_t ThreadCount = 8u;
+			core::vector<core::smart_refctd_ptr<ICPUShader>> results(ThreadCount);
+			core::vector<std::thread> threads;
+			std::latch start(ThreadCount);
+			for (auto i=0u; i<ThreadCount; i++)
+			{
+				threads.emplace_back([&,i]() -> void
+				{
+					start.arrive_and_wait();
+					results[i] = cache->compileToSPIRV(shader.get(),options);
+				});
+			}
+			for (auto& thread : threads)
+				thread.join();
+			const auto& stats = cache->getStats();
+			bool passed = stats.compiles==1u && stats.misses==1u && stats.memoryHits+stats.deduplicated==ThreadCount-1u;
+			for (const auto& result : results)
+				passed = passed && result==results[0];
+			report("concurrent compiles of the same shader get deduplicated",passed);
+			printf("%u waited for the compile in flight, %u came after it\n",stats.deduplicated.load(),stats.memoryHits.load());
+		}
+
+		std::filesystem::remove_all(scratch);
+		if (!allPassed)
+			exit(0x45);
+	}
+
+	core::smart_refctd_ptr<CSPIRVCompileCache> makeCache(const std::filesystem::path& directory, std::string&& compilerVersion, const uint64_t maxDirectorySize=CSPIRVCompileCache::DefaultMaxDirectorySize)
+	{
+		return core::make_smart_refctd_ptr<CSPIRVCompileCache>(core::smart_refctd_ptr(compilerSet),directory,std::move(compilerVersion),maxDirectorySize);
+	}
+
+	static uint32_t countCacheFiles(const std::filesystem::path& directory)
+	{
+		uint32_t count = 0u;
+		for (const auto& entry : std::filesystem::directory_iterator(directory))
+		if (entry.path().extension()==".spv")
+			count++;
+		return count;
+	}
+
+	IShaderCompiler::SCompilerOptions getOptions() const
+	{
+		IShaderCompiler::SCompilerOptions options = {};
+		options.stage = IShader::ESS_COMPUTE;
+		options.debugInfoFlags = IShaderCompiler::E_DEBUG_INFO_FLAGS::EDIF_SOURCE_BIT;
+		options.preprocessorOptions.sourceIdentifier = shaderPath;
+		options.preprocessorOptions.logger = logger.get();
+		options.preprocessorOptions.includeFinder = compilerSet->getShaderCompiler(IShader::E_CONTENT_TYPE::ECT_GLSL)->getDefaultIncludeFinder();
+		return options;
+	}
+
+	// found relative to the shader
+	void writeInclude(const uint32_t factor)
+	{
+		writeFile(scratch/"spirv_cache_test.glsl","#define WORKGROUP_SIZE 64\nuint scale(in uint x)\n{\n\treturn x*"+std::to_string(factor)+"u;\n}\n");
+	}
+
+	static void writeFile(const std::filesystem::path& path, const std::string& content)
+	{
+		std::ofstream file(path,std::ios::binary|std::ios::trunc);
+		file.write(content.data(),content.size());
+	}
+
+	static bool isSPIRV(const ICPUShader* shader)
+	{
+		if (!shader || shader->getContentType()!=IShader::E_CONTENT_TYPE::ECT_SPIRV || shader->getContent()->getSize()<sizeof(uint32_t))
+			return false;
+		return *reinterpret_cast<const uint32_t*>(shader->getContent()->getPointer())==0x07230203u;
+	}
+
+	static bool sameContent(const ICPUShader* a, const ICPUShader* b)
+	{
+		if (!isSPIRV(a) || !isSPIRV(b) || a->getContent()->getSize()!=b->getContent()->getSize())
+			return false;
+		return memcmp(a->getContent()->getPointer(),b->getContent()->getPointer(),a->getContent()->getSize())==0;
+	}
+
+	static bool counts(const CSPIRVCompileCache* cache, const uint32_t memoryHits, const uint32_t diskHits, const uint32_t misses, const uint32_t invalidated)
+	{
+		const auto& stats = cache->getStats();
+		return stats.memoryHits==memoryHits && stats.diskHits==diskHits && stats.misses==misses && stats.invalidated==invalidated;
+	}
+
+	void report(const char* what, const bool passed)
+	{
+		printf("%-56s | %s\n",what,passed ? "PASSED":"FAILED");
+		allPassed = allPassed && passed;
+	}
+
+	void onAppTerminated_impl() override
+	{
+	}
+
+	void workLoopBody() override
+	{
+	}
+
+	bool keepRunning() override
+	{
+		return false;
+	}
+};
+
+NBL_COMMON_API_MAIN(SPIRVCompileCacheTestApp)
@@ -0,0 +1,243 @@
+#define _NBL_STATIC_LIB_
+#include <nabla.h>
+#include <chrono>
+#include <fstream>
+#include "../common/CommonAPI.h"
+
+#include "../common/CShaderPermutationCompiler.h"
+
+using namespace nbl;
+using namespace core;
+using namespace asset;
+
+
+// Headless check of `CShaderPermutationCompiler` on generated compute shaders in a scratch directory which gets wiped first.
+// `variants.comp` includes `shared.glsl` which includes `leaf.glsl`, `workgroup.comp` includes `workgroup.glsl`, both get compiled with
+// a number of different defines. Checks that
+//	- every permutation compiles, and the parallel build gives the same SPIR-V as compiling them one after the other
+//	- building again compiles nothing
+//	- editing a header only recompiles the permutations which include it, directly or not, and leaves the others alone
+// Usage: `[-PERMUTATIONS=n]`, how many defines `variants.comp` gets compiled with (default 32).
+class ShaderPermutationCompileTestApp : public NonGraphicalApplicationBase
+{
+	using clock_t = std::chrono::high_resolution_clock;
+
+	static inline constexpr uint32_t WorkgroupPermutationCount = 4u;
+
+	core::smart_refctd_ptr<nbl::system::ISystem> system;
+	core::smart_refctd_ptr<nbl::asset::CCompilerSet> compilerSet;
+	core::smart_refctd_ptr<nbl::system::ILogger> logger;
+
+	std::filesystem::path scratch;
+	bool allPassed = true;
+
+public:
+
+	void setSystem(core::smart_refctd_ptr<nbl::system::ISystem>&& _system) override
+	{
+		system = std::move(_system);
+	}
+
+	NON_GRAPHICAL_APP_CONSTRUCTOR(ShaderPermutationCompileTestApp);
+
+	void onAppInitialized_impl() override
+	{
+		uint32_t variantCount = 32u;
+		for (const auto& arg : argv)
+		{
+			if (arg.rfind("-PERMUTATIONS=",0)==0)
+				variantCount = std::stoul(arg.substr(14));
+		}
+
+		CommonAPI::InitParams initParams;
+		initParams.apiType = video::EAT_VULKAN;
+		initParams.appName = { "74.ShaderPermutationCompileTest" };
+		// CPU only, no Vulkan device needed
+		auto initOutput = CommonAPI::Init<false>(std::move(initParams));
+
+		system = std::move(initOutput.system);
+		compilerSet = std::move(initOutput.compilerSet);
+		logger = std::move(initOutput.logger);
+
+		scratch = localOutputCWD/"shader_permutation_test";
+		std::filesystem::remove_all(scratch);
+		std::filesystem::create_directories(scratch);
+		writeFile(scratch/"variants.comp",R"===(#version 460 core
+#include "shared.glsl"
+layout(local_size_x=64) in;
+layout(set=0, binding=0, std430) restrict buffer Data
+{
+	uint data[];
+};
+void main()
+{
+	data[gl_GlobalInvocationID.x] = transform(data[gl_GlobalInvocationID.x],VARIANT);
+}
+)===");
+		writeFile(scratch/"shared.glsl","#include \"leaf.glsl\"\nuint transform(in uint x, in uint variant)\n{\n\treturn leaf(x)*variant+1u;\n}\n");
+		writeFile(scratch/"leaf.glsl","uint leaf(in uint x)\n{\n\treturn x^0x45u;\n}\n");
+		writeFile(scratch/"workgroup.comp",R"===(#version 460 core
+#include "workgroup.glsl"
+layout(local_size_x=WORKGROUP_SIZE) in;
+shared uint scratch[WORKGROUP_SIZE];
+layout(set=0, binding=0, std430) restrict buffer Data
+{
+	uint data[];
+};
+void main()
+{
+	scratch[gl_LocalInvocationIndex] = data[gl_GlobalInvocationID.x];
+	barrier();
+	data[gl_GlobalInvocationID.x] = combine(scratch[gl_LocalInvocationIndex],scratch[WORKGROUP_SIZE-1u-gl_LocalInvocationIndex]);
+}
+)===");
+		writeFile(scratch/"workgroup.glsl","uint combine(in uint a, in uint b)\n{\n\treturn a+b;\n}\n");
+
+		core::vector<CShaderPermutationCompiler::SPermutation> permutations;
+		for (auto i=0u; i<variantCount; i++)
+			permutations.push_back({scratch/"variants.comp",IShader::ESS_COMPUTE,{"VARIANT "+std::to_string(i)+"u"}});
+		for (auto i=0u; i<WorkgroupPermutationCount; i++)
+			permutations.push_back({scratch/"workgroup.comp",IShader::ESS_COMPUTE,{"WORKGROUP_SIZE "+std::to_string(32u<<i)}});
+
+		// what the examples did before, for reference
+		core::vector<core::smart_refctd_ptr<ICPUShader>> serial;
+		const auto serialStart = clock_t::now();
+		for (const auto& permutation : permutations)
+			serial.push_back(compileSerial(permutation));
+		const auto serialEnd = clock_t::now();
+
+		// memory only cache, otherwise the timing would depend on what previous runs left behind
+		auto permutationCompiler = core::make_smart_refctd_ptr<CShaderPermutationCompiler>(core::make_smart_refctd_ptr<CSPIRVCompileCache>(core::smart_refctd_ptr(compilerSet),std::filesystem::path()),getOptions());
+		for (auto permutation : permutations)
+			permutationCompiler->add(std::move(permutation));
+		const auto parallelStart = clock_t::now();
+		const auto compiled = permutationCompiler->build();
+		const auto parallelEnd = clock_t::now();
+		{
+			bool passed = compiled==permutations.size();
+			for (auto i=0u; i<permutations.size(); i++)
+				passed = passed && sameContent(permutationCompiler->getSPIRV(i).get(),serial[i].get());
+			passed = passed && !sameContent(permutationCompiler->getSPIRV(0u).get(),permutationCompiler->getSPIRV(1u).get());
+			report("parallel build matches serial compiles",passed);
+			printf(
+				"%zu permutations, serial %.3f ms, parallel %.3f ms\n",permutations.size(),
+				std::chrono::duration<double,std::milli>(serialEnd-serialStart).count(),
+				std::chrono::duration<double,std::milli>(parallelEnd-parallelStart).count()
+			);
+		}
+		report("building again compiles nothing",permutationCompiler->build()==0u);
+
+		auto snapshot = [&]() -> core::vector<core::smart_refctd_ptr<ICPUShader>>
+		{
+			core::vector<core::smart_refctd_ptr<ICPUShader>> retval;
+			for (auto i=0u; i<permutationCompiler->getPermutationCount(); i++)
+				retval.push_back(permutationCompiler->getSPIRV(i));
+			return retval;
+		};
+		// which permutations got replaced by a new compile, -1 if any failed
+		auto recompiledSince = [&](const core::vector<core::smart_refctd_ptr<ICPUShader>>& before, const uint32_t begin, const uint32_t end) -> int32_t
+		{
+			int32_t retval = 0;
+			for (auto i=0u; i<before.size(); i++)
+			{
+				const auto& spirv = permutationCompiler->getSPIRV(i);
+				if (!spirv)
+					return -1;
+				const bool recompiled = spirv!=before[i];
+				if (recompiled!=(i>=begin && i<end))
+					return -1;
+				retval += recompiled;
+			}
+			return retval;
+		};
+		{
+			const auto dependents = permutationCompiler->getDependents(scratch/"leaf.glsl");
+			bool passed = dependents.size()==variantCount;
+			for (auto i=0u; passed && i<dependents.size(); i++)
+				passed = dependents[i]==i;
+			report("dependency graph goes through nested includes",passed && permutationCompiler->getDependencies(0u).size()==3u);
+
+			auto before = snapshot();
+			writeFile(scratch/"leaf.glsl","uint leaf(in uint x)\n{\n\treturn x^0x54u;\n}\n");
+			const auto rebuilt = permutationCompiler->build();
+			report("editing a nested include only recompiles its dependents",rebuilt==variantCount && recompiledSince(before,0u,variantCount)==variantCount);
+		}
+		{
+			auto before = snapshot();
+			writeFile(scratch/"workgroup.glsl","uint combine(in uint a, in uint b)\n{\n\treturn a*b;\n}\n");
+			const auto rebuilt = permutationCompiler->build();
+			report("editing a direct include only recompiles its dependents",rebuilt==WorkgroupPermutationCount && recompiledSince(before,variantCount,variantCount+WorkgroupPermutationCount)==WorkgroupPermutationCount);
+		}
+
+		std::filesystem::remove_all(scratch);
+		if (!allPassed)
+			exit(0x45);
+	}
+
+	IShaderCompiler::SCompilerOptions getOptions() const
+	{
+		IShaderCompiler::SCompilerOptions options = {};
+		// the cache compiles already preprocessed sources, the debug info would differ from the serial compiles
+		options.debugInfoFlags = IShaderCompiler::E_DEBUG_INFO_FLAGS::EDIF_NONE;
+		options.preprocessorOptions.logger = logger.get();
+		options.preprocessorOptions.includeFinder = compilerSet->getShaderCompiler(IShader::E_CONTENT_TYPE::ECT_GLSL)->getDefaultIncludeFinder();
+		return options;
+	}
+
+	core::smart_refctd_ptr<ICPUShader> compileSerial(const CShaderPermutationCompiler::SPermutation& permutation) const
+	{
+		const auto path = std::filesystem::absolute(permutation.path).lexically_normal().string();
+		std::ifstream file(path,std::ios::binary);
+		const std::string source((std::istreambuf_iterator<char>(file)),std::istreambuf_iterator<char>());
+		auto shader = core::make_smart_refctd_ptr<ICPUShader>(source.c_str(),permutation.stage,IShader::E_CONTENT_TYPE::ECT_GLSL,std::string(path));
+		std::string defines;
+		for (const auto& define : permutation.defines)
+			defines += "#define "+define+"\n";
+		shader = CGLSLCompiler::createOverridenCopy(shader.get(),"%s",defines.c_str());
+		auto options = getOptions();
+		options.stage = permutation.stage;
+		options.preprocessorOptions.sourceIdentifier = path;
+		return compilerSet->compileToSPIRV(shader.get(),options);
+	}
+
+	// the file system's timestamp granularity may be too coarse to tell an edit right after the build apart, so move it forward explicitly
+	static void writeFile(const std::filesystem::path& path, const std::string& content)
+	{
+		std::error_code error;
+		const auto previous = std::filesystem::last_write_time(path,error);
+		{
+			std::ofstream file(path,std::ios::binary|std::ios::trunc);
+			file.write(content.data(),content.size());
+		}
+		if (!error)
+			std::filesystem::last_write_time(path,previous+std::chrono::seconds(2),error);
+	}
+
+	static bool sameContent(const ICPUShader* a, const ICPUShader* b)
+	{
+		if (!a || !b || a->getContent()->getSize()!=b->getContent()->getSize())
+			return false;
+		return memcmp(a->getContent()->getPointer(),b->getContent()->getPointer(),a->getContent()->getSize())==0;
+	}
+
+	void report(const char* what, const bool passed)
+	{
+		printf("%-56s | %s\n",what,passed ? "PASSED":"FAILED");
+		allPassed = allPassed && passed;
+	}
+
+	void onAppTerminated_impl() override
+	{
+	}
+
+	void workLoopBody() override
+	{
+	}
+
+	bool keepRunning() override
+	{
+		return false;
+	}
+};
+
+NBL_COMMON_API_MAIN(ShaderPermutationCompileTestApp)
@@ -0,0 +1,611 @@
+#define _NBL_STATIC_LIB_
+#include <nabla.h>
+#include <random>
+#include <chrono>
+#include <cfloat>
+#include <numeric>
+#include "../common/CommonAPI.h"
+
+#include "../56.RayQuery/CCPUAccelerationStructure.h"
+
+using namespace nbl;
+using namespace core;
+using namespace asset;
+
+
+// Headless check and benchmark of `CCPUAccelerationStructure` on the spheres of 56.RayQuery (as AABBs, like it builds them) and on sponza.
+// Every scene gets a bottom level structure and a top level one with a single identity instance of it, like 56.RayQuery has.
+//	- closest hits of a brute force loop over all the primitives have to match, for the bottom and top level structure
+//	- so do those of a top level structure with a few rotated and translated instances with different masks, against the brute force loop
+//	  over every instance's primitives transformed to world space, for random rays with random masks
+//	- build times, and Mrays/s for closest hit and occlusion queries of camera rays and of random rays get printed
+// Usage: `[-WIDTH=n] [-HEIGHT=n] [-REFERENCE=n] [-REPEATS=n]`, the camera ray resolution (default 1280x720), how many of the random rays
+// get checked against the brute force loop on sponza (default 4096, the spheres get all checked) and best of `n` runs (default 3).
+class CPUAccelerationStructureBenchmarkApp : public NonGraphicalApplicationBase
+{
+	using clock_t = std::chrono::high_resolution_clock;
+	using HostGeom = ICPUAccelerationStructure::HostBuildGeometryInfo::Geom;
+	using Instance = ICPUAccelerationStructure::Instance;
+	static inline constexpr uint32_t InstanceCount = 4u;
+	static inline constexpr uint32_t InstanceCustomIndexBase = 0x10u;
+
+	struct SSphere
+	{
+		float position[3];
+		float radius;
+	};
+	// intersection part of the ray query in 56.RayQuery's shaders
+	struct SSphereIntersector
+	{
+		const SSphere* spheres;
+
+		inline bool operator()(const CCPUAccelerationStructure::SProceduralCandidate& candidate, const float tMax, float& t) const
+		{
+			return intersectSphere(spheres[candidate.primitiveIndex],candidate.ray,tMax,t);
+		}
+	};
+
+	// the scene a structure gets built from and checked against
+	struct SScene
+	{
+		const char* name;
+		core::smart_refctd_dynamic_array<HostGeom> geometries;
+		core::vector<ICPUAccelerationStructure::BuildRangeInfo> ranges;
+		// for the brute force reference, triangles as 9 floats in world space, unless it's the spheres
+		core::vector<float> triangles;
+		core::vector<SSphere> spheres;
+		core::vectorSIMDf cameraPosition;
+		core::vectorSIMDf cameraTarget;
+	};
+
+	core::smart_refctd_ptr<nbl::system::ISystem> system;
+	core::smart_refctd_ptr<nbl::asset::IAssetManager> assetManager;
+	core::smart_refctd_ptr<nbl::system::ILogger> logger;
+
+	uint32_t width = 1280u;
+	uint32_t height = 720u;
+	uint32_t referenceRays = 4096u;
+	uint32_t repeats = 3u;
+
+public:
+
+	void setSystem(core::smart_refctd_ptr<nbl::system::ISystem>&& _system) override
+	{
+		system = std::move(_system);
+	}
+
+	NON_GRAPHICAL_APP_CONSTRUCTOR(CPUAccelerationStructureBenchmarkApp);
+
+	void onAppInitialized_impl() override
+	{
+		CommonAPI::InitParams initParams;
+		initParams.apiType = video::EAT_VULKAN;
+		initParams.appName = { "75.CPUAccelerationStructureBenchmark" };
+		// CPU only, no Vulkan device needed
+		auto initOutput = CommonAPI::Init<false>(std::move(initParams));
+
+		system = std::move(initOutput.system);
+		assetManager = std::move(initOutput.assetManager);
+		logger = std::move(initOutput.logger);
+
+		for (const auto& arg : argv)
+		{
+			if (arg.rfind("-WIDTH=",0)==0)
+				width = std::max<uint32_t>(std::stoul(arg.substr(7)),1u);
+			else if (arg.rfind("-HEIGHT=",0)==0)
+				height = std::max<uint32_t>(std::stoul(arg.substr(8)),1u);
+			else if (arg.rfind("-REFERENCE=",0)==0)
+				referenceRays = std::stoul(arg.substr(11));
+			else if (arg.rfind("-REPEATS=",0)==0)
+				repeats = std::max<uint32_t>(std::stoul(arg.substr(9)),1u);
+		}
+
+		bool allPassed = runScene(createSpheres());
+		auto sponza = loadSponza();
+		if (sponza.ranges.empty())
+			logger->log("Couldn't load sponza, skipping it.",system::ILogger::ELL_WARNING);
+		else
+			allPassed = runScene(sponza) && allPassed;
+
+		if (!allPassed)
+			exit(0x45);
+	}
+
+	// the ones 56.RayQuery renders
+	static SScene createSpheres()
+	{
+		SScene scene;
+		scene.name = "spheres";
+		scene.spheres = {
+			{{0.f,-100.5f,-1.f},100.f},
+			{{3.f,0.f,-1.f},0.5f},
+			{{0.f,0.f,-1.f},0.5f},
+			{{-3.f,0.f,-1.f},0.5f},
+			{{3.f,0.f,1.f},0.5f},
+			{{0.f,0.f,1.f},0.5f},
+			{{-3.f,0.f,1.f},0.5f},
+			{{0.5f,1.f,0.5f},0.5f},
+			{{-1.5f,1.5f,0.f},0.3f}
+		};
+		const uint32_t sphereCount = scene.spheres.size();
+		auto aabbs = core::make_smart_refctd_ptr<ICPUBuffer>(sizeof(float)*6u*sphereCount);
+		float* aabb = reinterpret_cast<float*>(aabbs->getPointer());
+		for (const auto& sphere : scene.spheres)
+		for (auto c=0u; c<6u; c++)
+			*(aabb++) = sphere.position[c%3u]+(c<3u ? -sphere.radius:sphere.radius);
+
+		scene.geometries = core::make_refctd_dynamic_array<core::smart_refctd_dynamic_array<HostGeom>>(1u);
+		auto& geometry = scene.geometries->operator[](0u);
+		geometry.type = IAccelerationStructure::EGT_AABBS;
+		geometry.flags = IAccelerationStructure::EGF_OPAQUE_BIT;
+		geometry.data.aabbs.data.offset = 0u;
+		geometry.data.aabbs.data.buffer = std::move(aabbs);
+		geometry.data.aabbs.stride = sizeof(float)*6u;
+		scene.ranges.push_back({sphereCount,0u,0u,0u});
+		scene.cameraPosition = core::vectorSIMDf(0.f,5.f,-10.f);
+		scene.cameraTarget = core::vectorSIMDf(0.f,0.f,0.f);
+		return scene;
+	}
+
+	// the way 63.OBB loads it, one triangle geometry per meshbuffer
+	SScene loadSponza()
+	{
+		SScene scene;
+		scene.name = "sponza";
+		auto archive = system->openFileArchive(sharedInputCWD/"sponza.zip");
+		if (!archive)
+			return scene;
+		system->mount(std::move(archive));
+		IAssetLoader::SAssetLoadParams loadParams;
+		loadParams.workingDirectory = sharedInputCWD;
+		loadParams.logger = logger.get();
+		auto bundle = assetManager->getAsset((sharedInputCWD/"sponza.zip/sponza.obj").string(),loadParams);
+
+		core::vector<HostGeom> geometries;
+		core::aabbox3df bounds;
+		bool first = true;
+		for (const auto& asset : bundle.getContents())
+		{
+			if (asset->getAssetType()!=IAsset::ET_MESH)
+				continue;
+			for (auto meshBuffer : static_cast<ICPUMesh*>(asset.get())->getMeshBuffers())
+			{
+				const auto positionAttributeIx = meshBuffer->getPositionAttributeIx();
+				const auto format = meshBuffer->getAttribFormat(positionAttributeIx);
+				if (meshBuffer->getPipeline()->getPrimitiveAssemblyParams().primitiveType!=EPT_TRIANGLE_LIST || (format!=EF_R32G32B32_SFLOAT && format!=EF_R32G32B32A32_SFLOAT))
+					continue;
+
+				HostGeom geometry;
+				geometry.type = IAccelerationStructure::EGT_TRIANGLES;
+				geometry.flags = IAccelerationStructure::EGF_OPAQUE_BIT;
+				auto& triangles = geometry.data.triangles;
+				triangles.vertexFormat = format;
+				const auto& attribute = meshBuffer->getPipeline()->getVertexInputParams().attributes[positionAttributeIx];
+				triangles.vertexData = meshBuffer->getVertexBufferBindings()[attribute.binding];
+				triangles.vertexData.offset += attribute.relativeOffset;
+				triangles.vertexStride = meshBuffer->getAttribStride(positionAttributeIx);
+				triangles.indexType = meshBuffer->getIndexType();
+				triangles.indexData = meshBuffer->getIndexBufferBinding();
+				const uint32_t triangleCount = meshBuffer->getIndexCount()/3u;
+				geometries.push_back(geometry);
+				scene.ranges.push_back({triangleCount,0u,static_cast<uint32_t>(meshBuffer->getBaseVertex()),0u});
+
+				// reference fetched the slow way
+				for (uint32_t i=0u; i<triangleCount*3u; i++)
+				{
+					uint32_t index = i;
+					if (meshBuffer->getIndexType()==EIT_16BIT)
+						index = reinterpret_cast<const uint16_t*>(meshBuffer->getIndices())[i];
+					else if (meshBuffer->getIndexType()==EIT_32BIT)
+						index = reinterpret_cast<const uint32_t*>(meshBuffer->getIndices())[i];
+					const auto position = meshBuffer->getPosition(index+meshBuffer->getBaseVertex());
+					for (auto c=0u; c<3u; c++)
+						scene.triangles.push_back(position.pointer[c]);
+					if (first)
+						bounds.reset(position.getAsVector3df());
+					else
+						bounds.addInternalPoint(position.getAsVector3df());
+					first = false;
+				}
+			}
+		}
+		scene.geometries = core::make_refctd_dynamic_array<core::smart_refctd_dynamic_array<HostGeom>>(geometries.size());
+		std::copy(geometries.begin(),geometries.end(),scene.geometries->begin());
+		// down the length of the atrium, from the middle of it
+		const auto center = bounds.getCenter();
+		const auto extent = bounds.getExtent();
+		scene.cameraPosition = core::vectorSIMDf(center.X,bounds.MinEdge.Y+extent.Y*0.25f,center.Z);
+		scene.cameraTarget = scene.cameraPosition;
+		if (extent.X>extent.Z)
+			scene.cameraTarget.X += extent.X;
+		else
+			scene.cameraTarget.Z += extent.Z;
+		return scene;
+	}
+
+	bool runScene(const SScene& scene)
+	{
+		uint32_t primitiveCount = 0u;
+		for (const auto& range : scene.ranges)
+			primitiveCount += range.primitiveCount;
+		printf("%s | %zu geometries, %u primitives, best of %u runs\n",scene.name,scene.ranges.size(),primitiveCount,repeats);
+
+		ICPUAccelerationStructure::HostBuildGeometryInfo blasInfo;
+		blasInfo.type = ICPUAccelerationStructure::ET_BOTTOM_LEVEL;
+		blasInfo.buildFlags = ICPUAccelerationStructure::EBF_PREFER_FAST_TRACE_BIT;
+		blasInfo.buildMode = ICPUAccelerationStructure::EBM_BUILD;
+		blasInfo.geometries = scene.geometries;
+		core::smart_refctd_ptr<CCPUAccelerationStructure> blas;
+		const double blasMs = timeBest([&]() -> void {blas = CCPUAccelerationStructure::create(blasInfo,scene.ranges.data(),nullptr,0u,logger.get());});
+		if (!blas)
+		{
+			printf("%s | building the bottom level structure | FAILED\n",scene.name);
+			return false;
+		}
+
+		// a single identity instance, like 56.RayQuery
+		const auto tlasInfo = createTopLevelInfo({createInstance(core::matrix3x4SIMD(),0u,0xFFu)});
+		const ICPUAccelerationStructure::BuildRangeInfo tlasRange = {1u,0u,0u,0u};
+		core::smart_refctd_ptr<CCPUAccelerationStructure> tlas;
+		const double tlasMs = timeBest([&]() -> void {tlas = CCPUAccelerationStructure::create(tlasInfo,&tlasRange,&blas,1u,logger.get());});
+		if (!tlas)
+		{
+			printf("%s | building the top level structure | FAILED\n",scene.name);
+			return false;
+		}
+		printf("%s | build bottom level %.3f ms, %u nodes, top level %.3f ms\n",scene.name,blasMs,blas->getNodeCount(),tlasMs);
+
+		const SSphereIntersector intersector = {scene.spheres.data()};
+		const auto cameraRays = createCameraRays(scene);
+		const auto randomRays = createRandomRays(blas->getBounds(),width*height);
+		bool passed = true;
+		auto runRays = [&](const char* what, const core::vector<CCPUAccelerationStructure::SRay>& rays, const uint32_t referenceCount) -> void
+		{
+			const uint32_t count = rays.size();
+			core::vector<CCPUAccelerationStructure::SHit> hits(count), blasHits(count);
+			core::vector<uint8_t> occluded(count);
+			const double intersectMs = timeBest([&]() -> void {tlas->intersect(rays.data(),hits.data(),count,intersector);});
+			const double occludedMs = timeBest([&]() -> void {tlas->occluded(rays.data(),occluded.data(),count,intersector);});
+			blas->intersect(rays.data(),blasHits.data(),count,intersector);
+
+			// spread evenly over all the rays
+			core::vector<uint32_t> checked(std::min(referenceCount,count));
+			for (auto i=0u; i<checked.size(); i++)
+				checked[i] = static_cast<uint64_t>(i)*count/checked.size();
+			std::atomic_uint32_t mismatches = 0u;
+			uint32_t hitCount = 0u;
+			for (const auto& hit : hits)
+				hitCount += hit.valid();
+			std::for_each(core::execution::par_unseq,checked.begin(),checked.end(),[&](const uint32_t i) -> void
+			{
+				const auto& hit = hits[i];
+				const float reference = scene.spheres.empty() ? bruteForceTriangles(scene.triangles,rays[i]):bruteForceSpheres(scene.spheres,rays[i]);
+				bool match = hit.valid()==(reference<rays[i].tMax) && (occluded[i]!=0u)==hit.valid();
+				if (hit.valid())
+					match = match && std::abs(hit.t-reference)<=1e-5f*reference && hit.instanceIndex==0u && hit.instanceCustomIndex==0u;
+				// identity instance, so the bottom level structure has to give exactly the same
+				match = match && blasHits[i].primitiveIndex==hit.primitiveIndex && blasHits[i].geometryIndex==hit.geometryIndex && (!hit.valid() || blasHits[i].t==hit.t);
+				if (!match)
+					mismatches++;
+			});
+			const bool raysPassed = mismatches==0u;
+			printf(
+				"%s | %s %u rays, %u hits | closest hit %.2f Mrays/s, occlusion %.2f Mrays/s | %u of %zu checked rays wrong | %s\n",
+				scene.name,what,count,hitCount,count*1e-3/intersectMs,count*1e-3/occludedMs,mismatches.load(),checked.size(),raysPassed ? "PASSED":"FAILED"
+			);
+			passed = passed && raysPassed;
+		};
+		// all rays on the spheres, brute force on them is cheap
+		runRays("camera",cameraRays,scene.spheres.empty() ? referenceRays:cameraRays.size());
+		runRays("random",randomRays,scene.spheres.empty() ? referenceRays:randomRays.size());
+		return runInstances(scene,blas,intersector) && passed;
+	}
+
+	// instance `i` only has bit `i` of the mask set, and gets rotated and shifted a quarter of the bounds further than the one before
+	bool runInstances(const SScene& scene, const core::smart_refctd_ptr<CCPUAccelerationStructure>& blas, const SSphereIntersector& intersector) const
+	{
+		const auto blasBounds = blas->getBounds();
+		core::vector<Instance> instances;
+		for (auto i=0u; i<InstanceCount; i++)
+			instances.push_back(createInstance(createInstanceTransform(i,blasBounds),InstanceCustomIndexBase+i,0x1u<<i));
+		const auto tlasInfo = createTopLevelInfo(instances);
+		const ICPUAccelerationStructure::BuildRangeInfo tlasRange = {InstanceCount,0u,0u,0u};
+		const auto tlas = CCPUAccelerationStructure::create(tlasInfo,&tlasRange,&blas,1u,logger.get());
+		if (!tlas)
+		{
+			printf("%s | building the top level structure with %u instances | FAILED\n",scene.name,InstanceCount);
+			return false;
+		}
+
+		// the reference's primitives in world space, the transforms are rigid so the spheres keep their radii
+		core::vector<float> triangles[InstanceCount];
+		core::vector<SSphere> spheres[InstanceCount];
+		for (auto i=0u; i<InstanceCount; i++)
+		{
+			const auto& transform = instances[i].mat;
+			auto transformPoint = [&](const float* p, float* out) -> void
+			{
+				for (auto r=0u; r<3u; r++)
+					out[r] = transform.rows[r][0]*p[0]+transform.rows[r][1]*p[1]+transform.rows[r][2]*p[2]+transform.rows[r][3];
+			};
+			triangles[i].resize(scene.triangles.size());
+			for (size_t v=0ull; v<scene.triangles.size(); v+=3ull)
+				transformPoint(scene.triangles.data()+v,triangles[i].data()+v);
+			spheres[i] = scene.spheres;
+			for (auto& sphere : spheres[i])
+			{
+				const float position[3] = {sphere.position[0],sphere.position[1],sphere.position[2]};
+				transformPoint(position,sphere.position);
+			}
+		}
+
+		// some of the masks select a few instances, the last one none of them
+		constexpr uint32_t RayMasks[] = {0xFFu,0x1u,0x6u,0x8u,0xF0u};
+		const auto tlasBounds = tlas->getBounds();
+		const float sceneSize = tlasBounds.getExtent().getLength();
+		auto rays = createRandomRays(tlasBounds,scene.spheres.empty() ? referenceRays:width*height);
+		for (auto i=0u; i<rays.size(); i++)
+			rays[i].mask = RayMasks[i%std::size(RayMasks)];
+		const uint32_t count = rays.size();
+		core::vector<CCPUAccelerationStructure::SHit> hits(count);
+		core::vector<uint8_t> occluded(count);
+		tlas->intersect(rays.data(),hits.data(),count,intersector);
+		tlas->occluded(rays.data(),occluded.data(),count,intersector);
+
+		core::vector<uint32_t> checked(count);
+		std::iota(checked.begin(),checked.end(),0u);
+		std::atomic_uint32_t mismatches = 0u;
+		uint32_t hitCount = 0u;
+		for (const auto& hit : hits)
+			hitCount += hit.valid();
+		std::for_each(core::execution::par_unseq,checked.begin(),checked.end(),[&](const uint32_t i) -> void
+		{
+			const auto& ray = rays[i];
+			const auto& hit = hits[i];
+			// closest hit on each instance and on its grown triangles, masked out ones don't get hit
+			float references[InstanceCount], grownReferences[InstanceCount];
+			float reference = ray.tMax, grownReference = ray.tMax;
+			for (auto j=0u; j<InstanceCount; j++)
+			{
+				references[j] = grownReferences[j] = ray.tMax;
+				if (instances[j].mask&ray.mask)
+				{
+					if (scene.spheres.empty())
+						references[j] = bruteForceTriangles(triangles[j],ray,grownReferences+j);
+					else
+						references[j] = grownReferences[j] = bruteForceSpheres(spheres[j],ray);
+				}
+				reference = std::min(references[j],reference);
+				grownReference = std::min(grownReferences[j],grownReference);
+			}
+			bool match = (occluded[i]!=0u)==hit.valid();
+			// transforming the rays to object space rounds differently than transforming the primitives to world space, more so far from the
+			// origin and at grazing angles
+			const float tolerance = 1e-4f*(std::min(reference,hit.t)+sceneSize);
+			// rays grazing the edges of triangles can go either way after the rounding, so the closest hit has to be somewhere between the
+			// one on the grown triangles and the one on the actual triangles
+			auto between = [&](const float grown, const float actual) -> bool {return hit.t>=grown-tolerance && (actual==ray.tMax || hit.t<=actual+tolerance);};
+			if (hit.valid())
+			{
+				match = match && hit.instanceIndex<InstanceCount && between(grownReference,reference);
+				match = match && between(grownReferences[hit.instanceIndex],references[hit.instanceIndex]) && hit.instanceCustomIndex==InstanceCustomIndexBase+hit.instanceIndex;
+			}
+			else
+				match = match && reference==ray.tMax;
+			if (!match)
+				mismatches++;
+		});
+		const bool passed = mismatches==0u;
+		printf(
+			"%s | %u instances, random %u rays with masks, %u hits | %u of %u checked rays wrong | %s\n",
+			scene.name,InstanceCount,count,hitCount,mismatches.load(),count,passed ? "PASSED":"FAILED"
+		);
+		return passed;
+	}
+
+	static Instance createInstance(const core::matrix3x4SIMD& transform, const uint32_t customIndex, const uint32_t mask)
+	{
+		Instance instance = {};
+		instance.mat = transform;
+		instance.instanceCustomIndex = customIndex;
+		instance.mask = mask;
+		instance.instanceShaderBindingTableRecordOffset = 0u;
+		instance.flags = IAccelerationStructure::EIF_TRIANGLE_FACING_CULL_DISABLE_BIT;
+		// index into the bottom level structures passed to `create`
+		instance.accelerationStructureReference = 0u;
+		return instance;
+	}
+
+	// a single geometry with all the instances
+	static ICPUAccelerationStructure::HostBuildGeometryInfo createTopLevelInfo(const core::vector<Instance>& instances)
+	{
+		auto instanceBuffer = core::make_smart_refctd_ptr<ICPUBuffer>(sizeof(Instance)*instances.size());
+		std::copy(instances.begin(),instances.end(),reinterpret_cast<Instance*>(instanceBuffer->getPointer()));
+		auto instanceGeometries = core::make_refctd_dynamic_array<core::smart_refctd_dynamic_array<HostGeom>>(1u);
+		instanceGeometries->operator[](0u).type = IAccelerationStructure::EGT_INSTANCES;
+		instanceGeometries->operator[](0u).flags = IAccelerationStructure::EGF_NONE;
+		instanceGeometries->operator[](0u).data.instances.data.offset = 0u;
+		instanceGeometries->operator[](0u).data.instances.data.buffer = std::move(instanceBuffer);
+		ICPUAccelerationStructure::HostBuildGeometryInfo tlasInfo;
+		tlasInfo.type = ICPUAccelerationStructure::ET_TOP_LEVEL;
+		tlasInfo.buildFlags = ICPUAccelerationStructure::EBF_PREFER_FAST_TRACE_BIT;
+		tlasInfo.buildMode = ICPUAccelerationStructure::EBM_BUILD;
+		tlasInfo.geometries = std::move(instanceGeometries);
+		return tlasInfo;
+	}
+
+	// rotated about the center of the bounds around Y and then X, and shifted along X and Z, so the instances overlap
+	static core::matrix3x4SIMD createInstanceTransform(const uint32_t i, const core::aabbox3df& bounds)
+	{
+		const float cosY = std::cos(1.1f*i), sinY = std::sin(1.1f*i);
+		const float cosX = std::cos(0.3f*i), sinX = std::sin(0.3f*i);
+		const float rotation[3][3] = {
+			{cosY,sinY*sinX,sinY*cosX},
+			{0.f,cosX,-sinX},
+			{-sinY,cosY*sinX,cosY*cosX}
+		};
+		const auto center = bounds.getCenter();
+		const auto extent = bounds.getExtent();
+		const float centerArray[3] = {center.X,center.Y,center.Z};
+		const float target[3] = {center.X+extent.X*0.25f*i,center.Y,center.Z+extent.Z*0.25f*i};
+		float rows[3][4];
+		for (auto r=0u; r<3u; r++)
+		{
+			rows[r][3] = target[r];
+			for (auto c=0u; c<3u; c++)
+			{
+				rows[r][c] = rotation[r][c];
+				rows[r][3] -= rotation[r][c]*centerArray[c];
+			}
+		}
+		return core::matrix3x4SIMD(
+			core::vectorSIMDf(rows[0][0],rows[0][1],rows[0][2],rows[0][3]),
+			core::vectorSIMDf(rows[1][0],rows[1][1],rows[1][2],rows[1][3]),
+			core::vectorSIMDf(rows[2][0],rows[2][1],rows[2][2],rows[2][3])
+		);
+	}
+
+	template<typename F>
+	double timeBest(F&& f) const
+	{
+		double best = DBL_MAX;
+		for (auto r=0u; r<repeats; r++)
+		{
+			const auto start = clock_t::now();
+			f();
+			best = std::min(best,std::chrono::duration<double,std::milli>(clock_t::now()-start).count());
+		}
+		return best;
+	}
+
+	// 60 degree vertical field of view, like 56.RayQuery
+	core::vector<CCPUAccelerationStructure::SRay> createCameraRays(const SScene& scene) const
+	{
+		const auto forward = core::normalize(scene.cameraTarget-scene.cameraPosition);
+		const auto right = core::normalize(core::cross(forward,core::vectorSIMDf(0.f,1.f,0.f)));
+		const auto up = core::cross(right,forward);
+		const float tanHalfFov = std::tan(core::radians(30.f));
+		const float aspect = float(width)/float(height);
+		core::vector<CCPUAccelerationStructure::SRay> rays(width*height);
+		for (auto y=0u; y<height; y++)
+		for (auto x=0u; x<width; x++)
+		{
+			const float ndcX = (2.f*(float(x)+0.5f)/float(width)-1.f)*tanHalfFov*aspect;
+			const float ndcY = (1.f-2.f*(float(y)+0.5f)/float(height))*tanHalfFov;
+			const auto direction = forward+right*ndcX+up*ndcY;
+			auto& ray = rays[y*width+x];
+			for (auto c=0u; c<3u; c++)
+			{
+				ray.origin[c] = scene.cameraPosition.pointer[c];
+				ray.direction[c] = direction.pointer[c];
+			}
+		}
+		return rays;
+	}
+
+	// from anywhere in the bounds in any direction, what bakers and occlusion queries look like
+	static core::vector<CCPUAccelerationStructure::SRay> createRandomRays(const core::aabbox3df& bounds, const uint32_t count)
+	{
+		std::mt19937 mt(0x45u);
+		std::uniform_real_distribution<float> unit(0.f,1.f);
+		std::normal_distribution<float> normal;
+		core::vector<CCPUAccelerationStructure::SRay> rays(count);
+		for (auto& ray : rays)
+		{
+			const float* min = &bounds.MinEdge.X;
+			const float* max = &bounds.MaxEdge.X;
+			for (auto c=0u; c<3u; c++)
+			{
+				ray.origin[c] = min[c]+(max[c]-min[c])*unit(mt);
+				ray.direction[c] = normal(mt);
+			}
+		}
+		return rays;
+	}
+
+	// optionally also the closest hit on the triangles grown by a little of their barycentric coordinates
+	static float bruteForceTriangles(const core::vector<float>& triangles, const CCPUAccelerationStructure::SRay& ray, float* grownClosest=nullptr)
+	{
+		constexpr float EdgeTolerance = 1e-3f;
+		const float grownBy = grownClosest ? EdgeTolerance:0.f;
+		float closest = ray.tMax;
+		if (grownClosest)
+			*grownClosest = ray.tMax;
+		for (size_t i=0ull; i<triangles.size(); i+=9ull)
+		{
+			const float* v = triangles.data()+i;
+			const float e1[3] = {v[3]-v[0],v[4]-v[1],v[5]-v[2]};
+			const float e2[3] = {v[6]-v[0],v[7]-v[1],v[8]-v[2]};
+			const float* d = ray.direction;
+			const float p[3] = {d[1]*e2[2]-d[2]*e2[1],d[2]*e2[0]-d[0]*e2[2],d[0]*e2[1]-d[1]*e2[0]};
+			const float det = e1[0]*p[0]+e1[1]*p[1]+e1[2]*p[2];
+			if (det==0.f)
+				continue;
+			const float rcpDet = 1.f/det;
+			const float s[3] = {ray.origin[0]-v[0],ray.origin[1]-v[1],ray.origin[2]-v[2]};
+			const float u = (s[0]*p[0]+s[1]*p[1]+s[2]*p[2])*rcpDet;
+			if (u<-grownBy || u>1.f+grownBy)
+				continue;
+			const float q[3] = {s[1]*e1[2]-s[2]*e1[1],s[2]*e1[0]-s[0]*e1[2],s[0]*e1[1]-s[1]*e1[0]};
+			const float w = (d[0]*q[0]+d[1]*q[1]+d[2]*q[2])*rcpDet;
+			if (w<-grownBy || u+w>1.f+grownBy)
+				continue;
+			const float t = (e2[0]*q[0]+e2[1]*q[1]+e2[2]*q[2])*rcpDet;
+			if (t<ray.tMin)
+				continue;
+			if (grownClosest)
+				*grownClosest = std::min(t,*grownClosest);
+			if (u>=0.f && u<=1.f && w>=0.f && u+w<=1.f && t<closest)
+				closest = t;
+		}
+		return closest;
+	}
+
+	static float bruteForceSpheres(const core::vector<SSphere>& spheres, const CCPUAccelerationStructure::SRay& ray)
+	{
+		float closest = ray.tMax;
+		for (const auto& sphere : spheres)
+		{
+			float t;
+			if (intersectSphere(sphere,ray,closest,t))
+				closest = t;
+		}
+		return closest;
+	}
+
+	static bool intersectSphere(const SSphere& sphere, const CCPUAccelerationStructure::SRay& ray, const float tMax, float& t)
+	{
+		float a = 0.f, b = 0.f, c = -sphere.radius*sphere.radius;
+		for (auto i=0u; i<3u; i++)
+		{
+			const float offset = ray.origin[i]-sphere.position[i];
+			a += ray.direction[i]*ray.direction[i];
+			b += offset*ray.direction[i];
+			c += offset*offset;
+		}
+		const float discriminant = b*b-a*c;
+		if (discriminant<0.f)
+			return false;
+		const float root = std::sqrt(discriminant);
+		t = (-b-root)/a;
+		// from inside
+		if (t<ray.tMin)
+			t = (-b+root)/a;
+		return t>=ray.tMin && t<tMax;
+	}
+
+	void onAppTerminated_impl() override
+	{
+	}
+
+	void workLoopBody() override
+	{
+	}
+
+	bool keepRunning() override
+	{
+		return false;
+	}
+};
+
+NBL_COMMON_API_MAIN(CPUAccelerationStructureBenchmarkApp)
@@ -0,0 +1,248 @@
+#define _NBL_STATIC_LIB_
+#include <nabla.h>
+#include <chrono>
+#include "../common/CommonAPI.h"
+#include "../common/Camera.hpp"
+
+#include "../42.FragmentShaderPathTracer/CCPUPathTracer.h"
+
+using namespace nbl;
+using namespace core;
+using namespace asset;
+
+
+// Headless convergence test of the light sampling techniques of 42.FragmentShaderPathTracer, rendered by `CCPUPathTracer` from its camera.
+// Every light geometry gets a reference from a differently seeded sequence, the triangle and rectangle one with both area and solid angle
+// sampling, and every technique gets compared with the reference of the other method, so a bias shared by both images of one method can't
+// go unnoticed. The sphere only ever gets its cone of directions sampled, so it has just the one reference.
+// Every technique renders up to `-SPP` samples and after every power of two prints the time so far, the mean squared error against its
+// reference, the variance estimated from the samples themselves and the efficiency (one over error times seconds), so techniques can be
+// compared for the same cost.
+//	- the mean luma of the final image has to be within 5 standard errors of the reference's, otherwise the technique has a bias
+// The references and the final images get written as `cpu_path_tracer_*.exr`, they're the golden images to compare the shaders' output with.
+// Usage: `[-WIDTH=n] [-HEIGHT=n] [-SPP=n] [-REFERENCE=n] [-PATH_LENGTH=n]`, the resolution (default 640x360, 1280x720 gives the same random
+// numbers per pixel as the example), samples per pixel rounded up to a power of two (default 256, reference 4096) and the surface hits per path
+// (default 1, like the shaders).
+class CPUPathTracerConvergenceApp : public NonGraphicalApplicationBase
+{
+	using clock_t = std::chrono::high_resolution_clock;
+
+	struct STechnique
+	{
+		const char* name;
+		CCPUPathTracer::E_LIGHT_GEOMETRY lightGeometry;
+		CCPUPathTracer::E_POLYGON_METHOD polygonMethod;
+	};
+	static inline constexpr STechnique Techniques[] = {
+		{"sphere_solid_angle",CCPUPathTracer::ELG_SPHERE,CCPUPathTracer::EPM_SOLID_ANGLE},
+		{"triangle_area",CCPUPathTracer::ELG_TRIANGLE,CCPUPathTracer::EPM_AREA},
+		{"triangle_solid_angle",CCPUPathTracer::ELG_TRIANGLE,CCPUPathTracer::EPM_SOLID_ANGLE},
+		{"rectangle_area",CCPUPathTracer::ELG_RECTANGLE,CCPUPathTracer::EPM_AREA},
+		{"rectangle_solid_angle",CCPUPathTracer::ELG_RECTANGLE,CCPUPathTracer::EPM_SOLID_ANGLE}
+	};
+	static inline constexpr const char* LightGeometryNames[CCPUPathTracer::ELG_COUNT] = {"sphere","triangle","rectangle"};
+	static inline constexpr const char* PolygonMethodNames[CCPUPathTracer::EPM_COUNT] = {"area","solid_angle"};
+
+	core::smart_refctd_ptr<nbl::system::ISystem> system;
+	core::smart_refctd_ptr<nbl::asset::IAssetManager> assetManager;
+	core::smart_refctd_ptr<nbl::system::ILogger> logger;
+
+	uint32_t width = 640u;
+	uint32_t height = 360u;
+	uint32_t samplesLog2 = 8u;
+	uint32_t referenceSamplesLog2 = 12u;
+	uint32_t pathLength = 1u;
+	bool allPassed = true;
+
+public:
+
+	void setSystem(core::smart_refctd_ptr<nbl::system::ISystem>&& _system) override
+	{
+		system = std::move(_system);
+	}
+
+	NON_GRAPHICAL_APP_CONSTRUCTOR(CPUPathTracerConvergenceApp);
+
+	void onAppInitialized_impl() override
+	{
+		CommonAPI::InitParams initParams;
+		initParams.apiType = video::EAT_VULKAN;
+		initParams.appName = { "76.CPUPathTracerConvergence" };
+		// CPU only, no Vulkan device needed
+		auto initOutput = CommonAPI::Init<false>(std::move(initParams));
+
+		system = std::move(initOutput.system);
+		assetManager = std::move(initOutput.assetManager);
+		logger = std::move(initOutput.logger);
+
+		auto ceilLog2 = [](const uint32_t count) -> uint32_t
+		{
+			uint32_t retval = 0u;
+			while ((0x1u<<retval)<count && retval<16u)
+				retval++;
+			return retval;
+		};
+		for (const auto& arg : argv)
+		{
+			if (arg.rfind("-WIDTH=",0)==0)
+				width = std::max<uint32_t>(std::stoul(arg.substr(7)),1u);
+			else if (arg.rfind("-HEIGHT=",0)==0)
+				height = std::max<uint32_t>(std::stoul(arg.substr(8)),1u);
+			else if (arg.rfind("-SPP=",0)==0)
+				samplesLog2 = ceilLog2(std::stoul(arg.substr(5)));
+			else if (arg.rfind("-REFERENCE=",0)==0)
+				referenceSamplesLog2 = ceilLog2(std::stoul(arg.substr(11)));
+			else if (arg.rfind("-PATH_LENGTH=",0)==0)
+				pathLength = std::clamp<uint32_t>(std::stoul(arg.substr(13)),1u,CCPUPathTracer::MaxPathLength);
+		}
+
+		// same camera as the example, which starts out at the same place every time
+		Camera camera(core::vectorSIMDf(0,5,-10),core::vectorSIMDf(0,0,0),matrix4SIMD::buildProjectionMatrixPerspectiveFovRH(core::radians(60.0f),float(width)/float(height),0.01f,500.0f));
+		CCPUPathTracer::SParams params;
+		params.width = width;
+		params.height = height;
+		params.maxPathLength = pathLength;
+		if (!camera.getConcatenatedMatrix().getInverseTransform<core::matrix4SIMD::E_MATRIX_INVERSE_PRECISION::EMIP_64BBIT>(params.invMVP))
+		{
+			logger->log("Couldn't invert the camera's view projection matrix.",system::ILogger::ELL_ERROR);
+			exit(0x45);
+		}
+		printf("%ux%u, %u hits per path, references with %u samples per pixel\n",width,height,pathLength,0x1u<<referenceSamplesLog2);
+
+		for (uint32_t lightGeometry=0u; lightGeometry<CCPUPathTracer::ELG_COUNT; lightGeometry++)
+		{
+			params.lightGeometry = static_cast<CCPUPathTracer::E_LIGHT_GEOMETRY>(lightGeometry);
+			core::smart_refctd_ptr<CCPUPathTracer> references[CCPUPathTracer::EPM_COUNT];
+			if (params.lightGeometry==CCPUPathTracer::ELG_SPHERE)
+				references[CCPUPathTracer::EPM_SOLID_ANGLE] = renderReference(params,CCPUPathTracer::EPM_SOLID_ANGLE);
+			else
+			for (uint32_t polygonMethod=0u; polygonMethod<CCPUPathTracer::EPM_COUNT; polygonMethod++)
+				references[polygonMethod] = renderReference(params,static_cast<CCPUPathTracer::E_POLYGON_METHOD>(polygonMethod));
+			for (const auto& technique : Techniques)
+			if (technique.lightGeometry==lightGeometry)
+			{
+				// the other method's reference, where there is one
+				const CCPUPathTracer* reference = references[technique.polygonMethod==CCPUPathTracer::EPM_AREA ? CCPUPathTracer::EPM_SOLID_ANGLE:CCPUPathTracer::EPM_AREA].get();
+				if (!reference)
+					reference = references[technique.polygonMethod].get();
+				runTechnique(technique,params,reference);
+			}
+		}
+
+		if (!allPassed)
+			exit(0x45);
+	}
+
+	// a different sequence and scrambles, so its noise doesn't correlate with the techniques' own
+	core::smart_refctd_ptr<CCPUPathTracer> renderReference(CCPUPathTracer::SParams params, const CCPUPathTracer::E_POLYGON_METHOD polygonMethod)
+	{
+		params.polygonMethod = polygonMethod;
+		params.maxSamplesLog2 = referenceSamplesLog2;
+		params.sequenceSeed ^= 0x45u;
+		params.scrambleSeed ^= 0x45u;
+		auto reference = CCPUPathTracer::create(params);
+		const auto start = clock_t::now();
+		reference->render(reference->getMaxSampleCount());
+		const auto end = clock_t::now();
+		std::string name = LightGeometryNames[params.lightGeometry];
+		if (params.lightGeometry!=CCPUPathTracer::ELG_SPHERE)
+			name += std::string("_")+PolygonMethodNames[polygonMethod];
+		name += "_reference";
+		printf("%-24s | %5u spp | %10.3f ms\n",name.c_str(),reference->getSampleCount(),std::chrono::duration<double,std::milli>(end-start).count());
+		writeImage(reference.get(),name);
+		return reference;
+	}
+
+	void runTechnique(const STechnique& technique, CCPUPathTracer::SParams params, const CCPUPathTracer* reference)
+	{
+		params.polygonMethod = technique.polygonMethod;
+		params.maxSamplesLog2 = samplesLog2;
+		auto tracer = CCPUPathTracer::create(params);
+
+		printf("%-24s | %9s | %13s | %12s | %12s | %12s\n",technique.name,"spp","ms","MSE","variance","efficiency");
+		double milliseconds = 0.0;
+		for (uint32_t spp=1u; spp<=tracer->getMaxSampleCount(); spp<<=1u)
+		{
+			const auto start = clock_t::now();
+			tracer->render(spp-tracer->getSampleCount());
+			milliseconds += std::chrono::duration<double,std::milli>(clock_t::now()-start).count();
+
+			const double error = meanSquaredError(tracer.get(),reference);
+			const double variance = tracer->getLumaVariance()/double(spp);
+			printf("%-24s | %9u | %13.3f | %12.6e | %12.6e | %12.6e\n","",spp,milliseconds,error,variance,1000.0/(error*milliseconds));
+		}
+		writeImage(tracer.get(),technique.name);
+
+		// the pixels are independent, so the variance of the mean is the mean variance over the pixel count
+		const double pixelCount = double(width)*double(height);
+		const double standardError = std::sqrt((tracer->getLumaVariance()/tracer->getSampleCount()+reference->getLumaVariance()/reference->getSampleCount())/pixelCount);
+		const double difference = std::abs(meanLuma(tracer.get())-meanLuma(reference));
+		printf("mean luma off by %f standard errors\n",difference/standardError);
+		const std::string what = std::string(technique.name)+" converges to the reference";
+		report(what.c_str(),difference<=5.0*standardError);
+	}
+
+	static double meanLuma(const CCPUPathTracer* tracer)
+	{
+		const size_t count = size_t(tracer->getParams().width)*tracer->getParams().height;
+		double retval = 0.0;
+		for (size_t i=0u; i<count; i++)
+		{
+			const float* rgb = tracer->getColor()+i*3u;
+			retval += 0.2126729*rgb[0]+0.7151522*rgb[1]+0.0721750*rgb[2];
+		}
+		return retval/double(count);
+	}
+
+	static double meanSquaredError(const CCPUPathTracer* tracer, const CCPUPathTracer* reference)
+	{
+		const size_t count = size_t(tracer->getParams().width)*tracer->getParams().height*3u;
+		double retval = 0.0;
+		for (size_t i=0u; i<count; i++)
+		{
+			const double diff = tracer->getColor()[i]-reference->getColor()[i];
+			retval += diff*diff;
+		}
+		return retval/double(count);
+	}
+
+	void writeImage(const CCPUPathTracer* tracer, const std::string& name)
+	{
+		auto image = tracer->createImage();
+		const auto& creationParams = image->getCreationParameters();
+		ICPUImageView::SCreationParams viewParams;
+		viewParams.flags = static_cast<ICPUImageView::E_CREATE_FLAGS>(0u);
+		viewParams.format = creationParams.format;
+		viewParams.viewType = ICPUImageView::ET_2D;
+		viewParams.subresourceRange = {static_cast<IImage::E_ASPECT_FLAGS>(0u),0u,creationParams.mipLevels,0u,creationParams.arrayLayers};
+		viewParams.image = std::move(image);
+		auto imageView = ICPUImageView::create(std::move(viewParams));
+
+		IAssetWriter::SAssetWriteParams wp(imageView.get());
+		wp.logger = logger.get();
+		const auto path = localOutputCWD/("cpu_path_tracer_"+name+".exr");
+		if (!assetManager->writeAsset(path.string(),wp))
+			logger->log("Couldn't write %s",system::ILogger::ELL_WARNING,path.string().c_str());
+	}
+
+	void report(const char* what, const bool passed)
+	{
+		printf("%-56s | %s\n",what,passed ? "PASSED":"FAILED");
+		allPassed = allPassed && passed;
+	}
+
+	void onAppTerminated_impl() override
+	{
+	}
+
+	void workLoopBody() override
+	{
+	}
+
+	bool keepRunning() override
+	{
+		return false;
+	}
+};
+
+NBL_COMMON_API_MAIN(CPUPathTracerConvergenceApp)
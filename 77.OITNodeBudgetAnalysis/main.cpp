@@ -0,0 +1,272 @@
+#define _NBL_STATIC_LIB_
+#include <nabla.h>
+#include <random>
+#include <chrono>
+#include <cfloat>
+#include "../common/CommonAPI.h"
+
+#include "../16.OrderIndependentTransparency/CCPUOITResolve.h"
+
+using namespace nbl;
+using namespace core;
+using namespace asset;
+
+
+// Headless analysis of the node budget of 16.OrderIndependentTransparency's OIT with `CCPUOITResolve`, on synthetic fragment lists of
+// the same mean depth complexity but differently distributed: every pixel the same, Poisson distributed, and particles splatted around
+// a few emitters, which leaves most pixels nearly empty and a few very deep.
+// Every node budget from 1 to `CCPUOITResolve::MaxNodeCount` prints its bytes per pixel, the fill and resolve time, Mfragments/s, and the
+// RMS and maximum error against the exactly sorted composite over a grey background, made of nodes rounded to the same storage formats.
+//	- pixels with no more fragments than there are nodes have to come out exactly like the sorted composite
+// Whether the RMS error shrinks with every node added gets printed too, but with the rounding after every merge it doesn't have to.
+// Usage: `[-WIDTH=n] [-HEIGHT=n] [-DEPTH=n] [-REPEATS=n]`, the resolution (default 1280x720, like the example), the mean fragments per
+// pixel (default 16) and best of `n` runs (default 3).
+class OITNodeBudgetAnalysisApp : public NonGraphicalApplicationBase
+{
+	using clock_t = std::chrono::high_resolution_clock;
+	using SFragment = CCPUOITResolve::SFragment;
+
+	struct SDistribution
+	{
+		const char* name;
+		core::vector<SFragment> fragments;
+		core::vector<uint32_t> offsets;
+	};
+	static inline constexpr float Background[3] = {0.5f,0.5f,0.5f};
+
+	core::smart_refctd_ptr<nbl::system::ISystem> system;
+	core::smart_refctd_ptr<nbl::asset::IAssetManager> assetManager;
+	core::smart_refctd_ptr<nbl::system::ILogger> logger;
+
+	uint32_t width = 1280u;
+	uint32_t height = 720u;
+	uint32_t depthComplexity = 16u;
+	uint32_t repeats = 3u;
+	bool allPassed = true;
+
+public:
+
+	void setSystem(core::smart_refctd_ptr<nbl::system::ISystem>&& _system) override
+	{
+		system = std::move(_system);
+	}
+
+	NON_GRAPHICAL_APP_CONSTRUCTOR(OITNodeBudgetAnalysisApp);
+
+	void onAppInitialized_impl() override
+	{
+		CommonAPI::InitParams initParams;
+		initParams.apiType = video::EAT_VULKAN;
+		initParams.appName = { "77.OITNodeBudgetAnalysis" };
+		// CPU only, no Vulkan device needed
+		auto initOutput = CommonAPI::Init<false>(std::move(initParams));
+
+		system = std::move(initOutput.system);
+		assetManager = std::move(initOutput.assetManager);
+		logger = std::move(initOutput.logger);
+
+		for (const auto& arg : argv)
+		{
+			if (arg.rfind("-WIDTH=",0)==0)
+				width = std::max<uint32_t>(std::stoul(arg.substr(7)),1u);
+			else if (arg.rfind("-HEIGHT=",0)==0)
+				height = std::max<uint32_t>(std::stoul(arg.substr(8)),1u);
+			else if (arg.rfind("-DEPTH=",0)==0)
+				depthComplexity = std::max<uint32_t>(std::stoul(arg.substr(7)),1u);
+			else if (arg.rfind("-REPEATS=",0)==0)
+				repeats = std::max<uint32_t>(std::stoul(arg.substr(9)),1u);
+		}
+		printf("%ux%u, %u fragments per pixel on average, best of %u runs\n",width,height,depthComplexity,repeats);
+
+		runDistribution(createConstant());
+		runDistribution(createPoisson());
+		runDistribution(createParticles());
+
+		if (!allPassed)
+			exit(0x45);
+	}
+
+	void runDistribution(const SDistribution& distribution)
+	{
+		const uint32_t pixelCount = width*height;
+		const CCPUOITResolve::SFragmentLists lists = {distribution.fragments.data(),distribution.offsets.data(),pixelCount};
+		uint32_t maxDepthComplexity = 0u;
+		for (auto i=0u; i<pixelCount; i++)
+			maxDepthComplexity = std::max(distribution.offsets[i+1u]-distribution.offsets[i],maxDepthComplexity);
+		const double megaFragments = double(distribution.fragments.size())/1000000.0;
+
+		core::vector<float> exact(pixelCount*3u);
+		const double exactMilliseconds = timeBest([&]() -> void {CCPUOITResolve::resolveExact(lists,Background,exact.data());});
+		printf("%s | %zu fragments, at most %u per pixel\n",distribution.name,distribution.fragments.size(),maxDepthComplexity);
+		printf("%-24s | %9s | %13s | %13s | %12s | %12s\n","nodes","bytes","ms","Mfragments/s","RMS error","max error");
+		printf("%-24s | %9s | %13.3f | %13.3f | %12s | %12s\n","sorted","",exactMilliseconds,megaFragments*1000.0/exactMilliseconds,"","");
+
+		core::vector<float> rgb(pixelCount*3u);
+		double lastError = DBL_MAX;
+		bool exactWhereItFits = true;
+		bool errorShrinks = true;
+		for (uint32_t nodeCount=1u; nodeCount<=CCPUOITResolve::MaxNodeCount; nodeCount++)
+		{
+			auto oit = CCPUOITResolve::create(nodeCount);
+			const double milliseconds = timeBest([&]() -> void {oit->resolve(lists,Background,rgb.data());});
+
+			double squaredError = 0.0;
+			double maxError = 0.0;
+			for (auto i=0u; i<pixelCount; i++)
+			{
+				const bool fits = distribution.offsets[i+1u]-distribution.offsets[i]<=nodeCount;
+				for (auto c=i*3u; c<i*3u+3u; c++)
+				{
+					const double diff = std::abs(rgb[c]-exact[c]);
+					squaredError += diff*diff;
+					maxError = std::max(diff,maxError);
+					exactWhereItFits = exactWhereItFits && (!fits || rgb[c]==exact[c]);
+				}
+			}
+			const double error = std::sqrt(squaredError/double(pixelCount*3u));
+			printf("%-24u | %9u | %13.3f | %13.3f | %12.6e | %12.6e\n",nodeCount,oit->getBytesPerPixel(),milliseconds,megaFragments*1000.0/milliseconds,error,maxError);
+			errorShrinks = errorShrinks && error<=lastError;
+			lastError = error;
+		}
+		report((std::string(distribution.name)+" is exact where the nodes suffice").c_str(),exactWhereItFits);
+		// only informative, rounding the merged nodes can make one more node come out a little worse
+		printf("%-56s | %s\n",(std::string(distribution.name)+" error shrinks with more nodes").c_str(),errorShrinks ? "yes":"no");
+	}
+
+	template<typename F>
+	double timeBest(F&& f) const
+	{
+		double best = DBL_MAX;
+		for (auto r=0u; r<repeats; r++)
+		{
+			const auto start = clock_t::now();
+			f();
+			best = std::min(best,std::chrono::duration<double,std::milli>(clock_t::now()-start).count());
+		}
+		return best;
+	}
+
+	// fragments come in random depth order, like unsorted draws, and are mostly quite transparent, like particles
+	static SFragment createFragment(std::mt19937& mt)
+	{
+		std::uniform_real_distribution<float> unit(0.f,1.f);
+		std::uniform_real_distribution<float> alpha(0.05f,0.5f);
+		SFragment fragment;
+		for (auto c=0u; c<3u; c++)
+			fragment.color[c] = unit(mt);
+		fragment.alpha = alpha(mt);
+		fragment.depth = unit(mt);
+		return fragment;
+	}
+
+	// every pixel gets as many fragments as `count` returns for it
+	template<typename F>
+	SDistribution createPerPixel(const char* name, F&& count) const
+	{
+		std::mt19937 mt(0x45u);
+		SDistribution distribution = {name};
+		distribution.offsets.reserve(width*height+1u);
+		distribution.offsets.push_back(0u);
+		for (auto i=0u; i<width*height; i++)
+		{
+			for (auto n=count(mt); n; n--)
+				distribution.fragments.push_back(createFragment(mt));
+			distribution.offsets.push_back(static_cast<uint32_t>(distribution.fragments.size()));
+		}
+		return distribution;
+	}
+
+	SDistribution createConstant() const
+	{
+		return createPerPixel("constant",[&](std::mt19937&) -> uint32_t {return depthComplexity;});
+	}
+
+	SDistribution createPoisson() const
+	{
+		std::poisson_distribution<uint32_t> poisson(depthComplexity);
+		return createPerPixel("poisson",[&](std::mt19937& mt) -> uint32_t {return poisson(mt);});
+	}
+
+	// discs scattered normally around 4 emitters until there's as many fragments as the other distributions have
+	SDistribution createParticles() const
+	{
+		struct SParticle
+		{
+			int32_t minX, maxX, minY, maxY;
+			float x, y, radius;
+			SFragment fragment;
+		};
+		std::mt19937 mt(0x45u);
+		std::uniform_real_distribution<float> unit(0.f,1.f);
+		std::normal_distribution<float> normal(0.f,float(width)/16.f);
+		float emitters[4][2];
+		for (auto& emitter : emitters)
+		{
+			emitter[0] = float(width)*(0.25f+0.5f*unit(mt));
+			emitter[1] = float(height)*(0.25f+0.5f*unit(mt));
+		}
+
+		const uint64_t fragmentCount = uint64_t(depthComplexity)*width*height;
+		core::vector<SParticle> particles;
+		core::vector<uint32_t> counts(width*height,0u);
+		for (uint64_t covered=0ull; covered<fragmentCount;)
+		{
+			SParticle particle;
+			const auto& emitter = emitters[particles.size()%4u];
+			particle.x = emitter[0]+normal(mt);
+			particle.y = emitter[1]+normal(mt);
+			particle.radius = float(width)*(0.005f+0.02f*unit(mt));
+			particle.minX = std::max<int32_t>(particle.x-particle.radius,0);
+			particle.maxX = std::min<int32_t>(particle.x+particle.radius,int32_t(width)-1);
+			particle.minY = std::max<int32_t>(particle.y-particle.radius,0);
+			particle.maxY = std::min<int32_t>(particle.y+particle.radius,int32_t(height)-1);
+			particle.fragment = createFragment(mt);
+			forEachCoveredPixel(particle,[&](const uint32_t pixel) -> void {counts[pixel]++; covered++;});
+			particles.push_back(particle);
+		}
+
+		SDistribution distribution = {"particles"};
+		distribution.offsets.resize(width*height+1u);
+		distribution.offsets[0] = 0u;
+		std::inclusive_scan(counts.begin(),counts.end(),distribution.offsets.begin()+1u);
+		distribution.fragments.resize(distribution.offsets.back());
+		std::copy(distribution.offsets.begin(),distribution.offsets.end()-1u,counts.begin());
+		for (const auto& particle : particles)
+			forEachCoveredPixel(particle,[&](const uint32_t pixel) -> void {distribution.fragments[counts[pixel]++] = particle.fragment;});
+		return distribution;
+	}
+
+	template<typename Particle, typename F>
+	void forEachCoveredPixel(const Particle& particle, F&& f) const
+	{
+		for (int32_t y=particle.minY; y<=particle.maxY; y++)
+		for (int32_t x=particle.minX; x<=particle.maxX; x++)
+		{
+			const float dx = float(x)+0.5f-particle.x;
+			const float dy = float(y)+0.5f-particle.y;
+			if (dx*dx+dy*dy<=particle.radius*particle.radius)
+				f(y*width+x);
+		}
+	}
+
+	void report(const char* what, const bool passed)
+	{
+		printf("%-56s | %s\n",what,passed ? "PASSED":"FAILED");
+		allPassed = allPassed && passed;
+	}
+
+	void onAppTerminated_impl() override
+	{
+	}
+
+	void workLoopBody() override
+	{
+	}
+
+	bool keepRunning() override
+	{
+		return false;
+	}
+};
+
+NBL_COMMON_API_MAIN(OITNodeBudgetAnalysisApp)
@@ -0,0 +1,343 @@
+#ifndef _C_SPIRV_COMPILE_CACHE_INCLUDED_
+#define _C_SPIRV_COMPILE_CACHE_INCLUDED_
+
+#include "nabla.h"
+
+#include <mutex>
+#include <atomic>
+#include <future>
+#include <thread>
+#include <chrono>
+#include <fstream>
+#include <filesystem>
+#include <unordered_map>
+#include <algorithm>
+#include <cstdlib>
+#ifdef _NBL_PLATFORM_WINDOWS_
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+
+// Content addressed cache in front of `CCompilerSet::compileToSPIRV`, in memory and on disk, so identical shaders only ever get compiled once.
+//
+// The key is the preprocessed source, which already has every include resolved and the extra defines inserted, plus the compile options
+// which change the output (stage, SPIR-V version, debug info flags, whether an optimizer runs) and the compiler version. The compiler is
+// statically linked into the examples, so by default the version is the size and timestamp of the executable.
+// Concurrent requests for the same key wait for the one compile already in flight instead of starting their own.
+//
+// One file per key, named after the key's hash: `SHeader`, the whole key, then the SPIR-V. The key gets compared in full when loading so
+// a hash collision is only a miss, files which are truncated or fail the checksum get recompiled and overwritten.
+// Every disk hit bumps the file's modification time. Creating a cache trims the directory to `maxDirectorySize` by deleting the least
+// recently used files first, so entries of old compiler versions and stale sources age out. It also deletes temporary files crashed
+// processes left behind.
+class CSPIRVCompileCache : public nbl::core::IReferenceCounted
+{
+	public:
+		static inline constexpr uint32_t Magic = 0x43565053u; // "SPVC"
+		static inline constexpr uint32_t Version = 1u;
+		static inline constexpr uint64_t DefaultMaxDirectorySize = 256ull<<20ull;
+
+		struct SHeader
+		{
+			uint32_t magic;
+			uint32_t version;
+			uint64_t keySize;
+			uint64_t spirvSize;
+			uint64_t spirvChecksum;
+		};
+
+		struct SStats
+		{
+			std::atomic_uint32_t memoryHits = 0u;
+			std::atomic_uint32_t diskHits = 0u;
+			std::atomic_uint32_t misses = 0u;
+			// on disk but truncated, corrupted, from another version or a hash collision
+			std::atomic_uint32_t invalidated = 0u;
+			// waited for the same key being compiled on another thread
+			std::atomic_uint32_t deduplicated = 0u;
+			// times the compiler actually ran
+			std::atomic_uint32_t compiles = 0u;
+			// files deleted to stay under the directory size cap
+			std::atomic_uint32_t evicted = 0u;
+		};
+
+		// An empty `directory` only caches in memory.
+		CSPIRVCompileCache(
+			nbl::core::smart_refctd_ptr<nbl::asset::CCompilerSet>&& _compilerSet, const std::filesystem::path& _directory,
+			std::string&& _compilerVersion=getDefaultCompilerVersion(), const uint64_t _maxDirectorySize=DefaultMaxDirectorySize
+		) : compilerSet(std::move(_compilerSet)), directory(_directory), compilerVersion(std::move(_compilerVersion)), maxDirectorySize(_maxDirectorySize)
+		{
+			if (!directory.empty())
+			{
+				std::error_code error;
+				std::filesystem::create_directories(directory,error);
+				trimDirectory();
+			}
+		}
+
+		// Drop-in for `CCompilerSet::compileToSPIRV`, shaders which already are SPIR-V get passed straight through.
+		nbl::core::smart_refctd_ptr<nbl::asset::ICPUShader> compileToSPIRV(const nbl::asset::ICPUShader* shader, const nbl::asset::IShaderCompiler::SCompilerOptions& options)
+		{
+			if (!shader || shader->getContentType()==nbl::asset::IShader::E_CONTENT_TYPE::ECT_SPIRV)
+				return compilerSet->compileToSPIRV(shader,options);
+
+			auto preprocessed = compilerSet->preprocessShader(shader,options.preprocessorOptions);
+			if (!preprocessed)
+				return nullptr;
+			std::string key = makeKey(preprocessed.get(),options);
+
+			std::promise<nbl::core::smart_refctd_ptr<nbl::asset::ICPUShader>> promise;
+			{
+				std::unique_lock lock(mutex);
+				auto found = entries.find(key);
+				if (found!=entries.end())
+				{
+					auto future = found->second;
+					lock.unlock();
+					if (future.wait_for(std::chrono::seconds(0))==std::future_status::ready)
+						stats.memoryHits++;
+					else
+						stats.deduplicated++;
+					return future.get();
+				}
+				entries.emplace(key,promise.get_future().share());
+			}
+
+			nbl::core::smart_refctd_ptr<nbl::asset::ICPUShader> spirv;
+			try
+			{
+				const auto path = getPath(key);
+				spirv = load(path,key,options.stage,shader->getFilepathHint());
+				if (spirv)
+					stats.diskHits++;
+				else
+				{
+					stats.misses++;
+					// already preprocessed, there are no includes left to resolve
+					auto compileOptions = options;
+					compileOptions.preprocessorOptions.includeFinder = nullptr;
+					stats.compiles++;
+					spirv = compilerSet->compileToSPIRV(preprocessed.get(),compileOptions);
+					if (spirv)
+						save(path,key,spirv.get());
+				}
+			}
+			catch (...)
+			{
+				// the threads waiting for this key rethrow it too, the next request tries again
+				promise.set_exception(std::current_exception());
+				forget(key);
+				throw;
+			}
+			promise.set_value(spirv);
+			// failures get retried by the next request, as the log of why it failed is more useful than a silent null
+			if (!spirv)
+				forget(key);
+			return spirv;
+		}
+
+		inline const SStats& getStats() const {return stats;}
+		inline const std::filesystem::path& getDirectory() const {return directory;}
+
+		// Forgets everything compiled in this process, the files on disk stay.
+		inline void clearMemory()
+		{
+			std::lock_guard lock(mutex);
+			entries.clear();
+		}
+
+		// Deletes the least recently used files until the directory fits in `maxDirectorySize`, and temporary files older than an hour.
+		void trimDirectory()
+		{
+			if (directory.empty())
+				return;
+			struct SFile
+			{
+				std::filesystem::path path;
+				std::filesystem::file_time_type time;
+				uint64_t size;
+			};
+			std::vector<SFile> files;
+			uint64_t totalSize = 0ull;
+			const auto staleTemporary = std::filesystem::file_time_type::clock::now()-std::chrono::hours(1);
+			std::error_code error;
+			for (const auto& entry : std::filesystem::directory_iterator(directory,error))
+			{
+				if (!entry.is_regular_file(error))
+					continue;
+				SFile file = {entry.path(),entry.last_write_time(error),entry.file_size(error)};
+				if (error)
+					continue;
+				if (file.path.extension()==".tmp")
+				{
+					// a process which crashed in the middle of `save`
+					if (file.time<staleTemporary)
+						std::filesystem::remove(file.path,error);
+				}
+				else if (file.path.extension()==".spv")
+				{
+					totalSize += file.size;
+					files.push_back(std::move(file));
+				}
+			}
+			std::sort(files.begin(),files.end(),[](const SFile& lhs, const SFile& rhs) -> bool {return lhs.time<rhs.time;});
+			for (auto it=files.begin(); it!=files.end() && totalSize>maxDirectorySize; it++)
+			{
+				if (std::filesystem::remove(it->path,error))
+				{
+					totalSize -= it->size;
+					stats.evicted++;
+				}
+			}
+		}
+
+		static inline std::string getDefaultCompilerVersion()
+		{
+			std::filesystem::path executable;
+			std::error_code error;
+			#ifdef _NBL_PLATFORM_WINDOWS_
+			wchar_t* path = nullptr;
+			if (_get_wpgmptr(&path)==0 && path)
+				executable = path;
+			#else
+			executable = std::filesystem::read_symlink("/proc/self/exe",error);
+			#endif
+			const auto size = std::filesystem::file_size(executable,error);
+			if (error)
+				return "unknown";
+			const auto time = std::filesystem::last_write_time(executable,error);
+			return std::to_string(size)+"-"+std::to_string(time.time_since_epoch().count());
+		}
+
+		// the file a key gets stored in, exposed so tests can corrupt it
+		inline std::filesystem::path getPath(const std::string& key) const
+		{
+			if (directory.empty())
+				return {};
+			char name[17];
+			snprintf(name,sizeof(name),"%016llx",static_cast<unsigned long long>(hash(key.data(),key.size())));
+			return directory/(std::string(name)+".spv");
+		}
+		std::string makeKey(const nbl::asset::ICPUShader* preprocessed, const nbl::asset::IShaderCompiler::SCompilerOptions& options) const
+		{
+			std::string key = "compiler "+compilerVersion;
+			key += "\nstage "+std::to_string(static_cast<uint32_t>(options.stage));
+			key += "\nspirv "+std::to_string(static_cast<uint32_t>(options.targetSpirvVersion));
+			key += "\ndebug "+std::to_string(static_cast<uint32_t>(options.debugInfoFlags.value));
+			// the passes aren't known, only that something runs, caches with different optimizers need different directories
+			key += "\noptimizer "+std::to_string(options.spirvOptimizer ? 1u:0u);
+			key += "\ncontent "+std::to_string(static_cast<uint32_t>(preprocessed->getContentType()));
+			key += "\nsource\n";
+			const auto* content = preprocessed->getContent();
+			// preprocessed sources are null terminated, which doesn't belong in the key
+			size_t size = content->getSize();
+			const char* source = reinterpret_cast<const char*>(content->getPointer());
+			while (size && source[size-1u]=='\0')
+				size--;
+			key.append(source,size);
+			return key;
+		}
+
+		// FNV-1a
+		static inline uint64_t hash(const void* data, const size_t size)
+		{
+			uint64_t retval = 0xcbf29ce484222325ull;
+			for (size_t i=0ull; i<size; i++)
+			{
+				retval ^= reinterpret_cast<const uint8_t*>(data)[i];
+				retval *= 0x100000001b3ull;
+			}
+			return retval;
+		}
+
+	private:
+		nbl::core::smart_refctd_ptr<nbl::asset::ICPUShader> load(const std::filesystem::path& path, const std::string& key, const nbl::asset::IShader::E_SHADER_STAGE stage, const std::string& filepathHint)
+		{
+			if (path.empty())
+				return nullptr;
+			std::ifstream file(path,std::ios::binary);
+			if (!file)
+				return nullptr;
+			auto invalid = [&]() -> nbl::core::smart_refctd_ptr<nbl::asset::ICPUShader>
+			{
+				stats.invalidated++;
+				return nullptr;
+			};
+
+			SHeader header;
+			if (!file.read(reinterpret_cast<char*>(&header),sizeof(header)) || header.magic!=Magic || header.version!=Version || header.keySize!=key.size())
+				return invalid();
+			std::string storedKey(key.size(),'\0');
+			if (!file.read(storedKey.data(),storedKey.size()) || storedKey!=key)
+				return invalid();
+			if (header.spirvSize==0ull || header.spirvSize%sizeof(uint32_t))
+				return invalid();
+			auto spirv = nbl::core::make_smart_refctd_ptr<nbl::asset::ICPUBuffer>(header.spirvSize);
+			if (!file.read(reinterpret_cast<char*>(spirv->getPointer()),header.spirvSize) || hash(spirv->getPointer(),header.spirvSize)!=header.spirvChecksum)
+				return invalid();
+			file.close();
+			// what `trimDirectory` goes by
+			std::error_code error;
+			std::filesystem::last_write_time(path,std::filesystem::file_time_type::clock::now(),error);
+			return nbl::core::make_smart_refctd_ptr<nbl::asset::ICPUShader>(std::move(spirv),stage,nbl::asset::IShader::E_CONTENT_TYPE::ECT_SPIRV,std::string(filepathHint));
+		}
+
+		// written to a temporary file and renamed over, so other processes sharing the directory never see a partial file
+		void save(const std::filesystem::path& path, const std::string& key, const nbl::asset::ICPUShader* spirv)
+		{
+			if (path.empty())
+				return;
+			const auto* content = spirv->getContent();
+			SHeader header;
+			header.magic = Magic;
+			header.version = Version;
+			header.keySize = key.size();
+			header.spirvSize = content->getSize();
+			header.spirvChecksum = hash(content->getPointer(),content->getSize());
+
+			// unique per process and thread, other processes may be saving the same key into a shared directory
+			#ifdef _NBL_PLATFORM_WINDOWS_
+			const auto pid = _getpid();
+			#else
+			const auto pid = getpid();
+			#endif
+			auto temporary = path;
+			temporary += "."+std::to_string(pid)+"."+std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()))+".tmp";
+			{
+				std::ofstream file(temporary,std::ios::binary|std::ios::trunc);
+				file.write(reinterpret_cast<const char*>(&header),sizeof(header));
+				file.write(key.data(),key.size());
+				file.write(reinterpret_cast<const char*>(content->getPointer()),content->getSize());
+				if (!file)
+				{
+					file.close();
+					std::error_code error;
+					std::filesystem::remove(temporary,error);
+					return;
+				}
+			}
+			std::error_code error;
+			std::filesystem::rename(temporary,path,error);
+			if (error)
+				std::filesystem::remove(temporary,error);
+		}
+
+		inline void forget(const std::string& key)
+		{
+			std::lock_guard lock(mutex);
+			entries.erase(key);
+		}
+
+		nbl::core::smart_refctd_ptr<nbl::asset::CCompilerSet> compilerSet;
+		const std::filesystem::path directory;
+		const std::string compilerVersion;
+		const uint64_t maxDirectorySize;
+
+		std::mutex mutex;
+		std::unordered_map<std::string,std::shared_future<nbl::core::smart_refctd_ptr<nbl::asset::ICPUShader>>> entries;
+		SStats stats;
+};
+
+#endif
@@ -0,0 +1,271 @@
+#ifndef _C_SHADER_PERMUTATION_COMPILER_INCLUDED_
+#define _C_SHADER_PERMUTATION_COMPILER_INCLUDED_
+
+#include "nabla.h"
+
+#include <mutex>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+
+#include "CSPIRVCompileCache.h"
+
+
+// Compiles batches of shader permutations (source file, stage, set of defines) in parallel and remembers which files each one included,
+// so that after editing a header `build()` only recompiles the permutations which actually include it.
+//
+// The include graph comes from scanning `#include` lines, quoted includes get looked up next to the including file and then in
+// `includeDirectories`, angled ones only in `includeDirectories`. Whatever can't be found there is assumed to be a builtin, which only
+// changes together with the executable and is covered by the compile cache's compiler version. Includes inside inactive `#if` blocks
+// still count as dependencies, that only costs a recompile which then hits the compile cache.
+// A file counts as changed when its size or modification time did.
+class CShaderPermutationCompiler : public nbl::core::IReferenceCounted
+{
+	public:
+		struct SPermutation
+		{
+			std::filesystem::path path;
+			nbl::asset::IShader::E_SHADER_STAGE stage;
+			// "NAME" or "NAME VALUE", inserted after the `#version` directive
+			nbl::core::vector<std::string> defines;
+		};
+
+		// `options` provides everything apart from the stage and source identifier, usually just the include finder and logger
+		CShaderPermutationCompiler(nbl::core::smart_refctd_ptr<CSPIRVCompileCache>&& _cache, const nbl::asset::IShaderCompiler::SCompilerOptions& _options, nbl::core::vector<std::filesystem::path>&& _includeDirectories={})
+			: cache(std::move(_cache)), options(_options), includeDirectories(std::move(_includeDirectories)) {}
+
+		// doesn't compile anything yet, returns the index to get the SPIR-V with after `build()`
+		inline uint32_t add(SPermutation&& permutation)
+		{
+			entries.push_back({std::move(permutation)});
+			return entries.size()-1u;
+		}
+
+		// Compiles every permutation which never compiled successfully or has a dependency that changed since, returns how many that was.
+		uint32_t build()
+		{
+			nbl::core::unordered_map<std::string,SStamp> current;
+			nbl::core::vector<uint32_t> dirty;
+			for (auto i=0u; i<entries.size(); i++)
+			{
+				const auto& entry = entries[i];
+				bool changed = !entry.spirv;
+				for (auto it=entry.dependencies.begin(); !changed && it!=entry.dependencies.end(); it++)
+				{
+					auto found = current.find(it->first);
+					if (found==current.end())
+						found = current.emplace(it->first,getStamp(it->first)).first;
+					changed = found->second!=it->second;
+				}
+				if (changed)
+					dirty.push_back(i);
+			}
+
+			SScanState scan;
+			// not `par_unseq`, the compiles take locks and wait on the cache's futures
+			std::for_each(nbl::core::execution::par,dirty.begin(),dirty.end(),[&](const uint32_t i) -> void
+			{
+				compile(entries[i],scan);
+			});
+			return dirty.size();
+		}
+
+		inline uint32_t getPermutationCount() const {return entries.size();}
+		inline const SPermutation& getPermutation(const uint32_t ix) const {return entries[ix].permutation;}
+		// null if the last `build()` failed to compile it
+		inline const nbl::core::smart_refctd_ptr<nbl::asset::ICPUShader>& getSPIRV(const uint32_t ix) const {return entries[ix].spirv;}
+		inline CSPIRVCompileCache* getCache() const {return cache.get();}
+
+		// the source itself and everything it includes, directly or not, as of the last `build()`
+		nbl::core::vector<std::filesystem::path> getDependencies(const uint32_t ix) const
+		{
+			nbl::core::vector<std::filesystem::path> retval;
+			for (const auto& dependency : entries[ix].dependencies)
+				retval.push_back(dependency.first);
+			return retval;
+		}
+		// the permutations which would recompile if `path` changed
+		nbl::core::vector<uint32_t> getDependents(const std::filesystem::path& path) const
+		{
+			const auto key = normalize(path);
+			nbl::core::vector<uint32_t> retval;
+			for (auto i=0u; i<entries.size(); i++)
+			for (const auto& dependency : entries[i].dependencies)
+			if (dependency.first==key)
+			{
+				retval.push_back(i);
+				break;
+			}
+			return retval;
+		}
+
+	private:
+		struct SStamp
+		{
+			uint64_t size = ~0ull;
+			int64_t time = 0;
+
+			inline bool operator!=(const SStamp& other) const {return size!=other.size || time!=other.time;}
+		};
+		struct SEntry
+		{
+			SPermutation permutation;
+			nbl::core::smart_refctd_ptr<nbl::asset::ICPUShader> spirv = nullptr;
+			nbl::core::vector<std::pair<std::string,SStamp>> dependencies = {};
+		};
+		struct SScannedFile
+		{
+			SStamp stamp;
+			nbl::core::vector<std::string> includes;
+		};
+		// files get scanned once per `build()`, no matter how many permutations include them
+		struct SScanState
+		{
+			std::mutex mutex;
+			nbl::core::unordered_map<std::string,SScannedFile> files;
+		};
+
+		static inline std::string normalize(const std::filesystem::path& path)
+		{
+			std::error_code error;
+			auto absolute = std::filesystem::absolute(path,error);
+			return (error ? path:absolute).lexically_normal().string();
+		}
+
+		static inline SStamp getStamp(const std::string& path)
+		{
+			SStamp retval;
+			std::error_code error;
+			const auto size = std::filesystem::file_size(path,error);
+			if (error)
+				return retval;
+			const auto time = std::filesystem::last_write_time(path,error);
+			if (error)
+				return retval;
+			retval.size = size;
+			retval.time = time.time_since_epoch().count();
+			return retval;
+		}
+
+		static inline bool readFile(const std::string& path, std::string& content)
+		{
+			std::ifstream file(path,std::ios::binary);
+			if (!file)
+				return false;
+			std::stringstream stream;
+			stream << file.rdbuf();
+			content = stream.str();
+			return true;
+		}
+
+		// only the direct includes which exist on disk
+		SScannedFile scanFile(const std::string& path, const std::string& content) const
+		{
+			SScannedFile retval;
+			const auto directory = std::filesystem::path(path).parent_path();
+			std::istringstream lines(content);
+			std::string line;
+			while (std::getline(lines,line))
+			{
+				auto it = line.find_first_not_of(" \t");
+				if (it==std::string::npos || line[it]!='#')
+					continue;
+				it = line.find_first_not_of(" \t",it+1u);
+				if (it==std::string::npos || line.compare(it,7u,"include")!=0)
+					continue;
+				it = line.find_first_not_of(" \t",it+7u);
+				if (it==std::string::npos || (line[it]!='"' && line[it]!='<'))
+					continue;
+				const bool quoted = line[it]=='"';
+				const auto end = line.find(quoted ? '"':'>',it+1u);
+				if (end==std::string::npos)
+					continue;
+				const std::filesystem::path name = line.substr(it+1u,end-it-1u);
+
+				auto tryInclude = [&](const std::filesystem::path& candidate) -> bool
+				{
+					std::error_code error;
+					if (!std::filesystem::is_regular_file(candidate,error))
+						return false;
+					retval.includes.push_back(normalize(candidate));
+					return true;
+				};
+				if (quoted && tryInclude(directory/name))
+					continue;
+				for (const auto& includeDirectory : includeDirectories)
+				if (tryInclude(includeDirectory/name))
+					break;
+			}
+			return retval;
+		}
+
+		void compile(SEntry& entry, SScanState& scan) const
+		{
+			const auto& permutation = entry.permutation;
+			const auto path = normalize(permutation.path);
+			entry.spirv = nullptr;
+			entry.dependencies.clear();
+
+			// stamps get taken before reading, so a file edited during the build gets picked up by the next one
+			std::string source;
+			nbl::core::vector<std::string> pending = {path};
+			nbl::core::unordered_set<std::string> visited = {path};
+			while (!pending.empty())
+			{
+				const std::string file = std::move(pending.back());
+				pending.pop_back();
+
+				std::unique_lock lock(scan.mutex);
+				auto found = scan.files.find(file);
+				if (found==scan.files.end())
+				{
+					lock.unlock();
+					const auto stamp = getStamp(file);
+					std::string content;
+					SScannedFile scanned;
+					if (readFile(file,content))
+						scanned = scanFile(file,content);
+					scanned.stamp = stamp;
+					if (file==path)
+						source = std::move(content);
+					lock.lock();
+					found = scan.files.emplace(file,std::move(scanned)).first;
+				}
+				else if (file==path)
+				{
+					lock.unlock();
+					readFile(file,source);
+					lock.lock();
+				}
+				entry.dependencies.emplace_back(file,found->second.stamp);
+				for (const auto& include : found->second.includes)
+				if (visited.insert(include).second)
+					pending.push_back(include);
+			}
+			if (source.empty())
+			{
+				options.preprocessorOptions.logger.log("Could not read shader permutation source %s",nbl::system::ILogger::ELL_ERROR,path.c_str());
+				return;
+			}
+
+			auto shader = nbl::core::make_smart_refctd_ptr<nbl::asset::ICPUShader>(source.c_str(),permutation.stage,nbl::asset::IShader::E_CONTENT_TYPE::ECT_GLSL,std::string(path));
+			if (!permutation.defines.empty())
+			{
+				std::string defines;
+				for (const auto& define : permutation.defines)
+					defines += "#define "+define+"\n";
+				shader = nbl::asset::CGLSLCompiler::createOverridenCopy(shader.get(),"%s",defines.c_str());
+			}
+			auto compileOptions = options;
+			compileOptions.stage = permutation.stage;
+			compileOptions.preprocessorOptions.sourceIdentifier = path;
+			entry.spirv = cache->compileToSPIRV(shader.get(),compileOptions);
+		}
+
+		nbl::core::smart_refctd_ptr<CSPIRVCompileCache> cache;
+		const nbl::asset::IShaderCompiler::SCompilerOptions options;
+		const nbl::core::vector<std::filesystem::path> includeDirectories;
+		nbl::core::vector<SEntry> entries;
+};
+
+#endif